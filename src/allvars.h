@@ -30,6 +30,8 @@
 #include <map>
 #include <unordered_map>
 #include <bitset>
+#include <functional>
+#include <memory>
 #include <getopt.h>
 #include <sys/stat.h>
 #include <sys/timeb.h>
@@ -251,6 +253,11 @@ typedef void (*ExtraPropFunc)(double, double, double&);
 ///diferent methods for calculating approximate potential
 #define POTAPPROXMETHODTREE 0
 #define POTAPPROXMETHODRAND 1
+///different methods for walking the tree when calculating the tree potential
+///walk the tree for every particle using monopole cell moments
+#define POTTREEMETHODPARTICLE 0
+///walk the tree once for every group of particles (sink cell) using quadrupole cell moments
+#define POTTREEMETHODGROUP 1
 
 ///when unbinding check to see if system is bound and least bound particle is also bound
 #define USYSANDPART 0
@@ -278,6 +285,8 @@ typedef void (*ExtraPropFunc)(double, double, double&);
 #define splitflag -1
 ///cellflag means a node that is not necessarily a leaf node can be approximated by mono-pole
 #define cellflag 0
+///number of independent components stored for the traceless quadrupole moment of a cell (xx,yy,zz,xy,xz,yz)
+#define NQUADCOMP 6
 
 //@}
 
@@ -313,6 +322,33 @@ typedef void (*ExtraPropFunc)(double, double, double&);
 #define PROFILERBINTYPELOG 0
 //@}
 
+///\defgroup particle properties by which \ref SortParticles orders particles, each replacing a comparison function
+//@{
+///IDCompare
+#define PSORTID 0
+///PIDCompare
+#define PSORTPID 1
+///TypeCompare
+#define PSORTTYPE 2
+///RadCompare
+#define PSORTRADIUS 3
+///PotCompare
+#define PSORTPOTENTIAL 4
+///DenCompare
+#define PSORTDENSITY 5
+//@}
+
+///\defgroup MPI mesh decomposition parameters
+//@{
+///space filling curves used to order the cells of the mesh
+#define MPIMESHCURVEMORTON 0
+#define MPIMESHCURVEHILBERT 1
+///what the load of a mesh cell is taken to be, its number of particles, a density weighted estimate or the measured cost
+#define MPIMESHWEIGHTNUMPARTS 0
+#define MPIMESHWEIGHTDENSITY 1
+#define MPIMESHWEIGHTMEASURED 2
+//@}
+
 ///\defgroup GASPARAMS Useful constants for gas
 //@{
 ///mass of helium relative to hydrogen
@@ -357,6 +393,12 @@ struct UnbindInfo
     //@{
     int BucketSize;
     Double_t TreeThetaOpen;
+    ///how the tree is walked, per particle (\ref POTTREEMETHODPARTICLE) or per group of particles (\ref POTTREEMETHODGROUP)
+    int TreeWalkMethod;
+    ///maximum number of particles in a sink cell that shares a single tree walk
+    int TreeGroupSize;
+    ///whether the tree of large groups is kept across unbinding iterations and the potential updated incrementally
+    int iincrementalpot;
     ///softening length
     Double_t eps;
     ///whether to calculate approximate potential energy
@@ -379,6 +421,9 @@ struct UnbindInfo
         minEfrac=1.0;
         BucketSize=8;
         TreeThetaOpen=0.5;
+        TreeWalkMethod=POTTREEMETHODGROUP;
+        TreeGroupSize=32;
+        iincrementalpot=1;
         eps=0.0;
         Npotref=20;
         fracpotref=1.0;
@@ -441,6 +486,12 @@ struct Options
     int iseparatefiles = 0;
     ///for output specify the format HDF, binary or ascii \ref OUTHDF, \ref OUTBINARY, \ref OUTASCII
     int ibinaryout = 0;
+    ///fill every property column into a structure-of-arrays store before writing the properties file
+    int ipropertycolumnstore = 0;
+    ///write catalogues on a background thread while the next stage continues
+    int iasyncoutput = 0;
+    ///memory budget of the output buffers waiting to be written asynchronously
+    long long asyncoutputbufsize = 4LL*1024*1024*1024;
     ///for extended output allowing extraction of particles
     int iextendedoutput = 0;
     /// output extra fields in halo properties
@@ -470,6 +521,8 @@ struct Options
     /// mpi paritcle buffer size when sending input particle information
     long long mpiparticletotbufsize = -1;
     long long mpiparticlebufsize = -1;
+    /// maximum number of particle buffers a read task has in flight to non-read tasks
+    int mpireadsendsinflight = 4;
     /// mpi factor by which to multiple the memory allocated, ie: buffer region
     /// to reduce likelihood of having to expand/allocate new memory
     Double_t mpipartfac = 0.1;
@@ -534,6 +587,8 @@ struct Options
     ///\name parameters that control the local and average volumes used to calculate the local velocity density and the mean field, also the size of the leafnode in the kd-tree used when searching the tree for fof neighbours
     //@{
     int iLocalVelDenApproxCalcFlag = 2;
+    ///whether the local velocity density searches the particles in a leaf of the tree together
+    int iLocalVelDenBatchedSearch = 1;
     int Nvel = 32;
     int Nsearch = 256;
     int Bsize = 32;
@@ -764,7 +819,7 @@ struct Options
     /*! Holds the node ID of each top-level cell. */
     std::vector<int> cellnodeids;
 
-    /// holds the order of cells based on z-curve decomposition;
+    /// holds the order of cells along the space filling curve of the decomposition;
     vector<int> cellnodeorder;
 
     /// holds the number of particles in a given top-level cell
@@ -780,6 +835,17 @@ struct Options
     ///whether using mesh decomposition
     bool impiusemesh = true;
 
+    ///space filling curve along which mesh cells are assigned to tasks
+    int mpimeshcurve = MPIMESHCURVEMORTON;
+    ///how the load of each mesh cell is estimated when repartitioning
+    int mpimeshweighting = MPIMESHWEIGHTNUMPARTS;
+    ///file storing the measured cost of each mesh cell, written after the analysis and read when repartitioning
+    string mpimeshcostfile;
+
+    ///whether particles are binned into the mesh as they are read and then exchanged,
+    ///instead of counting the particles in each domain before reading
+    bool impisinglepassload = false;
+
     //@}
 
     /// \name options related to calculation of aperture/profile
@@ -1043,6 +1109,36 @@ struct Options
     bool inputcontainslittleh = true;
 };
 
+/*! Members of \ref Options that are updated while an object is searched for substructure. Objects searched in
+    parallel share one copy of the rest of the configuration per thread and only reset this context between objects.
+*/
+struct SearchContext{
+    Int_t Ncell;
+    int MinSize, HaloMinSize;
+    Int_t num3dfof;
+    Double_t HaloSigmaV, HaloVelDispScale, HaloLocalSigmaV;
+
+    SearchContext(const Options &opt){
+        Ncell = opt.Ncell;
+        MinSize = opt.MinSize;
+        HaloMinSize = opt.HaloMinSize;
+        num3dfof = opt.num3dfof;
+        HaloSigmaV = opt.HaloSigmaV;
+        HaloVelDispScale = opt.HaloVelDispScale;
+        HaloLocalSigmaV = opt.HaloLocalSigmaV;
+    }
+    ///reset the search state of opt to that stored in the context
+    void Apply(Options &opt) const {
+        opt.Ncell = Ncell;
+        opt.MinSize = MinSize;
+        opt.HaloMinSize = HaloMinSize;
+        opt.num3dfof = num3dfof;
+        opt.HaloSigmaV = HaloSigmaV;
+        opt.HaloVelDispScale = HaloVelDispScale;
+        opt.HaloLocalSigmaV = HaloLocalSigmaV;
+    }
+};
+
 struct ConfigInfo{
     //list the name of the info
     vector<string> nameinfo;
@@ -1254,8 +1350,10 @@ struct GridCell
     Double_t xm[6], xbl[6],xbu[6];
     //mass, radial size of in cell
     Double_t mass, rsize;
-    //number of particles in cell
+    //number of particles in cell and their indices, which point into the index buffer shared by the cells of the grid
     Int_t nparts,*nindex;
+    //start of the shared index buffer, which is freed with the grid
+    Int_t *indexbuffer;
     //neighbouring grid cells and distance from cell centers
     Int_t nnidcells[MAXNGRID];
     Double_t nndist[MAXNGRID];
@@ -1263,11 +1361,10 @@ struct GridCell
     GridCell(int N=3){
         ndim=N;
         nparts=0;
+        nindex=NULL;
+        indexbuffer=NULL;
         den=0;
     }
-    ~GridCell(){
-        if (nparts>0)delete[] nindex;
-    }
 };
 
 /*! structure stores bulk properties like
@@ -2558,13 +2655,6 @@ struct PropData
         }
     }
 
-    void WriteBinary(fstream &Fout, Options &opt);
-    void WriteAscii(fstream &Fout, Options &opt);
-    ///write (append) the properties data to an already open ascii file
-#ifdef USEHDF
-    ///write (append) the properties data to an already open hdf file
-    //void WriteHDF(H5File &Fhdf, DataSpace *&dataspaces, DataSet *&datasets, Options&opt){};
-#endif
 };
 
 
@@ -2586,9 +2676,8 @@ struct HeaderUnitInfo{
     HeaderUnitInfo(string s);
 };
 
-/*! Structures stores header info of the data writen by the \ref PropData data structure,
-    specifically the \ref PropData::WriteBinary, \ref PropData::WriteAscii, \ref PropData::WriteHDF routines
-    Must ensure that these routines are all altered together so that the io makes sense.
+/*! Structures stores header info of the data writen by the \ref PropData data structure.
+    Entries must be declared in the same order as the columns of \ref PropDataColumns so that the io makes sense.
 */
 struct PropDataHeader{
     //list the header info
@@ -2630,6 +2719,49 @@ struct PropDataHeader{
     static const HeaderUnitInfo TIME;
 };
 
+/*! Column registry of the \ref PropData data structure. Entry i extracts the value written to the
+    dataset \ref PropDataHeader::headerdatainfo[i], so the HDF, binary and ascii property outputs
+    are all produced from the same list of columns.
+*/
+class PropDataColumns{
+public:
+    PropDataColumns(Options &opt);
+
+    std::size_t size() const {return columns.size();}
+    ///size in bytes of a single value of a column
+    std::size_t element_size(std::size_t icol) const {return columns[icol].element_size;}
+    ///fill the contiguous buffer with the values of column icol for groups 1..ngroups of pdata
+    void fill(std::size_t icol, Int_t ngroups, PropData *pdata, void *buffer) const {columns[icol].fill(ngroups, pdata, buffer);}
+    ///write the i-th value of a filled column buffer as ascii
+    void write_ascii(std::size_t icol, std::ostream &out, const void *buffer, Int_t i) const {columns[icol].write_ascii(out, buffer, i);}
+
+private:
+    struct Column{
+        std::size_t element_size;
+        std::function<void(Int_t, PropData *, void *)> fill;
+        std::function<void(std::ostream &, const void *, Int_t)> write_ascii;
+    };
+    std::vector<Column> columns;
+
+    void declare_all_columns(Options &opt);
+
+    template <typename T, typename F>
+    void add_column(F value);
+};
+
+/*! Structure of arrays store of the properties of a contiguous range of groups, with each column
+    of \ref PropDataColumns held in its own contiguous buffer so it can be written without copying.
+*/
+struct PropDataColumnStore{
+    vector<vector<char>> buffers;
+
+    ///fills all columns for groups 1..ngroups of pdata, parallelised over blocks of groups
+    PropDataColumnStore(const PropDataColumns &columns, Int_t ngroups, PropData *pdata);
+
+    void *column(std::size_t icol) {return buffers[icol].data();}
+    const void *column(std::size_t icol) const {return buffers[icol].data();}
+};
+
 
 /*! Structures stores profile info of the data writen by the \ref PropData profiles data structures,
     specifically the \ref PropData::WriteProfileBinary, \ref PropData::WriteProfileAscii, \ref PropData::WriteProfileHDF routines
@@ -3163,6 +3295,50 @@ struct leaf_node_info{
 #endif
 };
 
+///Packed structure of arrays of particle positions and masses, built once per group so that
+///direct summation kernels can stream through contiguous memory and be vectorised
+struct PackedParticleData{
+    vector<Double_t> x, y, z, mass;
+    PackedParticleData(){}
+    PackedParticleData(Int_t nbodies, Particle *Part){
+        Fill(nbodies, Part);
+    }
+    void Fill(Int_t nbodies, Particle *Part){
+        x.resize(nbodies);
+        y.resize(nbodies);
+        z.resize(nbodies);
+        mass.resize(nbodies);
+        for (Int_t i=0;i<nbodies;i++) {
+            x[i]=Part[i].X();
+            y[i]=Part[i].Y();
+            z[i]=Part[i].Z();
+            mass[i]=Part[i].GetMass();
+        }
+    }
+};
+
+/*! Tree of a group that is kept alive across unbinding iterations. Particles removed in an iteration
+    are accumulated in the cells that contain them (mass, dipole and second moments about a fixed reference
+    point of each cell) so that their contribution can be subtracted from the potential of the remaining
+    particles without rebuilding the tree. See \ref UpdatePotentialForUnboundParticlesTree.
+*/
+struct IncrementalPotentialTree{
+    Int_t nbodies = 0, ncell = 0;
+    ///tree ordered positions and masses
+    PackedParticleData pdata;
+    ///map from particle PID to its index in tree order
+    unordered_map<Int_t, Int_t> pidindex;
+    ///particle range of every cell and its children (-1 for leaf cells)
+    vector<Int_t> start, end, left, right;
+    ///fixed reference point of every cell (cm at construction) and squared opening distance
+    vector<Coordinate> cellref;
+    vector<Double_t> cR2max;
+    ///moments of the particles removed in the current iteration, dipole has 3 and second moments \ref NQUADCOMP entries per cell
+    vector<Double_t> dmass, ddipole, dsecond;
+    ///0 if particle active, 1 if removed in the current iteration, 2 if removed in an earlier iteration
+    vector<char> removed;
+};
+
 ///if using MPI API
 #ifdef USEMPI
 #include <mpi.h>
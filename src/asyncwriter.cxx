@@ -0,0 +1,117 @@
+/**
+ * @file
+ *
+ * Background writer running output jobs on a dedicated I/O thread
+ */
+
+#include "asyncwriter.h"
+#include "ioutils.h"
+#include "logging.h"
+#include "timer.h"
+
+namespace vr
+{
+
+AsyncWriter::AsyncWriter(std::size_t max_bytes, bool asynchronous)
+  : max_bytes(max_bytes)
+{
+	if (asynchronous) {
+		thread = std::thread(&AsyncWriter::run, this);
+	}
+}
+
+AsyncWriter::~AsyncWriter()
+{
+	try {
+		flush();
+	}
+	catch (const std::exception &e) {
+		LOG(error) << "Asynchronous output failed: " << e.what();
+	}
+	if (thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		job_submitted.notify_one();
+		thread.join();
+	}
+}
+
+void AsyncWriter::submit(job_type job, std::size_t nbytes)
+{
+	if (!asynchronous()) {
+		job();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	// back-pressure: a job larger than the whole budget is still accepted, but only once the queue is empty
+	if (bytes_pending > 0 && bytes_pending + nbytes > max_bytes) {
+		Timer timer;
+		LOG(debug) << "Output buffers hold " << memory_amount(bytes_pending) << ", waiting for space";
+		job_finished.wait(lock, [&] { return bytes_pending == 0 || bytes_pending + nbytes <= max_bytes; });
+		LOG(debug) << "Waited " << timer << " for output buffer space";
+	}
+	jobs.push_back({std::move(job), nbytes});
+	bytes_pending += nbytes;
+	jobs_pending++;
+	lock.unlock();
+	job_submitted.notify_one();
+}
+
+void AsyncWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (jobs_pending > 0) {
+		Timer timer;
+		job_finished.wait(lock, [&] { return jobs_pending == 0; });
+		LOG(info) << "Waited " << timer << " for asynchronous output to finish";
+	}
+	if (error) {
+		auto e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+void AsyncWriter::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		job_submitted.wait(lock, [&] { return stopping || !jobs.empty(); });
+		if (jobs.empty()) {
+			return;
+		}
+		auto job = std::move(jobs.front());
+		jobs.pop_front();
+		lock.unlock();
+
+		// once a job has failed the output is incomplete, so later jobs are dropped until flush() reports it
+		bool failed;
+		{
+			std::lock_guard<std::mutex> error_lock(mutex);
+			failed = static_cast<bool>(error);
+		}
+		if (!failed) {
+			try {
+				Timer timer;
+				job.work();
+				LOG(debug) << "Asynchronous output job holding " << memory_amount(job.nbytes) << " written in " << timer;
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> error_lock(mutex);
+				error = std::current_exception();
+			}
+		}
+		// release whatever the job captured before its memory is given back to the budget
+		job.work = nullptr;
+
+		lock.lock();
+		bytes_pending -= job.nbytes;
+		jobs_pending--;
+		job_finished.notify_all();
+	}
+}
+
+}  // namespace vr
@@ -0,0 +1,86 @@
+/**
+ * @file
+ *
+ * Background writer running output jobs on a dedicated I/O thread
+ */
+
+#ifndef VR_ASYNCWRITER_H_
+#define VR_ASYNCWRITER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace vr {
+
+/**
+ * Runs output jobs in submission order on a single I/O thread so that the
+ * caller can carry on computing while data is written.
+ *
+ * Each job declares the amount of memory it holds until it has run. When the
+ * memory held by pending jobs would exceed the budget, submit() blocks until
+ * enough earlier jobs have finished. flush() waits for all submitted jobs and
+ * rethrows the first exception raised by any of them.
+ *
+ * A writer constructed as synchronous runs every job on submission, so calling
+ * code need not distinguish between the two modes.
+ */
+class AsyncWriter {
+
+public:
+
+	using job_type = std::function<void()>;
+
+	/**
+	 * @param max_bytes Memory budget of the jobs waiting to be written
+	 * @param asynchronous Whether to use a background thread at all
+	 */
+	AsyncWriter(std::size_t max_bytes, bool asynchronous = true);
+	~AsyncWriter();
+
+	AsyncWriter(const AsyncWriter &) = delete;
+	AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+	/**
+	 * Queues a job, blocking while the pending jobs hold more memory than the budget.
+	 *
+	 * @param job The work to run on the I/O thread, which owns whatever it captures
+	 * @param nbytes The memory held by the job until it has run
+	 */
+	void submit(job_type job, std::size_t nbytes = 0);
+
+	/// Waits until all submitted jobs have been written
+	void flush();
+
+	bool asynchronous() const { return thread.joinable(); }
+
+private:
+
+	struct pending_job {
+		job_type work;
+		std::size_t nbytes;
+	};
+
+	void run();
+
+	std::size_t max_bytes;
+	std::size_t bytes_pending {0};
+	std::size_t jobs_pending {0};
+	bool stopping {false};
+	std::deque<pending_job> jobs;
+	std::exception_ptr error;
+	std::mutex mutex;
+	std::condition_variable job_submitted;
+	std::condition_variable job_finished;
+	std::thread thread;
+
+};
+
+}  // namespace vr
+
+#endif // VR_ASYNCWRITER_H_
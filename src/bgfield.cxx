@@ -4,6 +4,8 @@
 
 //--  Background Velocity Routines
 
+#include <cassert>
+
 #include "logging.h"
 #include "stf.h"
 
@@ -75,13 +77,38 @@ private(i,vel) if (nbodies > ompsubsearchnum)
     return tree;
 }
 
+///Returns the leaf nodes of a tree in the order of the particles they hold, found in a single walk down from the root
+/*!
+    A node is a leaf if it holds no more particles than the bucket size of the tree, as in \ref GetNodeList.
+    The leaves therefore cover the particles in tree order with contiguous [start,end) ranges.
+*/
+vector<Node*> GetLeafNodeList(KDTree *tree)
+{
+    vector<Node*> leaves, stack;
+    const Int_t bsize=tree->GetBucketSize();
+    leaves.reserve(tree->GetNumLeafNodes());
+    stack.push_back(tree->GetRoot());
+    while (!stack.empty()) {
+        Node *np=stack.back();
+        stack.pop_back();
+        if (np->GetCount()>bsize) {
+            //right is pushed first so that left is visited first
+            stack.push_back(((SplitNode*)np)->GetRight());
+            stack.push_back(((SplitNode*)np)->GetLeft());
+        }
+        else leaves.push_back(np);
+    }
+    return leaves;
+}
+
 ///Fills the GridCell struct using KD-Tree initialized by \ref InitializeTreeGrid
+/*!
+    The indices of the particles of all cells are stored in a single buffer in the order of the cells, which
+    each cell points into, so that cell quantities are calculated streaming through the buffer.
+    The buffer is freed along with the grid by \ref FreeTreeGrid.
+*/
 void FillTreeGrid(Options &opt, const Int_t nbodies, const Int_t ngrid, KDTree *&tree, Particle *Part, GridCell* &grid)
-//void FillTreeGrid(Options &opt, const Int_t nbodies, const Int_t ngrid, KDTree *tree, Particle *Part, GridCell* grid, PartCellNum *pglist)
 {
-    Int_t gridcount=0,ncount=0;
-    //this is used to create tree and search for near neighbours
-    Particle *ptemp=new Particle[ngrid];
     int treetype=tree->GetTreeType();
     int ND;
     if (treetype==tree->TPHYS) ND=3;
@@ -89,57 +116,57 @@ void FillTreeGrid(Options &opt, const Int_t nbodies, const Int_t ngrid, KDTree *
 
     LOG(trace) << "Filling KD-Tree Grid";
 
-    //this loop works well for large cells but for small cells may have to replace this with a for loop which goes through every particle
-    //and stores nid and size of node, then builds grid based on these values and then places the particles in the cells.
-    //for leaf nodes, use starts and ends indices (ie what particles in the system are in the node)
-    while (ncount<nbodies) {
-        //check if particle is within start and end, if not just means that splitting is not perfect
-        //and this particle is left alone. Go to the next particle
-        Node *np=(tree->FindLeafNode((Int_t)ncount));
-        Int_t start=((LeafNode*)np)->GetStart();
-        Int_t end=((LeafNode*)np)->GetEnd();
-        //this while loop ensures that if there is a particle out of place, one still proceeds to move through
-        //the tree appropriately.
-        while (!(ncount>=start&&ncount<end))
-        {
-            ncount++;
-            np=(tree->FindLeafNode((Int_t)ncount));
-            start=((LeafNode*)np)->GetStart();
-            end=((LeafNode*)np)->GetEnd();
-        }
+    //the leaves cover the particles in tree order, so the index buffer is simply the ids of the particles in tree order
+    vector<Node*> leaves=GetLeafNodeList(tree);
+    assert((Int_t)leaves.size()==ngrid);
+    Int_t *gridindex=new Int_t[nbodies];
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbodies > ompsubsearchnum)
+#endif
+    for (Int_t k=0;k<nbodies;k++) gridindex[k]=Part[k].GetID();
 
-        grid[gridcount].ndim=ND;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic) if (nbodies > ompsubsearchnum)
+#endif
+    for (Int_t i=0;i<ngrid;i++) {
+        Node *np=leaves[i];
+        Int_t start=np->GetStart();
+        Int_t end=np->GetEnd();
+        grid[i].ndim=ND;
         //get center of mass and boundaries of grid cell
         for (int j=0;j<ND;j++) {
-            grid[gridcount].xm[j]=0.;
-            grid[gridcount].xbl[j]=np->GetBoundary(j,0);
-            grid[gridcount].xbu[j]=np->GetBoundary(j,1);
+            grid[i].xm[j]=0.;
+            grid[i].xbl[j]=np->GetBoundary(j,0);
+            grid[i].xbu[j]=np->GetBoundary(j,1);
         }
-        grid[gridcount].nparts=np->GetCount();
-        grid[gridcount].gid=np->GetID();
-        grid[gridcount].nindex=new Int_t[grid[gridcount].nparts];
+        grid[i].nparts=np->GetCount();
+        grid[i].gid=np->GetID();
+        grid[i].nindex=&gridindex[start];
+        grid[i].indexbuffer=gridindex;
 
         Double_t mtot=0.;
-        for (Int_t k=start,l=0;k<end;k++,l++){
-            Int_t id=Part[k].GetID();
-            grid[gridcount].nindex[l]=id;
+        for (Int_t k=start;k<end;k++){
             for (int j=0;j<ND;j++)
-                grid[gridcount].xm[j]+=Part[k].GetPosition(j)*Part[k].GetMass();
+                grid[i].xm[j]+=Part[k].GetPosition(j)*Part[k].GetMass();
             mtot+=Part[k].GetMass();
         }
-        grid[gridcount].mass=mtot;
-        ptemp[gridcount].SetMass(mtot);
+        grid[i].mass=mtot;
         mtot=1.0/mtot;
-        for (int j=0;j<ND;j++) grid[gridcount].xm[j]=grid[gridcount].xm[j]*mtot;
-        for (int j=0;j<ND;j++) ptemp[gridcount].SetPhase(j,grid[gridcount].xm[j]);
-        gridcount++; ncount=end;
+        for (int j=0;j<ND;j++) grid[i].xm[j]=grid[i].xm[j]*mtot;
     }
     //resets particle order
     delete tree;
-    delete[] ptemp;
     LOG(trace) << "Done";
 }
 
+///Frees a grid filled by \ref FillTreeGrid along with the index buffer shared by its cells
+void FreeTreeGrid(const Int_t ngrid, GridCell *grid)
+{
+    //all cells refer to the same buffer
+    if (ngrid>0 && grid[0].indexbuffer!=NULL) delete[] grid[0].indexbuffer;
+    delete[] grid;
+}
+
 //@}
 
 ///\name Calculate mean velocity distribution quantities
@@ -162,7 +189,8 @@ private(i,mtot) if (nbodies > ompsubsearchnum)
     for (i=0;i<ngrid;i++) {
         for (int k=0;k<3;k++) gvel[i][k]=0.;
         for (int j=0;j<grid[i].nparts;j++) {
-            for (int k=0;k<3;k++) gvel[i][k]+=Part[grid[i].nindex[j]].GetVelocity(k)*Part[grid[i].nindex[j]].GetMass();
+            Particle &p=Part[grid[i].nindex[j]];
+            for (int k=0;k<3;k++) gvel[i][k]+=p.GetVelocity(k)*p.GetMass();
         }
         mtot=1.0/grid[i].mass;
         for (int k=0;k<3;k++)gvel[i][k]*=mtot;
@@ -191,7 +219,10 @@ private(i,mtot) if (nbodies > ompsubsearchnum)
     for (i=0;i<ngrid;i++) {
         for (int k=0;k<3;k++) for (int l=0;l<3;l++) gveldisp[i](k,l)=0.;
         for (int j=0;j<grid[i].nparts;j++) {
-            for (int k=0;k<3;k++) for (int l=0;l<3;l++) gveldisp[i](k,l)+=(Part[grid[i].nindex[j]].GetVelocity(k)-gvel[i][k])*(Part[grid[i].nindex[j]].GetVelocity(l)-gvel[i][l])*Part[grid[i].nindex[j]].GetMass();
+            Particle &p=Part[grid[i].nindex[j]];
+            Double_t dv[3];
+            for (int k=0;k<3;k++) dv[k]=p.GetVelocity(k)-gvel[i][k];
+            for (int k=0;k<3;k++) for (int l=0;l<3;l++) gveldisp[i](k,l)+=dv[k]*dv[l]*p.GetMass();
         }
         mtot=1.0/grid[i].mass;
         for (int k=0;k<3;k++)for (int l=0;l<3;l++)gveldisp[i](k,l)*=mtot;
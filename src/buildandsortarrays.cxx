@@ -201,7 +201,7 @@ Int_t *BuildNoffset(const Int_t nbodies, Particle *Part, Int_t numgroups,Int_t *
         if (sortval[Part[i].GetID()]>ioffset) Part[i].SetType(sortval[Part[i].GetID()]);
         else Part[i].SetType(nbodies+1);//here move all particles not in groups to the back of the particle array
     }
-    qsort(Part, nbodies, sizeof(Particle), TypeCompare);
+    SortParticles(nbodies, Part, PSORTTYPE);
     if (numgroups >= 1) noffset[0]=noffset[1]=0;
     for (Int_t i=2;i<=numgroups;i++) noffset[i]=noffset[i-1]+numingroup[i-1];
     for (Int_t i=0;i<nbodies;i++) Part[i].SetType(storetype[Part[i].GetID()]);
@@ -5,6 +5,9 @@ using namespace Math;
 #ifndef ENDIANUTILS_H
 #define ENDIANUTILS_H
 
+#include <cstring>
+#include <utility>
+
 //functions that reverse endian, check endian and some useful pointers. This code is from 
 //http://www.gamedev.net/reference/articles/article2091.asp
 //I've also copied some of their comments. 
@@ -199,6 +202,33 @@ extern double (*LittleRAMSESFLOAT) ( double f );
 
 extern bool BigEndianSystem;  //you might want to extern this
 
+//For whole arrays of values read from files, the byte reversal is written for any size of value so that the compiler
+//can turn it into single byte swap instructions and vectorize loops over the array, rather than calling through the
+//function pointers for every value.
+template<typename T> inline T ByteSwap(T value)
+{
+  unsigned char b[sizeof(T)];
+  memcpy(b, &value, sizeof(T));
+  for (size_t j = 0; j < sizeof(T) / 2; ++j) std::swap(b[j], b[sizeof(T) - 1 - j]);
+  memcpy(&value, b, sizeof(T));
+  return value;
+}
+
+//value i of a little endian array, which need not be aligned
+template<typename T> inline T LittleEndianValue(const char *src, size_t i)
+{
+  T value;
+  memcpy(&value, src + i * sizeof(T), sizeof(T));
+  return BigEndianSystem ? ByteSwap(value) : value;
+}
+
+//copies n values of a little endian array, which need not be aligned
+template<typename T> inline void LittleEndianCopy(const char *src, T *dest, size_t n)
+{
+  memcpy(dest, src, n * sizeof(T));
+  if (BigEndianSystem) for (size_t i = 0; i < n; ++i) dest[i] = ByteSwap(dest[i]);
+}
+
 inline void InitEndian( void )
 {
   unsigned char SwapTest[2] = { 1, 0 };
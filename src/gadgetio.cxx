@@ -6,27 +6,113 @@
 
 #include "stf.h"
 
+#include "io.h"
 #include "gadgetitems.h"
 #include "endianutils.h"
+#include "timer.h"
+
+///record holding block iblock of a file, the header being block 0. Gadget-2 format files precede each block with a label record
+static int GadgetBlockRecord(int iblock)
+{
+#ifdef GADGET2FORMAT
+    return 2*iblock+1;
+#else
+    return iblock;
+#endif
+}
+
+string Gadget_file_name(Options &opt, int ifile)
+{
+    char buf[2000];
+    if(opt.num_files>1) sprintf(buf,"%s.%d",opt.fname,ifile);
+    else sprintf(buf,"%s",opt.fname);
+    return string(buf);
+}
+
+/*! Maps a gadget file and locates its blocks from the index of its records. The file holds the header, positions,
+    velocities and ids of all particles, then the masses of the types without a mass in the header. If the snapshot
+    has gas, the internal energy and density of the gas follow, then \ref Options.gnsphblocks further gas blocks,
+    of which the star formation rate is the one labelled "SFR " in Gadget-2 format files and otherwise the last
+    if the header flags star formation. Then, if compiled with EXTRASTARINFO and the snapshot has stars,
+    come the stellar ages and the metallicities of gas and stars.
+    Blocks whose size does not match the number of particles and the type of their values are reported as errors,
+    except for the gas densities, which are ignored if not compiled with EXTRASPHINFO.
+*/
+bool Gadget_open_file(Options &opt, int ifile, Fortran_Record_File &F, gadget_header &header, Gadget_Blocks &blocks)
+{
+    string fname=Gadget_file_name(opt, ifile);
+    if (!F.open(fname) || !F.holds<char>(GadgetBlockRecord(0), sizeof(gadget_header))) {
+        LOG(error) << "Could not read gadget file " << fname;
+        return false;
+    }
+    memcpy(&header, F.data(GadgetBlockRecord(0)), sizeof(gadget_header));
+    header.Endian();
+
+    size_t ntot=0, ntot_withmasses=0, ngas=header.npart[GGASTYPE];
+    for (int k=0;k<NGTYPE;k++) {
+        ntot+=header.npart[k];
+        if (header.mass[k]==0) ntot_withmasses+=header.npart[k];
+    }
+    auto matches = [&](int irecord, size_t n, size_t valuesize) {
+        return irecord<F.nrecords() && (n==0 || F.size(irecord)/n==valuesize);
+    };
+    auto check = [&](int irecord, size_t n, size_t valuesize, const char *name) {
+        if (matches(irecord, n, valuesize)) return true;
+        if (irecord>=F.nrecords()) LOG(error) << "Gadget file " << fname << " has no " << name << " block";
+        else LOG(error) << "Mismatch in " << name << " type size in " << fname << ", file has " << F.size(irecord)/n << " but using " << valuesize;
+        return false;
+    };
+
+    int iblock=1;
+    blocks=Gadget_Blocks();
+    blocks.pos=GadgetBlockRecord(iblock++);
+    blocks.vel=GadgetBlockRecord(iblock++);
+    blocks.id=GadgetBlockRecord(iblock++);
+    if (!check(blocks.pos, 3*ntot, sizeof(FLOAT), "position") || !check(blocks.vel, 3*ntot, sizeof(FLOAT), "velocity")
+        || !check(blocks.id, ntot, sizeof(GADGETIDTYPE), "ID")) return false;
+    if (ntot_withmasses>0) {
+        blocks.mass=GadgetBlockRecord(iblock++);
+        if (!check(blocks.mass, ntot_withmasses, sizeof(REAL), "mass")) return false;
+    }
+    if (header.npartTotal[GGASTYPE]>0) {
+        blocks.u=GadgetBlockRecord(iblock++);
+        if (!check(blocks.u, ngas, sizeof(FLOAT), "SPH")) return false;
+        blocks.rho=GadgetBlockRecord(iblock++);
+#ifdef EXTRASPHINFO
+        if (!check(blocks.rho, ngas, sizeof(FLOAT), "SPH")) return false;
+        for (int nsphblocks=0;nsphblocks<opt.gnsphblocks;nsphblocks++,iblock++) {
+            int irecord=GadgetBlockRecord(iblock);
+            if (!check(irecord, ngas, sizeof(FLOAT), "SPH")) return false;
+#ifdef GADGET2FORMAT
+            if (F.get_string(irecord-1).compare(0,4,"SFR ")==0) blocks.sfr=irecord;
+#else
+            if (header.flag_sfr && nsphblocks==opt.gnsphblocks-1) blocks.sfr=irecord;
+#endif
+        }
+#else
+        if (!matches(blocks.rho, ngas, sizeof(FLOAT))) blocks.rho=-1;
+#endif
+    }
+#ifdef EXTRASTARINFO
+    if (header.npartTotal[GSTARTYPE]>0) {
+        size_t nstar=header.npart[GSTARTYPE];
+        blocks.age=GadgetBlockRecord(iblock++);
+        blocks.metals=GadgetBlockRecord(iblock++);
+        if (!check(blocks.age, nstar, sizeof(FLOAT), "Star") || !check(blocks.metals, ngas+nstar, sizeof(FLOAT), "SPH+STAR")) return false;
+    }
+#endif
+    return true;
+}
 
 ///reads a gadget file. If cosmological simulation uses cosmology (generally assuming LCDM or small deviations from this) to estimate the mean interparticle spacing
 ///and scales physical linking length passed by this distance. Also reads header and over rides passed cosmological parameters with ones stored in header.
 void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle *&Pbaryons, Int_t nbaryons)
 {
     //counters
-    Int_t i,k,n,temp,count,countsph,count2,bcount,bcount2,pc,pc_new,Ntotfile;
-    Int_t ntot_withmasses;
-    //used to read gadget data
-    unsigned int dummy;
-    GADGETIDTYPE idval;
-    FLOAT ctemp[3];
-    REAL dtemp;
-    char buf[2000];
-    char DATA[5];
+    Int_t i,k,n,temp,count,countsph,count2,bcount,bcount2;
     //store cosmology
     double z,aadjust,Hubble,Hubbleflow;
 
-    fstream *Fgad;
     struct gadget_header *header;
     Double_t mscale,lscale,lvscale;
     Double_t MP_DM=MAXVALUE,LN,N_DM,MP_B=MAXVALUE;
@@ -44,20 +130,23 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
     //if MPI is used, Processor zero opens the file and loads the data into a particle buffer
     //this particle buffer is used to broadcast data to the appropriate processor
 #ifdef USEMPI
-    //since positions, velocities, masses are all at different points in the file,
-    //to correctly assign particle to proccessor with correct velocities and mass must have several file pointers
-    fstream *Fgadvel, *Fgadid, *Fgadmass, *Fgadsph;
-    fstream *Fgadstar, *Fgadbh;
+    Int_t pc,pc_new;
+    GADGETIDTYPE idval;
+    FLOAT ctemp[3];
+    REAL dtemp;
     FLOAT vtemp[3];
     MPI_Comm mpi_comm_read;
+    //files read by this task and the time taken to read them
+    std::vector<MPIReadRange> readranges;
+    std::vector<double> typecost(NGTYPE, 1.0);
+    double readtime = 0;
     Particle *Pbuf;
     vector<Particle> *Preadbuf;
     Int_t chunksize=opt.inputbufsize,nchunk;
     Int_t BufSize=opt.mpiparticlebufsize;
-    FLOAT *ctempchunk, *vtempchunk, *sphtempchunk;
-    FLOAT *startempchunk, *bhtempchunk;
-    REAL *dtempchunk;
-    GADGETIDTYPE *idvalchunk;
+    //positions of a chunk of particles, decoded together to determine their processors
+    FLOAT *ctempchunk;
+    vector<int> chunkprocessor;
     //for parallel io
     Int_t *Nbuf, *Nreadbuf,*nreadoffset;
     int ibuf=0;
@@ -97,26 +186,16 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
             Preadbuf=new vector<Particle>[opt.nsnapread];
             for (int j=0;j<opt.nsnapread;j++) Preadbuf[j].reserve(BufSize);
         }
-        //to determine which files the thread should read
+        //to determine which files the thread should read, balancing the number of particles rather than files per read task
         ireadfile = std::vector<int>(opt.num_files);
-        ifirstfile=MPISetFilesRead(opt,ireadfile,ireadtask);
+        readranges = MPIPlanFileReads(opt, ireadtask, MPIGadgetFileParticleCounts(opt, mpi_comm_read), typecost, false);
+        ifirstfile=MPISetFilesRead(opt,ireadfile,readranges);
         inreadsend=0;
         for (int j=0;j<opt.num_files;j++) inreadsend+=ireadfile[j];
         MPI_Allreduce(&inreadsend,&totreadsend,1,MPI_Int_t,MPI_MIN,mpi_comm_read);
 
         ctempchunk=new FLOAT[3*chunksize];
-        vtempchunk=new FLOAT[3*chunksize];
-        dtempchunk=new REAL[chunksize];
-        idvalchunk=new GADGETIDTYPE[chunksize];
-#ifdef GASON
-        sphtempchunk=new FLOAT[NUMGADGETSPHBLOCKS*chunksize];
-#endif
-#ifdef STARON
-        startempchunk=new FLOAT[NUMGADGETSTARBLOCKS*chunksize];
-#endif
-#ifdef BHON
-        bhtempchunk=new FLOAT[NUMGADGETBHBLOCKS*chunksize];
-#endif
+        chunkprocessor.resize(chunksize);
     }
     else {
         Nlocalthreadbuf=new Int_t[opt.nsnapread];
@@ -131,37 +210,21 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
 
     if (ireadtask[ThisTask]>=0) {
 #endif
-    //opening file
-#define SKIP2 Fgad[i].read((char*)&dummy, sizeof(dummy));
-#define SKIPV2 Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-#define SKIPI2 Fgadid[i].read((char*)&dummy, sizeof(dummy));
-#define SKIPM2 Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-
-    Fgad=new fstream[opt.num_files];
+    //reading the headers of the files
     header=new gadget_header[opt.num_files];
     for(i=0; i<opt.num_files; i++)
-    //if(i==ThisTask)
     if(ireadfile[i])
     {
-        if(opt.num_files>1) sprintf(buf,"%s.%lld",opt.fname,i);
-        else sprintf(buf,"%s",opt.fname);
-        Fgad[i].open(buf,ios::in);
-        if(!Fgad[i]) {
-            cout<<"can't open file "<<buf<<endl;
-            exit(0);
-        }
-        else cout<<"reading "<<buf<<endl;
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
+        Fortran_Record_File F;
+        Gadget_Blocks blocks;
+        if (!Gadget_open_file(opt, i, F, header[i], blocks)) {
+#ifdef USEMPI
+            MPI_Abort(MPI_COMM_WORLD,8);
+#else
+            exit(8);
 #endif
-        Fgad[i].read((char*)&dummy, sizeof(dummy));
-        Fgad[i].read((char*)&header[i], sizeof(gadget_header));
-        Fgad[i].read((char*)&dummy, sizeof(dummy));
-        //endian indep call
-        header[i].Endian();
+        }
+        cout<<"reading "<<Gadget_file_name(opt, i)<<endl;
     }
     opt.p=header[ifirstfile].BoxSize;
     //if input is from a cosmological box, the following cosmological parameters have meaning
@@ -234,545 +297,116 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
 
     count2=bcount2=0;
 #ifndef USEMPI
-    //now read and store data appropriately
-    for(i=0,count=0,bcount=0,pc=0;i<opt.num_files; i++,pc=pc_new,count=count2,bcount=bcount2)
+    //now read and store data appropriately, decoding the blocks of each type straight from the mapped file into the particles
+    for(i=0,count=0,bcount=0;i<opt.num_files; i++,count=count2,bcount=bcount2)
     {
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-#ifndef NOMASS
-        //determine number of particles with masses that need to be read
-        for(k=0, ntot_withmasses=0; k<NGTYPE; k++) if(header[i].mass[k]==0) ntot_withmasses+= header[i].npart[k];
-#endif
-        for(k=0, Ntotfile=0; k<NGTYPE; k++) Ntotfile+=header[i].npart[k];
-        //and read positions, velocities, ids, masses, etc
-        SKIP2;
-        if (dummy/Ntotfile/3!=sizeof(FLOAT)) {cout<<" mismatch in position type size, file has "<<dummy/Ntotfile/3<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
+        Fortran_Record_File F;
+        Gadget_Blocks blocks;
+        if (!Gadget_open_file(opt, i, F, header[i], blocks)) exit(9);
+        const char *pos=F.data(blocks.pos), *vel=F.data(blocks.vel), *ids=F.data(blocks.id);
+        //index in the blocks of all particles and of those with masses of the first particle of each type
+        Int_t nfirst=0, nmassfirst=0;
+        for(k=0,count2=count,bcount2=bcount;k<NGTYPE;nfirst+=header[i].npart[k],k++)
         {
-            for(n=0;n<header[i].npart[k];n++)
-            {
-                Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT)*3);
-                if (opt.partsearchtype==PSTALL) {
-                    for (Int_t m=0;m<3;m++) Part[count2].SetPosition(m,LittleFLOAT(ctemp[m]));
-                    count2++;
-                }
-                else if (opt.partsearchtype==PSTDARK) {
-                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                        for (Int_t m=0;m<3;m++) Part[count2].SetPosition(m,LittleFLOAT(ctemp[m]));
-                        count2++;
-                    }
-                    else {
-                        if (opt.iBaryonSearch==1 && (k==GGASTYPE || k==GSTARTYPE)) {
-                            for (Int_t m=0;m<3;m++) Pbaryons[bcount2].SetPosition(m,LittleFLOAT(ctemp[m]));
-                            bcount2++;
-                        }
-                    }
-                }
-                else if (opt.partsearchtype==PSTSTAR) {
-                    if (k==GSTARTYPE) {
-                        for (Int_t m=0;m<3;m++) Part[count2].SetPosition(m,LittleFLOAT(ctemp[m]));
-                        count2++;
-                    }
-                }
-                else if (opt.partsearchtype==PSTGAS) {
-                    if (k==GGASTYPE) {
-                        for (Int_t m=0;m<3;m++) Part[count2].SetPosition(m,LittleFLOAT(ctemp[m]));
-                        count2++;
-                    }
-                }
-                pc_new++;
+            Int_t nk=header[i].npart[k];
+            bool isbaryon=(k==GGASTYPE || k==GSTARTYPE || k==GBHTYPE);
+            //smallest masses are found for all types, whether or not they are stored
+            if (header[i].mass[k]!=0) {
+                if (nk>0 && !isbaryon && header[i].mass[k]<MP_DM) MP_DM=header[i].mass[k];
+                if (nk>0 && k==GGASTYPE && header[i].mass[k]<MP_B) MP_B=header[i].mass[k];
             }
-        }
-        SKIP2;
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
+            else {
+                Double_t mpmin=MAXVALUE;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) reduction(min:mpmin) if (nk>ompsearchnum)
 #endif
-        SKIP2;
-        if (dummy/Ntotfile/3!=sizeof(FLOAT)) {cout<<" mismatch in velocity type size, file has "<<dummy/Ntotfile/3<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            for(n=0;n<header[i].npart[k];n++)
-            {
-                Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT)*3);
-                if (opt.partsearchtype==PSTALL) {
-                    for (Int_t m=0;m<3;m++) Part[count2].SetVelocity(m,LittleFLOAT(ctemp[m]));
-                    count2++;
-                }
-                else if (opt.partsearchtype==PSTDARK) {
-                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                        for (Int_t m=0;m<3;m++) Part[count2].SetVelocity(m,LittleFLOAT(ctemp[m]));
-                        count2++;
-                    }
-                    else {
-                        if (opt.iBaryonSearch==1 && (k==GGASTYPE || k==GSTARTYPE)) {
-                            for (Int_t m=0;m<3;m++) Pbaryons[bcount2].SetVelocity(m,LittleFLOAT(ctemp[m]));
-                            bcount2++;
-                        }
-                    }
-                }
-                else if (opt.partsearchtype==PSTSTAR) {
-                    if (k==GSTARTYPE) {
-                        for (Int_t m=0;m<3;m++) Part[count2].SetVelocity(m,LittleFLOAT(ctemp[m]));
-                        count2++;
-                    }
-                }
-                else if (opt.partsearchtype==PSTGAS) {
-                    if (k==GGASTYPE) {
-                        for (Int_t m=0;m<3;m++) Part[count2].SetVelocity(m,LittleFLOAT(ctemp[m]));
-                        count2++;
-                    }
+                for (n=0;n<nk;n++) {
+                    Double_t mtemp=LittleEndianValue<REAL>(F.data(blocks.mass),nmassfirst+n);
+                    if (mtemp>0 && mtemp<mpmin) mpmin=mtemp;
                 }
-                pc_new++;
+                if (!isbaryon) MP_DM=min(MP_DM,mpmin);
+                else if (k==GGASTYPE) MP_B=min(MP_B,mpmin);
             }
-        }
-        SKIP2;
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-        SKIP2;
-        if (dummy/Ntotfile!=sizeof(idval)) {cout<<" mismatch in ID type size, file has "<<dummy/Ntotfile<<" but using "<<sizeof(idval)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            for(n=0;n<header[i].npart[k];n++) {
-                Fgad[i].read((char*)&idval, sizeof(idval));
-#ifdef GADGETLONGID
-                idval=LittleLongInt(idval);
-#else
-                idval=LittleInt(idval);
-#endif
-                if (opt.partsearchtype==PSTALL) {
-                    Part[count2].SetPID(idval);
-                    Part[count2].SetID(count2);
+
+            //particles of this type go to Part, to Pbaryons or are not stored
+            Particle *P=NULL;
+            Int_t idoffset=0;
+            int type=k;
+            if (opt.partsearchtype==PSTALL || (opt.partsearchtype==PSTDARK && !isbaryon)
+                || (opt.partsearchtype==PSTSTAR && k==GSTARTYPE) || (opt.partsearchtype==PSTGAS && k==GGASTYPE)) {
+                P=&Part[count2];
+                idoffset=count2;
+                count2+=nk;
 #ifdef HIGHRES
-                    if (!(k==GGASTYPE || k==GSTARTYPE || k==GBHTYPE)) Part[count2].SetType(DARKTYPE);
-                    else Part[count2].SetType(k);
-#else
-                    Part[count2].SetType(k);
-#endif
-#ifdef EXTRAINPUTINFO
-                    if (opt.iextendedoutput)
-                    {
-                        Part[count2].SetInputFileID(i);
-                        Part[count2].SetInputIndexInFile(n);
-                    }
-#endif
-                    count2++;
-                }
-                else if (opt.partsearchtype==PSTDARK) {
-                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                        Part[count2].SetPID(idval);
-                        Part[count2].SetID(count2);
-                        Part[count2].SetType(DARKTYPE);
-#ifdef EXTRAINPUTINFO
-                        if (opt.iextendedoutput)
-                        {
-                            Part[count2].SetInputFileID(i);
-                            Part[count2].SetInputIndexInFile(n);
-                        }
-#endif
-                        count2++;
-                    }
-                    else {
-                        if (opt.iBaryonSearch==1 && (k==GGASTYPE || k==GSTARTYPE || k==GBHTYPE)) {
-                            Pbaryons[bcount2].SetPID(idval);
-                            Pbaryons[bcount2].SetID(bcount2+nbodies);
-                            Pbaryons[bcount2].SetType(STARTYPE*(k==GSTARTYPE)+GASTYPE*(k==GGASTYPE)+BHTYPE*(k==GBHTYPE));
-#ifdef EXTRAINPUTINFO
-                            if (opt.iextendedoutput)
-                            {
-                                Pbaryons[bcount2].SetInputFileID(i);
-                                Pbaryons[bcount2].SetInputIndexInFile(n);
-                            }
-#endif
-                            bcount2++;
-                        }
-                    }
-                }
-                else if (opt.partsearchtype==PSTSTAR) {
-                    if (k==GSTARTYPE) {
-                        Part[count2].SetPID(idval);
-                        Part[count2].SetID(count2);
-                        Part[count2].SetType(STARTYPE);
-#ifdef EXTRAINPUTINFO
-                        if (opt.iextendedoutput)
-                        {
-                            Part[count2].SetInputFileID(i);
-                            Part[count2].SetInputIndexInFile(n);
-                        }
-#endif
-                        count2++;
-                    }
-                }
-                else if (opt.partsearchtype==PSTGAS) {
-                    if (k==GGASTYPE) {
-                        Part[count2].SetPID(idval);
-                        Part[count2].SetID(count2);
-                        Part[count2].SetType(GASTYPE);
-#ifdef EXTRAINPUTINFO
-                        if (opt.iextendedoutput)
-                        {
-                            Part[count2].SetInputFileID(i);
-                            Part[count2].SetInputIndexInFile(n);
-                        }
-#endif
-                        count2++;
-                    }
-                }
-                pc_new++;
-            }
-        }
-        SKIP2;
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
+                if (!isbaryon) type=DARKTYPE;
 #endif
-#ifndef NOMASS
-        if(ntot_withmasses>0) {
-        SKIP2;
-        if (dummy/ntot_withmasses!=sizeof(REAL)) {cout<<" mismatch in mass type size, file has "<<dummy/ntot_withmasses<<" but using "<<sizeof(REAL)<<endl;exit(9);}
-        }
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            for(n=0;n<header[i].npart[k];n++)
-            {
-                //if mass is read from header then does not need to
-                //be altered for endian. but must be altered if read from file.
-                if(header[i].mass[k]==0) {
-                    Fgad[i].read((char*)&dtemp, sizeof(REAL));
-                    dtemp=LittleREAL(dtemp);
-                }
-                else dtemp=header[i].mass[k];
-                if(k!=GGASTYPE && k!=GSTARTYPE && k!=GBHTYPE && dtemp<MP_DM&&dtemp>0) MP_DM=dtemp;
-                if(k==GGASTYPE && dtemp<MP_B&&dtemp>0) MP_B=dtemp;
-                if (opt.partsearchtype==PSTALL) {
-                    Part[count2].SetMass(dtemp);
-                    count2++;
-                }
-                else if (opt.partsearchtype==PSTDARK) {
-                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                        Part[count2].SetMass(dtemp);
-                        count2++;
-                    }
-                    else {
-                        if (opt.iBaryonSearch==1 && (k==GGASTYPE || k==GSTARTYPE)) {
-                            Pbaryons[bcount2].SetMass(dtemp);
-                            bcount2++;
-                        }
-                    }
-                }
-                else if (opt.partsearchtype==PSTSTAR) {
-                    if (k==GSTARTYPE) {
-                        Part[count2].SetMass(dtemp);
-                        count2++;
-                    }
-                }
-                else if (opt.partsearchtype==PSTGAS) {
-                    if (k==GGASTYPE) {
-                        Part[count2].SetMass(dtemp);
-                        count2++;
-                    }
-                }
-                pc_new++;
-            }
-        }
-        if(ntot_withmasses>0) SKIP2;
-#endif
-        //more information contained in sph particles and if there is sf feed back but for the moment, ignore
-        //other quantities
-        if (header[i].npartTotal[GGASTYPE]>0) {
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-        SKIP2;
-        if (dummy/header[i].npart[GGASTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in SPH type size, file has "<<dummy/header[i].npart[GGASTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            if (k==GGASTYPE) {
-                if ((opt.partsearchtype==PSTALL || opt.partsearchtype==PSTGAS || (opt.partsearchtype==PSTDARK && opt.iBaryonSearch==1))) {
-                for(n=0;n<header[i].npart[k];n++) {
-                    Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT));
-                    if (opt.partsearchtype==PSTALL || opt.partsearchtype==PSTGAS) {
-#ifdef GASON
-                        Part[count2].SetU(ctemp[0]);
-#endif
-                        count2++;
-                    }
-                    else if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch==1) {
-#ifdef GASON
-                        Pbaryons[bcount2].SetU(ctemp[0]);
-#endif
-                        bcount2++;
-                    }
-                    pc_new++;
-                }
-                }
-                else Fgad[i].seekg(header[i].npart[GGASTYPE]*sizeof(FLOAT),ios::cur);
+                if (opt.partsearchtype==PSTDARK) type=DARKTYPE;
             }
-        }
-        SKIP2
-#if defined(EXTRASPHINFO)&&defined(GASON)
-        //then gas densities and softening lengths
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-        SKIP2;
-        if (dummy/header[i].npart[GGASTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in SPH type size, file has "<<dummy/header[i].npart[GGASTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            if (k==GGASTYPE) {
-                if ((opt.partsearchtype==PSTALL || opt.partsearchtype==PSTGAS || (opt.partsearchtype==PSTDARK && opt.iBaryonSearch==1))) {
-                for(n=0;n<header[i].npart[k];n++) {
-                    Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT));
-                    if (opt.partsearchtype==PSTALL || opt.partsearchtype==PSTGAS) {
-                        Part[count2].SetSPHDen(ctemp[0]);
-                        count2++;
-                    }
-                    else if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch==1) {
-                        Pbaryons[bcount2].SetSPHDen(ctemp[0]);
-                        bcount2++;
-                    }
-                    pc_new++;
-                }
-                }
-                else Fgad[i].seekg(header[i].npart[GGASTYPE]*sizeof(FLOAT),ios::cur);
+            else if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch>0 && (k==GGASTYPE
+                || (k==GSTARTYPE && opt.iusestarparticles) || (k==GBHTYPE && opt.iusesinkparticles))) {
+                P=&Pbaryons[bcount2];
+                idoffset=nbodies+bcount2;
+                bcount2+=nk;
             }
-        }
-        SKIP2
+            else nk=0;
 
-        //next skip N gas blocks where, typically N is 4 for Ne, Nh, HSML, SFR. Note that if header indicates SFR block, data is kept
-        for (int nsphblocks=0;nsphblocks<opt.gnsphblocks;nsphblocks++) {
-        //ignored
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nk>ompsearchnum)
 #endif
-        if (!strcmp(DATA,"SFR ")){
-        SKIP2;
-        if (dummy/header[i].npart[GGASTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in SPH type size, file has "<<dummy/header[i].npart[GGASTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        Fgad[i].seekg(header[i].npart[GGASTYPE]*sizeof(FLOAT),ios::cur);
-        SKIP2;
-        }
-        else {
-        SKIP2;
-        if (dummy/header[i].npart[GGASTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in SPH type size, file has "<<dummy/header[i].npart[GGASTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            if (k==GGASTYPE) {
-                if ((opt.partsearchtype==PSTALL || opt.partsearchtype==PSTGAS || (opt.partsearchtype==PSTDARK && opt.iBaryonSearch==1))) {
-                for(n=0;n<header[i].npart[k];n++) {
-                    Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT));
-                    if (opt.partsearchtype==PSTALL || opt.partsearchtype==PSTGAS) {
-#ifdef STARON
-                        Part[count2].SetSFR(ctemp[0]);
-#endif
-                        count2++;
-                    }
-                    else if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch==1) {
-#ifdef STARON
-                        Pbaryons[bcount2].SetSFR(ctemp[0]);
-#endif
-                        bcount2++;
-                    }
-                    pc_new++;
-                }
+            for (n=0;n<nk;n++) {
+                Particle &p=P[n];
+                Int_t nfile=nfirst+n;
+                for (int m=0;m<3;m++) {
+                    p.SetPosition(m,LittleEndianValue<FLOAT>(pos,3*nfile+m));
+                    p.SetVelocity(m,LittleEndianValue<FLOAT>(vel,3*nfile+m));
                 }
-                else Fgad[i].seekg(header[i].npart[GGASTYPE]*sizeof(FLOAT),ios::cur);
-            }
-        }
-        SKIP2;
-        }
-        }
-
-#endif
-        }
-
-#ifdef EXTRASTARINFO
-        //then star ages
-        if (header[i].npartTotal[GSTARTYPE]>0) {
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-        SKIP2;
-        if (dummy/header[i].npart[GSTARTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in Star type size, file has "<<dummy/header[i].npart[GSTARTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            for(n=0;n<header[i].npart[k];n++) {
-                if (k==GSTARTYPE) Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT));
-                if (opt.partsearchtype==PSTALL) {
-                    if (k==GSTARTYPE) {
-#ifdef STARON
-                        Part[count2].SetTage(ctemp[0]);
+                p.SetPID(LittleEndianValue<GADGETIDTYPE>(ids,nfile));
+                p.SetID(idoffset+n);
+                p.SetType(type);
+#ifndef NOMASS
+                if (header[i].mass[k]==0) p.SetMass(LittleEndianValue<REAL>(F.data(blocks.mass),nmassfirst+n));
+                else p.SetMass(header[i].mass[k]);
 #endif
-                    }
-                    count2++;
+#ifdef EXTRAINPUTINFO
+                if (opt.iextendedoutput)
+                {
+                    p.SetInputFileID(i);
+                    p.SetInputIndexInFile(n);
                 }
-                else if (opt.partsearchtype==PSTDARK) {
-                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                        count2++;
-                    }
-                    else {
-                        if (opt.iBaryonSearch==1 && (k==GGASTYPE || k==GSTARTYPE)) {
-                            if (k==GSTARTYPE) {
-#ifdef STARON
-                                Pbaryons[bcount2].SetTage(ctemp[0]);
 #endif
-                            }
-                            bcount2++;
-                        }
-                    }
-                }
-                else if (opt.partsearchtype==PSTSTAR) {
-                    if (k==GSTARTYPE) {
+                //gas comes first in the gas blocks, followed by stars in the metallicities
+#ifdef GASON
+                if (k==GGASTYPE) {
+                    if (blocks.u>=0) p.SetU(LittleEndianValue<FLOAT>(F.data(blocks.u),n));
+                    if (blocks.rho>=0) p.SetSPHDen(LittleEndianValue<FLOAT>(F.data(blocks.rho),n));
 #ifdef STARON
-                        Part[count2].SetTage(ctemp[0]);
+                    if (blocks.sfr>=0) p.SetSFR(LittleEndianValue<FLOAT>(F.data(blocks.sfr),n));
 #endif
-                        count2++;
-                    }
                 }
-                else if (opt.partsearchtype==PSTGAS) {
-                    if (k==GGASTYPE) {
-                        count2++;
-                    }
-                }
-                pc_new++;
-            }
-        }
-        SKIP2;
-        //then metallicity of gas AND stars
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
 #endif
-        SKIP2;
-        if (dummy/(header[i].npart[GSTARTYPE]+header[i].npart[GGASTYPE])!=sizeof(FLOAT)) {cout<<" mismatch in SPH+STAR type size, file has "<<dummy/(header[i].npart[GSTARTYPE]+header[i].npart[GGASTYPE])<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)
-        {
-            for(n=0;n<header[i].npart[k];n++) {
-                if (k==GSTARTYPE||k==GGASTYPE) Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT));
-                if (opt.partsearchtype==PSTALL) {
-                    if (k==GSTARTYPE||k==GGASTYPE) {
-#if defined(STARON)
-                        Part[count2].SetZmet(ctemp[0]);
-#endif
-                    }
-                    count2++;
-                }
-                else if (opt.partsearchtype==PSTDARK) {
-                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                        count2++;
-                    }
-                    else {
-                        if (opt.iBaryonSearch==1 && (k==GGASTYPE || k==GSTARTYPE)) {
-                            if (k==GSTARTYPE||k==GGASTYPE) {
-#if defined(STARON)
-                                Pbaryons[bcount2].SetZmet(ctemp[0]);
-#endif
-                            }
-                            bcount2++;
-                        }
-                    }
-                }
-                else if (opt.partsearchtype==PSTSTAR) {
-                    if (k==GSTARTYPE) {
-#if defined(STARON)
-                        Part[count2].SetZmet(ctemp[0]);
-#endif
-                        count2++;
-                    }
-                }
-                else if (opt.partsearchtype==PSTGAS) {
-                    if (k==GGASTYPE) {
-#if defined(STARON)
-                        Part[count2].SetZmet(ctemp[0]);
+#ifdef STARON
+                if (k==GSTARTYPE && blocks.age>=0) p.SetTage(LittleEndianValue<FLOAT>(F.data(blocks.age),n));
+                if (k==GGASTYPE && blocks.metals>=0) p.SetZmet(LittleEndianValue<FLOAT>(F.data(blocks.metals),n));
+                if (k==GSTARTYPE && blocks.metals>=0) p.SetZmet(LittleEndianValue<FLOAT>(F.data(blocks.metals),header[i].npart[GGASTYPE]+n));
 #endif
-                        count2++;
-                    }
-                }
-                pc_new++;
             }
+            if (header[i].mass[k]==0) nmassfirst+=header[i].npart[k];
         }
-        SKIP2;
-
-        //extra star blocks
-        for (int nstarblocks=0;nstarblocks<opt.gnstarblocks;nstarblocks++) {
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-        SKIP2;
-        if (dummy/header[i].npart[GSTARTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in STAR type size, file has "<<dummy/header[i].npart[GSTARTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        Fgad[i].seekg(header[i].npart[GSTARTYPE]*sizeof(FLOAT),ios::cur);
-        SKIP2;
-        }
-        }
-#endif
-
-#ifdef EXTRABHINFO
-        //typical to have black hole ages, black hole scale, black hole mass perhaps
-        if (header[i].npartTotal[GBHTYPE]>0) {
-        for (int nbhblocks=0;nbhblocks<opt.gnbhblocks;nbhblocks++) {
-#ifdef GADGET2FORMAT
-        SKIP2;
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        SKIP2;
-        SKIP2;
-        cout<<"reading "<<DATA<<endl;
-#endif
-        SKIP2;
-        if (dummy/header[i].npart[GBHTYPE]!=sizeof(FLOAT)) {cout<<" mismatch in BH type size, file has "<<dummy/header[i].npart[GBHTYPE]<<" but using "<<sizeof(FLOAT)<<endl;exit(9);}
-        Fgad[i].seekg(header[i].npart[GBHTYPE]*sizeof(FLOAT),ios::cur);
-        SKIP2;
-        }
-        }
-#endif
-
-        Fgad[i].close();
     }
     //finally adjust to appropriate units
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbodies>ompsearchnum)
+#endif
     for (i=0;i<nbodies;i++)
     {
         Part[i].SetMass(Part[i].GetMass()*mscale);
         for (int j=0;j<3;j++) Part[i].SetVelocity(j,Part[i].GetVelocity(j)*opt.velocityinputconversion*sqrt(opt.a)+Hubbleflow*Part[i].GetPosition(j));
         for (int j=0;j<3;j++) Part[i].SetPosition(j,Part[i].GetPosition(j)*lscale);
     }
-    if (Pbaryons!=NULL && opt.iBaryonSearch==1) {
+    if (Pbaryons!=NULL && opt.iBaryonSearch>0) {
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbaryons>ompsearchnum)
+#endif
     for (i=0;i<nbaryons;i++)
     {
         Pbaryons[i].SetMass(Pbaryons[i].GetMass()*mscale);
@@ -783,354 +417,41 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
 
 #else
     inreadsend=0;
-    Fgadvel=new fstream[opt.num_files];
-    Fgadid=new fstream[opt.num_files];
-    Fgadmass=new fstream[opt.num_files];
-    Fgadsph=new fstream[opt.num_files*NUMGADGETSPHBLOCKS];
-    Fgadstar=new fstream[opt.num_files*NUMGADGETSTARBLOCKS];
-    Fgadbh=new fstream[opt.num_files*NUMGADGETBHBLOCKS];
-    for(i=0; i<opt.num_files; i++)
-    if (ireadfile[i])
-    {
-        if(opt.num_files>1) sprintf(buf,"%s.%d",opt.fname,int(i));
-        else sprintf(buf,"%s",opt.fname);
-
-        count=0;for(k=0;k<NGTYPE;k++)count+=header[i].npart[k];
-
-        //offset all the files for easy reading
-        Fgadvel[i].open(buf,ios::in);
-        Fgadid[i].open(buf,ios::in);
-        Fgadmass[i].open(buf,ios::in);
-        for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++) Fgadsph[i+sphblocks].open(buf,ios::in);
-        for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++) Fgadstar[i+starblocks].open(buf,ios::in);
-        for (int bhblocks=0;bhblocks<NUMGADGETBHBLOCKS;bhblocks++) Fgadbh[i+bhblocks].open(buf,ios::in);
-#ifdef GADGET2FORMAT
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&header[i], sizeof(gadget_header));
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&header[i], sizeof(gadget_header));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&header[i], sizeof(gadget_header));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        //endian indep call
-        header[i].Endian();
-
-        //move to velocities
-#ifdef GADGET2FORMAT
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-
-        //move to ids
-#ifdef GADGET2FORMAT
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-#ifdef GADGET2FORMAT
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-
-        //move to masses
-#ifdef GADGET2FORMAT
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-#ifdef GADGET2FORMAT
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-
-#ifdef GADGET2FORMAT
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].seekg(count*sizeof(idval),ios::cur);
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-
-#ifdef GASON
-        //move to sph
-        for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++){
-#ifdef GADGET2FORMAT
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-#ifdef GADGET2FORMAT
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-
-#ifdef GADGET2FORMAT
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].seekg(count*sizeof(idval),ios::cur);
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-
-#ifdef GADGET2FORMAT
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        for (int k=0;k<NGTYPE;k++)
-            if(header[i].mass[k]==0)
-              Fgadsph[i+sphblocks].seekg(header[i].npart[k]*sizeof(REAL),ios::cur);
-        Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        }
-
-        //offset each sph block appropriately
-        for (int sphstart=1;sphstart<NUMGADGETSPHBLOCKS;sphstart++){
-        for (int  sphblocks=0;sphblocks<sphstart;sphblocks++){
-#ifdef GADGET2FORMAT
-            Fgadsph[i+sphstart].read((char*)&dummy, sizeof(dummy));
-            Fgadsph[i+sphstart].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-            Fgadsph[i+sphstart].read((char*)&dummy, sizeof(dummy));
-            Fgadsph[i+sphstart].read((char*)&dummy, sizeof(dummy));
-#endif
-            Fgadsph[i+sphstart].read((char*)&dummy, sizeof(dummy));
-            countsph=dummy;
-            Fgadsph[i+sphstart].seekg(countsph,ios::cur);
-            Fgadsph[i+sphstart].read((char*)&dummy, sizeof(dummy));
-        }
-        }
-#endif
-
-#ifdef STARON
-        //move to star
-        for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++){
-#ifdef GADGET2FORMAT
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-#ifdef GADGET2FORMAT
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].seekg(count*3*sizeof(FLOAT),ios::cur);
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-
-#ifdef GADGET2FORMAT
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].seekg(count*sizeof(idval),ios::cur);
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-
-#ifdef GADGET2FORMAT
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        for (int k=0;k<NGTYPE;k++)
-            if(header[i].mass[k]==0)
-              Fgadstar[i+starblocks].seekg(header[i].npart[k]*sizeof(REAL),ios::cur);
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-
-        for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++){
-#ifdef GADGET2FORMAT
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-#endif
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        Fgadstar[i+starblocks].seekg(header[i].npart[GGASTYPE]*sizeof(FLOAT),ios::cur);
-        Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        }
-        }
-
-        //offset each star block appropriately
-        for (int starstart=1;starstart<NUMGADGETSTARBLOCKS;starstart++){
-        for (int starblocks=0;starblocks<starstart;starblocks++){
-#ifdef GADGET2FORMAT
-            Fgadstar[i+starstart].read((char*)&dummy, sizeof(dummy));
-            Fgadstar[i+starstart].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-            Fgadstar[i+starstart].read((char*)&dummy, sizeof(dummy));
-            Fgadstar[i+starstart].read((char*)&dummy, sizeof(dummy));
-#endif
-            Fgadstar[i+starstart].read((char*)&dummy, sizeof(dummy));
-            Fgadstar[i+starstart].seekg(dummy,ios::cur);
-            Fgadstar[i+starstart].read((char*)&dummy, sizeof(dummy));
-        }
-        }
-#endif
-
-        //need black hole offset
-
-#ifdef GADGET2FORMAT
-        Fgad[i].read((char*)&dummy, sizeof(dummy));
-        Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgad[i].read((char*)&dummy, sizeof(dummy));
-        Fgad[i].read((char*)&dummy, sizeof(dummy));
-
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-
-        for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++){
-            Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-            Fgadsph[i+sphblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-            Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-            Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        }
-
-        for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++){
-            Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-            Fgadstar[i+starblocks].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-            Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-            Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-        }
-#endif
-
-    }
-    //all fstreams now at appropriate points in the input file so data easily read
     for(i=0,count=0,pc=0;i<opt.num_files; i++,pc=pc_new,count=count2)
     if (ireadfile[i])
     {
-        //determine number of particles with masses that need to be read
-        for(k=0, ntot_withmasses=0; k<NGTYPE; k++) if(header[i].mass[k]==0) ntot_withmasses+= header[i].npart[k];
-        for(k=0, Ntotfile=0; k<NGTYPE; k++) Ntotfile+=header[i].npart[k];
-        //and read positions, velocities, masses, etc
-        Fgad[i].read((char*)&dummy, sizeof(dummy));
-        Fgadvel[i].read((char*)&dummy, sizeof(dummy));
-        Fgadid[i].read((char*)&dummy, sizeof(dummy));
-        Fgadmass[i].read((char*)&dummy, sizeof(dummy));
-        for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++) Fgadsph[i+sphblocks].read((char*)&dummy, sizeof(dummy));
-        for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++) Fgadstar[i+starblocks].read((char*)&dummy, sizeof(dummy));
-
-        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;k++)if (header[i].npart[k]>0)
+        vr::Timer filetimer;
+        Fortran_Record_File F;
+        Gadget_Blocks blocks;
+        if (!Gadget_open_file(opt, i, F, header[i], blocks)) MPI_Abort(MPI_COMM_WORLD,9);
+        //index in the blocks of all particles and of those with masses of the first particle of each type
+        Int_t nfirst=0, nmassfirst=0;
+        for(k=0,count2=count,bcount2=bcount,pc_new=pc;k<NGTYPE;nfirst+=header[i].npart[k],nmassfirst+=(header[i].mass[k]==0)*header[i].npart[k],k++)if (header[i].npart[k]>0)
         {
-            //data loaded into memory in chunks
-            if (header[i].npart[k]<chunksize)nchunk=header[i].npart[k];
-            else nchunk=chunksize;
             ninputoffset = 0;
             for(n=0;n<header[i].npart[k];n+=nchunk)
             {
-                if (header[i].npart[k]-n<chunksize&&header[i].npart[k]-n>0)nchunk=header[i].npart[k]-n;
-                Fgad[i].read((char*)ctempchunk, sizeof(FLOAT)*3*nchunk);
-                Fgadvel[i].read((char*)vtempchunk, sizeof(FLOAT)*3*nchunk);
-                Fgadid[i].read((char*)idvalchunk, sizeof(idval)*nchunk);
-#ifdef GASON
-                for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++){
-                    Fgadsph[i+sphblocks].read((char*)&sphtempchunk[sphblocks*nchunk], sizeof(FLOAT)*nchunk);
-                }
-#endif
-#ifdef STARON
-                for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++){
-                    Fgadstar[i+starblocks].read((char*)&startempchunk[starblocks*nchunk], sizeof(FLOAT)*nchunk);
-                }
-#endif
-#ifndef NOMASS
-                if(header[i].mass[k]==0) Fgadmass[i].read((char*)dtempchunk, sizeof(REAL)*nchunk);
-#endif
-                //once a block of data is in memory, start parsing it.
+                nchunk=min(chunksize,(Int_t)header[i].npart[k]-n);
+                //positions are decoded from the mapped file and their processors determined for the whole chunk with OpenMP threads,
+                //other quantities being decoded as each particle is placed
+                Gadget_read_block(F, blocks.pos, 3*(nfirst+n), 3*nchunk, ctempchunk);
+                MPIGetParticlesProcessor(opt, nchunk, ctempchunk, chunkprocessor.data());
                 for (int nn=0;nn<nchunk;nn++) {
+                Int_t nfile=nfirst+n+nn;
                 ctemp[0]=ctempchunk[0+3*nn];ctemp[1]=ctempchunk[1+3*nn];ctemp[2]=ctempchunk[2+3*nn];
-                vtemp[0]=vtempchunk[0+3*nn];vtemp[1]=vtempchunk[1+3*nn];vtemp[2]=vtempchunk[2+3*nn];
-                idval=idvalchunk[nn];
-                for (int kk=0;kk<3;kk++) {ctemp[kk]=LittleFLOAT(ctemp[kk]);vtemp[kk]=LittleFLOAT(vtemp[kk]);}
+                for (int kk=0;kk<3;kk++) vtemp[kk]=LittleEndianValue<FLOAT>(F.data(blocks.vel),3*nfile+kk);
+                idval=LittleEndianValue<GADGETIDTYPE>(F.data(blocks.id),nfile);
 #ifdef GASON
-                for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++)sphtempchunk[sphblocks*nchunk+nn]=LittleFLOAT(sphtempchunk[sphblocks*nchunk+nn]);
+                FLOAT utemp=0, rhotemp=0;
+                if (k==GGASTYPE && blocks.u>=0) utemp=LittleEndianValue<FLOAT>(F.data(blocks.u),n+nn);
+                if (k==GGASTYPE && blocks.rho>=0) rhotemp=LittleEndianValue<FLOAT>(F.data(blocks.rho),n+nn);
 #endif
 #ifdef STARON
-                for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++)startempchunk[starblocks*nchunk+nn]=LittleFLOAT(startempchunk[starblocks*nchunk+nn]);
-#endif
-
-#ifdef GADGETLONGID
-                idval=LittleLongInt(idval);
-#else
-                idval=LittleInt(idval);
+                FLOAT agetemp=0;
+                if (k==GSTARTYPE && blocks.age>=0) agetemp=LittleEndianValue<FLOAT>(F.data(blocks.age),n+nn);
 #endif
 #ifndef NOMASS
-                if(header[i].mass[k]==0) {
-                    dtemp=dtempchunk[nn];
-                    dtemp=LittleREAL(dtemp);
-                }
+                if(header[i].mass[k]==0) dtemp=LittleEndianValue<REAL>(F.data(blocks.mass),nmassfirst+n+nn);
                 else dtemp=header[i].mass[k];
 #else
                 dtemp=1.0;
@@ -1139,8 +460,8 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
                 if(k!=GGASTYPE && k!= GSTARTYPE && k!=GBHTYPE && dtemp<MP_DM&&dtemp>0) MP_DM=dtemp;
                 if(k==GGASTYPE && dtemp<MP_B&&dtemp>0) MP_B=dtemp;
 
-                //determine processor this particle belongs on based on its spatial position
-                ibuf=MPIGetParticlesProcessor(opt, ctemp[0],ctemp[1],ctemp[2]);
+                //processor this particle belongs on based on its spatial position
+                ibuf=chunkprocessor[nn];
                 ibufindex=ibuf*BufSize+Nbuf[ibuf];
                 //when running hydro runs, need to reset particle buffer quantities
                 //related to hydro info to zero
@@ -1176,11 +497,11 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
                     else Pbuf[ibufindex].SetType(DARKTYPE);
                     //assume that first sphblock is internal energy
 #ifdef GASON
-                    if (k==GGASTYPE) Pbuf[ibufindex].SetU(sphtempchunk[0*nchunk+nn]);
-                    if (k==GGASTYPE) Pbuf[ibufindex].SetSPHDen(sphtempchunk[1*nchunk+nn]);
+                    if (k==GGASTYPE) Pbuf[ibufindex].SetU(utemp);
+                    if (k==GGASTYPE) Pbuf[ibufindex].SetSPHDen(rhotemp);
 #endif
 #ifdef STARON
-                    if (k==GSTARTYPE) Pbuf[ibufindex].SetTage(startempchunk[0*nchunk+nn]);
+                    if (k==GSTARTYPE) Pbuf[ibufindex].SetTage(agetemp);
 #endif
 #ifdef EXTRAINPUTINFO
                     if (opt.iextendedoutput)
@@ -1225,14 +546,14 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
                         Pbuf[ibufindex].SetPID(idval);
                         if (k==GGASTYPE) {
 #ifdef GASON
-                            Pbuf[ibufindex].SetU(sphtempchunk[0*nchunk+nn]);
-                            Pbuf[ibufindex].SetSPHDen(sphtempchunk[1*nchunk+nn]);
+                            Pbuf[ibufindex].SetU(utemp);
+                            Pbuf[ibufindex].SetSPHDen(rhotemp);
 #endif
                             Pbuf[ibufindex].SetType(GASTYPE);
                         }
                         else if (k==GSTARTYPE) {
 #ifdef STARON
-                            Pbuf[ibufindex].SetTage(startempchunk[0*nchunk+nn]);
+                            Pbuf[ibufindex].SetTage(agetemp);
 #endif
                             Pbuf[ibufindex].SetType(STARTYPE);
                         }
@@ -1265,7 +586,7 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
                             vtemp[2]*opt.velocityinputconversion*sqrt(opt.a)+Hubbleflow*ctemp[2],
                             count2,STARTYPE);
 #ifdef STARON
-                        Pbuf[ibufindex].SetTage(startempchunk[0*nchunk+nn]);
+                        Pbuf[ibufindex].SetTage(agetemp);
 #endif
                         Pbuf[ibufindex].SetPID(idval);
 #ifdef EXTRAINPUTINFO
@@ -1291,8 +612,8 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
                         //ensure that store number of particles to be sent to the reading threads
                         Pbuf[ibufindex].SetPID(idval);
 #ifdef GASON
-                        Pbuf[ibufindex].SetU(sphtempchunk[0*nchunk+nn]);
-                        Pbuf[ibufindex].SetSPHDen(sphtempchunk[1*nchunk+nn]);
+                        Pbuf[ibufindex].SetU(utemp);
+                        Pbuf[ibufindex].SetSPHDen(rhotemp);
 #endif
 #ifdef EXTRAINPUTINFO
                         if (opt.iextendedoutput)
@@ -1311,14 +632,7 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
                 ninputoffset += nchunk;
             }
         }
-        //more information contained in sph particles and if there is sf feed back but for the moment, ignore
-        Fgad[i].close();
-        Fgadvel[i].close();
-        Fgadid[i].close();
-        Fgadmass[i].close();
-        for (int sphblocks=0;sphblocks<NUMGADGETSPHBLOCKS;sphblocks++) Fgadsph[i+sphblocks].close();
-        for (int starblocks=0;starblocks<NUMGADGETSTARBLOCKS;starblocks++) Fgadstar[i+starblocks].close();
-        for (int bhblocks=0;bhblocks<NUMGADGETBHBLOCKS;bhblocks++) Fgadbh[i+bhblocks].close();
+        readtime += filetimer.get()*1e-6;
         //send information between read threads
         if (opt.nsnapread>1&&inreadsend<totreadsend){
             MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
@@ -1327,6 +641,8 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
             for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
         }
     }//end of loop over input files
+    //wait for the full buffers still in flight before sending what is left
+    MPICompleteParticleSendsFromReadThreads();
     //once finished reading the file if there are any particles left in the buffer broadcast them
     for(ibuf = 0; ibuf < NProcs; ibuf++) if (ireadtask[ibuf]<0)
     {
@@ -1345,6 +661,8 @@ void ReadGadget(Options &opt, vector<Particle> &Part, const Int_t nbodies,Partic
         MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
         MPISendParticlesBetweenReadThreads(opt, Preadbuf, Part.data(), ireadtask, readtaskID, Pbaryons, mpi_comm_read, mpi_nsend_readthread, mpi_nsend_readthread_baryon);
     }
+    MPIReportReadBalance(mpi_comm_read, MPIReadRangesCost(readranges, typecost), readtime);
+    delete[] ctempchunk;
 #endif
 
 #ifdef USEMPI
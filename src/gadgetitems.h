@@ -3,6 +3,7 @@
 
 //for endian independance
 #include "endianutils.h"
+#include "io.h"
 
 ///for gadget coords
 #ifdef GADGETDOUBLEPRECISION
@@ -125,6 +126,38 @@ struct gadget_particle_data
   }
 };
 
+///records of the blocks of an unformatted gadget file, -1 for blocks the file does not hold
+struct Gadget_Blocks {
+    int pos = -1, vel = -1, id = -1, mass = -1;
+    ///gas internal energy, density and star formation rate
+    int u = -1, rho = -1, sfr = -1;
+    ///stellar ages and the metallicity of gas and stars
+    int age = -1, metals = -1;
+};
+
+///name of gadget input file ifile
+string Gadget_file_name(Options &opt, int ifile);
+///maps a gadget file, reading its header and locating the records of its particle blocks
+bool Gadget_open_file(Options &opt, int ifile, Fortran_Record_File &F, gadget_header &header, Gadget_Blocks &blocks);
+
+///copies values [first, first+n) of a block to dest in native byte order, with threads sharing large blocks
+template<typename T> void Gadget_read_block(const Fortran_Record_File &F, int irecord, size_t first, size_t n, T *dest)
+{
+    const char *src=F.data(irecord)+first*sizeof(T);
+#ifdef USEOPENMP
+    if (n>ompsearchnum) {
+#pragma omp parallel
+    {
+        size_t nthreads=omp_get_num_threads(), ithread=omp_get_thread_num();
+        size_t start=n*ithread/nthreads, end=n*(ithread+1)/nthreads;
+        LittleEndianCopy(src+start*sizeof(T), dest+start, end-start);
+    }
+    return;
+    }
+#endif
+    LittleEndianCopy(src, dest, n);
+}
+
 inline int find_files(char *fname)
 {
   FILE *fd;
@@ -84,7 +84,7 @@ void H5OutputFile::close()
 }
 
 
-void H5OutputFile::write_dataset(Options opt, string name, hsize_t len, void *data,
+void H5OutputFile::write_dataset(const Options &opt, string name, hsize_t len, void *data,
    hid_t memtype_id, hid_t filetype_id, bool flag_parallel)
 {
     int rank = 1;
@@ -92,7 +92,7 @@ void H5OutputFile::write_dataset(Options opt, string name, hsize_t len, void *da
     write_dataset_nd(opt, name, rank, dims, data, memtype_id, filetype_id, flag_parallel);
 }
 
-void H5OutputFile::write_dataset(Options opt, string name, hsize_t len, string data,
+void H5OutputFile::write_dataset(const Options &opt, string name, hsize_t len, string data,
     bool flag_parallel)
 {
 #ifdef USEPARALLELHDF
@@ -196,7 +196,7 @@ static void write_in_chunks(const void *data, hsize_t *dims,
 };
 
 
-void H5OutputFile::write_dataset_nd(Options opt, std::string name,
+void H5OutputFile::write_dataset_nd(const Options &opt, std::string name,
     int ndims, hsize_t *dims, void *data,
     hid_t memtype_id, hid_t filetype_id,
     bool flag_parallel)
@@ -27,6 +27,7 @@
 
 #include "logging.h"
 #include "stf.h"
+#include "timer.h"
 
 #include "hdfitems.h"
 extern "C" herr_t file_attrib_info(hid_t loc_id, const char *name, const H5L_info_t *linfo, void *opdata)
@@ -738,9 +739,17 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
 
     //for parallel input
     MPI_Comm mpi_comm_read;
-    //for parallel hdf5 read
-    MPI_Comm mpi_comm_parallel_read;
-    int ThisParallelReadTask, NProcsParallelReadTask;
+    //particle ranges read by this task and the time taken to read them
+    std::vector<MPIReadRange> readranges;
+    std::vector<double> typecost(NHDFTYPE, 0);
+    double readtime = 0;
+    //processor of each particle in the current chunk
+    vector<int> chunkprocessor(chunksize);
+    //a single pass load reads with every task and keeps what is read, exchanging particles once all files are read
+    bool isinglepassload = (opt.impisinglepassload && NProcs>1);
+    int nsnapread = opt.nsnapread;
+    Int_t nlocalread = 0, nbaryonread = 0;
+    if (isinglepassload) opt.nsnapread = NProcs;
     vector<Particle> *Preadbuf;
     Int_t BufSize=opt.mpiparticlebufsize;
     Int_t *Nbuf, *Nreadbuf,*nreadoffset;
@@ -807,26 +816,6 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
             Preadbuf=new vector<Particle>[opt.nsnapread];
             for (int j=0;j<opt.nsnapread;j++) Preadbuf[j].reserve(BufSize);
         }
-        //to determine which files the thread should read
-        ireadfile = std::vector<int>(opt.num_files);
-        ifirstfile=MPISetFilesRead(opt,ireadfile,ireadtask);
-        inreadsend=0;
-        for (int j=0;j<opt.num_files;j++) inreadsend+=ireadfile[j];
-        MPI_Allreduce(&inreadsend,&totreadsend,1,MPI_Int_t,MPI_MIN,mpi_comm_read);
-#ifdef USEPARALLELHDF
-        if (opt.nsnapread > opt.num_files) {
-            int ntaskread = ceil(opt.nsnapread/opt.num_files);
-            int ifile = floor(ireadtask[ThisTask]/ntaskread);
-	    int ThisReadTask, NProcsReadTask;
-            MPI_Comm_rank(mpi_comm_read, &ThisReadTask);
-            MPI_Comm_size(mpi_comm_read, &NProcsReadTask);
-            MPI_Comm_split(mpi_comm_read, ifile, ThisReadTask, &mpi_comm_parallel_read);
-            MPI_Comm_rank(mpi_comm_parallel_read, &ThisParallelReadTask);
-            MPI_Comm_size(mpi_comm_parallel_read, &NProcsParallelReadTask);
-            plist_id = H5Pcreate(H5P_FILE_ACCESS);
-            H5Pset_fapl_mpio(plist_id, mpi_comm_parallel_read, MPI_INFO_NULL);
-        }
-#endif
     }
     else {
         Nlocalthreadbuf=new Int_t[opt.nsnapread];
@@ -899,6 +888,35 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
         for (auto &x:partsdataspaceall_extra) x=-1;
         extrafieldbuff = new double[numextrafields*chunksize];
     }
+
+    //to determine which parts of which files the thread should read, balancing the number of values loaded by each read task.
+    //Each range is read independently so several tasks can read hyperslabs of the same file
+    for (j=0;j<nusetypes;j++) typecost[usetypes[j]] = 8 + numextrafieldsvec[usetypes[j]];
+    if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch) for (j=1;j<=nbusetypes;j++) typecost[usetypes[j]] = 8 + numextrafieldsvec[usetypes[j]];
+#ifdef GASON
+    if (typecost[HDFGASTYPE] > 0) typecost[HDFGASTYPE] += 4;
+#endif
+#ifdef STARON
+    if (typecost[HDFSTARTYPE] > 0) typecost[HDFSTARTYPE] += 2;
+#endif
+    readranges = MPIPlanFileReads(opt, ireadtask, MPIHDFFileParticleCounts(opt, mpi_comm_read), typecost, true);
+    //the plan gives the exact number of particles kept locally in a single pass load
+    if (isinglepassload) {
+        for (auto &range:readranges) {
+            bool issearched = false;
+            for (j=0;j<nusetypes;j++) issearched |= (range.itype==usetypes[j]);
+            if (issearched) nlocalread += range.nend-range.nstart;
+            else nbaryonread += range.nend-range.nstart;
+        }
+        Part.resize(nlocalread+nbaryonread);
+        if (opt.iBaryonSearch && opt.partsearchtype!=PSTALL) Pbaryons=&(Part.data()[nlocalread]);
+        else Pbaryons=NULL;
+    }
+    ireadfile = std::vector<int>(opt.num_files);
+    ifirstfile = MPISetFilesRead(opt, ireadfile, readranges);
+    inreadsend=0;
+    for (int j=0;j<opt.num_files;j++) inreadsend+=ireadfile[j];
+    MPI_Allreduce(&inreadsend,&totreadsend,1,MPI_Int_t,MPI_MIN,mpi_comm_read);
 #endif
     for(i=0; i<opt.num_files; i++) if(ireadfile[i]) {
         if(opt.num_files>1) sprintf(buf,"%s.%d.hdf5",opt.fname,(int)i);
@@ -912,9 +930,6 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
 
             //Open the specified file and the specified dataset in the file.
             Fhdf[i] = H5Fopen(buf, H5F_ACC_RDONLY, plist_id);
-#ifdef USEPARALLELHDF
-            H5Pclose(plist_id);
-#endif
             if (ThisTask==0 && i==0) {
                 LOG(info) << "HDF file " << buf << " contains the following group structures:";
                 //H5Literate(Fhdf[i].getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, file_info, NULL);
@@ -2330,6 +2345,7 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
         for(i=0; i<opt.num_files; i++) if(ireadfile[i])
         {
             LOG(info) << "Reading file " << i;
+            vr::Timer filetimer;
             ///\todo should be more rigorous with try/catch stuff
             //try
             {
@@ -2712,28 +2728,15 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
 #endif
                 }
 
-#ifdef USEPARALLELHDF
-                if (opt.num_files<opt.nsnapread) {
-                    plist_id = H5Pcreate(H5P_DATASET_XFER);
-                    H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_INDEPENDENT);
-                }
-#endif
                 for (j=0;j<nusetypes;j++)
                 {
                     k=usetypes[j];
-                    unsigned long long nstart = 0, nend = hdf_header_info[i].npart[k];
-                    unsigned long long nlocalsize;
-#ifdef USEPARALLELHDF
-                    if (opt.num_files<opt.nsnapread) {
-                        nlocalsize = nend / NProcsParallelReadTask;
-                        nstart = nlocalsize*ThisParallelReadTask;
-                        if (ThisParallelReadTask < NProcsParallelReadTask -1)
-                            nend = nlocalsize + nstart;
-                    }
-#endif
+                    //only the planned range of this type in this file is read
+                    unsigned long long nstart = 0, nend = 0;
+                    for (auto &range:readranges) if (range.ifile==i && range.itype==k) {nstart=range.nstart; nend=range.nend;}
                     if (nend-nstart<chunksize)nchunk=nend-nstart;
                     else nchunk=chunksize;
-                    ninputoffset = 0;
+                    ninputoffset = nstart;
                     for(n=nstart;n<nend;n+=nchunk)
                     {
                         if (nend - n < chunksize && nend - n > 0) nchunk=nend-n;
@@ -3070,8 +3073,12 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
                             iextraoffset += opt.extra_dm_internalprop_names.size();
 #endif
                         }
+                    //processors of the whole chunk are determined with OpenMP threads before the particles are buffered
+                    MPIGetParticlesProcessor(opt, nchunk, doublebuff, chunkprocessor.data());
                     for (unsigned long long nn=0;nn<nchunk;nn++) {
-                        ibuf=MPIGetParticlesProcessor(opt, doublebuff[nn*3],doublebuff[nn*3+1],doublebuff[nn*3+2]);
+                        ibuf=chunkprocessor[nn];
+                        //particle is still binned into its mesh cell but kept by the reading task
+                        if (isinglepassload) ibuf=ThisTask;
                         ibufindex=ibuf*BufSize+Nbuf[ibuf];
                         //reset hydro quantities of buffer
 #ifdef GASON
@@ -3405,19 +3412,12 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
                 if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch) {
                   for (j=1;j<=nbusetypes;j++) {
                     k=usetypes[j];
-                    unsigned long long nstart = 0, nend = hdf_header_info[i].npart[k];
-                    unsigned long long nlocalsize;
-#ifdef USEPARALLELHDF
-                    if (opt.num_files<opt.nsnapread) {
-                        nlocalsize = nend / NProcsParallelReadTask;
-                        nstart = nlocalsize*ThisParallelReadTask;
-                        if (ThisParallelReadTask < NProcsParallelReadTask -1)
-                            nend = nlocalsize + nstart;
-                    }
-#endif
+                    //only the planned range of this type in this file is read
+                    unsigned long long nstart = 0, nend = 0;
+                    for (auto &range:readranges) if (range.ifile==i && range.itype==k) {nstart=range.nstart; nend=range.nend;}
                     if (nend-nstart<chunksize)nchunk=nend-nstart;
                     else nchunk=chunksize;
-                    ninputoffset = 0;
+                    ninputoffset = nstart;
                     for(n=nstart;n<nend;n+=nchunk)
                     {
                       if (nend - n < chunksize && nend - n > 0) nchunk=nend-n;
@@ -3474,9 +3474,11 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
 
 #endif
 #endif
+                      if (ifloat_pos) MPIGetParticlesProcessor(opt, nchunk, floatbuff, chunkprocessor.data());
+                      else MPIGetParticlesProcessor(opt, nchunk, doublebuff, chunkprocessor.data());
                       for (int nn=0;nn<nchunk;nn++) {
-                        if (ifloat_pos) ibuf=MPIGetParticlesProcessor(opt, floatbuff[nn*3],floatbuff[nn*3+1],floatbuff[nn*3+2]);
-                        else ibuf=MPIGetParticlesProcessor(opt, doublebuff[nn*3],doublebuff[nn*3+1],doublebuff[nn*3+2]);
+                        ibuf=chunkprocessor[nn];
+                        if (isinglepassload) ibuf=ThisTask;
                         ibufindex=ibuf*BufSize+Nbuf[ibuf];
                         //reset hydro quantities of buffer
 #ifdef GASON
@@ -3541,10 +3543,6 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
                     }//end of chunk
                   }//end of part type
                 }//end of baryon if
-                //close property
-#ifdef USEPARALLELHDF
-                H5Pclose(plist_id);
-#endif
                 //close data spaces
                 for (auto &hidval:partsdataspaceall) HDF5CloseDataSpace(hidval);
                 for (auto &hidval:partsdatasetall) HDF5CloseDataSet(hidval);
@@ -3597,6 +3595,7 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
             }
             */
             HDF5CloseFile(Fhdf[i]);
+            readtime += filetimer.get()*1e-6;
             //send info between read threads
             if (opt.nsnapread>1&&inreadsend<totreadsend){
                 MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
@@ -3605,6 +3604,8 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
                 for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
             }
         }//end of file if read
+        //wait for the full buffers still in flight before sending what is left
+        MPICompleteParticleSendsFromReadThreads();
         //once finished reading the file if there are any particles left in the buffer broadcast them
         for(ibuf = 0; ibuf < NProcs; ibuf++) if (ireadtask[ibuf]<0)
         {
@@ -3628,11 +3629,13 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
             inreadsend++;
             for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
         }
+        MPIReportReadBalance(mpi_comm_read, MPIReadRangesCost(readranges, typecost), readtime);
     }
     //if not reading information than waiting to receive information
     else {
         MPIReceiveParticlesFromReadThreads(opt,Pbuf,Part.data(),readtaskID, irecv, mpi_irecvflag, Nlocalthreadbuf, mpi_request,Pbaryons);
     }
+    if (isinglepassload) MPIExchangeSinglePassLoad(opt, Part, Pbaryons, nlocalread, nbaryonread, ireadtask, readtaskID, mpi_comm_read);
 #endif
 
 
@@ -3731,11 +3734,6 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
     }
     //a bit of clean up
 #ifdef USEMPI
-#ifdef USEPARALLELHDF
-    if (opt.nsnapread > opt.num_files) {
-        if (ireadtask[ThisTask] >= 0) MPI_Comm_free(&mpi_comm_parallel_read);
-    }
-#endif
     MPI_Comm_free(&mpi_comm_read);
     if (opt.iBaryonSearch) delete[] mpi_nsend_baryon;
     if (opt.nsnapread>1) {
@@ -3750,6 +3748,7 @@ void ReadHDF(Options &opt, vector<Particle> &Part, const Int_t nbodies,Particle
     }
     delete[] ireadtask;
     delete[] readtaskID;
+    opt.nsnapread = nsnapread;
 #endif
 
 #ifdef USEMPI
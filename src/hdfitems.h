@@ -530,7 +530,7 @@ public:
 
     /// Write a new 1D dataset. Data type of the new dataset is taken to be the type of
     /// the input data if not explicitly specified with the filetype_id parameter.
-    template <typename T> void write_dataset(Options opt, std::string name, hsize_t len, T *data,
+    template <typename T> void write_dataset(const Options &opt, std::string name, hsize_t len, T *data,
        hid_t memtype_id = -1, hid_t filetype_id=-1, bool flag_parallel = true)
     {
         assert(memtype_id == -1);
@@ -540,16 +540,16 @@ public:
                       memtype_id, filetype_id, flag_parallel);
     }
 
-    void write_dataset(Options opt, string name, hsize_t len, void *data,
+    void write_dataset(const Options &opt, string name, hsize_t len, void *data,
        hid_t memtype_id, hid_t filetype_id = -1, bool flag_parallel = true);
 
-    void write_dataset(Options opt, string name, hsize_t len, string data, bool flag_parallel = true);
+    void write_dataset(const Options &opt, string name, hsize_t len, string data, bool flag_parallel = true);
 
     /// Write a multidimensional dataset. Data type of the new dataset is taken to be the type of
     /// the input data if not explicitly specified with the filetype_id parameter. This is just
     /// a wrapper which uses the type of the supplied array to set the memtype_id parameter
     /// if it's not set explicitly.
-    template <typename T> void write_dataset_nd(Options opt, std::string name, int rank, hsize_t *dims, T *data,
+    template <typename T> void write_dataset_nd(const Options &opt, std::string name, int rank, hsize_t *dims, T *data,
         hid_t memtype_id = -1, hid_t filetype_id = -1,
         bool flag_parallel = true)
     {
@@ -560,7 +560,7 @@ public:
                          memtype_id, filetype_id, flag_parallel);
     }
 
-    void write_dataset_nd(Options opt, std::string name, int rank, hsize_t *dims, void *data,
+    void write_dataset_nd(const Options &opt, std::string name, int rank, hsize_t *dims, void *data,
         hid_t memtype_id = -1, hid_t filetype_id = -1, bool flag_parallel = true);
 
     /// write an attribute
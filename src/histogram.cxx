@@ -0,0 +1,134 @@
+/**
+ * @file
+ *
+ * Weighted histograms of the outlier values of the particles built by all threads
+ */
+
+#include <algorithm>
+
+#include "histogram.h"
+
+namespace vr
+{
+
+/// The number of values whose bins are computed together before their weights are added
+static constexpr Int_t block_size = 256;
+
+Histogram::Histogram(Int_t nbodies, Particle *part)
+  : values(nbodies), weights(nbodies)
+{
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbodies > ompsubsearchnum && !omp_in_parallel())
+#endif
+	for (Int_t i = 0; i < nbodies; i++) {
+		values[i] = part[i].GetPotential();
+#if defined(NOMASSWEIGHT) || defined(HIGHRES)
+		weights[i] = 1.0;
+#else
+		weights[i] = part[i].GetMass();
+#endif
+	}
+}
+
+int Histogram::nthreads() const
+{
+#ifdef USEOPENMP
+	if (size() > ompsubsearchnum && !omp_in_parallel()) {
+		return omp_get_max_threads();
+	}
+#endif
+	return 1;
+}
+
+std::pair<Double_t, Double_t> Histogram::range() const
+{
+	const Int_t n = size();
+	if (n == 0) {
+		return {0, 0};
+	}
+	const Double_t *v = values.data();
+	Double_t vmin = v[0], vmax = v[0];
+#ifdef USEOPENMP
+#pragma omp parallel for simd schedule(static) num_threads(nthreads()) reduction(min:vmin) reduction(max:vmax)
+#endif
+	for (Int_t i = 1; i < n; i++) {
+		vmin = std::min(vmin, v[i]);
+		vmax = std::max(vmax, v[i]);
+	}
+	return {vmin, vmax};
+}
+
+Int_t Histogram::count(Double_t lo, Double_t hi) const
+{
+	const Int_t n = size();
+	const Double_t *v = values.data();
+	Int_t num = 0;
+#ifdef USEOPENMP
+#pragma omp parallel for simd schedule(static) num_threads(nthreads()) reduction(+:num)
+#endif
+	for (Int_t i = 0; i < n; i++) {
+		num += (v[i] >= lo && v[i] < hi);
+	}
+	return num;
+}
+
+Histogram::bins Histogram::fill(Double_t xmin, Double_t dx, int nbins) const
+{
+	const Int_t n = size();
+	const int nt = nthreads();
+	// each thread sums into its own histogram, with an extra last bin for the values outside the range
+	std::vector<std::vector<Double_t>> sum(nt), sum2(nt);
+
+	auto fill_range = [&](Int_t begin, Int_t end, std::vector<Double_t> &s, std::vector<Double_t> &s2) {
+		s.assign(nbins + 1, 0);
+		s2.assign(nbins + 1, 0);
+		int ibin[block_size];
+		const Double_t *v = values.data();
+		const Double_t *w = weights.data();
+		for (Int_t b = begin; b < end; b += block_size) {
+			const int nblock = std::min(block_size, end - b);
+#ifdef USEOPENMP
+#pragma omp simd
+#endif
+			for (int k = 0; k < nblock; k++) {
+				Double_t t = (v[b + k] - xmin) / dx;
+				ibin[k] = (t >= 0 && t < nbins) ? int(t) : nbins;
+			}
+			for (int k = 0; k < nblock; k++) {
+				Double_t wk = w[b + k];
+				s[ibin[k]] += wk;
+				s2[ibin[k]] += wk * wk;
+			}
+		}
+	};
+
+#ifdef USEOPENMP
+#pragma omp parallel num_threads(nt) if (nt > 1)
+	{
+		int tid = omp_get_thread_num(), nused = omp_get_num_threads();
+		fill_range(n * tid / nused, n * (tid + 1) / nused, sum[tid], sum2[tid]);
+	}
+#else
+	fill_range(0, n, sum[0], sum2[0]);
+#endif
+
+	bins result;
+	result.sum.assign(nbins, 0);
+	result.sum2.assign(nbins, 0);
+	result.total = 0;
+	for (int t = 0; t < nt; t++) {
+		if (sum[t].empty()) {
+			continue;
+		}
+		for (int j = 0; j < nbins; j++) {
+			result.sum[j] += sum[t][j];
+			result.sum2[j] += sum2[t][j];
+		}
+	}
+	for (int j = 0; j < nbins; j++) {
+		result.total += result.sum[j];
+	}
+	return result;
+}
+
+}  // namespace vr
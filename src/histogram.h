@@ -0,0 +1,89 @@
+/**
+ * @file
+ *
+ * Weighted histograms of the outlier values of the particles built by all threads
+ */
+
+#ifndef VR_HISTOGRAM_H_
+#define VR_HISTOGRAM_H_
+
+#include <utility>
+#include <vector>
+
+#include "allvars.h"
+
+
+namespace vr {
+
+/**
+ * Bins the values held in the potential of a set of particles, weighted as in
+ * the fits of the distribution of the velocity density ratios.
+ *
+ * The values and weights are packed into arrays once, so that the repeated
+ * binnings done while fitting the distribution stream through contiguous memory
+ * instead of the particles. Each thread fills its own histogram over a static
+ * share of the values, first computing the bins of a block of values in a loop
+ * that vectorises and then adding the weights, and the histograms are summed in
+ * the order of the threads. The result therefore only depends on the number of
+ * threads. Sets of at least ompsubsearchnum values are binned with several
+ * threads unless already within a parallel region, so the same code serves the
+ * field and every substructure level.
+ */
+class Histogram {
+
+public:
+
+	/// The weights summed in each bin
+	struct bins {
+		/// the sum of the weights
+		std::vector<Double_t> sum;
+		/// the sum of the squared weights
+		std::vector<Double_t> sum2;
+		/// the sum of the weights over all bins
+		Double_t total;
+	};
+
+	/**
+	 * Packs the values and weights of the particles.
+	 *
+	 * Particles are weighted by their mass, unless NOMASSWEIGHT or HIGHRES is
+	 * defined in which case all have unit weight.
+	 *
+	 * @param nbodies The number of particles
+	 * @param part The particles, whose potential holds the values
+	 */
+	Histogram(Int_t nbodies, Particle *part);
+
+	/// The number of values
+	Int_t size() const { return values.size(); }
+
+	/// The smallest and largest values
+	std::pair<Double_t, Double_t> range() const;
+
+	/// The number of values in [lo, hi)
+	Int_t count(Double_t lo, Double_t hi) const;
+
+	/**
+	 * Bins the values.
+	 *
+	 * A value v falls in bin (int)((v - xmin) / dx), and is skipped if that
+	 * is not one of the nbins bins.
+	 *
+	 * @param xmin The lower edge of the first bin
+	 * @param dx The width of the bins
+	 * @param nbins The number of bins
+	 * @return The weights summed in each bin
+	 */
+	bins fill(Double_t xmin, Double_t dx, int nbins) const;
+
+private:
+
+	std::vector<Double_t> values, weights;
+
+	int nthreads() const;
+
+};
+
+}  // namespace vr
+
+#endif // VR_HISTOGRAM_H_
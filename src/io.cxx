@@ -24,6 +24,10 @@
 #include "logging.h"
 #include "timer.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 ///write the information stored in a unit struct as meta data into a HDF5 file
 #ifdef USEHDF
 inline void WriteHeaderUnitEntry(Options & opt, H5OutputFile & hfile, string datasetname, HeaderUnitInfo &u)
@@ -48,6 +52,66 @@ bool FileExists(const char *fname)
   return stat(fname, &stFileInfo) == 0;
 }
 
+bool Fortran_Record_File::open(const string &fname)
+{
+    close();
+    int fd=::open(fname.c_str(), O_RDONLY);
+    if (fd<0) return false;
+    struct stat st;
+    if (fstat(fd, &st)!=0) {
+        ::close(fd);
+        return false;
+    }
+    length=st.st_size;
+    void *addr=(length>0)?mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0):MAP_FAILED;
+    if (addr!=MAP_FAILED) {
+        madvise(addr, length, MADV_WILLNEED);
+        base=(const char*)addr;
+        mapped=true;
+    }
+    else {
+        //read the whole file in large blocks instead
+        buffer.resize(length+1);
+        size_t nread=0;
+        ssize_t n;
+        while (nread<length && (n=::read(fd, &buffer[nread], length-nread))>0) nread+=n;
+        if (nread<length) {
+            ::close(fd);
+            close();
+            return false;
+        }
+        base=buffer.data();
+    }
+    ::close(fd);
+
+    //index the records, each being a payload between two markers holding its size
+    //the markers are little endian like the payloads, which are read with LittleEndianValue
+    size_t offset=0;
+    int head, tail;
+    while (offset+2*sizeof(int)<=length) {
+        head=LittleEndianValue<int>(base+offset, 0);
+        if (head<0 || offset+2*sizeof(int)+head>length) break;
+        tail=LittleEndianValue<int>(base+offset+sizeof(int)+head, 0);
+        if (tail!=head) break;
+        offsets.push_back(offset+sizeof(int));
+        sizes.push_back(head);
+        offset+=2*sizeof(int)+head;
+    }
+    if (offset!=length) LOG(warning) << "File " << fname << " has " << length-offset << " bytes after its last complete record";
+    return true;
+}
+
+void Fortran_Record_File::close()
+{
+    if (mapped) munmap((void*)base, length);
+    base=NULL;
+    length=0;
+    mapped=false;
+    vector<char>().swap(buffer);
+    offsets.clear();
+    sizes.clear();
+}
+
 ///\name Read particle data files
 //@{
 
@@ -247,10 +311,26 @@ void ReadLocalVelocityDensity(Options &opt, const Int_t nbodies, vector<Particle
 /// \name Write STF data files for intermediate steps
 //@{
 
-///Writes local velocity density of each particle to a file
+///Returns the particle indices in input order, as given by ids that index the input order, or in the current order if
+///the ids do not. The local velocity density can leave the particles in the order of its tree for later searches.
+static vector<Int_t> InputOrder(const Int_t nbodies, vector<Particle> &Part){
+    vector<Int_t> order(nbodies, -1);
+    for(Int_t i=0;i<nbodies;i++) {
+        Int_t id=Part[i].GetID();
+        if (id<0 || id>=nbodies || order[id]!=-1) {
+            for(Int_t j=0;j<nbodies;j++) order[j]=j;
+            return order;
+        }
+        order[id]=i;
+    }
+    return order;
+}
+
+///Writes local velocity density of each particle to a file, in input order
 void WriteLocalVelocityDensity(Options &opt, const Int_t nbodies, vector<Particle> &Part){
     fstream Fout;
     char fname[1000];
+    vector<Int_t> order=InputOrder(nbodies, Part);
 #ifdef USEMPI
     if(opt.smname==NULL) sprintf(fname,"%s.smdata.%d",opt.outname,ThisTask);
     else sprintf(fname,"%s.%d",opt.smname,ThisTask);
@@ -262,13 +342,13 @@ void WriteLocalVelocityDensity(Options &opt, const Int_t nbodies, vector<Particl
         Fout.open(fname,ios::out|ios::binary);
         Fout.write((char*)&nbodies,sizeof(Int_t));
         Double_t tempd;
-        for(Int_t i=0;i<nbodies;i++) {tempd=Part[i].GetDensity();Fout.write((char*)&tempd,sizeof(Double_t));}
+        for(Int_t i=0;i<nbodies;i++) {tempd=Part[order[i]].GetDensity();Fout.write((char*)&tempd,sizeof(Double_t));}
     }
     if (opt.ibinaryout==OUTBINARY) {
         Fout.open(fname,ios::out);
         Fout<<nbodies<<endl;
         Fout<<scientific<<setprecision(10);
-        for(Int_t i=0;i<nbodies;i++)Fout<<Part[i].GetDensity()<<endl;
+        for(Int_t i=0;i<nbodies;i++)Fout<<Part[order[i]].GetDensity()<<endl;
     }
     Fout.close();
 }
@@ -278,6 +358,51 @@ void WriteLocalVelocityDensity(Options &opt, const Int_t nbodies, vector<Particl
 ///\name FOF outputs
 //@{
 
+///Formats integers into a large character buffer that is written to the stream in blocks, rather than
+///formatting and flushing every value through the stream
+class AsciiIntWriter {
+public:
+    AsciiIntWriter(ostream &out, size_t bufsize = 1<<20) : out(out), buffer(bufsize) {}
+    ~AsciiIntWriter() { flush(); }
+
+    ///append value followed by the separator
+    void write(long long value, char sep = '\n') {
+        if (used + maxwidth > buffer.size()) flush();
+        used += format(value, sep, &buffer[used]);
+    }
+    ///append the same value count times
+    void write(long long value, Int_t count) {
+        char text[maxwidth];
+        auto len = format(value, '\n', text);
+        for (Int_t i=0;i<count;i++) {
+            if (used + len > buffer.size()) flush();
+            memcpy(&buffer[used], text, len);
+            used += len;
+        }
+    }
+    void flush() {
+        out.write(buffer.data(), used);
+        used = 0;
+    }
+
+private:
+    static constexpr size_t maxwidth = 22;
+    static size_t format(long long value, char sep, char *text) {
+        char digits[20];
+        int ndigits = 0;
+        size_t len = 0;
+        unsigned long long u = value < 0 ? -static_cast<unsigned long long>(value) : value;
+        do {digits[ndigits++] = '0' + u % 10; u /= 10;} while (u > 0);
+        if (value < 0) text[len++] = '-';
+        while (ndigits > 0) text[len++] = digits[--ndigits];
+        text[len++] = sep;
+        return len;
+    }
+    ostream &out;
+    vector<char> buffer;
+    size_t used = 0;
+};
+
 /*! Writes a tipsy formatted fof.grp array file that contains the number of particles first then for each particle the group id of that particle
     group zero is untagged particles. \n
 */
@@ -286,38 +411,150 @@ void WriteFOF(Options &opt, const Int_t nbodies, Int_t *pfof){
     char fname[1000];
     sprintf(fname,"%s.fof.grp",opt.outname);
     LOG(info) << "Saving fof data to " << fname;
+    vr::Timer timer;
     Fout.open(fname,ios::out);
+    Int_t nt=0;
+    for (int i=0;i<NPARTTYPES;i++) nt+=opt.numpart[i];
+    {
+    AsciiIntWriter writer(Fout);
     if (opt.partsearchtype==PSTALL) {
-        Fout<<nbodies<<endl;
-        for (Int_t i=0;i<nbodies;i++) Fout<<pfof[i]<<endl;
+        writer.write(nbodies);
+        for (Int_t i=0;i<nbodies;i++) writer.write(pfof[i]);
     }
     else if (opt.partsearchtype==PSTDARK) {
-        Int_t nt=0;
-        for (int i=0;i<NPARTTYPES;i++) nt+=opt.numpart[i];
-        Fout<<nt<<endl;
-        for (Int_t i=0;i<opt.numpart[GASTYPE];i++) Fout<<0<<endl;
-        for (Int_t i=0;i<nbodies;i++) Fout<<pfof[i]<<endl;
-        for (Int_t i=0;i<opt.numpart[STARTYPE];i++) Fout<<0<<endl;
+        writer.write(nt);
+        writer.write(0, opt.numpart[GASTYPE]);
+        for (Int_t i=0;i<nbodies;i++) writer.write(pfof[i]);
+        writer.write(0, opt.numpart[STARTYPE]);
     }
     else if (opt.partsearchtype==PSTSTAR) {
-        Int_t nt=0;
-        for (int i=0;i<NPARTTYPES;i++) nt+=opt.numpart[i];
-        Fout<<nt<<endl;
-        for (Int_t i=0;i<opt.numpart[GASTYPE];i++) Fout<<0<<endl;
-        for (Int_t i=0;i<opt.numpart[DARKTYPE];i++) Fout<<0<<endl;
-        for (Int_t i=0;i<nbodies;i++) Fout<<pfof[i]<<endl;
+        writer.write(nt);
+        writer.write(0, opt.numpart[GASTYPE]);
+        writer.write(0, opt.numpart[DARKTYPE]);
+        for (Int_t i=0;i<nbodies;i++) writer.write(pfof[i]);
     }
     else if (opt.partsearchtype==PSTGAS) {
-        Int_t nt=0;
-        for (int i=0;i<NPARTTYPES;i++) nt+=opt.numpart[i];
-        Fout<<nt<<endl;
-        for (Int_t i=0;i<nbodies;i++) Fout<<pfof[i]<<endl;
-        for (Int_t i=0;i<opt.numpart[DARKTYPE];i++) Fout<<0<<endl;
-        for (Int_t i=0;i<opt.numpart[STARTYPE];i++) Fout<<0<<endl;
+        writer.write(nt);
+        for (Int_t i=0;i<nbodies;i++) writer.write(pfof[i]);
+        writer.write(0, opt.numpart[DARKTYPE]);
+        writer.write(0, opt.numpart[STARTYPE]);
+    }
     }
     Fout.close();
-    LOG(info) << "Done";
+    LOG(info) << "Done in " << timer;
+}
+
+#ifdef USEMPI
+/*! Writes the group id of every local particle together with its particle id without collecting anything on a single task.
+    Particles are no longer in input order once groups have been localised, so the particle ids identify each entry.
+    Group ids are made global by offsetting them by the number of groups on preceding tasks.
+    - \ref OUTBINARY : all tasks write their slice at their global offset into a single file with MPI-IO. The file holds
+    the total number of particles (long long), then all particle ids (long long), then all group ids (\ref Int_t).
+    - \ref OUTHDF : Particle_IDs and Group_ID datasets. With parallel HDF5 the tasks of a write communicator
+    write collectively to one file, otherwise each task writes its own file.
+    - otherwise each task writes an ascii file listing its number of particles followed by particle id, group id pairs.
+*/
+void WriteFOFDistributed(Options &opt, const Int_t nbodies, Particle *Part, Int_t *pfof)
+{
+    vr::Timer timer;
+    MPIBuildWriteComm(opt);
+    Int_t ngroupoffset=0;
+    for (int j=0;j<ThisTask;j++) ngroupoffset+=mpi_ngroups[j];
+    vector<long long> pids(nbodies);
+    vector<Int_t> groupids(nbodies);
+    for (Int_t i=0;i<nbodies;i++) {
+        pids[i]=Part[i].GetPID();
+        groupids[i]=(pfof[i]>0)?pfof[i]+ngroupoffset:0;
+    }
+    long long nlocal=nbodies, noffset=0, ntotal=0;
+    MPI_Exscan(&nlocal, &noffset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (ThisTask==0) noffset=0;
+    MPI_Allreduce(&nlocal, &ntotal, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    char fname[1000];
+    if (opt.ibinaryout==OUTBINARY) {
+        sprintf(fname,"%s.fof.grp",opt.outname);
+        LOG_RANK0(info) << "Saving fof data of " << ntotal << " particles to " << fname;
+        MPI_File fh;
+        if (MPI_File_open(MPI_COMM_WORLD, fname, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+            LOG(error) << "Unable to open " << fname;
+            MPI_Abort(MPI_COMM_WORLD, 8);
+        }
+        MPI_File_set_size(fh, 0);
+        MPI_Status status;
+        if (ThisTask==0) MPI_File_write_at(fh, 0, &ntotal, 1, MPI_LONG_LONG, &status);
+        //write in chunks so that counts fit in an int
+        const Int_t chunk=1<<26;
+        MPI_Offset pidstart=sizeof(long long)*(1+noffset);
+        MPI_Offset gidstart=sizeof(long long)*(1+ntotal)+sizeof(Int_t)*noffset;
+        for (Int_t i=0;i<nbodies;i+=chunk) {
+            int n=min(chunk,nbodies-i);
+            MPI_File_write_at(fh, pidstart+sizeof(long long)*i, &pids[i], n, MPI_LONG_LONG, &status);
+            MPI_File_write_at(fh, gidstart+sizeof(Int_t)*i, &groupids[i], n, MPI_Int_t, &status);
+        }
+        MPI_File_close(&fh);
+    }
+#ifdef USEHDF
+    else if (opt.ibinaryout==OUTHDF) {
+        H5OutputFile Fhdf;
+#ifdef USEPARALLELHDF
+        sprintf(fname,"%s.fof.grp.%d",opt.outname,ThisWriteComm);
+        LOG_RANK0(info) << "Saving fof data of " << ntotal << " particles to " << fname;
+        if (opt.mpinprocswritesize>1) {
+            //task 0 of the write communicator writes the header, then the file is reopened for the parallel write
+            unsigned long long nlocalwrite=nbodies, nwritecommtot;
+            MPI_Allreduce(&nlocalwrite, &nwritecommtot, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, mpi_comm_write);
+            Fhdf.create(string(fname),H5F_ACC_TRUNC, 0, false);
+            if (ThisWriteTask==0) {
+                Fhdf.write_dataset(opt, "File_id", 1, &ThisWriteComm, -1, -1, false);
+                Fhdf.write_dataset(opt, "Num_of_files", 1, &NWriteComms, -1, -1, false);
+                Fhdf.write_dataset(opt, "Num_of_particles", 1, &nwritecommtot, -1, -1, false);
+                Fhdf.write_dataset(opt, "Total_num_of_particles", 1, &ntotal, -1, -1, false);
+            }
+            Fhdf.close();
+            MPI_Barrier(MPI_COMM_WORLD);
+            Fhdf.append(string(fname));
+        }
+        else {
+            Fhdf.create(string(fname),H5F_ACC_TRUNC, ThisWriteComm, false);
+            Fhdf.write_dataset(opt, "File_id", 1, &ThisWriteComm, -1, -1, false);
+            Fhdf.write_dataset(opt, "Num_of_files", 1, &NWriteComms, -1, -1, false);
+            Fhdf.write_dataset(opt, "Num_of_particles", 1, &nlocal, -1, -1, false);
+            Fhdf.write_dataset(opt, "Total_num_of_particles", 1, &ntotal, -1, -1, false);
+        }
+#else
+        sprintf(fname,"%s.fof.grp.%d",opt.outname,ThisTask);
+        LOG_RANK0(info) << "Saving fof data of " << ntotal << " particles to " << fname;
+        Fhdf.create(string(fname));
+        Fhdf.write_dataset(opt, "File_id", 1, &ThisTask);
+        Fhdf.write_dataset(opt, "Num_of_files", 1, &NProcs);
+        Fhdf.write_dataset(opt, "Num_of_particles", 1, &nlocal);
+        Fhdf.write_dataset(opt, "Total_num_of_particles", 1, &ntotal);
+#endif
+        Fhdf.write_dataset(opt, "Particle_IDs", nbodies, pids.data());
+        Fhdf.write_dataset(opt, "Group_ID", nbodies, groupids.data());
+        Fhdf.close();
+    }
+#endif
+    else {
+        sprintf(fname,"%s.fof.grp.%d",opt.outname,ThisTask);
+        LOG_RANK0(info) << "Saving fof data of " << ntotal << " particles to " << fname;
+        fstream Fout(fname,ios::out);
+        {
+        AsciiIntWriter writer(Fout);
+        writer.write(nlocal);
+        for (Int_t i=0;i<nbodies;i++) {
+            writer.write(pids[i], ' ');
+            writer.write(groupids[i]);
+        }
+        }
+        Fout.close();
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPIFreeWriteComm();
+    LOG_RANK0(info) << "Done in " << timer;
 }
+#endif
 
 /*! Writes a particle group list array file that contains the total number of groups,
     local number of groups (if using MPI) and group id followed by number of particles
@@ -1206,6 +1443,54 @@ void WriteGroupPartType(Options &opt, const Int_t ngroups, Int_t *numingroup, In
     LOG(info) << "Wrote particle type info in " << write_timer;
 }
 
+///the particles of the groups and their index lists, copied so that the catalogue can be written in the background
+struct GroupCatalogBuffer {
+    Options opt;
+    vector<Int_t> numingroup;
+    vector<Int_t> pgliststore;
+    vector<Int_t *> pglist;
+    vector<Particle> Part;
+};
+
+///Queues the group catalogue, and if requested the particle type catalogue, on the writer. When writing
+///asynchronously the particles of each group are first copied in pglist order so Part and pglist are free to change
+void SubmitGroupCatalog(vr::AsyncWriter &writer, Options &opt, const Int_t ngroups, Int_t *numingroup, Int_t **pglist, vector<Particle> &Part, Int_t nadditional, bool iparttype)
+{
+    if (!writer.asynchronous()) {
+        WriteGroupCatalog(opt, ngroups, numingroup, pglist, Part, nadditional);
+        if (iparttype) WriteGroupPartType(opt, ngroups, numingroup, pglist, Part);
+        return;
+    }
+    auto buffer = make_shared<GroupCatalogBuffer>();
+    buffer->opt = opt;
+    buffer->numingroup.assign(numingroup, numingroup + ngroups + 1);
+    bool haspglist = (pglist != NULL);
+    if (haspglist) {
+        Int_t nids = 0, offset = 0;
+        for (Int_t i=1;i<=ngroups;i++) nids += numingroup[i];
+        buffer->Part.reserve(nids);
+        buffer->pgliststore.resize(nids + ngroups);
+        buffer->pglist.assign(ngroups + 1, NULL);
+        for (Int_t i=1;i<=ngroups;i++) {
+            Int_t *ids = &buffer->pgliststore[offset];
+            for (Int_t j=0;j<numingroup[i];j++) {
+                ids[j] = buffer->Part.size();
+                buffer->Part.push_back(Part[pglist[i][j]]);
+            }
+            //the entry past the group members holds the number of bound particles
+            ids[numingroup[i]] = pglist[i][numingroup[i]];
+            buffer->pglist[i] = ids;
+            offset += numingroup[i] + 1;
+        }
+    }
+    size_t nbytes = buffer->Part.size() * sizeof(Particle) + buffer->pgliststore.size() * sizeof(Int_t);
+    writer.submit([buffer, ngroups, nadditional, iparttype, haspglist]() {
+        Int_t **pglist = haspglist ? buffer->pglist.data() : NULL;
+        WriteGroupCatalog(buffer->opt, ngroups, buffer->numingroup.data(), pglist, buffer->Part, nadditional);
+        if (iparttype) WriteGroupPartType(buffer->opt, ngroups, buffer->numingroup.data(), pglist, buffer->Part);
+    }, nbytes);
+}
+
 ///Write the particles in each SO region
 ///Note that this particle list will not be exclusive
 ///\todo optimisation memory wise can be implemented by not creating an array
@@ -1587,6 +1872,24 @@ void WriteSOCatalog(Options &opt, const Int_t ngroups, vector<Int_t> *SOpids, ve
 
 ///\name Final outputs such as properties and output that can be used to construct merger trees and substructure hierarchy
 //@{
+///Writes the rows of groups stored in a column store to an open binary or ascii properties file
+static void WritePropertyRows(Options &opt, fstream &Fout, const PropDataColumns &columns, const PropDataColumnStore &store, Int_t ngroups)
+{
+    for (Int_t i=0;i<ngroups;i++) {
+        for (std::size_t icol=0;icol<columns.size();icol++) {
+            if (opt.ibinaryout==OUTBINARY) {
+                auto size = columns.element_size(icol);
+                Fout.write(static_cast<const char *>(store.column(icol)) + i * size, size);
+            }
+            else {
+                columns.write_ascii(icol, Fout, store.column(icol), i);
+                Fout<<" ";
+            }
+        }
+        if (opt.ibinaryout==OUTASCII) Fout<<"\n";
+    }
+}
+
 ///Writes the bulk properties of the substructures
 ///\todo need to add in 500crit mass and radial output in here and in \ref allvars.h
 void WriteProperties(Options &opt, const Int_t ngroups, PropData *pdata){
@@ -1755,1128 +2058,42 @@ void WriteProperties(Options &opt, const Int_t ngroups, PropData *pdata){
         Fout<<setprecision(10);
     }
 
-    long long idbound;
-    //for ensuring downgrade of precision as subfind uses floats when storing values save for Mvir (??why??)
-    float value,ctemp[3],mtemp[9];
-    double dvalue;
-    int ivalue;
-    for (Int_t i=1;i<=ngroups;i++) {
-        if (opt.ibinaryout==OUTBINARY) {
-            pdata[i].WriteBinary(Fout,opt);
-        }
-#ifdef USEHDF
-        else if (opt.ibinaryout==OUTHDF) {
-            //pdata[i].WriteHDF(Fhdf);
-            //for hdf may be more useful to produce an array of the appropriate size and write each data set in one go
-            //requires allocating memory
-        }
-#endif
-        else if (opt.ibinaryout==OUTASCII){
-            pdata[i].WriteAscii(Fout,opt);
-        }
+    //properties are extracted through the column registry, which is declared in the same order as the header
+    PropDataColumns columns(opt);
+    assert(columns.size() == head.headerdatainfo.size());
+    unique_ptr<PropDataColumnStore> store;
+    if (opt.ipropertycolumnstore) {
+        vr::Timer fill_timer;
+        store.reset(new PropDataColumnStore(columns, ngroups, pdata));
+        LOG(debug) << "Filled " << columns.size() << " property columns in " << fill_timer;
     }
-#ifdef USEHDF
-    if (opt.ibinaryout==OUTHDF) {
-        //for hdf may be more useful to produce an array of the appropriate size and write each data set in one go
-        //requires allocating memory
-        int *iarray,itemp;
-        unsigned int *uiarray;
-        long long *larray;
-        unsigned long *ularray;
-        //void pointer to hold data
-        void *data;
-        //allocate enough memory to store largest data type
-        data= ::operator new(sizeof(long long)*(ng+1));
-        itemp=0;
-
-        //first is halo ids, then id of most bound particle, host halo id, number of direct subhaloes, number of particles
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].haloid;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((long long*)data)[i]=pdata[i+1].ibound;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((long long*)data)[i]=pdata[i+1].iminpot;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((long long*)data)[i]=pdata[i+1].hostid;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].numsubs;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].num;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((int*)data)[i]=pdata[i+1].stype;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        if (opt.iKeepFOF==1){
-            for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].directhostid;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].hostfofid;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        //now halo properties that are doubles
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gMvir;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gcm[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gposmbp[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gposminpot[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gcmvel[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gvelmbp[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gvelminpot[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gmass;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gMFOF;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gM200m;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gM200c;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gMBN98;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Efrac;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRvir;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gsize;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gR200m;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gR200c;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRBN98;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRhalfmass;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRmaxvel;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRhalf200m;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRhalf200c;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRhalfBN98;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gmaxvel;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gsigma_v;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gveldisp(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].glambda_B;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJ[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gq;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gs;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].geigvec(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cNFW;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cNFW200c;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cNFW200m;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cNFWBN98;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Krot;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].T;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Pot;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_sigma_v;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_veldisp(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_lambda_B;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_J[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_q;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_s;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].RV_eigvec(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        if (opt.iextrahalooutput) {
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJ200m[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJ200c[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJBN98[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            if (opt.iInclusiveHalo>0) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gM200m_excl;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gM200c_excl;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gMBN98_excl;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gR200m_excl;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gR200c_excl;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gRBN98_excl;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-                for (int k=0;k<3;k++){
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJ200m_excl[k];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-                for (int k=0;k<3;k++){
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJ200c_excl[k];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-                for (int k=0;k<3;k++){
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].gJBN98_excl[k];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-        }
-
-#ifdef GASON
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].n_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_rvmax;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_30kpc;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_500c;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cm_gas[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cmvel_gas[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Efrac_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Rhalfmass_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].veldisp_gas(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_gas[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].q_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].s_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].eigvec_gas(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Krot_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Temp_mean_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#ifdef STARON
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Z_mean_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SFR_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#endif
-    if (opt.iextragasoutput) {
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_gas;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_gas[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_gas[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_gas[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        if (opt.iInclusiveHalo>0) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_excl_gas;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_excl_gas;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_excl_gas;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_excl_gas[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_excl_gas[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_excl_gas[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-        }
-    }
-#endif
-
-#ifdef STARON
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].n_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_star_rvmax;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_star_30kpc;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_star_500c;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cm_star[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].cmvel_star[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Efrac_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Rhalfmass_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].veldisp_star(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_star[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].q_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].s_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (int k=0;k<3;k++) for (int n=0;n<3;n++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].eigvec_star(k,n);
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Krot_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].t_mean_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Z_mean_star;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        if (opt.iextrastaroutput) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_star;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_star;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_star;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_star[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_star[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_star[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-
-            if (opt.iInclusiveHalo>0) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_excl_star;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_excl_star;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_excl_star;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-                for (int k=0;k<3;k++){
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_excl_star[k];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-                for (int k=0;k<3;k++){
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_excl_star[k];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-                for (int k=0;k<3;k++){
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_excl_star[k];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-        }
-#endif
-#ifdef BHON
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].n_bh;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_bh;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#endif
-#ifdef HIGHRES
-        for (Int_t i=0;i<ngroups;i++) ((unsigned long*)data)[i]=pdata[i+1].n_interloper;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_interloper;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        if (opt.iextrainterloperoutput) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_interloper;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_interloper;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_interloper;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            if (opt.iInclusiveHalo>0) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_excl_interloper;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_excl_interloper;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_excl_interloper;
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-        }
-#endif
-
-#if defined(GASON) && defined(STARON)
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_sf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Rhalfmass_gas_sf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].sigV_gas_sf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (int k=0;k<3;k++){
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_gas_sf[k];
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    }
-
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Krot_gas_sf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Temp_mean_gas_sf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Z_mean_gas_sf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    if (opt.iextragasoutput) {
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_gas_sf;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_gas_sf;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_gas_sf;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_gas_sf[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_gas_sf[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_gas_sf[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        if (opt.iInclusiveHalo>0) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_excl_gas_sf;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_excl_gas_sf;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_excl_gas_sf;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_excl_gas_sf[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_excl_gas_sf[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_excl_gas_sf[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-        }
-    }
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_nsf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Rhalfmass_gas_nsf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].sigV_gas_nsf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (int k=0;k<3;k++){
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_gas_nsf[k];
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    }
-
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Krot_gas_nsf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Temp_mean_gas_nsf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Z_mean_gas_nsf;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    if (opt.iextragasoutput) {
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_gas_nsf;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_gas_nsf;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_gas_nsf;
-        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_gas_nsf[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_gas_nsf[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (int k=0;k<3;k++){
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_gas_nsf[k];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-
-        if (opt.iInclusiveHalo>0) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200mean_excl_gas_nsf;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_200crit_excl_gas_nsf;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_BN98_excl_gas_nsf;
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200mean_excl_gas_nsf[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_200crit_excl_gas_nsf[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (int k=0;k<3;k++){
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].L_BN98_excl_gas_nsf[k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
+    if (opt.ibinaryout==OUTBINARY || opt.ibinaryout==OUTASCII) {
+        if (store) WritePropertyRows(opt, Fout, columns, *store, ngroups);
+        else {
+            //without the full store, rows are written from small blocks of columns
+            const Int_t blocksize = 4096;
+            for (Int_t offset=0;offset<ngroups;offset+=blocksize) {
+                Int_t n = min(blocksize, ngroups - offset);
+                PropDataColumnStore block(columns, n, &pdata[offset]);
+                WritePropertyRows(opt, Fout, columns, block, n);
             }
         }
     }
-
-
-#endif
-#if (defined(GASON)) || (defined(GASON) && defined(SWIFTINTERFACE))
-    /*writing M_gas_highT and related quantities*/
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_highT;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Temp_mean_gas_highT;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Z_mean_gas_highT;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_highT_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Temp_mean_gas_highT_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].Z_mean_gas_highT_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-
-    int sonum_hotgas = opt.aperture_hotgas_normalised_to_overdensity.size();
-    if (sonum_hotgas>0){
-        for (auto j=0;j<sonum_hotgas;j++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_totalmass_highT[j];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (auto j=0;j<sonum_hotgas;j++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_mass_highT[j];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (auto j=0;j<sonum_hotgas;j++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_Temp_mean_gas_highT[j];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-        for (auto j=0;j<sonum_hotgas;j++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_Z_mean_gas_highT[j];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-    }
-#endif
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_tot_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#ifdef GASON
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#ifdef STARON
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_nsf_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_gas_sf_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#endif
-#endif
-#ifdef STARON
-    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].M_star_incl;
-    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-#endif
-        //output extra hydro/star/bh props
-#ifdef GASON
-        if (opt.gas_internalprop_names.size() + opt.gas_chem_names.size() + opt.gas_chemproduction_names.size()>0) {
-            for (auto &extrafield:opt.gas_internalprop_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].hydroprop.GetInternalProperties(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-            for (auto &extrafield:opt.gas_chem_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].hydroprop.GetChemistry(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-            for (auto &extrafield:opt.gas_chemproduction_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].hydroprop.GetChemistryProduction(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-        }
-#endif
-#ifdef STARON
-        if (opt.star_internalprop_names.size() + opt.star_chem_names.size() + opt.star_chemproduction_names.size()>0) {
-            for (auto &extrafield:opt.star_internalprop_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].starprop.GetInternalProperties(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-            for (auto &extrafield:opt.star_chem_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].starprop.GetChemistry(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-            for (auto &extrafield:opt.star_chemproduction_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].starprop.GetChemistryProduction(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-        }
-#endif
-#ifdef BHON
-        if (opt.bh_internalprop_names.size() + opt.bh_chem_names.size() + opt.bh_chemproduction_names.size()>0) {
-            for (auto &extrafield:opt.bh_internalprop_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].bhprop.GetInternalProperties(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-            for (auto &extrafield:opt.bh_chem_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].bhprop.GetChemistry(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-            for (auto &extrafield:opt.bh_chemproduction_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].bhprop.GetChemistryProduction(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-        }
-#endif
-#ifdef EXTRADMON
-        if (opt.extra_dm_internalprop_names.size()>0) {
-            for (auto &extrafield:opt.extra_dm_internalprop_output_names)
-            {
-                for (Int_t i=0;i<ngroups;i++)
-                    ((Double_t*)data)[i]=pdata[i+1].extradmprop.GetExtraProperties(extrafield);
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);
-                itemp++;
-            }
-        }
-#endif
-
-
-        //output apertures
-        if (opt.iaperturecalc && opt.aperturenum>0){
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart_gas[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart_gas_sf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart_gas_nsf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#endif
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart_star[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#ifdef BHON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart_bh[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#ifdef HIGHRES
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((unsigned int*)data)[i]=pdata[i+1].aperture_npart_interloper[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_gas[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_gas_sf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_gas_nsf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#endif
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_star[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#ifdef BHON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_bh[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#ifdef HIGHRES
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_interloper[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_gas[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_gas_sf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_gas_nsf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#endif
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_star[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_veldisp[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_veldisp_gas[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_veldisp_gas_sf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_veldisp_gas_nsf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#endif
-#ifdef STARON
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_veldisp_star[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#if defined(GASON) && defined(STARON)
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_SFR_gas[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_gas[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_gas_sf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_gas_nsf[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_star[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-
-            #if (defined(GASON)) || (defined(GASON) && defined(SWIFTINTERFACE))
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_M_gas_highT[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Temp_mean_gas_highT[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_mean_gas_highT[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            #endif
-
-#endif
-#ifdef GASON
-            if (opt.gas_extraprop_aperture_calc) {
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.gas_internalprop_output_names_aperture) {
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_gas[j].GetInternalProperties(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (auto &x:opt.gas_chem_output_names_aperture){
-                    for (Int_t i=0;i<ngroups;i++)
-                        ((Double_t*)data)[i]=pdata[i+1].aperture_properties_gas[j].GetChemistry(x);
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-            for (auto j=0;j<opt.aperturenum;j++) {
-                for (auto &x:opt.gas_chemproduction_output_names_aperture){
-                    for (Int_t i=0;i<ngroups;i++)
-                        ((Double_t*)data)[i]=pdata[i+1].aperture_properties_gas[j].GetChemistryProduction(x);
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-        }
-#endif
-#ifdef STARON
-            if (opt.star_extraprop_aperture_calc) {
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.star_internalprop_output_names_aperture) {
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_star[j].GetInternalProperties(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.star_chem_output_names_aperture){
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_star[j].GetChemistry(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.star_chemproduction_output_names_aperture){
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_star[j].GetChemistryProduction(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-            }
-#endif
-#ifdef BHON
-            if (opt.bh_extraprop_aperture_calc) {
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.bh_internalprop_output_names_aperture) {
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_bh[j].GetInternalProperties(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.bh_chem_output_names_aperture){
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_bh[j].GetChemistry(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.bh_chemproduction_output_names_aperture){
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_bh[j].GetChemistryProduction(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-            }
-#endif
-#ifdef EXTTRADMON
-            if (opt.extra_dm_extraprop_aperture_calc) {
-                for (auto j=0;j<opt.aperturenum;j++) {
-                    for (auto &x:opt.extra_dm_internalprop_output_names_aperture) {
-                        for (Int_t i=0;i<ngroups;i++)
-                            ((Double_t*)data)[i]=pdata[i+1].aperture_properties_extra_dm[j].GetExtraProperties(x);
-                        Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                    }
-                }
-            }
-#endif
-
-        }
-        //output apertures
-        if (opt.iaperturecalc && opt.apertureprojnum>0){
-            for (auto k=0;k<3;k++) {
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_proj[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_proj_gas[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_proj_gas_sf[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_proj_gas_nsf[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#endif
-#ifdef STARON
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_mass_proj_star[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_proj[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_proj_gas[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_proj_gas_sf[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_proj_gas_nsf[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#endif
-#ifdef STARON
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_rhalfmass_proj_star[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-#if defined(GASON) && defined(STARON)
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_SFR_proj_gas[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_proj_gas[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_proj_gas_sf[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_proj_gas_nsf[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.apertureprojnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].aperture_Z_proj_star[j][k];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#endif
-            }
-        }
-        if (opt.SOnum>0) {
-            for (auto j=0;j<opt.SOnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_mass[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-            for (auto j=0;j<opt.SOnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_radius[j];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef GASON
-            if (opt.iextragasoutput && opt.iextrahalooutput) {
-                for (auto j=0;j<opt.SOnum;j++) {
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_mass_gas[j];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-#ifdef STARON
-#endif
-            }
-#endif
-#ifdef STARON
-            if (opt.iextrastaroutput && opt.iextrahalooutput) {
-                for (auto j=0;j<opt.SOnum;j++) {
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_mass_star[j];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-#endif
-#ifdef HIGHRES
-            if (opt.iextrainterloperoutput && opt.iextrahalooutput) {
-                for (auto j=0;j<opt.SOnum;j++) {
-                    for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_mass_interloper[j];
-                    Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                }
-            }
-#endif
-        }
-        if (opt.SOnum>0 && opt.iextrahalooutput) {
-        for (auto j=0;j<opt.SOnum;j++) {
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum[j][0];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum[j][1];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum[j][2];
-            Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-        }
-#ifdef GASON
-        if (opt.iextragasoutput) {
-            for (auto j=0;j<opt.SOnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum_gas[j][0];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum_gas[j][1];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum_gas[j][2];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-            }
-#ifdef STARON
-#endif
-        }
-#endif
-#ifdef STARON
-        if (opt.iextrastaroutput) {
-            for (auto j=0;j<opt.SOnum;j++) {
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum_star[j][0];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum_star[j][1];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
-                for (Int_t i=0;i<ngroups;i++) ((Double_t*)data)[i]=pdata[i+1].SO_angularmomentum_star[j][2];
-                Fhdf.write_dataset(opt, head.headerdatainfo[itemp],ng,data,head.hdfpredtypeinfo[itemp]);itemp++;
+#ifdef USEHDF
+    else if (opt.ibinaryout==OUTHDF) {
+        //each dataset is written straight from its column, either from the store or
+        //from a single buffer reused for every column
+        vector<char> buffer;
+        if (!store) buffer.resize(sizeof(long long)*(ng+1));
+        for (std::size_t icol=0;icol<columns.size();icol++) {
+            void *data;
+            if (store) data = store->column(icol);
+            else {
+                columns.fill(icol, ngroups, pdata, buffer.data());
+                data = buffer.data();
             }
+            Fhdf.write_dataset(opt, head.headerdatainfo[icol],ng,data,head.hdfpredtypeinfo[icol]);
         }
-#endif
-        }
-        //delete memory associated with void pointer
-        ::operator delete(data);
-        // delete[] propdataspace;
-        // delete[] propdataset;
     }
 #endif
     if (opt.ibinaryout!=OUTHDF) Fout.close();
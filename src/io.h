@@ -1,7 +1,59 @@
 #ifndef SRC_IO_H
 #define SRC_IO_H
 
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
 /// Return true if if given file exists
 bool FileExists(const char *fname);
 
+/*! Fortran unformatted sequential file, such as RAMSES outputs and unformatted Gadget snapshots, where each
+    record is a payload enclosed by two markers holding its size in bytes.
+    The file is memory mapped, or read whole in one go if it cannot be mapped, and the offsets of all its
+    records are indexed once on opening so that any record can be read directly without walking the file.
+*/
+class Fortran_Record_File {
+public:
+    Fortran_Record_File() {}
+    ~Fortran_Record_File() {close();}
+    Fortran_Record_File(const Fortran_Record_File &) = delete;
+    Fortran_Record_File &operator=(const Fortran_Record_File &) = delete;
+
+    ///maps the file and indexes its records, returning false if it cannot be read
+    bool open(const std::string &fname);
+    void close();
+    int nrecords() const {return offsets.size();}
+    ///size in bytes of the payload of a record
+    size_t size(int irecord) const {return sizes[irecord];}
+    ///payload of a record, which is not aligned to any particular type
+    const char *data(int irecord) const {return base+offsets[irecord];}
+    ///whether a record holds at least n values of type T
+    template<typename T> bool holds(int irecord, size_t n) const {
+        return irecord>=0 && irecord<nrecords() && sizes[irecord]>=n*sizeof(T);
+    }
+    ///value i of a record
+    template<typename T> T get(int irecord, size_t i) const {
+        T value;
+        memcpy(&value, base+offsets[irecord]+i*sizeof(T), sizeof(T));
+        return value;
+    }
+    ///copies up to n values of a record, returning the number copied
+    template<typename T> size_t read(int irecord, T *dest, size_t n) const {
+        n=std::min(n, sizes[irecord]/sizeof(T));
+        memcpy(dest, base+offsets[irecord], n*sizeof(T));
+        return n;
+    }
+    ///payload of a record holding characters
+    std::string get_string(int irecord) const {return std::string(base+offsets[irecord], sizes[irecord]);}
+
+private:
+    const char *base = NULL;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<char> buffer;
+    std::vector<size_t> offsets, sizes;
+};
+
 #endif /* SRC_IO_H */
\ No newline at end of file
@@ -3,6 +3,8 @@
     \todo once ratio is calculated, must figure out best way to do global mpi fit. Probably best to combine the binned distribution and fit that
  */
 
+#include <tuple>
+
 #include "exceptions.h"
 #include "logging.h"
 #include "stf.h"
@@ -50,7 +52,7 @@ private(i) if (nbodies > ompsubsearchnum)
     mpi_gvel=new Coordinate[Ngridtotal];
     mpi_gveldisp=new Matrix[Ngridtotal];
     MPIBuildGridData(ngrid, grid, gvel, gveldisp);
-    delete[] grid;
+    FreeTreeGrid(ngrid, grid);
     delete[] gvel;
     delete[] gveldisp;
     ngrid=Ngridtotal;
@@ -134,7 +136,7 @@ if (nbodies > ompsubsearchnum)
     delete[] gveldisp;
     delete tree;
     delete[] ptemp;
-    delete[] grid;
+    FreeTreeGrid(ngrid, grid);
 }
 
 
@@ -149,24 +151,16 @@ void DetermineDenVRatioDistribution(Options &opt,const Int_t nbodies, Particle *
     Double_t mtot,mtotpeak,deltar,maxprob,minprob,rmin,rmax;
     vector<Double_t> rbin;
     vector<Double_t> xbin;
-    int nthreads=1,tid;
-    Double_t w;
-    unsigned int ir;
     const int MINBIN = 5;
     //to determine initial number of bins using modified Sturges' formula
     nbins = max((int)ceil(log10((Double_t)nbodies)/log10(2.0)+1)*4, MINBIN);
 
+    //pack the ratios once, every binning below is then done by all threads over the packed values
+    vr::Histogram histogram(nbodies, Part);
+    vr::Histogram::bins hbins;
+
     //deterrmine average, rmin,rmax and variance about mean
-    rmin=rmax=Part[0].GetPotential();
-#ifdef USEOPENMP
-    #pragma omp parallel for default(shared) \
-    private(i,tid) schedule(static) \
-    reduction(min:rmin) reduction(max:rmax) if (nbodies > ompperiodnum)
-#endif
-    for (i=1;i<nbodies;i++) {
-        if (rmin>Part[i].GetPotential())rmin=Part[i].GetPotential();
-        if (rmax<Part[i].GetPotential())rmax=Part[i].GetPotential();
-    }
+    std::tie(rmin,rmax)=histogram.range();
 
     //now bin data and find initial estimates for most probable value and the FWHM on either side of the most probable value
     //deltar=(rmax-rmin)/(Double_t)nbins;
@@ -174,23 +168,10 @@ void DetermineDenVRatioDistribution(Options &opt,const Int_t nbodies, Particle *
     rmin-=deltar*0.025;
     deltar*=1.05;
 
-    rbin.resize(nbins);
-    mtot=0;
-    for (i=0;i<nbodies;i++) {
-        ir=(unsigned int)((Part[i].GetPotential()-rmin)/deltar);
-        if (ir >= nbins) continue;
-        //mass weighted
-#ifdef NOMASSWEIGHT
-        w=1.0;
-#else
-        w=Part[i].GetMass();
-#endif
-#ifdef HIGHRES
-        w = 1.0;
-#endif
-        rbin[ir]+=w;
-        mtot+=w;
-    }
+    //mass weighted
+    hbins=histogram.fill(rmin,deltar,nbins);
+    rbin=hbins.sum;
+    mtot=hbins.total;
 
     maxprob=0.;
     for (i=0;i<nbins;i++) {
@@ -233,11 +214,9 @@ void DetermineDenVRatioDistribution(Options &opt,const Int_t nbodies, Particle *
     GMatrix W(nbins,nbins);
     rbin.resize(nbins);
     do {
-        mtotpeak=0;
         rmin=(meanr-sl*sdlow);
         rmax=(meanr+sl*sdhigh);
-        int npeak=0;
-        for (i=0;i<nbodies;i++) if (Part[i].GetPotential()>=rmin&&Part[i].GetPotential()<rmax) npeak++;
+        Int_t npeak=histogram.count(rmin,rmax);
         //once have initial estimates of variance bin using Scott's formula
         //deltar=3.5*sdlow/pow(nbodies,1./3.);
         deltar=3.5*sqrt(sdlow*sdlow+sdhigh*sdhigh)/pow(npeak,1./3.);
@@ -246,25 +225,11 @@ void DetermineDenVRatioDistribution(Options &opt,const Int_t nbodies, Particle *
         //recalculate deltar
         deltar = (rmax-rmin)/(double)nbins;
         W=GMatrix(nbins,nbins);
-        rbin.resize(nbins);
-        for (i=0;i<nbins;i++)rbin[i]=0;
         for (int j=0;j<nbins;j++) for (int k=0;k<nbins;k++) W(j,k)=0.;
-        for (i=0;i<nbodies;i++) {
-            if (Part[i].GetPotential()>=rmin && Part[i].GetPotential()<rmax) {
-                ir=(unsigned int)((Part[i].GetPotential()-rmin)/deltar);
-#ifdef NOMASSWEIGHT
-                w=1.0;
-#else
-                w=Part[i].GetMass();
-#endif
-#ifdef HIGHRES
-                w = 1.0;
-#endif
-                rbin[ir]+=w;
-                W(ir,ir)+=w*w;
-                mtotpeak+=w;
-            }
-        }
+        hbins=histogram.fill(rmin,deltar,nbins);
+        rbin=hbins.sum;
+        for (int j=0;j<nbins;j++) W(j,j)=hbins.sum2[j];
+        mtotpeak=hbins.total;
         sl*=1.25;
     }while (mtotpeak/mtot<0.2);
 
@@ -31,7 +31,14 @@ void GetVelocityDensity(Options &opt, const Int_t nbodies, Particle *Part, KDTre
 #ifdef HALOONLYDEN
     GetVelocityDensityHaloOnlyDen(opt, nbodies, Part, tree);
 #else
-    if (opt.iLocalVelDenApproxCalcFlag>0) GetVelocityDensityApproximative(opt, nbodies, Part, tree);
+    //the batched search does not import neighbours from other mpi domains
+#ifdef USEMPI
+    bool ilocalsearch = (NProcs==1 || opt.iLocalVelDenApproxCalcFlag==2);
+#else
+    bool ilocalsearch = true;
+#endif
+    if (opt.iLocalVelDenBatchedSearch && ilocalsearch) GetVelocityDensityBatched(opt, nbodies, Part, tree);
+    else if (opt.iLocalVelDenApproxCalcFlag>0) GetVelocityDensityApproximative(opt, nbodies, Part, tree);
     else GetVelocityDensityExact(opt, nbodies, Part, tree);
 #endif
     LOG(info) << "Finished local density calculation in " << timer;
@@ -527,6 +534,11 @@ void GetVelocityDensityExact(Options &opt, const Int_t nbodies, Particle *Part,
 
     MEMORY_USAGE_REPORT(debug, opt);
     vr::Timer local_densities_timer;
+    //only build tree if necessary, keeping it for the searches that follow on the same particles
+    if (tree==NULL) {
+        itreeflag=1;
+        tree=vr::spatial_index().acquire(Part,nbodies,opt.Bsize,period);
+    }
 
     //In loop determine if particles NN search radius overlaps another mpi threads domain.
     //If not, then proceed as usually to determine velocity density.
@@ -739,67 +751,22 @@ private(i,j,k,pid2,v2,nnids,nnr2,nnidsneighbours,nnr2neighbours,weight,pqx,pqv)
     LOG(debug) << "Finished other domain search " << other_domain_search_timer;
     }
 #endif
-    if (itreeflag) delete tree;
+    if (itreeflag) vr::spatial_index().release(tree, true);
     if (period!=NULL) delete[] period;
 }
 
-void GetVelocityDensityApproximative(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree)
+///Returns the leaf nodes of the tree with the centre of mass and size of the active particles in each
+static vector<leaf_node_info> GetLeafNodes(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree)
 {
-#ifndef USEMPI
-    int ThisTask=0, NProcs=1;
-#endif
-    LOG(debug) << "Calculating the local velocity density by finding APPROXIMATIVE nearest physical neighbour search for each particle ";
-    int id,pid2,itreeflag=0;
-    Double_t v2;
-    Int_t nprocessed=0, ntot=0;
-    ///\todo alter period so arbitrary dimensions
-    Double_t *period=NULL;
-    if (opt.p>0) {
-        period=new Double_t[3];
-        for (int j=0;j<3;j++) period[j]=opt.p;
-    }
-
-    //if using mpi run NN search store largest distance for each particle so that export list can be built.
-    //if calculating using only particles IN a structure,
-    Int_t nimport;
-    Double_t *maxrdist=NULL;
-    Double_t *weight;
-    Int_t *nnids,*nnidsneighbours;
-    Double_t *nnr2, *nnr2neighbours;
-    PriorityQueue *pqx, *pqv;
-    Particle *Pval;
-
-    vr::Timer local_densities_timer;
-    //only build tree if necessary
-    if (tree==NULL) {
-        itreeflag=1;
-        tree=new KDTree(Part,nbodies,opt.Bsize,tree->TPHYS,tree->KEPAN,1000,0,0,0,period);
-    }
-    //In loop determine if particles NN search radius overlaps another mpi threads domain.
-    //If not, then proceed as usually to determine velocity density.
-    //If so, do not calculate local velocity density and set its velocity density to -1 as a flag
-    //idea is to use approximative near neighbour search using the centre-of-mass of the bucket
-    //and the size of the bucket to get particle list.
-    //if MPI is used, then also use size of bucket to determine rough maximum search distance
-    //and whether other mpi domains need to be searched.
-
-    //first get all local leaf nodes;
-    Int_t numleafnodes = tree->GetNumLeafNodes();
-    Node *node;
+    vector<Node*> leaves=GetLeafNodeList(tree);
+    Int_t numleafnodes = leaves.size();
     vector<leaf_node_info> leafnodes(numleafnodes);
-    Int_t inode=0, ipart=0;
-    while (ipart<nbodies) {
-        node=tree->FindLeafNode(ipart);
+    for (Int_t inode=0;inode<numleafnodes;inode++) {
         leafnodes[inode].id = inode;
-        leafnodes[inode].istart = node->GetStart();
-        leafnodes[inode].iend = node->GetEnd();
-        leafnodes[inode].numtot = node->GetCount();
-        ipart+=leafnodes[inode].numtot;
-        inode++;
+        leafnodes[inode].istart = leaves[inode]->GetStart();
+        leafnodes[inode].iend = leaves[inode]->GetEnd();
+        leafnodes[inode].numtot = leaves[inode]->GetCount();
     }
-    node=NULL;
-
-    MEMORY_USAGE_REPORT(debug, opt);
 
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)
@@ -810,6 +777,7 @@ void GetVelocityDensityApproximative(Options &opt, const Int_t nbodies, Particle
     {
         leafnodes[i].num=0;
         leafnodes[i].cm[0]=leafnodes[i].cm[1]=leafnodes[i].cm[2]=0;
+        leafnodes[i].size=0;
 #ifdef USEMPI
         leafnodes[i].searchdist = 0;
 #endif
@@ -837,6 +805,55 @@ void GetVelocityDensityApproximative(Options &opt, const Int_t nbodies, Particle
 #ifdef USEOPENMP
 }
 #endif
+    return leafnodes;
+}
+
+void GetVelocityDensityApproximative(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree)
+{
+#ifndef USEMPI
+    int ThisTask=0, NProcs=1;
+#endif
+    LOG(debug) << "Calculating the local velocity density by finding APPROXIMATIVE nearest physical neighbour search for each particle ";
+    int id,pid2,itreeflag=0;
+    Double_t v2;
+    Int_t nprocessed=0, ntot=0;
+    ///\todo alter period so arbitrary dimensions
+    Double_t *period=NULL;
+    if (opt.p>0) {
+        period=new Double_t[3];
+        for (int j=0;j<3;j++) period[j]=opt.p;
+    }
+
+    //if using mpi run NN search store largest distance for each particle so that export list can be built.
+    //if calculating using only particles IN a structure,
+    Int_t nimport;
+    Double_t *maxrdist=NULL;
+    Double_t *weight;
+    Int_t *nnids,*nnidsneighbours;
+    Double_t *nnr2, *nnr2neighbours;
+    PriorityQueue *pqx, *pqv;
+    Particle *Pval;
+
+    vr::Timer local_densities_timer;
+    //only build tree if necessary, keeping it for the searches that follow on the same particles
+    //the leaves are walked below, so the tree must have the requested bucket size
+    if (tree==NULL) {
+        itreeflag=1;
+        tree=vr::spatial_index().acquire(Part,nbodies,opt.Bsize,period,true);
+    }
+    //In loop determine if particles NN search radius overlaps another mpi threads domain.
+    //If not, then proceed as usually to determine velocity density.
+    //If so, do not calculate local velocity density and set its velocity density to -1 as a flag
+    //idea is to use approximative near neighbour search using the centre-of-mass of the bucket
+    //and the size of the bucket to get particle list.
+    //if MPI is used, then also use size of bucket to determine rough maximum search distance
+    //and whether other mpi domains need to be searched.
+
+    //first get all local leaf nodes;
+    vector<leaf_node_info> leafnodes=GetLeafNodes(opt, nbodies, Part, tree);
+    Int_t numleafnodes = leafnodes.size();
+
+    MEMORY_USAGE_REPORT(debug, opt);
 
 #ifdef USEOPENMP
 #pragma omp parallel default(shared) \
@@ -1056,7 +1073,7 @@ reduction(+:nprocessed)
 #endif
 
     //free memory
-    if (itreeflag) delete tree;
+    if (itreeflag) vr::spatial_index().release(tree, true);
     if (period!=NULL) delete[] period;
 
     // Double-check that valid densities have been set in all particles
@@ -1071,3 +1088,215 @@ reduction(+:nprocessed)
         }
     }
 }
+
+///\name Leaf batched velocity density
+//@{
+///Keeps the smallest distances pushed to it, up to a maximum number, with their indices in an array sorted by distance.
+///For the number of neighbours used by the velocity density, insertion into a short sorted array is cheaper than a heap
+struct BoundedNeighbourList{
+    int num=0, nmax=0;
+    vector<Double_t> dist;
+    vector<Int_t> index;
+    void Reset(int n) {
+        nmax=n;
+        num=0;
+        if ((int)dist.size()<n) {dist.resize(n);index.resize(n);}
+    }
+    void Push(Int_t id, Double_t d) {
+        if (num==nmax) {
+            if (!(d<dist[nmax-1])) return;
+            num--;
+        }
+        int k=num++;
+        while (k>0 && dist[k-1]>d) {dist[k]=dist[k-1];index[k]=index[k-1];k--;}
+        dist[k]=d;
+        index[k]=id;
+    }
+};
+
+///Squared distances between (xi,yi,zi) and the packed coordinates [0,n), wrapped if the period is positive.
+///Written so that it is vectorised, for positions and velocities alike
+inline void PackedDistanceKernel(const Double_t xi, const Double_t yi, const Double_t zi,
+    const Double_t *x, const Double_t *y, const Double_t *z, const Int_t n, const Double_t period, Double_t *d2)
+{
+    if (period>0) {
+        const Double_t half=0.5*period;
+#ifdef USEOPENMP
+#pragma omp simd
+#endif
+        for (Int_t k=0;k<n;k++) {
+            Double_t dx=x[k]-xi, dy=y[k]-yi, dz=z[k]-zi;
+            dx=(dx>half)?dx-period:((dx<-half)?dx+period:dx);
+            dy=(dy>half)?dy-period:((dy<-half)?dy+period:dy);
+            dz=(dz>half)?dz-period:((dz<-half)?dz+period:dz);
+            d2[k]=dx*dx+dy*dy+dz*dz;
+        }
+    }
+    else {
+#ifdef USEOPENMP
+#pragma omp simd
+#endif
+        for (Int_t k=0;k<n;k++) {
+            Double_t dx=x[k]-xi, dy=y[k]-yi, dz=z[k]-zi;
+            d2[k]=dx*dx+dy*dy+dz*dz;
+        }
+    }
+}
+
+///Per thread buffers of the batched search, holding the packed candidate neighbours of a leaf
+struct VelocityDensityBuffers{
+    vector<Int_t> candidates;
+    vector<Double_t> x, y, z, vx, vy, vz, d2;
+    ///velocities of the physical neighbours of a particle, for the exact calculation
+    vector<Double_t> nvx, nvy, nvz;
+    BoundedNeighbourList xlist, vlist;
+    void Pack(Particle *Part, bool ipositions) {
+        Int_t n=candidates.size();
+        if ((Int_t)d2.size()<n) {
+            x.resize(n);y.resize(n);z.resize(n);
+            vx.resize(n);vy.resize(n);vz.resize(n);
+            d2.resize(n);
+        }
+        for (Int_t k=0;k<n;k++) {
+            Particle &p=Part[candidates[k]];
+            if (ipositions) {x[k]=p.X();y[k]=p.Y();z[k]=p.Z();}
+            vx[k]=p.Vx();vy[k]=p.Vy();vz[k]=p.Vz();
+        }
+    }
+};
+
+///Smooths the velocity neighbours held in the list with the kernel of the tree
+static Double_t SmoothVelocityNeighbours(KDTree *tree, int nvel, BoundedNeighbourList &vlist, PriorityQueue *pqv, Double_t *weight)
+{
+    for (auto k=0;k<nvel;k++) {
+        if (k<vlist.num) pqv->Push(vlist.index[k], vlist.dist[k]);
+        else pqv->Push(-1, MAXVALUE);
+        weight[k]=1.0;
+    }
+    return tree->CalcSmoothLocalValue(nvel, pqv, weight);
+}
+
+/*! Calculates the local velocity density of the active particles, searching the particles of each leaf node of the tree together.
+    The nearest physical neighbours of the centre of mass of a leaf are found with a single tree search.
+    In the approximative calculation they are used as the physical neighbours of every particle in the leaf, as in \ref GetVelocityDensityApproximative.
+    In the exact calculation, the ball around the centre of mass whose radius is the distance to its furthest neighbour plus twice the size of the leaf
+    contains the nearest neighbours of every particle in the leaf, so it is searched once and each particle selects its own neighbours from it,
+    giving the neighbours of \ref GetVelocityDensityExact.
+    Candidates are packed into arrays so that distances are vectorised and neighbours are selected with bounded sorted lists rather than heaps.
+    Neighbours are only searched for in the local domain, so with mpi this is only used when no particles are imported from other domains.
+*/
+void GetVelocityDensityBatched(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree)
+{
+    const bool iexact=(opt.iLocalVelDenApproxCalcFlag==0);
+    LOG(debug) << "Calculating the local velocity density with a leaf batched search for "
+               << (iexact ? "EXACT" : "APPROXIMATIVE") << " nearest physical neighbours";
+    int itreeflag=0;
+    ///\todo alter period so arbitrary dimensions
+    Double_t *period=NULL;
+    if (opt.p>0) {
+        period=new Double_t[3];
+        for (int j=0;j<3;j++) period[j]=opt.p;
+    }
+    const int nsearch=opt.Nsearch, nvel=opt.Nvel;
+    //if not searching all particles in FOF but also doing baryon search then only base calculation on dark matter particles
+#ifdef STRUCDEN
+    const bool icheck=(opt.iBaryonSearch>=1 && opt.partsearchtype==PSTALL);
+#else
+    const bool icheck=false;
+#endif
+
+    vr::Timer local_densities_timer;
+    //only build tree if necessary, keeping it for the searches that follow on the same particles
+    //the particles are batched by leaves, so the tree must have the requested bucket size
+    if (tree==NULL) {
+        itreeflag=1;
+        tree=vr::spatial_index().acquire(Part,nbodies,opt.Bsize,period,true);
+    }
+    vector<leaf_node_info> leafnodes=GetLeafNodes(opt, nbodies, Part, tree);
+    Int_t numleafnodes = leafnodes.size();
+    Int_t ncandidates=0;
+
+    MEMORY_USAGE_REPORT(debug, opt);
+
+#ifdef USEOPENMP
+#pragma omp parallel default(shared)
+{
+#endif
+    vector<Int_t> nnids(nsearch);
+    vector<Double_t> nnr2(nsearch), weight(nvel);
+    PriorityQueue *pqv=new PriorityQueue(nvel);
+    VelocityDensityBuffers buf;
+#ifdef USEOPENMP
+#pragma omp for schedule(dynamic) reduction(+:ncandidates)
+#endif
+    for (auto i=0;i<numleafnodes;i++) {
+        leaf_node_info &leaf=leafnodes[i];
+        if (leaf.num == 0) continue;
+        Double_t xc[3]={leaf.cm[0],leaf.cm[1],leaf.cm[2]};
+        if (!icheck) tree->FindNearestPos(leaf.cm,nnids.data(),nnr2.data(),nsearch);
+        else tree->FindNearestCheck(leaf.cm,FOFcheckpositivetype,NULL,nnids.data(),nnr2.data(),nsearch);
+        if (iexact) {
+            Double_t rsearch=0;
+            for (auto k=0;k<nsearch;k++) rsearch=max(rsearch,nnr2[k]);
+            //pad the radius so that rounding cannot drop neighbours on its edge
+            rsearch=(sqrt(rsearch)+2.0*leaf.size)*(1.0+1e-6);
+            buf.candidates=tree->SearchBallPosTagged(xc,rsearch*rsearch);
+            if (icheck) {
+                buf.candidates.erase(remove_if(buf.candidates.begin(), buf.candidates.end(),
+                    [&](Int_t k){return Part[k].GetType()<0;}), buf.candidates.end());
+            }
+        }
+        else buf.candidates.assign(nnids.begin(), nnids.end());
+        buf.Pack(Part, iexact);
+        Int_t n=buf.candidates.size();
+        ncandidates+=n;
+        for (auto j=leaf.istart;j<leaf.iend;j++)
+        {
+#ifdef STRUCDEN
+            if (Part[j].GetType()<=0) continue;
+#endif
+            Particle &p=Part[j];
+            buf.vlist.Reset(nvel);
+            if (iexact) {
+                PackedDistanceKernel(p.X(),p.Y(),p.Z(),buf.x.data(),buf.y.data(),buf.z.data(),n,opt.p,buf.d2.data());
+                buf.xlist.Reset(nsearch);
+                for (auto k=0;k<n;k++) buf.xlist.Push(k,buf.d2[k]);
+                Int_t nx=buf.xlist.num;
+                buf.nvx.resize(nx);buf.nvy.resize(nx);buf.nvz.resize(nx);
+                for (auto k=0;k<nx;k++) {
+                    Int_t c=buf.xlist.index[k];
+                    buf.nvx[k]=buf.vx[c];buf.nvy[k]=buf.vy[c];buf.nvz[k]=buf.vz[c];
+                }
+                PackedDistanceKernel(p.Vx(),p.Vy(),p.Vz(),buf.nvx.data(),buf.nvy.data(),buf.nvz.data(),nx,0,buf.d2.data());
+                for (auto k=0;k<nx;k++) buf.vlist.Push(buf.candidates[buf.xlist.index[k]],buf.d2[k]);
+            }
+            else {
+                PackedDistanceKernel(p.Vx(),p.Vy(),p.Vz(),buf.vx.data(),buf.vy.data(),buf.vz.data(),n,0,buf.d2.data());
+                //the particle itself is not one of its neighbours in the approximative calculation
+                for (auto k=0;k<n;k++) if (buf.candidates[k]!=j) buf.vlist.Push(buf.candidates[k],buf.d2[k]);
+            }
+            p.SetDensity(SmoothVelocityNeighbours(tree, nvel, buf.vlist, pqv, weight.data()));
+        }
+    }
+    delete pqv;
+#ifdef USEOPENMP
+}
+#endif
+    LOG(debug) << "Searched " << ncandidates << " candidate neighbours over " << numleafnodes << " leaves in " << local_densities_timer;
+
+    //free memory
+    if (itreeflag) vr::spatial_index().release(tree, true);
+    if (period!=NULL) delete[] period;
+
+    for (Int_t i = 0; i < nbodies; i++)
+    {
+        const auto &part = Part[i];
+#ifdef STRUCDEN
+        if (part.GetType()<=0) continue;
+#endif
+        if (!(part.GetDensity() > 0)) {
+            throw vr::non_positive_density(Part[i], __PRETTY_FUNCTION__);
+        }
+    }
+}
+//@}
@@ -257,12 +257,22 @@ int main(int argc,char **argv)
 #ifdef MPIREDUCEMEM
         //if allocating reasonable amounts of memory, use MPIREDUCEMEM
         //this determines number of particles in the mpi domains
-        MPINumInDomain(opt);
-        LOG(info) << "There are " << Nlocal << " particles and have allocated enough memory for "
-                  << Nmemlocal << " requiring " << vr::memory_amount(Nmemlocal * sizeof(Particle));
-        if (opt.iBaryonSearch > 0) {
-            LOG(info) << "There are " << Nlocalbaryon[0] << " baryon particles and have allocated enough memory for "
-                      << Nmemlocalbaryon << " requiring " << vr::memory_amount(Nmemlocalbaryon * sizeof(Particle));
+        if (opt.impisinglepassload) {
+            //particles are binned into the mesh as they are read and then exchanged,
+            //so only the decomposition is set up here and the reader allocates the local memory
+            MPIDomainExtent(opt);
+            MPIDomainDecomposition(opt);
+            Nlocal=Nmemlocal=0;
+            Nlocalbaryon[0]=Nmemlocalbaryon=0;
+        }
+        else {
+            MPINumInDomain(opt);
+            LOG(info) << "There are " << Nlocal << " particles and have allocated enough memory for "
+                      << Nmemlocal << " requiring " << vr::memory_amount(Nmemlocal * sizeof(Particle));
+            if (opt.iBaryonSearch > 0) {
+                LOG(info) << "There are " << Nlocalbaryon[0] << " baryon particles and have allocated enough memory for "
+                          << Nmemlocalbaryon << " requiring " << vr::memory_amount(Nmemlocalbaryon * sizeof(Particle));
+            }
         }
 #else
         //otherwise just base on total number of particles * some factor and initialise the domains
@@ -384,7 +394,7 @@ int main(int argc,char **argv)
             ///here if inclusive halo flag is 3, then S0 masses are calculated after substructures are found for field objects
             ///and only calculate FOF masses. Otherwise calculate inclusive masses at this moment.
             GetInclusiveMasses(opt, nbodies, Part.data(), nhalos, pfof, numinhalos, pdatahalos, noffsethalos);
-            qsort(Part.data(),nbodies,sizeof(Particle),IDCompare);
+            SortParticles(nbodies, Part.data(), PSORTID);
             //sort(Part.begin(), Part.end(), IDCompareVec);
             delete[] numinhalos;
             delete[] sortvalhalos;
@@ -449,11 +459,23 @@ int main(int argc,char **argv)
     }
     if (opt.iSubSearch) {
         LOG(info) << "Searching subset";
+#ifdef USEMPI
+        //the substructure search is local to each task, so its time is shared out between the mesh cells
+        //to balance the decomposition of later runs by cost
+        bool imeasuremeshcosts = (opt.impiusemesh && opt.mpimeshweighting==MPIMESHWEIGHTMEASURED && NProcs>1);
+        vector<double> cellnumparts, cellwork;
+        if (imeasuremeshcosts) MPIGetMeshCellWork(opt, Nlocal, Part.data(), pfof, ngroup, cellnumparts, cellwork);
+#endif
         vr::Timer timer;
+        double searchtime;
         //if groups have been found (and localized to single MPI thread) then proceed to search for subsubstructures
-        SearchSubSub(opt, nbodies, Part, pfof,ngroup,nhalos, pdatahalos);
+        SearchSubSub(opt, nbodies, Part, pfof,ngroup,nhalos, pdatahalos, &searchtime);
         LOG(info) << "Search for substructures " << Nlocal << " with " << nthreads
                   << " threads finished in " << timer;
+#ifdef USEMPI
+        //use the time of the local search, excluding the wait for other tasks at its end
+        if (imeasuremeshcosts) MPIWriteMeshCellCosts(opt, cellnumparts, cellwork, searchtime);
+#endif
     }
     pdata=new PropData[ngroup+1];
     //if inclusive halo mass required
@@ -519,30 +541,27 @@ int main(int argc,char **argv)
     //if want a simple tipsy still array listing particles group ids in input order
     if(opt.iwritefof) {
 #ifdef USEMPI
-        if (ThisTask==0) {
-            mpi_pfof=new Int_t[Ntotal];
-            //since pfof is a local subset, not all pfof values have been set, thus initialize them to zero.
-            for (Int_t i=0;i<Ntotal;i++) mpi_pfof[i]=0;
-        }
-        MPICollectFOF(Ntotal, pfof);
-        if (ThisTask==0) WriteFOF(opt,Ntotal,mpi_pfof);
+        //each task writes its own particles, nothing is collected on a single task
+        WriteFOFDistributed(opt,Nlocal,Part.data(),pfof);
 #else
         WriteFOF(opt,nbodies,pfof);
 #endif
     }
     numingroup=BuildNumInGroup(Nlocal, ngroup, pfof);
 
+    //catalogues are handed to the writer, which may write them on its own thread while the next objects are processed.
+    //Each job keeps a copy of the options, and pdata and the hierarchy are kept until the writer is flushed
+    vr::AsyncWriter writer(opt.asyncoutputbufsize, opt.iasyncoutput);
+    Int_t nfield=psldata->nsinlevel;
+
     //if separate files explicitly save halos, associated baryons, and subhalos separately
     if (opt.iseparatefiles) {
         if (nhalos>0) {
             pglist=SortAccordingtoBindingEnergy(opt,Nlocal,Part.data(),nhalos,pfof,numingroup,pdata);//alters pglist so most bound particles first
-            WriteProperties(opt,nhalos,pdata);
-            WriteGroupCatalog(opt, nhalos, numingroup, pglist, Part,ngroup-nhalos);
+            writer.submit([=]() mutable {WriteProperties(opt,nhalos,pdata);});
             //if baryons have been searched output related gas baryon catalogue
-            if (opt.partsearchtype==PSTALL){
-                WriteGroupPartType(opt, nhalos, numingroup, pglist, Part);
-            }
-            WriteHierarchy(opt,ngroup,nhierarchy,psldata->nsinlevel,nsub,parentgid,stype);
+            SubmitGroupCatalog(writer, opt, nhalos, numingroup, pglist, Part, ngroup-nhalos, opt.partsearchtype==PSTALL);
+            writer.submit([=]() mutable {WriteHierarchy(opt,ngroup,nhierarchy,nfield,nsub,parentgid,stype);});
             for (Int_t i=1;i<=nhalos;i++) delete[] pglist[i];
             delete[] pglist;
         }
@@ -552,11 +571,8 @@ int main(int argc,char **argv)
             //MPI as domain, despite having no groups might need to exchange particles
             if (opt.iInclusiveHalo==3) SortAccordingtoBindingEnergy(opt,Nlocal,Part.data(),nhalos,pfof,numingroup,pdata);
 #endif
-            WriteGroupCatalog(opt,nhalos,numingroup,NULL,Part);
-            WriteHierarchy(opt,nhalos,nhierarchy,psldata->nsinlevel,nsub,parentgid,stype);
-            if (opt.partsearchtype==PSTALL){
-                WriteGroupPartType(opt, nhalos, numingroup, NULL, Part);
-            }
+            SubmitGroupCatalog(writer, opt, nhalos, numingroup, NULL, Part, 0, opt.partsearchtype==PSTALL);
+            writer.submit([=]() mutable {WriteHierarchy(opt,nhalos,nhierarchy,nfield,nsub,parentgid,stype);});
         }
     }
     Int_t indexii=0;
@@ -572,13 +588,9 @@ int main(int argc,char **argv)
 
     if (ng>0) {
         pglist=SortAccordingtoBindingEnergy(opt,Nlocal,Part.data(),ng,pfof,&numingroup[indexii],&pdata[indexii],indexii);//alters pglist so most bound particles first
-        WriteProperties(opt,ng,&pdata[indexii]);
-        WriteGroupCatalog(opt, ng, &numingroup[indexii], pglist, Part);
-        if (opt.iseparatefiles) WriteHierarchy(opt,ngroup,nhierarchy,psldata->nsinlevel,nsub,parentgid,stype,1);
-        else WriteHierarchy(opt,ngroup,nhierarchy,psldata->nsinlevel,nsub,parentgid,stype,-1);
-        if (opt.partsearchtype==PSTALL){
-            WriteGroupPartType(opt, ng, &numingroup[indexii], pglist, Part);
-        }
+        writer.submit([=]() mutable {WriteProperties(opt,ng,&pdata[indexii]);});
+        SubmitGroupCatalog(writer, opt, ng, &numingroup[indexii], pglist, Part, 0, opt.partsearchtype==PSTALL);
+        writer.submit([=]() mutable {WriteHierarchy(opt,ngroup,nhierarchy,nfield,nsub,parentgid,stype,opt.iseparatefiles?1:-1);});
         for (Int_t i=1;i<=ng;i++) delete[] pglist[i];
         delete[] pglist;
     }
@@ -588,16 +600,14 @@ int main(int argc,char **argv)
         //MPI as domain, despite having no groups might need to exchange particles
         if (opt.iInclusiveHalo==3) SortAccordingtoBindingEnergy(opt,Nlocal,Part.data(),ng,pfof,numingroup,pdata);
 #endif
-        WriteProperties(opt,ng,NULL);
-        WriteGroupCatalog(opt,ng,&numingroup[indexii],NULL,Part);
-        if (opt.iseparatefiles) WriteHierarchy(opt,ngroup,nhierarchy,psldata->nsinlevel,nsub,parentgid,stype,1);
-        else WriteHierarchy(opt,ngroup,nhierarchy,psldata->nsinlevel,nsub,parentgid,stype,-1);
-        if (opt.partsearchtype==PSTALL){
-            WriteGroupPartType(opt, ng, &numingroup[indexii], NULL, Part);
-        }
+        writer.submit([=]() mutable {WriteProperties(opt,ng,NULL);});
+        SubmitGroupCatalog(writer, opt, ng, &numingroup[indexii], NULL, Part, 0, opt.partsearchtype==PSTALL);
+        writer.submit([=]() mutable {WriteHierarchy(opt,ngroup,nhierarchy,nfield,nsub,parentgid,stype,opt.iseparatefiles?1:-1);});
     }
 
-    if (opt.iprofilecalc) WriteProfiles(opt, ngroup, pdata);
+    if (opt.iprofilecalc) writer.submit([=]() mutable {WriteProfiles(opt, ngroup, pdata);});
+    //final barrier before the data used by the writer is changed or freed
+    writer.flush();
 
 #ifdef EXTENDEDHALOOUTPUT
     if (opt.iExtendedOutput) WriteExtendedOutput (opt, ngroup, Nlocal, pdata, Part, pfof);
@@ -614,6 +624,9 @@ int main(int argc,char **argv)
     delete[] uparentgid;
     delete[] stype;
 
+    vr::spatial_index().report();
+    vr::spatial_index().clear();
+
     LOG(info) << "VELOCIraptor finished in " << total_timer;
 
     finish_vr(opt);
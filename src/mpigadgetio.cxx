@@ -8,6 +8,7 @@
 
 #include "stf.h"
 
+#include "io.h"
 #include "gadgetitems.h"
 #include "endianutils.h"
 
@@ -502,10 +503,46 @@ void MPIDomainDecompositionGadget(Options &opt){
     }
 }
 
+/*! Reads the number of particles of each type in every gadget input file, stored as [ifile*NGTYPE+itype].
+    The headers are shared out between the tasks of the read communicator and the counts combined.
+*/
+vector<unsigned long long> MPIGadgetFileParticleCounts(Options &opt, MPI_Comm comm)
+{
+    int ThisReadTask, NReadTasks;
+    MPI_Comm_rank(comm, &ThisReadTask);
+    MPI_Comm_size(comm, &NReadTasks);
+    vector<unsigned long long> npartfile(opt.num_files*NGTYPE, 0);
+    struct gadget_header header;
+    char buf[2000];
+    char DATA[5];
+    int dummy;
+    InitEndian();
+    for (int i=ThisReadTask; i<opt.num_files; i+=NReadTasks) {
+        if(opt.num_files>1) sprintf(buf,"%s.%d",opt.fname,i);
+        else sprintf(buf,"%s",opt.fname);
+        fstream Fgad(buf,ios::in);
+        if (!Fgad) {
+            LOG(error) << "Unable to open " << buf;
+            MPI_Abort(MPI_COMM_WORLD,8);
+        }
+#ifdef GADGET2FORMAT
+        Fgad.read((char*)&dummy, sizeof(dummy));
+        Fgad.read((char*)&DATA[0],sizeof(char)*4);
+        Fgad.read((char*)&dummy, sizeof(dummy));
+        Fgad.read((char*)&dummy, sizeof(dummy));
+#endif
+        Fgad.read((char*)&dummy, sizeof(dummy));
+        Fgad.read((char*)&header, sizeof(gadget_header));
+        header.Endian();
+        for (int k=0;k<NGTYPE;k++) npartfile[i*NGTYPE+k]=header.npart[k];
+    }
+    MPI_Allreduce(MPI_IN_PLACE, npartfile.data(), npartfile.size(), MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    return npartfile;
+}
+
 ///reads a gadget file to determine number of particles in each MPIDomain
 void MPINumInDomainGadget(Options &opt)
 {
-    #define SKIP2 Fgad[i].read((char*)&dummy, sizeof(dummy));
     InitEndian();
     if (NProcs>1) {
     MPIDomainExtentGadget(opt);
@@ -514,12 +551,7 @@ void MPINumInDomainGadget(Options &opt)
     Int_t i,j,k,n,m,temp,pc,pc_new, Ntot,indark,ingas,instar;
     Int_t idval;
     Int_t ntot_withmasses;
-    int dummy;
     double z,aadjust,Hubble;
-    FLOAT ctemp[3], dtemp;
-    char   buf[200];
-    char DATA[5];
-    fstream *Fgad;
     struct gadget_header *header;
     Int_t Nlocalold=Nlocal;
     int *ireadtask,*readtaskID;
@@ -529,74 +561,47 @@ void MPINumInDomainGadget(Options &opt)
     MPIDistributeReadTasks(opt,ireadtask,readtaskID);
 
     MPI_Status status;
-    Int_t Nlocalbuf,ibuf=0,*Nbuf, *Nbaryonbuf;
+    Int_t Nlocalbuf,*Nbuf, *Nbaryonbuf;
     Nbuf=new Int_t[NProcs];
     Nbaryonbuf=new Int_t[NProcs];
     for (int j=0;j<NProcs;j++) Nbuf[j]=0;
     for (int j=0;j<NProcs;j++) Nbaryonbuf[j]=0;
 
-    //opening file
-    Fgad=new fstream[opt.num_files];
     header=new gadget_header[opt.num_files];
+    MPI_Comm mpi_comm_read;
+    MPI_Comm_split(MPI_COMM_WORLD, (ireadtask[ThisTask]>=0), ThisTask, &mpi_comm_read);
     if (ireadtask[ThisTask]>=0) {
-        MPISetFilesRead(opt,ireadfile,ireadtask);
+        vector<double> typecost(NGTYPE, 1.0);
+        MPISetFilesRead(opt,ireadfile,MPIPlanFileReads(opt, ireadtask, MPIGadgetFileParticleCounts(opt, mpi_comm_read), typecost, false));
+        //positions are decoded from the mapped files and their processors determined a chunk at a time
+        Int_t chunksize=opt.inputbufsize,nchunk;
+        vector<FLOAT> ctempchunk(3*chunksize);
+        vector<int> chunkprocessor(chunksize);
         for(i=0; i<opt.num_files; i++) if(ireadfile[i])
         {
-            if(opt.num_files>1) sprintf(buf,"%s.%d",opt.fname,int(i));
-            else sprintf(buf,"%s",opt.fname);
-            Fgad[i].open(buf,ios::in);
-        #ifdef GADGET2FORMAT
-            SKIP2;
-            Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-            SKIP2;
-            SKIP2;
-            fprintf(stderr,"reading... %s\n",DATA);
-        #endif
-            Fgad[i].read((char*)&dummy, sizeof(dummy));
-            Fgad[i].read((char*)&header[i], sizeof(gadget_header));
-            Fgad[i].read((char*)&dummy, sizeof(dummy));
-            //endian indep call
-            header[i].Endian();
-
-        #ifdef GADGET2FORMAT
-            Fgad[i].read((char*)&dummy, sizeof(dummy));
-            Fgad[i].read((char*)&DATA[0],sizeof(char)*4);DATA[4] = '\0';
-            Fgad[i].read((char*)&dummy, sizeof(dummy));
-            Fgad[i].read((char*)&dummy, sizeof(dummy));
-        #endif
-            Fgad[i].read((char*)&dummy, sizeof(dummy));
-            for(k=0;k<NGTYPE;k++)
+            Fortran_Record_File F;
+            Gadget_Blocks blocks;
+            if (!Gadget_open_file(opt, i, F, header[i], blocks)) MPI_Abort(MPI_COMM_WORLD,8);
+            Int_t nfirst=0;
+            for(k=0;k<NGTYPE;nfirst+=header[i].npart[k],k++)
             {
-                for(n=0;n<header[i].npart[k];n++)
+                Int_t *Ncount=NULL;
+                if (opt.partsearchtype==PSTALL) Ncount=Nbuf;
+                else if (opt.partsearchtype==PSTDARK) {
+                    if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) Ncount=Nbuf;
+                    else if (opt.iBaryonSearch) Ncount=Nbaryonbuf;
+                }
+                else if (opt.partsearchtype==PSTSTAR && k==GSTARTYPE) Ncount=Nbuf;
+                else if (opt.partsearchtype==PSTGAS && k==GGASTYPE) Ncount=Nbuf;
+                if (Ncount==NULL) continue;
+                for(n=0;n<header[i].npart[k];n+=nchunk)
                 {
-                    Fgad[i].read((char*)&ctemp[0], sizeof(FLOAT)*3);
-                    ibuf=MPIGetParticlesProcessor(opt, ctemp[0],ctemp[1],ctemp[2]);
-                    if (opt.partsearchtype==PSTALL) {
-                        Nbuf[ibuf]++;
-                    }
-                    else if (opt.partsearchtype==PSTDARK) {
-                        if (!(k==GGASTYPE||k==GSTARTYPE||k==GBHTYPE)) {
-                            Nbuf[ibuf]++;
-                        }
-                        else {
-                            if (opt.iBaryonSearch) {
-                                Nbaryonbuf[ibuf]++;
-                            }
-                        }
-                    }
-                    else if (opt.partsearchtype==PSTSTAR) {
-                        if (k==STARTYPE) {
-                            Nbuf[ibuf]++;
-                        }
-                    }
-                    else if (opt.partsearchtype==PSTGAS) {
-                        if (k==GASTYPE) {
-                            Nbuf[ibuf]++;
-                        }
-                    }
+                    nchunk=min(chunksize,(Int_t)header[i].npart[k]-n);
+                    Gadget_read_block(F, blocks.pos, 3*(nfirst+n), 3*nchunk, ctempchunk.data());
+                    MPIGetParticlesProcessor(opt, nchunk, ctempchunk.data(), chunkprocessor.data());
+                    for (Int_t nn=0;nn<nchunk;nn++) Ncount[chunkprocessor[nn]]++;
                 }
             }
-            Fgad[i].close();
         }
     }
     //now having read number of particles, run all gather
@@ -607,6 +612,7 @@ void MPINumInDomainGadget(Options &opt)
         MPI_Allreduce(Nbaryonbuf,mpi_nlocal,NProcs,MPI_Int_t,MPI_SUM,MPI_COMM_WORLD);
         Nlocalbaryon[0]=mpi_nlocal[ThisTask];
     }
+    MPI_Comm_free(&mpi_comm_read);
     }
 }
 
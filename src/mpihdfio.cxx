@@ -124,6 +124,40 @@ void MPIDomainDecompositionHDF(Options &opt){
     }
 }
 
+/*! Reads the number of particles of each type in every input file, stored as [ifile*NHDFTYPE+itype].
+    The headers are shared out between the tasks of the read communicator and the counts combined.
+*/
+vector<unsigned long long> MPIHDFFileParticleCounts(Options &opt, MPI_Comm comm)
+{
+    int ThisReadTask, NReadTasks;
+    MPI_Comm_rank(comm, &ThisReadTask);
+    MPI_Comm_size(comm, &NReadTasks);
+    vector<unsigned long long> npartfile(opt.num_files*NHDFTYPE, 0);
+    HDF_Header hdf_header_info(opt.ihdfnameconvention);
+    char buf[2000];
+    for (int i=ThisReadTask; i<opt.num_files; i+=NReadTasks) {
+        if(opt.num_files>1) sprintf(buf,"%s.%d.hdf5",opt.fname,i);
+        else sprintf(buf,"%s.hdf5",opt.fname);
+        hid_t Fhdf=H5Fopen(buf, H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (Fhdf < 0) {
+            LOG(error) << "Unable to open " << buf;
+            MPI_Abort(MPI_COMM_WORLD,8);
+        }
+        if (opt.ihdfnameconvention==HDFSWIFTEAGLENAMES || opt.ihdfnameconvention==HDFOLDSWIFTEAGLENAMES ||
+            opt.ihdfnameconvention == HDFSWIFTFLAMINGONAMES) {
+            auto npart = read_attribute_v<long long>(Fhdf, hdf_header_info.names[hdf_header_info.INuminFile]);
+            for (int k=0;k<NHDFTYPE;k++) npartfile[i*NHDFTYPE+k]=npart[k];
+        }
+        else {
+            auto npart = read_attribute_v<unsigned int>(Fhdf, hdf_header_info.names[hdf_header_info.INuminFile]);
+            for (int k=0;k<NHDFTYPE;k++) npartfile[i*NHDFTYPE+k]=npart[k];
+        }
+        H5Fclose(Fhdf);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, npartfile.data(), npartfile.size(), MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    return npartfile;
+}
+
 ///reads HDF file to determine number of particles in each MPIDomain
 void MPINumInDomainHDF(Options &opt)
 {
@@ -182,28 +216,12 @@ void MPINumInDomainHDF(Options &opt)
     hsize_t datadim[5];
     Int_t Nlocalbuf,ibuf=0,*Nbuf, *Nbaryonbuf;
     int *ireadtask,*readtaskID;
-    hid_t plist_id = H5P_DEFAULT;
     ireadtask=new int[NProcs];
     readtaskID=new int[opt.nsnapread];
     std::vector<int> ireadfile(opt.num_files);
     MPIDistributeReadTasks(opt,ireadtask,readtaskID);
-#ifdef USEPARALLELHDF
     MPI_Comm mpi_comm_read;
-    MPI_Comm mpi_comm_parallel_read;
-    int ThisReadTask, NProcsReadTask, ThisParallelReadTask, NProcsParallelReadTask;
-    if (opt.nsnapread > opt.num_files) {
-        MPI_Comm_split(MPI_COMM_WORLD, (ireadtask[ThisTask]>=0), ThisTask, &mpi_comm_read);
-        int ntaskread = ceil(opt.nsnapread/opt.num_files);
-        int ifile = floor(ireadtask[ThisTask]/ntaskread);
-        MPI_Comm_rank(mpi_comm_read, &ThisReadTask);
-        MPI_Comm_size(mpi_comm_read, &NProcsReadTask);
-        MPI_Comm_split(mpi_comm_read, ifile, ThisReadTask, &mpi_comm_parallel_read);
-        MPI_Comm_rank(mpi_comm_parallel_read, &ThisParallelReadTask);
-        MPI_Comm_size(mpi_comm_parallel_read, &NProcsParallelReadTask);
-        plist_id = H5Pcreate(H5P_FILE_ACCESS);
-        H5Pset_fapl_mpio(plist_id, mpi_comm_parallel_read, MPI_INFO_NULL);
-    }
-#endif
+    MPI_Comm_split(MPI_COMM_WORLD, (ireadtask[ThisTask]>=0), ThisTask, &mpi_comm_read);
 
     Nbuf=new Int_t[NProcs];
     Nbaryonbuf=new Int_t[NProcs];
@@ -216,111 +234,49 @@ void MPINumInDomainHDF(Options &opt)
     int usetypes[NHDFTYPE];
     if (ireadtask[ThisTask]>=0) {
         HDFSetUsedParticleTypes(opt,nusetypes,nbusetypes,usetypes);
-        hdf_header_info.resize(opt.num_files);
         Fhdf.resize(opt.num_files);
-        headerdataspace.resize(opt.num_files);
-        headerattribs.resize(opt.num_files);
         partsgroup.resize(opt.num_files*NHDFTYPE,-1);
         partsdataset.resize(opt.num_files*NHDFTYPE,-1);
         partsdataspace.resize(opt.num_files*NHDFTYPE,-1);
 
-        MPISetFilesRead(opt,ireadfile,ireadtask);
+        //only positions are read here, so every particle costs the same
+        vector<double> typecost(NHDFTYPE, 0);
+        vector<int> baryontypes;
+        if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch) for (j=1;j<=nbusetypes;j++) baryontypes.push_back(usetypes[j]);
+        for (j=0;j<nusetypes;j++) typecost[usetypes[j]] = 1;
+        for (auto k:baryontypes) typecost[k] = 1;
+        auto readranges = MPIPlanFileReads(opt, ireadtask, MPIHDFFileParticleCounts(opt, mpi_comm_read), typecost, true);
+        MPISetFilesRead(opt,ireadfile,readranges);
         for(i=0; i<opt.num_files; i++) {
     	    if(ireadfile[i] == 0 ) continue;
             if(opt.num_files>1) sprintf(buf,"%s.%d.hdf5",opt.fname,int(i));
             else sprintf(buf,"%s.hdf5",opt.fname);
             //Open the specified file and the specified dataset in the file.
-            Fhdf[i]=H5Fopen(buf, H5F_ACC_RDONLY, plist_id);
-#ifdef USEPARALLELHDF
-            H5Pclose(plist_id);
-#endif
-            //get number in file
-            if (opt.ihdfnameconvention==HDFSWIFTEAGLENAMES || opt.ihdfnameconvention==HDFOLDSWIFTEAGLENAMES ||
-		opt.ihdfnameconvention == HDFSWIFTFLAMINGONAMES) {
-	      
-                vlongbuff = read_attribute_v<long long>(Fhdf[i], hdf_header_info[i].names[hdf_header_info[i].INuminFile]);
-                for (k=0;k<NHDFTYPE;k++) hdf_header_info[i].npart[k]=vlongbuff[k];
-		
-            } else {
-	      
-                vintbuff = read_attribute_v<int>(Fhdf[i], hdf_header_info[i].names[hdf_header_info[i].INuminFile]);
-                for (k=0;k<NHDFTYPE;k++) hdf_header_info[i].npart[k]=vintbuff[k];
-            }
-	    
-            //open particle group structures
-            for (j=0;j<nusetypes;j++) {k=usetypes[j]; partsgroup[i*NHDFTYPE+k]=HDF5OpenGroup(Fhdf[i],hdf_gnames.part_names[k]);}
-            if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch) {
-                 for (j=1;j<=nbusetypes;j++) {k=usetypes[j];partsgroup[i*NHDFTYPE+k]=HDF5OpenGroup(Fhdf[i],hdf_gnames.part_names[k]);}
-            }
-
-            //get positions
-            for (j=0;j<nusetypes;j++) {
-                k=usetypes[j];
-                partsdataset[i*NHDFTYPE+k]=HDF5OpenDataSet(partsgroup[i*NHDFTYPE+k],hdf_parts[k]->names[0]);
-                partsdataspace[i*NHDFTYPE+k]=HDF5OpenDataSpace(partsdataset[i*NHDFTYPE+k]);
-            }
-            if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch) for (j=1;j<=nbusetypes;j++) {
-                k=usetypes[j];
+            Fhdf[i]=H5Fopen(buf, H5F_ACC_RDONLY, H5P_DEFAULT);
+            for (auto &range:readranges) {
+                if (range.ifile!=i) continue;
+                k=range.itype;
+                //open particle group structures and positions
+                partsgroup[i*NHDFTYPE+k]=HDF5OpenGroup(Fhdf[i],hdf_gnames.part_names[k]);
                 partsdataset[i*NHDFTYPE+k]=HDF5OpenDataSet(partsgroup[i*NHDFTYPE+k],hdf_parts[k]->names[0]);
                 partsdataspace[i*NHDFTYPE+k]=HDF5OpenDataSpace(partsdataset[i*NHDFTYPE+k]);
-            }
-            for (j=0;j<nusetypes;j++) {
-                k=usetypes[j];
-                unsigned long long nstart = 0, nend = hdf_header_info[i].npart[k];
-                unsigned long long nlocalsize;
-#ifdef USEPARALLELHDF
-                if (opt.num_files<opt.nsnapread) {
-                    plist_id = H5Pcreate(H5P_DATASET_XFER);
-                    H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_INDEPENDENT);
-                    nlocalsize = nend / NProcsParallelReadTask;
-                    nstart = nlocalsize*ThisParallelReadTask;
-                    if (ThisParallelReadTask < NProcsParallelReadTask -1)
-                        nend = nlocalsize + nstart;
-                }
-#endif
+                //baryons are counted separately when searched separately
+                bool isbaryon = find(baryontypes.begin(), baryontypes.end(), k) != baryontypes.end();
+                Int_t *nbuf = isbaryon ? Nbaryonbuf : Nbuf;
+                unsigned long long nstart = range.nstart, nend = range.nend;
                 if (nend-nstart<chunksize)nchunk=nend-nstart;
                 else nchunk=chunksize;
                 for(n=nstart;n<nend;n+=nchunk)
                 {
                     if (nend - n < chunksize && nend - n > 0) nchunk=nend-n;
                     //setup hyperslab so that it is loaded into the buffer
-                    HDF5ReadHyperSlabReal(doublebuff,partsdataset[i*NHDFTYPE+k], partsdataspace[i*NHDFTYPE+k], 1, 3, nchunk, n, plist_id);
+                    HDF5ReadHyperSlabReal(doublebuff,partsdataset[i*NHDFTYPE+k], partsdataspace[i*NHDFTYPE+k], 1, 3, nchunk, n);
                     for (auto nn=0;nn<nchunk;nn++) {
                         ibuf=MPIGetParticlesProcessor(opt, doublebuff[nn*3],doublebuff[nn*3+1],doublebuff[nn*3+2]);
-                        Nbuf[ibuf]++;
-                    }
-                }
-            }
-            if (opt.partsearchtype==PSTDARK && opt.iBaryonSearch) {
-                for (j=1;j<=nbusetypes;j++) {
-                    k=usetypes[j];
-                    unsigned long long nstart = 0, nend = hdf_header_info[i].npart[k];
-#ifdef USEPARALLELHDF
-                    if (opt.num_files<opt.nsnapread) {
-                        unsigned long long nlocalsize = nend / NProcsParallelReadTask;
-                        nstart = nlocalsize*ThisParallelReadTask;
-                        if (ThisParallelReadTask < NProcsParallelReadTask -1)
-                            nend = nlocalsize + nstart;
-                    }
-#endif
-                    if (nend-nstart<chunksize)nchunk=nend-nstart;
-                    else nchunk=chunksize;
-                    for(n=nstart;n<nend;n+=nchunk)
-                    {
-                        if (nend - n < chunksize && nend - n > 0) nchunk=nend-n;
-                        // setup hyperslab so that it is loaded into the buffer
-                        HDF5ReadHyperSlabReal(doublebuff, partsdataset[i*NHDFTYPE+k], partsdataspace[i*NHDFTYPE+k], 1, 3, nchunk, n, plist_id);
-
-                        for (auto nn=0;nn<nchunk;nn++) {
-                            ibuf=MPIGetParticlesProcessor(opt, doublebuff[nn*3],doublebuff[nn*3+1],doublebuff[nn*3+2]);
-                            Nbaryonbuf[ibuf]++;
-                        }
+                        nbuf[ibuf]++;
                     }
                 }
             }
-#ifdef USEPARALLELHDF
-            H5Pclose(plist_id);
-#endif
             //close data spaces
             for (auto &hidval:partsdataspace) HDF5CloseDataSpace(hidval);
             for (auto &hidval:partsdataset) HDF5CloseDataSet(hidval);
@@ -336,12 +292,7 @@ void MPINumInDomainHDF(Options &opt)
         MPI_Allreduce(Nbaryonbuf,mpi_nlocal,NProcs,MPI_Int_t,MPI_SUM,MPI_COMM_WORLD);
         Nlocalbaryon[0]=mpi_nlocal[ThisTask];
     }
-#ifdef USEPARALLELHDF
-    if (opt.nsnapread > opt.num_files) {
-        MPI_Comm_free(&mpi_comm_parallel_read);
-        MPI_Comm_free(&mpi_comm_read);
-    }
-#endif
+    MPI_Comm_free(&mpi_comm_read);
     delete[] ireadtask;
     delete[] readtaskID;
     delete[] doublebuff;
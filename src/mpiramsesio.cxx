@@ -100,7 +100,6 @@ void MPIDomainDecompositionRAMSES(Options &opt){
 }
 
 ///reads a gadget file to determine number of particles in each MPIDomain
-///\todo need to add code to read gas cell positions and send them to the appropriate mpi thead
 void MPINumInDomainRAMSES(Options &opt)
 {
 
@@ -109,37 +108,15 @@ void MPINumInDomainRAMSES(Options &opt)
         MPIDomainExtentRAMSES(opt);
         MPIInitialDomainDecomposition(opt);
         MPIDomainDecompositionRAMSES(opt);
-        Int_t i,j,k,n,m,temp,Ntot,indark,ingas,instar;
-        int idim,ivar,igrid;
-        Int_t idval;
-        int   typeval;
+        Int_t i,n,m,temp,Ntot,indark,ingas,instar;
         Int_t Nlocalold=Nlocal;
-        RAMSESFLOAT xtemp[3], ageval;
-        Double_t mtemp;
         MPI_Status status;
         Int_t Nlocalbuf,ibuf=0,*Nbuf, *Nbaryonbuf;
-        int *ngridlevel,*ngridbound,*ngridfile;
-        int lmin=1000000,lmax=0;
+        int   typeval;
 
-        char buf[2000],buf1[2000],buf2[2000];
+        char buf1[2000];
         string stringbuf,orderingstring;
         fstream Finfo;
-        fstream *Fpart, *Fpartmass, *Fpartage, *Famr, *Fhydro;
-        fstream  Framses;
-        RAMSES_Header *header;
-        int intbuff[NRAMSESTYPE];
-        long long longbuff[NRAMSESTYPE];
-        Int_t count2,bcount2;
-        int dummy,byteoffset;
-        Int_t chunksize = opt.inputbufsize, nchunk;
-        RAMSESFLOAT *xtempchunk, *mtempchunk, *agetempchunk;
-        int *icellchunk;
-        Fpart      = new fstream[opt.num_files];
-        Fpartmass  = new fstream[opt.num_files];
-        Fpartage   = new fstream[opt.num_files];
-        Famr       = new fstream[opt.num_files];
-        Fhydro     = new fstream[opt.num_files];
-        header     = new RAMSES_Header[opt.num_files];
         double dmp_mass,OmegaM, OmegaB;
         int n_out_of_bounds = 0;
         int ndark  = 0;
@@ -187,254 +164,98 @@ void MPINumInDomainRAMSES(Options &opt)
         MPI_Bcast(&dmp_mass, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
         if (ireadtask[ThisTask]>=0) {
+            //files are decoded in batches, one per thread, and their particles then assigned to domains in file order
+            int nreadbatch=1, ireaderror=0;
+#ifdef USEOPENMP
+            nreadbatch=omp_get_max_threads();
+#endif
+            vector<int> readfiles;
+            for (i=0;i<opt.num_files;i++) if (ireadfile[i]) readfiles.push_back(i);
             if (opt.partsearchtype!=PSTGAS) {
-                for (int i = 0, count2 = 0; i < opt.num_files; i++) if (ireadfile[i]){
-                    sprintf(buf1,"%s/part_%s.out%05d",opt.fname,opt.ramsessnapname,i+1);
-                    sprintf(buf2,"%s/part_%s.out",opt.fname,opt.ramsessnapname);
-                    if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-                    else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-                    Fpart[i].open      (buf, ios::binary|ios::in);
-                    Fpartmass[i].open  (buf, ios::binary|ios::in);
-                    Fpartage[i].open   (buf, ios::binary|ios::in);
-                    //skip header information in each file save for number in the file
-                    //@{
-                    byteoffset = 0;
-                    // ncpus
-                    byteoffset += RAMSES_fortran_skip(Fpart[i], 1);
-                    // ndims
-                    byteoffset += RAMSES_fortran_read(Fpart[i],header[i].ndim);
-                    //store number of particles locally in file
-                    byteoffset += RAMSES_fortran_read(Fpart[i],header[i].npartlocal);
-                    // skip local seeds, nstartot, mstartot, mstarlost, nsink
-                    byteoffset += RAMSES_fortran_skip(Fpart[i], 5);
-                    // byteoffset now stores size of header offset for particles
-                    Fpartmass[i].seekg  (byteoffset,ios::cur);
-                    Fpartage[i].seekg   (byteoffset,ios::cur);
-
-                    //skip positions
-                    for(idim = 0; idim < header[i].ndim; idim++)
-                    {
-                          RAMSES_fortran_skip (Fpartmass[i]);
-                          RAMSES_fortran_skip (Fpartage[i]);
+                vector<RAMSES_Part_Data> partdata(min(nreadbatch,(int)readfiles.size()));
+                for (size_t ibatch=0;ibatch<readfiles.size();ibatch+=nreadbatch) {
+                    int nbatchfiles=min((size_t)nreadbatch,readfiles.size()-ibatch);
+                    //only positions, masses and ages are needed to determine the type and domain of each particle
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ireaderror) if (nbatchfiles>1)
+#endif
+                    for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+                        if (!RAMSES_read_part_file(opt, readfiles[ibatch+ibatchfile], partdata[ibatchfile], RAMSESPARTPOS|RAMSESPARTMASS|RAMSESPARTAGE)) ireaderror++;
                     }
-                    //skip velocities
-                    for(idim=0;idim<header[i].ndim;idim++)
-                    {
-                        RAMSES_fortran_skip(Fpartmass[i]);
-                        RAMSES_fortran_skip(Fpartage[i]);
+                    //a file that cannot be read would leave the particle counts inconsistent with the header
+                    if (ireaderror>0) {
+                        LOG(error) << "Could not read " << ireaderror << " RAMSES particle files, exiting";
+                        MPI_Abort(MPI_COMM_WORLD,9);
                     }
-                    //skip mass
-                    RAMSES_fortran_skip(Fpartage[i]);
-                    //skip ids;
-                    RAMSES_fortran_skip(Fpartage[i]);
-                    //skip levels
-                    RAMSES_fortran_skip(Fpartage[i]);
-                    //data loaded into memory in chunks
-                    chunksize    = nchunk = header[i].npartlocal;
-                    xtempchunk   = new RAMSESFLOAT  [3*chunksize];
-                    mtempchunk   = new RAMSESFLOAT  [chunksize];
-                    agetempchunk = new RAMSESFLOAT  [chunksize];
-                    //now load position data, mass data, and age data
-                    for(idim = 0; idim < header[i].ndim; idim++)RAMSES_fortran_read(Fpart[i], &xtempchunk[idim*nchunk]);
-                    RAMSES_fortran_read(Fpartmass[i],  mtempchunk);
-                    RAMSES_fortran_read(Fpartage[i],   agetempchunk);
-
-                    for (int nn = 0; nn < nchunk; nn++)
-                    {
-                        //this should be a ghost star particle
-                        if (fabs((mtempchunk[nn]-dmp_mass)/dmp_mass) > 1e-5 && (agetempchunk[nn] == 0.0)) nghost++;
-                        else
+                    for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+                        RAMSES_Part_Data &data=partdata[ibatchfile];
+                        Int_t nchunk = data.npart;
+                        RAMSESFLOAT *xtempchunk = data.x.data(), *mtempchunk = data.m.data(), *agetempchunk = data.age.data();
+                        for (Int_t nn = 0; nn < nchunk; nn++)
                         {
-                            xtemp[0] = xtempchunk[nn];
-                            xtemp[1] = xtempchunk[nn+nchunk];
-                            xtemp[2] = xtempchunk[nn+2*nchunk];
-                            mtemp = mtempchunk[nn];
-                            ageval = agetempchunk[nn];
-
-                            if (fabs(mtemp-dmp_mass)/dmp_mass<1e-5)
-                            {
-                                typeval = DARKTYPE;
-                                ndark++;
-                            }
-                            else
-                            {
-                                typeval = STARTYPE;
-                                nstar++;
-                            }
-
-                            //determine processor this particle belongs on based on its spatial position
-                            ibuf = MPIGetParticlesProcessor(opt, xtemp[0],xtemp[1],xtemp[2]);
-                            /// Count total number of DM particles, Baryons, etc
-                            //@{
-                            if (opt.partsearchtype == PSTALL)
-                            {
-                            Nbuf[ibuf]++;
-                            count2++;
-                            }
+                            //this should be a ghost star particle
+                            if (fabs((mtempchunk[nn]-dmp_mass)/dmp_mass) > 1e-5 && (agetempchunk[nn] == 0.0)) nghost++;
                             else
                             {
-                                if (opt.partsearchtype == PSTDARK)
+                                if (fabs(mtempchunk[nn]-dmp_mass)/dmp_mass<1e-5)
                                 {
-                                    if (typeval == DARKTYPE)
-                                    {
-                                        Nbuf[ibuf]++;
-                                        count2++;
-                                    }
-                                    else
-                                    {
-                                        if (opt.iBaryonSearch)
-                                        {
-                                            Nbaryonbuf[ibuf]++;
-                                        }
-                                    }
+                                    typeval = DARKTYPE;
+                                    ndark++;
                                 }
                                 else
                                 {
-                                    if (opt.partsearchtype == PSTSTAR)
-                                    {
-                                        if (typeval == STARTYPE)
-                                        {
-                                            Nbuf[ibuf]++;
-                                            count2++;
-                                        }
-                                    }
+                                    typeval = STARTYPE;
+                                    nstar++;
+                                }
+
+                                //determine processor this particle belongs on based on its spatial position
+                                ibuf = MPIGetParticlesProcessor(opt, xtempchunk[nn],xtempchunk[nn+nchunk],xtempchunk[nn+2*nchunk]);
+                                /// Count total number of DM particles, Baryons, etc
+                                //@{
+                                if (opt.partsearchtype == PSTALL) Nbuf[ibuf]++;
+                                else if (opt.partsearchtype == PSTDARK)
+                                {
+                                    if (typeval == DARKTYPE) Nbuf[ibuf]++;
+                                    else if (opt.iBaryonSearch) Nbaryonbuf[ibuf]++;
+                                }
+                                else if (opt.partsearchtype == PSTSTAR)
+                                {
+                                    if (typeval == STARTYPE) Nbuf[ibuf]++;
                                 }
+                                //@}
                             }
                         }
+                        data=RAMSES_Part_Data();
                     }
-                    delete[] xtempchunk;
-                    delete[] mtempchunk;
-                    delete[] agetempchunk;
-
-                    Fpart[i].close();
-                    Fpartmass[i].close();
-                    Fpartage[i].close();
                 }
             }
 
-            // now process gas if necessary
-            if (opt.partsearchtype==PSTGAS || opt.partsearchtype==PSTALL) {
-                for (i=0;i<opt.num_files;i++) if (ireadfile[i]) {
-                    sprintf(buf1,"%s/amr_%s.out%05d",opt.fname,opt.ramsessnapname,int(i+1));
-                    sprintf(buf2,"%s/amr_%s.out",opt.fname,opt.ramsessnapname);
-                    if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-                    else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-                    Famr[i].open(buf, ios::binary|ios::in);
-                    sprintf(buf1,"%s/hydro_%s.out%05d",opt.fname,opt.ramsessnapname,int(i+1));
-                    sprintf(buf2,"%s/hydro_%s.out",opt.fname,opt.ramsessnapname);
-                    if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-                    else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-                    Fhydro[i].open(buf, ios::binary|ios::in);
-                    //read some of the amr header till get to number of cells in current file
-                    //@{
-                    byteoffset=0;
-                    byteoffset+=RAMSES_fortran_read(Famr[i],header[i].ndim);
-                    header[i].twotondim=pow(2,header[i].ndim);
-                    Famr[i].read((char*)&dummy, sizeof(dummy));
-                    Famr[i].read((char*)&header[i].nx, sizeof(int));
-                    Famr[i].read((char*)&header[i].ny, sizeof(int));
-                    Famr[i].read((char*)&header[i].nz, sizeof(int));
-                    Famr[i].read((char*)&dummy, sizeof(dummy));
-                    byteoffset+=RAMSES_fortran_read(Famr[i],header[i].nlevelmax);
-                    byteoffset+=RAMSES_fortran_read(Famr[i],header[i].ngridmax);
-                    byteoffset+=RAMSES_fortran_read(Famr[i],header[i].nboundary);
-                    byteoffset+=RAMSES_fortran_read(Famr[i],header[i].npart[RAMSESGASTYPE]);
-
-                    //then skip the rest
-                    for (j=0;j<14;j++) RAMSES_fortran_skip(Famr[i]);
-                    if (lmin>header[i].nlevelmax) lmin=header[i].nlevelmax;
-                    if (lmax<header[i].nlevelmax) lmax=header[i].nlevelmax;
-                    //@}
-                    //read header info from hydro files
-                    //@{
-                    RAMSES_fortran_skip(Fhydro[i]);
-                    RAMSES_fortran_read(Fhydro[i],header[i].nvarh);
-                    RAMSES_fortran_skip(Fhydro[i]);
-                    RAMSES_fortran_skip(Fhydro[i]);
-                    RAMSES_fortran_skip(Fhydro[i]);
-                    RAMSES_fortran_read(Fhydro[i],header[i].gamma_index);
-                    //@}
-
-                    //then apparently read ngridlevels, which appears to be an array storing the number of grids at a given level
-                    ngridlevel=new int[header[i].nlevelmax];
-                    ngridfile=new int[(1+header[i].nboundary)*header[i].nlevelmax];
-                    RAMSES_fortran_read(Famr[i],ngridlevel);
-                    for (j=0;j<header[i].nlevelmax;j++) ngridfile[j]=ngridlevel[j];
-                    //skip some more
-                    RAMSES_fortran_skip(Famr[i]);
-                    //if nboundary>0 then need two skip twice then read ngridbound
-                    if(header[i].nboundary>0) {
-                        ngridbound=new int[header[i].nboundary*header[i].nlevelmax];
-                        RAMSES_fortran_skip(Famr[i]);
-                        RAMSES_fortran_skip(Famr[i]);
-                        //ngridbound is an array of some sort but I don't see what it is used for
-                        RAMSES_fortran_read(Famr[i],ngridbound);
-                        for (j=0;j<header[i].nlevelmax;j++) ngridfile[header[i].nlevelmax+j]=ngridbound[j];
+            // now process gas if necessary, which is stored with the baryons when searching dark matter
+            if (opt.partsearchtype==PSTGAS || opt.partsearchtype==PSTALL || (opt.partsearchtype==PSTDARK && opt.iBaryonSearch)) {
+                Int_t *Ngasbuf = (opt.partsearchtype==PSTDARK) ? Nbaryonbuf : Nbuf;
+                vector<RAMSES_Gas_Data> gasdata(min(nreadbatch,(int)readfiles.size()));
+                vector<int> icellbuf;
+                for (size_t ibatch=0;ibatch<readfiles.size();ibatch+=nreadbatch) {
+                    int nbatchfiles=min((size_t)nreadbatch,readfiles.size()-ibatch);
+                    //the cell positions are those used when reading, so cells are counted in the domain they are sent to
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ireaderror) if (nbatchfiles>1)
+#endif
+                    for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+                        if (!RAMSES_read_gas_file(opt, readfiles[ibatch+ibatchfile], gasdata[ibatchfile], RAMSESGASPOS)) ireaderror++;
                     }
-                    //skip some more
-                    RAMSES_fortran_skip(Famr[i],2);
-                    //if odering list in info is bisection need to skip more
-                    if (orderingstring==string("bisection")) RAMSES_fortran_skip(Famr[i],5);
-                    else RAMSES_fortran_skip(Famr[i],4);
-
-                    for (k=0;k<header[i].nboundary+1;k++) {
-                        for (j=0;j<header[i].nlevelmax;j++) {
-                            //first read amr for positions
-                            chunksize=nchunk=ngridfile[k*header[i].nlevelmax+j];
-                            if (chunksize>0) {
-                                xtempchunk=new RAMSESFLOAT[3*chunksize];
-                                //store son value in icell
-                                icellchunk=new int[header[i].twotondim*chunksize];
-                                //skip grid index, next index and prev index.
-                                RAMSES_fortran_skip(Famr[i],3);
-                                //now read grid centre
-                                for (idim=0;idim<header[i].ndim;idim++) {
-                                    RAMSES_fortran_read(Famr[i],&xtempchunk[idim*chunksize]);
-                                }
-                                //skip father index, then neighbours index
-                                RAMSES_fortran_skip(Famr[i],1+2*header[i].ndim);
-                                //read son index to determine if a cell in a specific grid is at the highest resolution and needs to be represented by a particle
-                                for (idim=0;idim<header[i].twotondim;idim++) {
-                                    RAMSES_fortran_read(Famr[i],&icellchunk[idim*chunksize]);
-                                }
-                                //skip cpu map and refinement map (2^ndim*2)
-                                RAMSES_fortran_skip(Famr[i],2*header[i].twotondim);
-                            }
-                            RAMSES_fortran_skip(Fhydro[i]);
-                            //then read hydro for other variables (first is density, then velocity, then pressure, then metallicity )
-                            if (chunksize>0) {
-                                //first read velocities (for 2 cells per number of dimensions (ie: cell corners?))
-                                for (idim=0;idim<header[i].twotondim;idim++) {
-                                    for (ivar=0;ivar<header[i].nvarh;ivar++) {
-                                        for (igrid=0;igrid<chunksize;igrid++) {
-                                            //once we have looped over all the hydro data then can start actually storing it into the particle structures
-                                            if (ivar==header[i].nvarh-1) {
-                                                //if cell has no internal cells or at maximum level produce a particle
-                                                if (icellchunk[idim*chunksize+igrid]==0 || j==header[i].nlevelmax-1) {
-                                                    //first suggestion is to add some jitter to the particle positions
-                                                    double dx = pow(0.5, j);
-                                                    int ix, iy, iz;
-                                                    //below assumes three dimensions with 8 corners (? maybe cells) per grid
-                                                    iz = idim/4;
-                                                    iy = (idim - (4*iz))/2;
-                                                    ix = idim - (2*iy) - (4*iz);
-                                                    // Calculate absolute coordinates + jitter, and generate particle
-                                                    xtemp[0] = ((((float)rand()/(float)RAND_MAX) * header[i].BoxSize * dx) +(header[i].BoxSize * (xtempchunk[igrid] + (double(ix)-0.5) * dx )) - (header[i].BoxSize*dx/2.0)) ;
-                                                    xtemp[1] = ((((float)rand()/(float)RAND_MAX) * header[i].BoxSize * dx) +(header[i].BoxSize * (xtempchunk[igrid+1*chunksize] + (double(iy)-0.5) * dx )) - (header[i].BoxSize*dx/2.0)) ;
-                                                    xtemp[2] = ((((float)rand()/(float)RAND_MAX) * header[i].BoxSize * dx) +(header[i].BoxSize * (xtempchunk[igrid+2*chunksize] + (double(iz)-0.5) * dx )) - (header[i].BoxSize*dx/2.0)) ;
-                                                    //determine processor this particle belongs on based on its spatial position
-                                                    ibuf=MPIGetParticlesProcessor(opt, xtemp[0],xtemp[1],xtemp[2]);
-                                                    Nbuf[ibuf]++;
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-                                delete[] xtempchunk;
-                            }
-                        }
+                    //a file that cannot be read would leave the particle counts inconsistent with the header
+                    if (ireaderror>0) {
+                        LOG(error) << "Could not read " << ireaderror << " RAMSES amr/hydro files, exiting";
+                        MPI_Abort(MPI_COMM_WORLD,9);
+                    }
+                    for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+                        RAMSES_Gas_Data &data=gasdata[ibatchfile];
+                        icellbuf.resize(data.ncell);
+                        MPIGetParticlesProcessor(opt, data.ncell, data.x.data(), icellbuf.data());
+                        for (Int_t icell=0;icell<data.ncell;icell++) Ngasbuf[icellbuf[icell]]++;
+                        data=RAMSES_Gas_Data();
                     }
-                    Famr[i].close();
                 }
             }
         }
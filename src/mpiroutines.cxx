@@ -8,11 +8,13 @@
 #ifdef USEMPI
 
 #include <cassert>
+#include <deque>
 #include <tuple>
 
 //-- For MPI
 
 #include "stf.h"
+#include "timer.h"
 
 #ifdef SWIFTINTERFACE
 #include "swiftinterface.h"
@@ -170,6 +172,35 @@ void MPIInitialDomainDecomposition(Options &opt)
     MPI_Bcast(mpi_domain, NProcs*sizeof(MPI_Domain), MPI_BYTE, 0, MPI_COMM_WORLD);
 }
 
+///position of a mesh cell along a Hilbert curve spanning a cube of 2^nbits cells per dimension.
+///Uses Skilling's transpose algorithm (AIP Conf. Proc. 707, 381, 2004), where the transposed coordinates
+///hold the bits of the Hilbert index, interleaved in the same way as the Morton index
+static unsigned long long MPIHilbertKey(const unsigned int coord[3], int nbits)
+{
+    unsigned int x[3] = {coord[0], coord[1], coord[2]};
+    unsigned int m = 1u << (nbits-1), p, q, t;
+    //inverse undo
+    for (q = m; q > 1; q >>= 1) {
+        p = q - 1;
+        for (auto i = 0; i < 3; i++) {
+            if (x[i] & q) x[0] ^= p;
+            else {
+                t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    //gray encode
+    for (auto i = 1; i < 3; i++) x[i] ^= x[i-1];
+    t = 0;
+    for (q = m; q > 1; q >>= 1) if (x[2] & q) t ^= q - 1;
+    for (auto i = 0; i < 3; i++) x[i] ^= t;
+    unsigned long long key = 0;
+    for (auto j = nbits-1; j >= 0; j--) for (auto i = 0; i < 3; i++) key = (key << 1) | ((x[i] >> j) & 1);
+    return key;
+}
+
 void MPIInitialDomainDecompositionWithMesh(Options &opt){
     if (ThisTask==0) {
         //each processor takes subsection of volume where use simple 2^(ceil(log(NProcs)/log(2))) subdivision
@@ -184,7 +215,7 @@ void MPIInitialDomainDecompositionWithMesh(Options &opt){
             opt.icellwidth[i] = 1.0/opt.cellwidth[i];
         }
 
-        //now order according to Z-curve or Morton curve
+        //now order according to Z-curve or Morton curve, or Hilbert curve
         //first fill curve
         vector<bitset<16>> zcurvevalue(3);
         struct zcurvestruct{
@@ -194,6 +225,9 @@ void MPIInitialDomainDecompositionWithMesh(Options &opt){
         };
         vector<zcurvestruct> zcurve(n3);
         unsigned long long index;
+        //the Hilbert curve spans the smallest power of two enclosing the mesh, which is walked skipping the cells outside it
+        int nbits = 1;
+        while ((1 << nbits) < opt.numcellsperdim) nbits++;
         for (auto ix=0;ix<opt.numcellsperdim;ix++) {
             for (auto iy=0;iy<opt.numcellsperdim;iy++) {
                 for (auto iz=0;iz<opt.numcellsperdim;iz++) {
@@ -205,6 +239,10 @@ void MPIInitialDomainDecompositionWithMesh(Options &opt){
                     zcurvevalue[0] = bitset<16>(ix);
                     zcurvevalue[1] = bitset<16>(iy);
                     zcurvevalue[2] = bitset<16>(iz);
+                    if (opt.mpimeshcurve == MPIMESHCURVEHILBERT) {
+                        zcurve[index].zcurvevalue = bitset<48>(MPIHilbertKey(zcurve[index].coord, nbits));
+                        continue;
+                    }
                     for (auto j=0; j<16;j++)
                     {
                         for (auto i = 0; i<3; i++) {
@@ -237,7 +275,7 @@ void MPIInitialDomainDecompositionWithMesh(Options &opt){
             numcellspertask[itask]++;
             count++;
         }
-        LOG(info) << "Z-curve Mesh MPI decomposition:";
+        LOG(info) << (opt.mpimeshcurve == MPIMESHCURVEHILBERT ? "Hilbert" : "Z-curve") << " Mesh MPI decomposition:";
         LOG(info) << " Mesh has resolution of " << opt.numcellsperdim << " per spatial dim";
         LOG(info) << " with each mesh spanning (" << opt.cellwidth[0] << ", " << opt.cellwidth[1] << ", " << opt.cellwidth[2] << ")";
         LOG(info) << "MPI tasks :";
@@ -261,19 +299,82 @@ void MPIInitialDomainDecompositionWithMesh(Options &opt){
 
 }
 
+///reads the cost of each mesh cell measured by a previous run along with the number of particles it then held,
+///returning false if there is no file or it was written for a different mesh
+static bool MPIReadMeshCellCosts(Options &opt, vector<double> &cellnumparts, vector<double> &cellcost)
+{
+    int iread = 0;
+    cellnumparts.resize(opt.numcells);
+    cellcost.resize(opt.numcells);
+    if (ThisTask == 0) {
+        ifstream Fin(opt.mpimeshcostfile);
+        int numcellsperdim = 0;
+        if (!Fin) {
+            LOG(warning) << "Could not open MPI mesh cost file " << opt.mpimeshcostfile << ", weighting cells by density";
+        }
+        else if (!(Fin >> numcellsperdim) || numcellsperdim != opt.numcellsperdim) {
+            LOG(warning) << "MPI mesh cost file " << opt.mpimeshcostfile << " is for a mesh of " << numcellsperdim
+                         << " cells per dim rather than " << opt.numcellsperdim << ", weighting cells by density";
+        }
+        else {
+            iread = 1;
+            for (auto i=0;i<opt.numcells;i++) if (!(Fin >> cellnumparts[i] >> cellcost[i])) {
+                LOG(warning) << "MPI mesh cost file " << opt.mpimeshcostfile << " is incomplete, weighting cells by density";
+                iread = 0;
+                break;
+            }
+        }
+    }
+    MPI_Bcast(&iread, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!iread) return false;
+    MPI_Bcast(cellnumparts.data(), opt.numcells, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(cellcost.data(), opt.numcells, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    return true;
+}
+
+///load of each mesh cell used to balance the decomposition. Either the number of particles in the cell, this number
+///weighted by 1+ln(n/<n>) for overdense cells, or the number of particles times the cost per particle measured in the cell
+static vector<double> MPIMeshCellWeights(Options &opt)
+{
+    vector<double> cellweight(opt.cellnodenumparts.begin(), opt.cellnodenumparts.end());
+    if (opt.mpimeshweighting == MPIMESHWEIGHTNUMPARTS) return cellweight;
+    vector<double> cellnumparts, cellcost;
+    if (opt.mpimeshweighting == MPIMESHWEIGHTMEASURED && MPIReadMeshCellCosts(opt, cellnumparts, cellcost)) {
+        double totnumparts = 0, totcost = 0;
+        for (auto i=0;i<opt.numcells;i++) {
+            totnumparts += cellnumparts[i];
+            totcost += cellcost[i];
+        }
+        if (totcost > 0) {
+            //cells that held no particles in the measured run take the average cost per particle
+            double meancost = totcost / totnumparts;
+            for (auto i=0;i<opt.numcells;i++) {
+                cellweight[i] *= (cellnumparts[i] > 0 && cellcost[i] > 0) ? cellcost[i] / cellnumparts[i] : meancost;
+            }
+            LOG_RANK0(info) << "Weighting mesh cells by costs measured in " << opt.mpimeshcostfile;
+            return cellweight;
+        }
+    }
+    double nmean = 0;
+    for (auto &x:cellweight) nmean += x;
+    nmean /= (double)opt.numcells;
+    for (auto &x:cellweight) if (x > nmean) x *= 1.0 + log(x / nmean);
+    return cellweight;
+}
+
 //find min/max, average and std
-inline double MPILoadBalanceWithMesh(Options &opt) {
+inline double MPILoadBalanceWithMesh(Options &opt, const vector<double> &cellweight) {
     //calculate imbalance based on min and max in mpi domains
-    vector<Int_t> mpinumparts(NProcs, 0);
+    vector<double> mpiload(NProcs, 0);
     for (auto i=0;i<opt.numcells;i++)
     {
         auto itask = opt.cellnodeids[i];
-        mpinumparts[itask] += opt.cellnodenumparts[i];
+        mpiload[itask] += cellweight[i];
     }
     double minval, maxval, ave, std, sum;
-    minval = maxval = mpinumparts[0];
+    minval = maxval = mpiload[0];
     ave = std = sum = 0;
-    for (auto &x:mpinumparts) {
+    for (auto &x:mpiload) {
         if (minval > x) minval = x;
         if (maxval < x) maxval = x;
         ave += x;
@@ -291,14 +392,17 @@ bool MPIRepartitionDomainDecompositionWithMesh(Options &opt){
     MPI_Allreduce(opt.cellnodenumparts.data(), buff, opt.numcells, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
     for (auto i=0;i<opt.numcells;i++) opt.cellnodenumparts[i]=buff[i];
     delete[] buff;
-    double optimalave = 0; for (auto i=0;i<opt.numcells;i++) optimalave += opt.cellnodenumparts[i];
+    //cells are split between tasks by their load, which is their number of particles unless costs are used
+    vector<double> cellweight = MPIMeshCellWeights(opt);
+    double optimalave = 0; for (auto i=0;i<opt.numcells;i++) optimalave += cellweight[i];
     optimalave /= (double)NProcs;
-    auto loadimbalance = MPILoadBalanceWithMesh(opt);
+    auto loadimbalance = MPILoadBalanceWithMesh(opt, cellweight);
     LOG_RANK0(info) << "MPI imbalance of " << loadimbalance;
     if (loadimbalance > opt.mpimeshimbalancelimit) {
         LOG_RANK0(info) << "Imbalance too large, adjusting MPI domains ...";
         int itask = 0;
         Int_t numparts = 0 ;
+        double load = 0;
         vector<int> numcellspertask(NProcs,0);
         vector<int> mpinumparts(NProcs,0);
         for (auto i=0;i<opt.numcells;i++)
@@ -307,7 +411,9 @@ bool MPIRepartitionDomainDecompositionWithMesh(Options &opt){
             numcellspertask[itask]++;
             opt.cellnodeids[index] = itask;
             numparts += opt.cellnodenumparts[index];
-            if (numparts > optimalave && itask < NProcs-1) {
+            //cut against the cumulative load so that the overshoot of one task is not carried into the next
+            load += cellweight[index];
+            if (load > optimalave*(itask+1) && itask < NProcs-1) {
                 mpinumparts[itask] = numparts;
                 itask++;
                 numparts = 0;
@@ -329,7 +435,7 @@ bool MPIRepartitionDomainDecompositionWithMesh(Options &opt){
                 LOG(error) << "Increase mesh resolution or reduce MPI Processes ";
                 MPI_Abort(MPI_COMM_WORLD,8);
             }
-            LOG(info) << "Now have MPI imbalance of " << MPILoadBalanceWithMesh(opt);
+            LOG(info) << "Now have MPI imbalance of " << MPILoadBalanceWithMesh(opt, cellweight);
             LOG(info) << "MPI tasks:";
             for (auto i=0; i<NProcs; i++) {
                 LOG(info) << " Task " << i << " has " << numcellspertask[i] / double(opt.numcells) << " of the volume";
@@ -344,6 +450,44 @@ bool MPIRepartitionDomainDecompositionWithMesh(Options &opt){
     return false;
 }
 
+///number of particles and expected work of each mesh cell from the local particles, between which the time of the
+///substructure search is later shared out. A particle in a group of n particles does work 1+ln(1+n), the log reflecting
+///the tree searches and unbinding passes whose cost per particle grows with the size of the group
+void MPIGetMeshCellWork(Options &opt, const Int_t nbodies, Particle *Part, Int_t *pfof, Int_t ngroup,
+    vector<double> &cellnumparts, vector<double> &cellwork)
+{
+    cellnumparts.assign(opt.numcells, 0);
+    cellwork.assign(opt.numcells, 0);
+    Int_t *numingroup = BuildNumInGroup(nbodies, ngroup, pfof);
+    for (Int_t i=0;i<nbodies;i++) {
+        auto index = MPIGetClampedMeshCellIndex(opt, Part[i].GetPosition(0), Part[i].GetPosition(1), Part[i].GetPosition(2));
+        cellnumparts[index] += 1;
+        cellwork[index] += 1.0 + ((pfof[i] > 0) ? log(1.0 + numingroup[pfof[i]]) : 0);
+    }
+    delete[] numingroup;
+}
+
+///shares the time this task took out between its mesh cells in proportion to their work, sums the costs of all tasks
+///and writes them to \ref Options.mpimeshcostfile for the decomposition of the next run
+void MPIWriteMeshCellCosts(Options &opt, vector<double> &cellnumparts, vector<double> &cellwork, double time)
+{
+    double totwork = 0;
+    for (auto &x:cellwork) totwork += x;
+    if (totwork > 0) for (auto &x:cellwork) x *= time / totwork;
+    MPI_Allreduce(MPI_IN_PLACE, cellnumparts.data(), opt.numcells, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, cellwork.data(), opt.numcells, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (ThisTask != 0) return;
+    ofstream Fout(opt.mpimeshcostfile);
+    if (!Fout) {
+        LOG(warning) << "Could not write MPI mesh cost file " << opt.mpimeshcostfile;
+        return;
+    }
+    Fout << opt.numcellsperdim << endl;
+    Fout << setprecision(10);
+    for (auto i=0;i<opt.numcells;i++) Fout << cellnumparts[i] << " " << cellwork[i] << "\n";
+    LOG(info) << "Measured costs of mesh cells written to " << opt.mpimeshcostfile;
+}
+
 void MPINumInDomain(Options &opt)
 {
     //when reading number in domain, use all available threads to read all available files
@@ -439,16 +583,27 @@ void MPIAdjustDomainWithMesh(Options &opt)
 
 
 
+///index of the mesh cell containing a position
+unsigned long long MPIGetMeshCellIndex(Options &opt, Double_t x, Double_t y, Double_t z){
+    unsigned int ix, iy, iz;
+    ix=floor(x*opt.icellwidth[0]);
+    iy=floor(y*opt.icellwidth[1]);
+    iz=floor(z*opt.icellwidth[2]);
+    return ix*opt.numcellsperdim*opt.numcellsperdim+iy*opt.numcellsperdim+iz;
+}
+
+unsigned long long MPIGetClampedMeshCellIndex(Options &opt, Double_t x, Double_t y, Double_t z){
+    Double_t pos[3]={x,y,z};
+    unsigned long long ix[3];
+    for (auto j=0;j<3;j++) ix[j] = min(max((int)floor(pos[j]*opt.icellwidth[j]), 0), opt.numcellsperdim-1);
+    return (ix[0]*opt.numcellsperdim+ix[1])*opt.numcellsperdim+ix[2];
+}
+
 ///given a position and a mpi thread domain information, determine which processor a particle is assigned to
 int MPIGetParticlesProcessor(Options &opt, Double_t x, Double_t y, Double_t z){
     if (NProcs==1) return 0;
     if (opt.impiusemesh) {
-        unsigned int ix, iy, iz;
-        unsigned long long index;
-        ix=floor(x*opt.icellwidth[0]);
-        iy=floor(y*opt.icellwidth[1]);
-        iz=floor(z*opt.icellwidth[2]);
-        index = ix*opt.numcellsperdim*opt.numcellsperdim+iy*opt.numcellsperdim+iz;
+        unsigned long long index = MPIGetMeshCellIndex(opt, x, y, z);
         opt.cellnodenumparts[index]++;
         if (index >= 0 && index < opt.numcells) return opt.cellnodeids[index];
     }
@@ -466,6 +621,57 @@ int MPIGetParticlesProcessor(Options &opt, Double_t x, Double_t y, Double_t z){
 }
 
 
+///as \ref MPIGetParticlesProcessor for a chunk of n positions stored as x,y,z triplets, with the lookups spread over OpenMP threads
+template<typename T> static void MPIGetParticlesProcessorChunk(Options &opt, Int_t n, const T *pos, int *ibuf)
+{
+    if (NProcs==1) {
+        for (Int_t i=0;i<n;i++) ibuf[i]=0;
+        return;
+    }
+    Int_t noutside = 0;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) reduction(+:noutside) if (n>ompsearchnum)
+#endif
+    for (Int_t i=0;i<n;i++) {
+        Double_t x=pos[3*i], y=pos[3*i+1], z=pos[3*i+2];
+        ibuf[i]=-1;
+        if (opt.impiusemesh) {
+            unsigned long long index = MPIGetMeshCellIndex(opt, x, y, z);
+            if (index < opt.numcells) ibuf[i]=opt.cellnodeids[index];
+        }
+        else {
+            for (int j=0;j<NProcs;j++){
+                if( (mpi_domain[j].bnd[0][0]<=x) && (mpi_domain[j].bnd[0][1]>=x)&&
+                    (mpi_domain[j].bnd[1][0]<=y) && (mpi_domain[j].bnd[1][1]>=y)&&
+                    (mpi_domain[j].bnd[2][0]<=z) && (mpi_domain[j].bnd[2][1]>=z) ) {
+                    ibuf[i]=j;
+                    break;
+                }
+            }
+        }
+        noutside += (ibuf[i]<0);
+    }
+    if (noutside>0) {
+        for (Int_t i=0;i<n;i++) if (ibuf[i]<0) {
+            LOG(error) << "Particle outside the mpi domains of every process (" << pos[3*i] << "," << pos[3*i+1] << "," << pos[3*i+2] << ")";
+            break;
+        }
+        MPI_Abort(MPI_COMM_WORLD,9);
+    }
+    //the mesh cell counts are shared so are updated serially
+    if (opt.impiusemesh) for (Int_t i=0;i<n;i++) opt.cellnodenumparts[MPIGetMeshCellIndex(opt, pos[3*i], pos[3*i+1], pos[3*i+2])]++;
+}
+
+void MPIGetParticlesProcessor(Options &opt, Int_t n, const float *pos, int *ibuf)
+{
+    MPIGetParticlesProcessorChunk(opt, n, pos, ibuf);
+}
+
+void MPIGetParticlesProcessor(Options &opt, Int_t n, const double *pos, int *ibuf)
+{
+    MPIGetParticlesProcessorChunk(opt, n, pos, ibuf);
+}
+
 void MPIStripExportParticleOfExtraInfo(Options &opt, Int_t n, Particle *Part)
 {
 #if defined(GASON) || defined(STARON) || defined(BHON) || defined(EXTRADMON)
@@ -1353,12 +1559,7 @@ void MPIAddParticletoAppropriateBuffer(Options &opt, const int &ibuf, Int_t ibuf
     }
     else {
         if(Nbuf[ibuf]==BufSize&&ireadtask[ibuf]<0) {
-            MPI_Send(&Nbuf[ibuf], 1, MPI_Int_t, ibuf, ibuf+NProcs, MPI_COMM_WORLD);
-            MPI_Send(&Pbuf[ibuf*BufSize],sizeof(Particle)*Nbuf[ibuf],MPI_BYTE,ibuf,ibuf,MPI_COMM_WORLD);
-            MPISendHydroInfoFromReadThreads(opt, Nbuf[ibuf], &Pbuf[ibuf*BufSize], ibuf);
-            MPISendStarInfoFromReadThreads(opt, Nbuf[ibuf], &Pbuf[ibuf*BufSize], ibuf);
-            MPISendBHInfoFromReadThreads(opt, Nbuf[ibuf], &Pbuf[ibuf*BufSize], ibuf);
-            MPISendExtraDMInfoFromReadThreads(opt, Nbuf[ibuf], &Pbuf[ibuf*BufSize], ibuf);
+            MPIISendParticlesFromReadThreads(opt, Nbuf[ibuf], &Pbuf[ibuf*BufSize], ibuf);
             Nbuf[ibuf]=0;
         }
         else if (ireadtask[ibuf]>=0) {
@@ -1372,6 +1573,44 @@ void MPIAddParticletoAppropriateBuffer(Options &opt, const int &ibuf, Int_t ibuf
     }
 }
 
+
+///particle buffers sent by this read task that may still be in flight, oldest first
+static deque<MPIParticleSend> mpi_particle_sends;
+
+/*! Sends a full particle buffer to a non-read task without waiting for it to be received, so that the read task can carry on
+    reading and decoding. The buffer is copied and can be refilled straight away. At most \ref Options.mpireadsendsinflight
+    buffers are outstanding, beyond which the oldest send is completed and its copy reused. Messages use the same tags and order
+    as the blocking sends, so \ref MPIReceiveParticlesFromReadThreads is unchanged.
+*/
+void MPIISendParticlesFromReadThreads(Options &opt, Int_t nlocalbuff, Particle *Pbuf, int taskID)
+{
+    MPIParticleSend send;
+    if (mpi_particle_sends.size() >= (size_t)opt.mpireadsendsinflight) {
+        MPI_Waitall(2, mpi_particle_sends.front().request, MPI_STATUSES_IGNORE);
+        send = std::move(mpi_particle_sends.front());
+        mpi_particle_sends.pop_front();
+    }
+    //elements of a deque do not move when adding at the end, so the count and data stay valid while in flight
+    mpi_particle_sends.push_back(std::move(send));
+    auto &s = mpi_particle_sends.back();
+    s.Part.assign(Pbuf, Pbuf+nlocalbuff);
+    s.numpart = nlocalbuff;
+    MPI_Isend(&s.numpart, 1, MPI_Int_t, taskID, taskID+NProcs, MPI_COMM_WORLD, &s.request[0]);
+    MPI_Isend(s.Part.data(), sizeof(Particle)*nlocalbuff, MPI_BYTE, taskID, taskID, MPI_COMM_WORLD, &s.request[1]);
+    //extra properties are few and follow the particles with blocking sends, as the receiver expects them next
+    MPISendHydroInfoFromReadThreads(opt, nlocalbuff, s.Part.data(), taskID);
+    MPISendStarInfoFromReadThreads(opt, nlocalbuff, s.Part.data(), taskID);
+    MPISendBHInfoFromReadThreads(opt, nlocalbuff, s.Part.data(), taskID);
+    MPISendExtraDMInfoFromReadThreads(opt, nlocalbuff, s.Part.data(), taskID);
+}
+
+///waits for all particle buffers sent with \ref MPIISendParticlesFromReadThreads and releases them
+void MPICompleteParticleSendsFromReadThreads()
+{
+    for (auto &s:mpi_particle_sends) MPI_Waitall(2, s.request, MPI_STATUSES_IGNORE);
+    deque<MPIParticleSend>().swap(mpi_particle_sends);
+}
+
 //@}
 
 /// \name routines which check to see if some search region overlaps with local mpi domain
@@ -1645,13 +1884,8 @@ int MPISearchForOverlapUsingMesh(Options &opt, Double_t xsearch[3][2]){
 void MPIDistributeReadTasks(Options&opt, int *&ireadtask, int*&readtaskID){
     //initialize
     if (opt.nsnapread>NProcs) opt.nsnapread=NProcs;
-#ifndef USEPARALLELHDF
-    //if not using parallel hdf5, allow only one task per file
-    if (opt.num_files<opt.nsnapread) opt.nsnapread=opt.num_files;
-#else
-    //if parallel hdf5 but not reading hdf then again, max one task per file
+    //hdf input is read in planned hyperslabs so several tasks can share a file, otherwise allow only one task per file
     if (opt.inputtype!=IOHDF) if (opt.num_files<opt.nsnapread) opt.nsnapread=opt.num_files;
-#endif
     for (int i=0;i<NProcs;i++) ireadtask[i]=-1;
     int spacing=max(1,(int)floor(NProcs/opt.nsnapread));
     for (int i=0;i<opt.nsnapread;i++) {ireadtask[i*spacing]=i;readtaskID[i]=i*spacing;}
@@ -1686,6 +1920,132 @@ int MPISetFilesRead(Options&opt, std::vector<int> &ireadfile, int *&ireadtask){
     return niread;
 }
 
+/*! Plans which particles each read task loads so that all read tasks read about the same amount of data, rather than the same number of files.
+    \param npartfile number of particles of each type in each file, stored as [ifile*ntypes+itype]
+    \param typecost relative cost of reading a single particle of each type, for instance the number of values loaded per particle
+    \param isplitfiles whether files can be read in hyperslabs by several read tasks
+
+    The cumulative cost of all files and types is split into opt.nsnapread equal intervals, one per read task.
+    If files can be split, interval boundaries fall within files so that several read tasks share a large file and
+    one read task can take many small files. Otherwise boundaries are moved to the nearest file boundary,
+    keeping at least one file per read task, and the ranges of a task cover all types of its files.
+    All read tasks compute the same plan and this returns the ranges of this task.
+*/
+std::vector<MPIReadRange> MPIPlanFileReads(Options &opt, int *ireadtask, const std::vector<unsigned long long> &npartfile, const std::vector<double> &typecost, bool isplitfiles)
+{
+    std::vector<MPIReadRange> readranges;
+    int itask = ireadtask[ThisTask], nread = opt.nsnapread, ntypes = typecost.size();
+    if (itask < 0) return readranges;
+    std::vector<double> filecost(opt.num_files, 0);
+    double totcost = 0;
+    for (int i=0;i<opt.num_files;i++) {
+        for (int k=0;k<ntypes;k++) filecost[i] += npartfile[i*ntypes+k]*typecost[k];
+        totcost += filecost[i];
+    }
+
+    double maxcost = totcost/nread;
+    if (isplitfiles) {
+        //the boundary between read tasks r-1 and r is at cumulative cost totcost*r/nread, evaluated identically by both tasks
+        double lo = totcost*itask/nread, hi = totcost*(itask+1)/nread, segstart = 0;
+        for (int i=0;i<opt.num_files;i++) {
+            for (int k=0;k<ntypes;k++) {
+                unsigned long long npart = npartfile[i*ntypes+k];
+                if (npart == 0 || typecost[k] <= 0) continue;
+                auto index = [&](double x) -> unsigned long long {
+                    double n = (x - segstart)/typecost[k];
+                    if (n <= 0) return 0;
+                    if (n >= npart) return npart;
+                    return llround(n);
+                };
+                unsigned long long nstart = (itask == 0) ? 0 : index(lo);
+                unsigned long long nend = (itask == nread-1) ? npart : index(hi);
+                if (nend > nstart) readranges.push_back({i, k, nstart, nend});
+                segstart += npart*typecost[k];
+            }
+        }
+    }
+    else {
+        std::vector<int> firstfile(nread+1);
+        firstfile[0] = 0;
+        firstfile[nread] = opt.num_files;
+        double cumcost = 0;
+        int ifile = 0;
+        for (int r=1;r<nread;r++) {
+            double target = totcost*r/nread;
+            while (ifile < opt.num_files && cumcost + filecost[ifile] <= target) cumcost += filecost[ifile++];
+            int iboundary = ifile;
+            if (ifile < opt.num_files && target - cumcost > cumcost + filecost[ifile] - target) iboundary++;
+            iboundary = max(iboundary, firstfile[r-1]+1);
+            iboundary = min(iboundary, opt.num_files-(nread-r));
+            firstfile[r] = iboundary;
+        }
+        maxcost = 0;
+        for (int r=0;r<nread;r++) {
+            double cost = 0;
+            for (int i=firstfile[r];i<firstfile[r+1];i++) cost += filecost[i];
+            maxcost = max(maxcost, cost);
+        }
+        for (int i=firstfile[itask];i<firstfile[itask+1];i++)
+            for (int k=0;k<ntypes;k++) readranges.push_back({i, k, 0, npartfile[i*ntypes+k]});
+    }
+    if (itask == 0) {
+        LOG(info) << "Planned reads of " << opt.num_files << " files by " << nread << " read tasks"
+                  << (isplitfiles ? ", splitting files" : ", whole files only")
+                  << ", largest share of the data is " << maxcost/max(totcost/nread, 1e-30) << " times the mean";
+    }
+    LOG(debug) << "Read task " << itask << " reads " << readranges.size() << " ranges with cost "
+               << MPIReadRangesCost(readranges, typecost) << " of a total " << totcost;
+    return readranges;
+}
+
+int MPISetFilesRead(Options&opt, std::vector<int> &ireadfile, const std::vector<MPIReadRange> &readranges)
+{
+    for (auto &x:ireadfile) x=0;
+    for (auto &r:readranges) ireadfile[r.ifile]=1;
+    //a read task with nothing to read still opens the first file for its header
+    if (readranges.size()==0) {
+        ireadfile[0]=1;
+        return 0;
+    }
+    return readranges[0].ifile;
+}
+
+double MPIReadRangesCost(const std::vector<MPIReadRange> &readranges, const std::vector<double> &typecost)
+{
+    double cost = 0;
+    for (auto &r:readranges) cost += (r.nend-r.nstart)*typecost[r.itype];
+    return cost;
+}
+
+/*! Compares the time taken by each read task with the time expected from the cost of the data it read.
+    The expected time of a task is its cost divided by the mean read rate over all read tasks.
+*/
+void MPIReportReadBalance(MPI_Comm comm, double cost, double readtime)
+{
+    int ThisReadTask, NReadTasks;
+    MPI_Comm_rank(comm, &ThisReadTask);
+    MPI_Comm_size(comm, &NReadTasks);
+    double local[2] = {cost, readtime};
+    std::vector<double> all(2*NReadTasks);
+    MPI_Gather(local, 2, MPI_DOUBLE, all.data(), 2, MPI_DOUBLE, 0, comm);
+    if (ThisReadTask != 0) return;
+    double totcost = 0, tottime = 0, maxexpected = 0, maxtime = 0, mintime = all[1];
+    for (int i=0;i<NReadTasks;i++) {
+        totcost += all[2*i];
+        tottime += all[2*i+1];
+        mintime = min(mintime, all[2*i+1]);
+        maxtime = max(maxtime, all[2*i+1]);
+    }
+    double secondspercost = (totcost > 0) ? tottime/totcost : 0;
+    for (int i=0;i<NReadTasks;i++) {
+        double expected = all[2*i]*secondspercost;
+        maxexpected = max(maxexpected, expected);
+        LOG(debug) << "Read task " << i << " expected read time " << expected << " s, actual " << all[2*i+1] << " s";
+    }
+    LOG(info) << "Read times of " << NReadTasks << " read tasks: expected max " << maxexpected << " s, actual min "
+              << mintime << " s, mean " << tottime/NReadTasks << " s, max " << maxtime << " s";
+}
+
 
 //@}
 
@@ -2137,7 +2497,7 @@ void MPIReceiveParticlesFromReadThreads(Options &opt, Particle *&Pbuf, Particle
             }
         }
         //sorted so that dark matter particles first, baryons after
-        qsort(Part,Nlocal, sizeof(Particle), IDCompare);
+        SortParticles(Nlocal, Part, PSORTID);
         //sort(Part.begin(),Part.end(), IDCompareVec);
         Nlocal-=Nlocalbaryon[0];
         //index type separated
@@ -3064,6 +3424,75 @@ void MPISendParticlesBetweenReadThreads(Options &opt, vector<Particle> *&Preadbu
     }
 }
 
+/*! Redistributes the particles after a single pass load, in which every task is a read task and keeps what it has read.
+    On entry Part holds the \a nlocalread particles that are searched followed by \a nbaryonread baryons when a
+    separate baryon search is run, and \ref Options.cellnodenumparts holds the number of particles read into each mesh cell.
+    The mesh is repartitioned with these counts and every particle is sent to the task owning its cell.
+    On return Part holds exactly the local particles with Pbaryons pointing past the local dark matter.
+*/
+void MPIExchangeSinglePassLoad(Options &opt, vector<Particle> &Part, Particle *&Pbaryons, Int_t nlocalread, Int_t nbaryonread, int *&ireadtask, int *&readtaskID, MPI_Comm &mpi_comm_read)
+{
+    vr::Timer timer;
+    bool ibaryon = (opt.iBaryonSearch && opt.partsearchtype!=PSTALL);
+    MPIRepartitionDomainDecompositionWithMesh(opt);
+
+    //split the particles into those kept and send buffers per task, dark matter before baryons as expected by the exchange
+    vector<Particle> *Psendbuf = new vector<Particle>[NProcs];
+    vector<Particle> baryonskept;
+    vector<Int_t> nsendlocal(NProcs,0), nsendlocalbaryon(NProcs,0);
+    Int_t *mpi_nsend = new Int_t[NProcs*NProcs];
+    Int_t *mpi_nsend_baryon = new Int_t[NProcs*NProcs];
+    Int_t nkept = 0, nsendtotal = 0;
+    for (Int_t i=0;i<nlocalread+nbaryonread;i++) {
+        //particles read on the upper edge of the box or just outside it are placed in the edge cells
+        auto index = MPIGetClampedMeshCellIndex(opt, Part[i].GetPosition(0), Part[i].GetPosition(1), Part[i].GetPosition(2));
+        int itask = opt.cellnodeids[index];
+        if (itask == ThisTask) {
+            if (i >= nlocalread) baryonskept.push_back(std::move(Part[i]));
+            else {
+                if (i != nkept) Part[nkept] = std::move(Part[i]);
+                nkept++;
+            }
+            continue;
+        }
+        Psendbuf[itask].push_back(std::move(Part[i]));
+        if (i >= nlocalread) nsendlocalbaryon[itask]++;
+        else nsendlocal[itask]++;
+        nsendtotal++;
+    }
+    //only the counts to and from this task are needed, so they are exchanged sparsely between the tasks that send
+    //every task reads in a single pass load, so ranks in mpi_comm_read are those in MPI_COMM_WORLD
+    MPIGatherSendCounts(nsendlocal.data(), mpi_nsend, mpi_comm_read);
+    MPIGatherSendCounts(nsendlocalbaryon.data(), mpi_nsend_baryon, mpi_comm_read);
+
+    //size the local particle array from what will be received, dropping the particles that have been moved out
+    Int_t nlocalnew = nkept, nbaryonnew = baryonskept.size();
+    for (int j=0;j<NProcs;j++) if (j != ThisTask) {
+        nlocalnew += mpi_nsend[j*NProcs+ThisTask];
+        nbaryonnew += mpi_nsend_baryon[j*NProcs+ThisTask];
+    }
+    Part.resize(nkept);
+    Part.resize(nlocalnew+nbaryonnew);
+    Nlocal = nkept;
+    Nlocalbaryon[0] = 0;
+    if (ibaryon) {
+        Pbaryons = &(Part.data()[nlocalnew]);
+        for (auto &p:baryonskept) Pbaryons[Nlocalbaryon[0]++] = std::move(p);
+    }
+    else Pbaryons = NULL;
+    vector<Particle>().swap(baryonskept);
+
+    MPISendParticlesBetweenReadThreads(opt, Psendbuf, Part.data(), ireadtask, readtaskID, Pbaryons, mpi_comm_read, mpi_nsend, mpi_nsend_baryon);
+    Nmemlocal = Nlocal;
+    Nmemlocalbaryon = Nlocalbaryon[0];
+    LOG(info) << "Exchanged " << nsendtotal << " of " << nlocalread+nbaryonread << " particles read in a single pass, now have "
+              << Nlocal << " particles" << (ibaryon ? " and " + std::to_string(Nlocalbaryon[0]) + " baryons" : "") << " in " << timer;
+
+    delete[] Psendbuf;
+    delete[] mpi_nsend;
+    delete[] mpi_nsend_baryon;
+}
+
 void MPIGetExportNum(const Int_t nbodies, Particle *Part, Double_t rdist){
     Int_t i, j,nthreads,nexport=0,nimport=0;
     Int_t nsend_local[NProcs],noffset[NProcs],nbuffer[NProcs];
@@ -3091,7 +3520,7 @@ void MPIGetExportNum(const Int_t nbodies, Particle *Part, Double_t rdist){
         }
     }
     NExport=nexport;//*(1.0+MPIExportFac);
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
 }
@@ -3138,7 +3567,7 @@ void MPIGetExportNumUsingMesh(Options &opt, const Int_t nbodies, Particle *Part,
         }
     }
     NExport=nexport;//*(1.0+MPIExportFac);
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
 }
@@ -3206,7 +3635,7 @@ void MPIBuildParticleExportList(Options &opt, const Int_t nbodies, Particle *Par
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     //now send the data.
     for (j=0;j<NProcs;j++)nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -3328,7 +3757,7 @@ void MPIBuildParticleExportListUsingMesh(Options &opt, const Int_t nbodies, Part
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     //now send the data.
     for (j=0;j<NProcs;j++)nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -3506,7 +3935,7 @@ void MPIGetNNExportNum(const Int_t nbodies, Particle *Part, Double_t *rdist){
         }
     }
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     NExport=nexport;
@@ -3548,7 +3977,7 @@ void MPIGetNNExportNumUsingMesh(Options &opt, const Int_t nbodies, Particle *Par
         }
     }
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     NExport=nexport;
@@ -3612,7 +4041,7 @@ void MPIBuildParticleNNExportList(const Int_t nbodies, Particle *Part, Double_t
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     //now send the data.
     ///\todo In determination of particle export, eventually need to place a check for the communication buffer so that if exported number
     ///is larger than the size of the buffer, iterate over the number exported
@@ -3721,7 +4150,7 @@ void MPIBuildParticleNNExportListUsingMesh(Options &opt, const Int_t nbodies, Pa
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     //now send the data.
     ///\todo In determination of particle export, eventually need to place a check for the communication buffer so that if exported number
     ///is larger than the size of the buffer, iterate over the number exported
@@ -3800,7 +4229,7 @@ void MPIGetNNImportNum(const Int_t nbodies, KDTree *tree, Particle *Part, int ia
     delete[] iflagged;
     //must store old mpi nsend for accessing NNDataGet properly.
     for (j=0;j<NProcs;j++) for (int k=0;k<NProcs;k++) oldnsend[k+j*NProcs]=mpi_nsend[k+j*NProcs];
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     NExport=nexport;
@@ -3882,7 +4311,7 @@ Int_t MPIBuildParticleNNImportList(Options &opt, const Int_t nbodies, KDTree *tr
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     //now send the data.
     for(j=0;j<NProcs;j++)
     {
@@ -3985,7 +4414,7 @@ vector<bool> MPIGetHaloSearchExportNum(const Int_t ngroup, PropData *&pdata, vec
         }
     }
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     NExport=nexport;
@@ -4028,7 +4457,7 @@ vector<bool> MPIGetHaloSearchExportNumUsingMesh(Options &opt, const Int_t ngroup
     }
 
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (auto j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     NExport=nexport;
@@ -4085,7 +4514,7 @@ void MPIBuildHaloSearchExportList(const Int_t ngroup, PropData *&pdata, vector<D
     //then store the offset in the export data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of items to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     //now send the data.
 
     for (j=0;j<NProcs;j++)nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -4187,7 +4616,7 @@ void MPIBuildHaloSearchExportListUsingMesh(Options &opt, const Int_t ngroup, Pro
     //then store the offset in the export data for the jth Task in order to send data.
     noffset[0] = 0; for(auto j = 1; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of items to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     //now send the data.
 
     for (auto j=0;j<NProcs;j++)nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -4281,7 +4710,7 @@ void MPIGetHaloSearchImportNum(const Int_t nbodies, KDTree *tree, Particle *Part
     }
     //must store old mpi nsend for accessing NNDataGet properly.
     for (j=0;j<NProcs;j++) for (int k=0;k<NProcs;k++) oldnsend[k+j*NProcs]=mpi_nsend[k+j*NProcs];
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;
     for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     NExport=nexport;
@@ -4344,7 +4773,7 @@ Int_t MPIBuildHaloSearchImportList(Options &opt, const Int_t nbodies, KDTree *tr
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     //now send the data.
     for(j=0;j<NProcs;j++)
     {
@@ -4449,7 +4878,7 @@ void MPIBuildParticleExportBaryonSearchList(Options &opt, const Int_t nbodies, P
     //then store the offset in the export particle data for the jth Task in order to send data.
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
     //and then gather the number of particles to be sent from mpi thread m to mpi thread n in the mpi_nsend[NProcs*NProcs] array via [n+m*NProcs]
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     NImport=0;for (j=0;j<NProcs;j++)NImport+=mpi_nsend[ThisTask+j*NProcs];
     //now send the data.
     ///\todo In determination of particle export for FOF routines, eventually need to place a check for the communication buffer so that if exported number
@@ -4515,6 +4944,60 @@ void MPIBuildParticleExportBaryonSearchList(Options &opt, const Int_t nbodies, P
 
 //@}
 
+/// \name Sparse communication routines
+//@{
+/*!
+    Determines the number of items this task receives from every other task given the number it sends to each, filling
+    the row (sends, nsend[j+ThisTask*NProcs]) and column (receives, nsend[ThisTask+j*NProcs]) of the NProcs x NProcs
+    count matrix belonging to this task. This replaces gathering the full matrix with MPI_Allgather, as the export and import
+    routines only use the row and column of their own task. Other entries are left unchanged.
+
+    Receivers are discovered with a non-blocking consensus: counts are sent with synchronous sends only to tasks that receive
+    something, incoming counts are probed for until all local sends have been matched, and a non-blocking barrier then
+    signals that every task is done. Messages and latency therefore scale with the number of neighbours rather than NProcs.
+    Consecutive calls alternate between two message tags so a task that finishes early cannot interfere with the previous call.
+*/
+void MPIGatherSendCounts(const Int_t *nsend_local, Int_t *nsend, MPI_Comm comm)
+{
+    static int ncalls=0;
+    int rank, size, tag=(ncalls++%2==0)?TAG_SPARSE_A:TAG_SPARSE_B;
+    int flag, sent=0, done=0;
+    bool barrieractive=false;
+    Int_t count;
+    MPI_Status status;
+    MPI_Request barrier;
+    vector<MPI_Request> requests;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    for (auto j=0;j<size;j++) {
+        nsend[j+rank*size]=nsend_local[j];
+        if (j!=rank) nsend[rank+j*size]=0;
+        if (j==rank || nsend_local[j]==0) continue;
+        requests.emplace_back();
+        MPI_Issend(&nsend_local[j], 1, MPI_Int_t, j, tag, comm, &requests.back());
+    }
+    while (true) {
+        if (barrieractive) {
+            MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+            if (done) break;
+        }
+        MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &flag, &status);
+        if (flag) {
+            MPI_Recv(&count, 1, MPI_Int_t, status.MPI_SOURCE, tag, comm, MPI_STATUS_IGNORE);
+            nsend[rank+status.MPI_SOURCE*size]=count;
+        }
+        if (!barrieractive) {
+            MPI_Testall(requests.size(), requests.data(), &sent, MPI_STATUSES_IGNORE);
+            if (sent) {
+                MPI_Ibarrier(comm, &barrier);
+                barrieractive=true;
+            }
+        }
+    }
+}
+//@}
+
 /// \name FOF related mpi routines
 //@{
 ///Set fof task id of particle
@@ -4787,6 +5270,379 @@ Int_t MPILinkAcross(const Int_t nbodies, KDTree *&tree, Particle *Part, Int_t *&
     delete[] nn;
     return links;
 }
+/// \name Linking across mpi domains using a distributed union-find
+//@{
+
+///union-find over group labels, where the smallest label of a linked set is its root
+struct LabelUnionFind {
+    unordered_map<Int_t, Int_t> parent;
+    unordered_map<Int_t, short_mpi_t> task;
+
+    void Add(Int_t label, short_mpi_t labeltask) {
+        if (parent.find(label)!=parent.end()) return;
+        parent[label]=label;
+        task[label]=labeltask;
+    }
+    Int_t Find(Int_t label) {
+        Int_t root=label, next;
+        while (parent[root]!=root) root=parent[root];
+        //compress path
+        while (parent[label]!=root) {next=parent[label];parent[label]=root;label=next;}
+        return root;
+    }
+    void Union(Int_t a, Int_t b) {
+        a=Find(a);
+        b=Find(b);
+        if (a==b) return;
+        if (a<b) parent[b]=a;
+        else parent[a]=b;
+    }
+    void Add(const foflink_data &link) {
+        Add(link.Label, link.LabelTask);
+        Add(link.Root, link.RootTask);
+        Union(link.Label, link.Root);
+    }
+    ///returns every label with the root of its set
+    vector<foflink_data> Flatten() {
+        vector<foflink_data> links;
+        links.reserve(parent.size());
+        for (auto &p:parent) {
+            foflink_data link;
+            link.Label=p.first;
+            link.LabelTask=task[p.first];
+            link.Root=Find(p.first);
+            link.RootTask=task[link.Root];
+            links.push_back(link);
+        }
+        return links;
+    }
+};
+
+///task owning the global state of a label, given by a hash of the label so that the labels of every task are spread over all tasks
+inline int LabelOwner(Int_t label)
+{
+    return (int)((((unsigned long long)label*11400714819323198485ull)>>32)%(unsigned long long)NProcs);
+}
+
+/*! Sends sendlinks[j] to task j and returns the links received from all tasks, including those this task sends to itself.
+    Only tasks exchanging links communicate, with the counts found by \ref MPIGatherSendCounts, and messages are sent in
+    chunks to stay below the mpi message size limit. The send lists are cleared.
+*/
+inline vector<foflink_data> MPIExchangeLinks(vector<vector<foflink_data>> &sendlinks, int tag)
+{
+    Int_t maxchunksize=2147483648/sizeof(foflink_data)-1, chunk, offset, nrecv;
+    vector<Int_t> nsend_local(NProcs);
+    vector<MPI_Request> requests;
+    for (auto j=0;j<NProcs;j++) nsend_local[j]=(j==ThisTask)?0:sendlinks[j].size();
+    MPIGatherSendCounts(nsend_local.data(), mpi_nsend);
+    vector<foflink_data> recvlinks;
+    recvlinks.swap(sendlinks[ThisTask]);
+    nrecv=offset=recvlinks.size();
+    for (auto j=0;j<NProcs;j++) if (j!=ThisTask) nrecv+=mpi_nsend[ThisTask+j*NProcs];
+    recvlinks.resize(nrecv);
+    for (auto j=0;j<NProcs;j++) {
+        if (j==ThisTask) continue;
+        Int_t nlinks=mpi_nsend[ThisTask+j*NProcs];
+        for (Int_t k=0;k<nlinks;k+=chunk) {
+            chunk=min(maxchunksize,nlinks-k);
+            requests.emplace_back();
+            MPI_Irecv(&recvlinks[offset+k], chunk*sizeof(foflink_data), MPI_BYTE, j, tag, MPI_COMM_WORLD, &requests.back());
+        }
+        offset+=nlinks;
+    }
+    for (auto j=0;j<NProcs;j++) {
+        if (j==ThisTask) continue;
+        Int_t nlinks=sendlinks[j].size();
+        for (Int_t k=0;k<nlinks;k+=chunk) {
+            chunk=min(maxchunksize,nlinks-k);
+            requests.emplace_back();
+            MPI_Isend(&sendlinks[j][k], chunk*sizeof(foflink_data), MPI_BYTE, j, tag, MPI_COMM_WORLD, &requests.back());
+        }
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    for (auto &links:sendlinks) links.clear();
+    return recvlinks;
+}
+
+/*! Asks the owners of the given labels for their parents, returning the parent of each label (in Root and RootTask).
+    The label of a request is in Label and the task asking in LabelTask. Labels without an owner entry are their own parent.
+*/
+inline unordered_map<Int_t, foflink_data> MPIQueryParents(const unordered_map<Int_t, foflink_data> &parent,
+    vector<vector<foflink_data>> &requests)
+{
+    unordered_map<Int_t, foflink_data> answers;
+    vector<vector<foflink_data>> replies(NProcs);
+    for (auto &request:MPIExchangeLinks(requests, TAG_FOF_LINK_B)) {
+        foflink_data reply;
+        auto it=parent.find(request.Label);
+        if (it!=parent.end()) reply=it->second;
+        else {
+            reply.Label=reply.Root=request.Label;
+            reply.LabelTask=reply.RootTask=ThisTask;
+        }
+        replies[request.LabelTask].push_back(reply);
+    }
+    for (auto &reply:MPIExchangeLinks(replies, TAG_FOF_LINK_B)) answers[reply.Label]=reply;
+    return answers;
+}
+
+///one round of pointer jumping, replacing the parent of every owned label by its grandparent. Returns the number of parents changed on all tasks
+inline Int_t MPIJumpLinks(unordered_map<Int_t, foflink_data> &parent)
+{
+    Int_t nchanged=0, nchangedtotal;
+    vector<vector<foflink_data>> requests(NProcs);
+    unordered_set<Int_t> asked;
+    for (auto &p:parent) {
+        if (p.second.Root==p.first || !asked.insert(p.second.Root).second) continue;
+        foflink_data request;
+        request.Label=request.Root=p.second.Root;
+        request.LabelTask=request.RootTask=ThisTask;
+        requests[LabelOwner(p.second.Root)].push_back(request);
+    }
+    unordered_map<Int_t, foflink_data> grandparent=MPIQueryParents(parent, requests);
+    for (auto &p:parent) {
+        if (p.second.Root==p.first) continue;
+        auto &g=grandparent[p.second.Root];
+        if (g.Root<p.second.Root) {
+            p.second.Root=g.Root;
+            p.second.RootTask=g.RootTask;
+            nchanged++;
+        }
+    }
+    MPI_Allreduce(&nchanged, &nchangedtotal, 1, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
+    return nchangedtotal;
+}
+
+/*! Resolves the links between labels found on each task into global roots, the smallest label of each linked set.
+    Every label is owned by the task given by \ref LabelOwner, which keeps the parent of the label, so each task holds a
+    share of all labels rather than any one task holding them all. Tasks start by sending the local root of each of their
+    labels to the owner of the label, as a claim that the parent of the label is at most that root. An owner receiving a
+    claim smaller than the current parent takes it as the parent and forwards a claim that the old parent is at most the
+    new one; a claim larger than the parent is forwarded as a claim that the claimed label is at most the parent, so that
+    the sets of both are merged. Claims are exchanged in rounds, each followed by one round of pointer jumping, in which
+    parents are replaced by their grandparents to keep the trees shallow. Once no claims are left pointer jumping is
+    repeated until every parent is a root. Returns the root of each label known locally.
+*/
+inline unordered_map<Int_t, foflink_data> MPIResolveLinks(LabelUnionFind &uf)
+{
+    //parent of each owned label, with the task owning the label in LabelTask and that owning the parent in RootTask
+    unordered_map<Int_t, foflink_data> parent;
+    vector<vector<foflink_data>> claims(NProcs);
+    vector<foflink_data> locallinks=uf.Flatten();
+    Int_t nclaims, nclaimstotal;
+    int nrounds=0;
+
+    //process a claim that the parent of claim.Label is at most claim.Root, forwarding the claim needed to merge the sets
+    auto claim=[&parent, &claims](const foflink_data &c) {
+        auto it=parent.find(c.Label);
+        if (it==parent.end()) {
+            parent[c.Label]=c;
+            return;
+        }
+        foflink_data &p=it->second, forward;
+        if (c.Root==p.Root || c.Root==c.Label) return;
+        if (c.Root<p.Root) {
+            forward.Label=p.Root;
+            forward.LabelTask=p.RootTask;
+            forward.Root=c.Root;
+            forward.RootTask=c.RootTask;
+            p.Root=c.Root;
+            p.RootTask=c.RootTask;
+        }
+        else {
+            forward.Label=c.Root;
+            forward.LabelTask=c.RootTask;
+            forward.Root=p.Root;
+            forward.RootTask=p.RootTask;
+        }
+        claims[LabelOwner(forward.Label)].push_back(forward);
+    };
+
+    //every label, including local roots, claims its local root
+    for (auto &link:locallinks) claims[LabelOwner(link.Label)].push_back(link);
+    do {
+        for (auto &c:MPIExchangeLinks(claims, TAG_FOF_LINK_A)) claim(c);
+        MPIJumpLinks(parent);
+        nclaims=0;
+        for (auto &c:claims) nclaims+=c.size();
+        MPI_Allreduce(&nclaims, &nclaimstotal, 1, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
+        nrounds++;
+    } while (nclaimstotal>0);
+    while (MPIJumpLinks(parent)>0) nrounds++;
+    LOG(debug) << "Resolved links of " << parent.size() << " owned labels in " << nrounds << " rounds";
+
+    //ask the owners for the roots of the local labels
+    vector<vector<foflink_data>> requests(NProcs);
+    for (auto &link:locallinks) {
+        foflink_data request;
+        request.Label=request.Root=link.Label;
+        request.LabelTask=request.RootTask=ThisTask;
+        requests[LabelOwner(link.Label)].push_back(request);
+    }
+    return MPIQueryParents(parent, requests);
+}
+
+/*! Links groups across mpi domains in a single pass. All imported particles are searched in parallel for local particles
+    that meet the linking criterion, recording an edge between the label of the imported particle and that of the local particle.
+    Labels are the global group id or, for ungrouped particles, a unique id above \ref mpi_maxgid.
+    The edges are merged locally with a union-find and resolved globally by \ref MPIResolveLinks, after which all particles of a
+    linked set are given the smallest label of the set and the task owning it. This replaces iterating \ref MPILinkAcross and
+    \ref MPIUpdateExportList until no links remain. If check is given, it is used as in the typed \ref MPILinkAcross, if cmp is given
+    it is used for the search instead of the search distance rdist2.
+    Returns the number of local labels whose group changed.
+*/
+Int_t MPILinkAcrossUnionFind(const Int_t nbodies, KDTree *&tree, Particle *Part, Int_t *&pfof, Double_t rdist2,
+    FOFcompfunc *cmp, FOFcheckfunc *check, Double_t *params)
+{
+    int nthreads=1;
+    Int_t nlocal[NProcs], particleoffset[NProcs], links=0;
+    vr::Timer timer;
+#ifdef USEOPENMP
+    nthreads=omp_get_max_threads();
+#endif
+    //unique labels of ungrouped particles are based on their index and the task they reside on
+    MPI_Allgather(&nbodies, 1, MPI_Int_t, nlocal, 1, MPI_Int_t, MPI_COMM_WORLD);
+    particleoffset[0]=mpi_maxgid+1;
+    for (auto j=1;j<NProcs;j++) particleoffset[j]=particleoffset[j-1]+nlocal[j-1];
+
+    //search imported particles in parallel, storing the edges found by each thread
+    //an edge links the label of a local particle (Label) to that of the imported particle (Root)
+    vector<vector<foflink_data>> threadedges(nthreads);
+#ifdef USEOPENMP
+#pragma omp parallel default(shared)
+{
+#endif
+    int tid=0;
+#ifdef USEOPENMP
+    tid=omp_get_thread_num();
+#endif
+    vector<Int_t> tagged, labels;
+    Int_t *nn=NULL;
+    if (cmp!=NULL) nn=new Int_t[nbodies];
+#ifdef USEOPENMP
+    #pragma omp for schedule(dynamic,256) nowait
+#endif
+    for (Int_t i=0;i<NImport;i++) {
+        foflink_data edge;
+        bool importpass=true;
+        if (check!=NULL) {
+            //as in the typed search, ungrouped imported particles are not linked
+            if (FoFDataGet[i].iGroup==0) continue;
+            importpass=((*check)(PartDataGet[i],params)==0);
+        }
+        if (cmp!=NULL) {
+            Int_t nt=tree->SearchCriterionTagged(PartDataGet[i], *cmp, params, nn);
+            tagged.assign(nn, nn+nt);
+        }
+        else {
+            Double_t x[3];
+            for (auto j=0;j<3;j++) x[j]=PartDataGet[i].GetPosition(j);
+            tagged=tree->SearchBallPosTagged(x, rdist2);
+        }
+        if (tagged.size()==0) continue;
+        labels.clear();
+        for (auto &k:tagged) {
+            Int_t localid=Part[k].GetID();
+            if (check!=NULL) {
+                bool localpass=((*check)(Part[k],params)==0);
+                if (pfof[localid]>0 && !(localpass && importpass)) continue;
+                if (pfof[localid]==0 && !importpass) continue;
+            }
+            if (pfof[localid]>0) labels.push_back(pfof[localid]);
+            else labels.push_back(particleoffset[ThisTask]+localid);
+        }
+        if (labels.size()==0) continue;
+        //many local particles of the same group are typically found
+        sort(labels.begin(),labels.end());
+        labels.erase(unique(labels.begin(),labels.end()),labels.end());
+        edge.RootTask=FoFDataGet[i].iGroupTask;
+        if (FoFDataGet[i].iGroup>0) edge.Root=FoFDataGet[i].iGroup;
+        else edge.Root=particleoffset[edge.RootTask]+PartDataGet[i].GetID();
+        edge.LabelTask=ThisTask;
+        for (auto &label:labels) {
+            edge.Label=label;
+            threadedges[tid].push_back(edge);
+        }
+    }
+    if (nn!=NULL) delete[] nn;
+#ifdef USEOPENMP
+}
+#endif
+    LabelUnionFind uf;
+    Int_t nedges=0;
+    for (auto &edges:threadedges) {
+        nedges+=edges.size();
+        for (auto &edge:edges) uf.Add(edge);
+        vector<foflink_data>().swap(edges);
+    }
+    LOG(debug) << "Found " << nedges << " edges to groups on other mpi domains in " << timer;
+
+    //resolve globally and relabel local particles
+    unordered_map<Int_t, foflink_data> roots=MPIResolveLinks(uf);
+    for (auto &root:roots) if (root.second.LabelTask==ThisTask && root.second.Root!=root.first) links++;
+    if (roots.size()>0) {
+#ifdef USEOPENMP
+#pragma omp parallel for default(shared) schedule(static) if (nbodies>ompsearchnum)
+#endif
+        for (Int_t i=0;i<nbodies;i++) {
+            Int_t label=(pfof[i]>0)?pfof[i]:particleoffset[ThisTask]+i;
+            auto it=roots.find(label);
+            if (it==roots.end()) continue;
+            pfof[i]=it->second.Root;
+            mpi_foftask[i]=it->second.RootTask;
+        }
+    }
+    LOG(debug) << "Resolved " << links << " local groups linked across mpi domains in " << timer;
+    return links;
+}
+//@}
+
+/*!
+    Orders the local particles for exchanging groups between mpi tasks, with the particles staying on this task first followed
+    by those to be exported grouped by destination task, each ordered by group id. The order is found with a radix sort of
+    (task, group id) keys, pfof and mpi_foftask are gathered into the new order and the particles are permuted in place.
+    On input pfof and mpi_foftask are indexed by particle id, on output by position in the particle array.
+*/
+void MPISortParticlesForGroupExchange(const Int_t nbodies, Particle *Part, Int_t *pfof)
+{
+    vector<Int_t> indices(nbodies);
+    vector<unsigned long long> keys(nbodies);
+    vector<Int_t> ids(nbodies);
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbodies>ompsortsize)
+#endif
+    for (Int_t i=0;i<nbodies;i++) {
+        indices[i]=i;
+        ids[i]=Part[i].GetID();
+        keys[i]=pfof[ids[i]];
+    }
+    RadixSortIndices(nbodies, keys.data(), indices.data());
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbodies>ompsortsize)
+#endif
+    for (Int_t i=0;i<nbodies;i++) {
+        short_mpi_t task=mpi_foftask[ids[i]];
+        keys[i]=(task==ThisTask)?0:(unsigned long long)task+1;
+    }
+    RadixSortIndices(nbodies, keys.data(), indices.data());
+
+    //gather the group ids and tasks into the new order
+    vector<Int_t> storegroup(nbodies);
+    vector<short_mpi_t> storetask(nbodies);
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (nbodies>ompsortsize)
+#endif
+    for (Int_t i=0;i<nbodies;i++) {
+        storegroup[i]=pfof[ids[indices[i]]];
+        storetask[i]=mpi_foftask[ids[indices[i]]];
+    }
+    copy(storegroup.begin(), storegroup.end(), pfof);
+    copy(storetask.begin(), storetask.end(), mpi_foftask);
+
+    //and permute the particles in place
+    PermuteParticles(nbodies, Part, indices.data());
+}
+
 /*!
     Group particles belong to a group to a particular mpi thread so that locally easy to determine
     the maximum group size and reoder the group ids according to descending group size.
@@ -4805,6 +5661,7 @@ Int_t MPIGroupExchange(Options &opt, const Int_t nbodies, Particle *Part, Int_t
 
 
     int task;
+    vr::Timer timer;
     FoFGroupDataExport=NULL;
     FoFGroupDataLocal=NULL;
     for (j=0;j<NProcs;j++) nsend_local[j]=0;
@@ -4814,7 +5671,7 @@ Int_t MPIGroupExchange(Options &opt, const Int_t nbodies, Particle *Part, Int_t
         if (mpi_foftask[i]!=ThisTask)
             nsend_local[mpi_foftask[i]]++;
     }
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     nexport=nimport=0;
     for (j=0;j<NProcs;j++){
         nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -4826,25 +5683,13 @@ Int_t MPIGroupExchange(Options &opt, const Int_t nbodies, Particle *Part, Int_t
     NExport=nexport;
     if (nexport >0) FoFGroupDataExport=new fofid_in[nexport];
 
-    Int_t *storeval=new Int_t[nbodies];
     Noldlocal=nbodies;
-    //store type in temporary array, then use type to store what task particle belongs to and sort values
-    for (i=0;i<nbodies;i++) storeval[i]=Part[i].GetType();
-    for (i=0;i<nbodies;i++) Part[i].SetType((mpi_foftask[i]!=ThisTask));
-    qsort(Part,nbodies,sizeof(Particle),TypeCompare);
-    for (i=0;i<nbodies;i++) Part[i].SetType(storeval[Part[i].GetID()]);
-    //now use array to rearrange data
-    for (i=0;i<nbodies;i++) storeval[i]=mpi_foftask[Part[i].GetID()];
-    for (i=0;i<nbodies;i++) mpi_foftask[i]=storeval[i];
-    for (i=0;i<nbodies;i++) storeval[i]=pfof[Part[i].GetID()];
-    for (i=0;i<nbodies;i++) pfof[i]=storeval[i];
-    for (i=0;i<nbodies;i++) Part[i].SetID(i);
-    //for sorting purposes to place untagged particles at the end. Was done by setting type
-    //now via storeval and ids
-    for (i=0;i<nbodies;i++) storeval[i]=-pfof[Part[i].GetID()];
-    for (i=0;i<nbodies;i++) Part[i].SetID(storeval[i]);
+    //order particles so that exported particles are at the end, grouped by destination task
+    MPISortParticlesForGroupExchange(nbodies, Part, pfof);
+    //the id stores the group id used by MPICompileGroups to place untagged particles at the end
+    for (i=0;i<nbodies;i++) Part[i].SetID(-pfof[i]);
     if (nimport>0) FoFGroupDataLocal=new fofid_in[nimport];
-    delete[] storeval;
+    LOG(debug) << "Sorted " << nbodies << " particles for group exchange in " << timer;
 
     //determine offsets in arrays so that data contiguous with regards to processors for broadcasting
     //offset on transmitter end
@@ -4929,6 +5774,7 @@ Int_t MPIGroupExchange(Options &opt, const Int_t nbodies, Particle *Part, Int_t
             }
         }
     }
+    LOG(debug) << "Exchanged " << nexport << " exported and " << nimport << " imported particles of groups in " << timer;
     Nlocal=nlocal;
     return nlocal;
 }
@@ -4946,6 +5792,7 @@ Int_t MPIBaryonGroupExchange(Options &opt, const Int_t nbodies, Particle *Part,
     int cursendchunksize,currecvchunksize;
     MPI_Status status;
     int task;
+    vr::Timer timer;
     FoFGroupDataExport=NULL;
     FoFGroupDataLocal=NULL;
     for (j=0;j<NProcs;j++) nsend_local[j]=0;
@@ -4955,7 +5802,7 @@ Int_t MPIBaryonGroupExchange(Options &opt, const Int_t nbodies, Particle *Part,
         if (mpi_foftask[i]!=ThisTask)
             nsend_local[mpi_foftask[i]]++;
     }
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     nexport=nimport=0;
     for (j=0;j<NProcs;j++){
         nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -4969,49 +5816,31 @@ Int_t MPIBaryonGroupExchange(Options &opt, const Int_t nbodies, Particle *Part,
 
     Nmemlocalbaryon=Nlocalbaryon[0];
     for (i=0;i<nbodies;i++) Part[i].SetID(i);
-    Int_t *storeval=new Int_t[nbodies];
     //if trying to reduce memory allocation,  if nlocal < than the memory allocated adjust local list so that all particles to be exported are near the end.
     //and allocate the appropriate memory for pfof and mpi_idlist. otherwise, need to actually copy the particle data into FoFGroupDataLocal and proceed
     //as normal, storing info, send info, delete particle array, allocate a new array large enough to store info and copy over info
     ///\todo eventually I should replace arrays with vectors so that the size can change, removing the need to free and allocate
     if (nlocal<=Nmemlocalbaryon) {
         Noldlocal=nbodies-nexport;
-        for (i=0;i<nbodies;i++) storeval[i]=Part[i].GetType();
-        for (i=0;i<nbodies;i++) Part[i].SetType((mpi_foftask[i]!=ThisTask));
-        qsort(Part,nbodies,sizeof(Particle),TypeCompare);
-        for (i=0;i<nbodies;i++) Part[i].SetType(storeval[Part[i].GetID()]);
-        //now use array to rearrange data
-        for (i=0;i<nbodies;i++) storeval[i]=mpi_foftask[Part[i].GetID()];
-        for (i=0;i<nbodies;i++) mpi_foftask[i]=storeval[i];
-        for (i=0;i<nbodies;i++) storeval[i]=pfof[Part[i].GetID()];
-        for (i=0;i<nbodies;i++) pfof[i]=storeval[i];
-        for (i=0;i<nbodies;i++) Part[i].SetID(i);
-        //now via storeval and ids
-        for (i=0;i<nbodies;i++) storeval[i]=-pfof[Part[i].GetID()];
-        for (i=0;i<nbodies;i++) Part[i].SetID(storeval[i]);
+        MPISortParticlesForGroupExchange(nbodies, Part, pfof);
+        //the id stores the group id used by MPIBaryonCompileGroups
+        for (i=0;i<nbodies;i++) Part[i].SetID(-pfof[i]);
         if (nimport>0) FoFGroupDataLocal=new fofid_in[nimport];
     }
     //otherwise use FoFGroupDataLocal to store all the necessary data
     else {
         FoFGroupDataLocal=new fofid_in[nlocal];
-        for (i=0;i<nbodies;i++) storeval[i]=Part[i].GetType();
-        for (i=0;i<nbodies;i++) Part[i].SetType((mpi_foftask[i]!=ThisTask));
-        qsort(Part,nbodies,sizeof(Particle),TypeCompare);
-        for (i=0;i<nbodies;i++) Part[i].SetType(storeval[Part[i].GetID()]);
+        MPISortParticlesForGroupExchange(nbodies, Part, pfof);
         Int_t nn=nbodies-nexport;
         for (i=0;i<nn;i++) {
             FoFGroupDataLocal[i].p=Part[i];
             FoFGroupDataLocal[i].Index = i;
             FoFGroupDataLocal[i].Task = ThisTask;
-            FoFGroupDataLocal[i].iGroup = pfof[Part[i].GetID()];
+            FoFGroupDataLocal[i].iGroup = pfof[i];
         }
-        for (i=nn;i<nbodies;i++) storeval[i]=mpi_foftask[Part[i].GetID()];
-        for (i=nn;i<nbodies;i++) mpi_foftask[i]=storeval[i];
-        for (i=nn;i<nbodies;i++) storeval[i]=pfof[Part[i].GetID()];
-        for (i=nn;i<nbodies;i++) pfof[i]=storeval[i];
         for (i=nn;i<nbodies;i++) Part[i].SetID(i);
     }
-    delete[] storeval;
+    LOG(debug) << "Sorted " << nbodies << " baryons for group exchange in " << timer;
     //determine offsets in arrays so that data contiguous with regards to processors for broadcasting
     //offset on transmitter end
     noffset_export[0]=0;
@@ -5074,6 +5903,7 @@ Int_t MPIBaryonGroupExchange(Options &opt, const Int_t nbodies, Particle *Part,
             }
         }
     }
+    LOG(debug) << "Exchanged " << nexport << " exported and " << nimport << " imported baryons of groups in " << timer;
     Nlocalbaryon[0]=nlocal;
     return nlocal;
 }
@@ -5098,7 +5928,7 @@ Int_t MPICompileGroups(Options &opt, const Int_t nbodies, Particle *Part, Int_t
         Part[i].SetID(-FoFGroupDataLocal[i-Noldlocal].iGroup);
     }
     //used to use ID store store group id info
-    qsort(Part,nbodies,sizeof(Particle),IDCompare);
+    SortParticles(nbodies, Part, PSORTID);
     //determine the # of groups, their size and the current group ID
     for (i=0,start=0;i<nbodies;i++) {
         if (Part[i].GetID()!=Part[start].GetID()) {
@@ -5110,7 +5940,7 @@ Int_t MPICompileGroups(Options &opt, const Int_t nbodies, Particle *Part, Int_t
         if (Part[i].GetID()>=0) break;
     }
     //again resort to move untagged particles to the end.
-    qsort(Part,nbodies,sizeof(Particle),IDCompare);
+    SortParticles(nbodies, Part, PSORTID);
     for (i=nbodies-NExport; i< nbodies; i++) Part[i].SetID(0);
     //now adjust pfof and ids.
     for (i=0;i<nbodies;i++) {pfof[i]=-Part[i].GetID();Part[i].SetID(i);}
@@ -5157,7 +5987,7 @@ Int_t MPIBaryonCompileGroups(Options &opt, const Int_t nbodies, Particle *Part,
             Part[i].SetID(-FoFGroupDataLocal[i-Noldlocal].iGroup);
         }
         //now use ID
-        qsort(Part,nbodies,sizeof(Particle),IDCompare);
+        SortParticles(nbodies, Part, PSORTID);
         //determine the # of groups, their size and the current group ID
         for (i=0,start=0;i<nbodies;i++) {
             if (Part[i].GetID()!=Part[start].GetID()) {
@@ -5170,7 +6000,7 @@ Int_t MPIBaryonCompileGroups(Options &opt, const Int_t nbodies, Particle *Part,
         }
 
         //again resort to move untagged particles to the end.
-        qsort(Part,nbodies,sizeof(Particle),IDCompare);
+        SortParticles(nbodies, Part, PSORTID);
         //now adjust pfof and ids.
         for (i=0;i<nbodies;i++) {pfof[i]=-Part[i].GetID();Part[i].SetID(i);}
         numingroup=new Int_t[ngroups+1];
@@ -5323,7 +6153,7 @@ Int_t MPIBaryonExchange(Options &opt, const Int_t nbaryons, Particle *Pbaryons,
         if (mpi_foftask[i]!=ThisTask)
             nsend_local[mpi_foftask[i]]++;
     }
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     nexport=nimport=0;
     for (j=0;j<NProcs;j++){
         nimport+=mpi_nsend[ThisTask+j*NProcs];
@@ -5345,7 +6175,7 @@ Int_t MPIBaryonExchange(Options &opt, const Int_t nbaryons, Particle *Pbaryons,
         Noldlocal=nbaryons-nexport;
         for (i=0;i<nbaryons;i++) storeval[i]=Pbaryons[i].GetType();
         for (i=0;i<nbaryons;i++) Pbaryons[i].SetType((mpi_foftask[i]!=ThisTask));
-        qsort(Pbaryons,nbaryons,sizeof(Particle),TypeCompare);
+        SortParticles(nbaryons, Pbaryons, PSORTTYPE);
         for (i=0;i<nbaryons;i++) Pbaryons[i].SetType(storeval[Pbaryons[i].GetID()]);
         //now use array to rearrange data
         for (i=0;i<nbaryons;i++) storeval[i]=mpi_foftask[Pbaryons[i].GetID()];
@@ -5363,7 +6193,7 @@ Int_t MPIBaryonExchange(Options &opt, const Int_t nbaryons, Particle *Pbaryons,
         FoFGroupDataLocal=new fofid_in[nlocal];
         for (i=0;i<nbaryons;i++) storeval[i]=Pbaryons[i].GetType();
         for (i=0;i<nbaryons;i++) Pbaryons[i].SetType((mpi_foftask[i]!=ThisTask));
-        qsort(Pbaryons,nbaryons,sizeof(Particle),TypeCompare);
+        SortParticles(nbaryons, Pbaryons, PSORTTYPE);
         for (i=0;i<nbaryons;i++) Pbaryons[i].SetType(storeval[Pbaryons[i].GetID()]);
         Int_t nn=nbaryons-nexport;
         for (i=0;i<nn;i++) {
@@ -5458,52 +6288,6 @@ inline void MPIAdjustGroupIDs(const Int_t nbodies,Int_t *pfof) {
     for (Int_t i=0;i<nbodies;i++) if (pfof[i]>0) pfof[i]+=noffset;
 }
 
-///Collect FOF from all
-void MPICollectFOF(const Int_t nbodies, Int_t *&pfof){
-    Int_t sendTask,recvTask;
-    MPI_Status status;
-    //if using mpi, offset the pfof so that group ids are no unique, before just local to thread
-    MPIAdjustGroupIDs(Nlocal,pfof);
-    //now send the data from all MPI threads to thread zero
-    //first must send how much data is local to a processor
-    Int_t nsend_local[NProcs];
-    for (int i=0;i<NProcs;i++) nsend_local[i]=0;
-    if (ThisTask!=0)nsend_local[0]=Nlocal;
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
-    recvTask=0;
-    //next copy task zero pfof into global mpi_pfof to the appropriate indices
-    if (ThisTask==0) {
-        for (Int_t i=0;i<Nlocal;i++) mpi_pfof[mpi_indexlist[i]]=pfof[i];
-    }
-    //then for each processor copy their values into local pfof and mpi_indexlist
-    //note mpi_idlist contains id values whereas indexlist contains the index order of how particles were loaded
-    //this requires determining the largest size needed
-    if (ThisTask==0) {
-        Int_t maxnlocal=0;
-        for(int j=1;j<NProcs;j++) if (maxnlocal<mpi_nsend[j*NProcs]) maxnlocal=mpi_nsend[j*NProcs];
-        delete[] pfof;
-        delete[] mpi_indexlist;
-        pfof=new Int_t[maxnlocal];
-        mpi_indexlist=new Int_t[maxnlocal];
-    }
-    MPI_Barrier(MPI_COMM_WORLD);
-    //now for each mpi task, copy appropriate data to mpi thread 0 local buffers
-    for(int j=1;j<NProcs;j++)
-    {
-        sendTask=j;
-        recvTask=0;
-        if (ThisTask==sendTask) {
-            MPI_Ssend(pfof, Nlocal , MPI_Int_t,0, TAG_FOF_D, MPI_COMM_WORLD);
-            MPI_Ssend(mpi_indexlist, Nlocal , MPI_Int_t,0, TAG_FOF_E, MPI_COMM_WORLD);
-        }
-        if(ThisTask==0) {
-            MPI_Recv(pfof, mpi_nsend[sendTask*NProcs], MPI_Int_t, sendTask, TAG_FOF_D, MPI_COMM_WORLD, &status);
-            MPI_Recv(mpi_indexlist, mpi_nsend[sendTask*NProcs], MPI_Int_t, sendTask, TAG_FOF_E, MPI_COMM_WORLD, &status);
-            for (Int_t i=0;i<mpi_nsend[sendTask*NProcs];i++) mpi_pfof[mpi_indexlist[i]]=pfof[i];
-        }
-        MPI_Barrier(MPI_COMM_WORLD);
-    }
-}
 //@}
 
 /// \name Routines related to distributing the grid cells used to calculate the coarse-grained mean field
@@ -5517,7 +6301,7 @@ void MPIBuildGridData(const Int_t ngrid, GridCell *grid, Coordinate *gvel, Matri
     MPI_Status status;
 
     for (j=0;j<NProcs;j++) nsend_local[j]=Ngridlocal;
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     noffset[0]=0;
     for (j=1;j<NProcs;j++) noffset[j]=noffset[j]+mpi_nsend[ThisTask+j*NProcs];
     for (i=0;i<Ngridlocal;i++) {
@@ -5553,6 +6337,12 @@ void MPIBuildGridData(const Int_t ngrid, GridCell *grid, Coordinate *gvel, Matri
                 MPI_BYTE, recvTask, TAG_GRID_C, MPI_COMM_WORLD, &status);
         }
     }
+    //the particle indices of received cells point into the memory of other tasks
+    for (i=0;i<Ngridtotal;i++) {
+        mpi_grid[i].nparts=0;
+        mpi_grid[i].nindex=NULL;
+        mpi_grid[i].indexbuffer=NULL;
+    }
 }
 //@}
 
@@ -5676,7 +6466,7 @@ void MPISwiftExchange(vector<Particle> &Part){
         }
     }
     for(j = 1, noffset[0] = 0; j < NProcs; j++) noffset[j]=noffset[j-1] + nsend_local[j-1];
-    MPI_Allgather(nsend_local, NProcs, MPI_Int_t, mpi_nsend, NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    MPIGatherSendCounts(nsend_local, mpi_nsend);
     for (j=0;j<NProcs;j++)nimport+=mpi_nsend[ThisTask+j*NProcs];
     ///\todo need to copy information and see what is what
 
@@ -5698,7 +6488,7 @@ void MPISwiftExchange(vector<Particle> &Part){
             PartBufSend[i]=Part[i+nbodies-nexport];
             PartBufSend[i].SetID(Part[i+nbodies-nexport].GetSwiftTask());
         }
-        qsort(PartBufSend,nexport,sizeof(Particle),IDCompare);
+        SortParticles(nexport, PartBufSend, PSORTID);
     }
     if (nimport > 0) PartBufRecv = new Particle[nimport];
 
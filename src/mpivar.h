@@ -93,6 +93,9 @@ typedef short short_mpi_t;
 #define TAG_FOF_D 13
 #define TAG_FOF_E 14
 #define TAG_FOF_F 15
+///flags for resolving groups across mpi domains with a union-find
+#define TAG_FOF_LINK_A 16
+#define TAG_FOF_LINK_B 17
 #define TAG_FOF_B_HYDRO 111
 #define TAG_FOF_B_STAR 112
 #define TAG_FOF_B_BH 113
@@ -119,6 +122,10 @@ typedef short short_mpi_t;
 #define TAG_GRID_B 31
 #define TAG_GRID_C 32
 
+///flags for sparse exchange of send counts
+#define TAG_SPARSE_A 40
+#define TAG_SPARSE_B 41
+
 ///flags for Extended output exchange
 #define TAG_EXTENDED_A 100
 #define TAG_EXTENDED_B 200
@@ -148,6 +155,23 @@ extern struct MPI_Domain {
 ///
 //@}
 
+/// \name for planning the input read by the read tasks
+//@{
+///contiguous range [nstart,nend) of particles of one type in one input file that a read task loads
+struct MPIReadRange
+{
+    int ifile, itype;
+    unsigned long long nstart, nend;
+};
+///a full particle buffer handed to MPI by a read task, kept until its count and data messages have been sent
+struct MPIParticleSend
+{
+    vector<Particle> Part;
+    Int_t numpart;
+    MPI_Request request[2];
+};
+//@}
+
 /// \name for mpi FOF search
 //@{
 ///array that stores number of particles
@@ -183,6 +207,14 @@ extern struct fofdata_in
     short_mpi_t Task;
 }
 *FoFDataIn, *FoFDataGet;
+
+///structure used to resolve the global ids of groups spanning mpi domains, storing a label (a group id or a
+///unique id of an ungrouped particle), the root label of the set of labels it is linked to and the tasks owning them
+struct foflink_data
+{
+    Int_t Label, Root;
+    short_mpi_t LabelTask, RootTask;
+};
 ///Particle arrays used for transmitting data between mpi threads
 extern Particle *PartDataIn, *PartDataGet;
 ///Particle arrays that allow allocation of memory need when deallocating local particle arrays that then need to be reassigned
@@ -6,11 +6,14 @@
 
 #ifdef USEOPENMP
 
+#include <atomic>
+
 //-- For MPI
 
 #include "logging.h"
 #include "stf.h"
 #include "timer.h"
+#include "unionfind.h"
 
 /// \name routines which check to see if some search region overlaps with local mpi domain
 //@{
@@ -196,95 +199,81 @@ OMP_ImportInfo *OpenMPImportParticles(Options &opt, const Int_t nbodies, vector<
     return ompimport;
 }
 
+///lowers an attachment label to a candidate if none is set yet or the candidate is smaller
+static inline void OpenMPAttachMin(std::atomic<Int_t> &attach, Int_t label)
+{
+    Int_t current=attach.load();
+    while ((current==0 || label<current) && !attach.compare_exchange_weak(current, label));
+}
+
+/*! Links groups across OpenMP domains in a single parallel pass. Every domain searches the particles it imports for local
+    particles within the linking length and links their labels in a lock-free union-find (\ref vr::ConcurrentUnionFind)
+    shared by all threads. Labels are the local group ids, at most nbodies, or nbodies+1+index for ungrouped particles, so
+    the root of any set holding a group is a group id and sets made only of ungrouped particles are left ungrouped.
+    This replaces sweeping the imported particles and rewriting the group ids of whole local groups until no links remain.
+    For the typed search, only particles that are a basis for links join sets, and other ungrouped particles are attached
+    to the smallest label that reaches them, as in \ref MPILinkAcrossUnionFind. On output pfof holds the root of each
+    particle's set, to be relabelled by \ref OpenMPResortParticleandGroups.
+*/
 void OpenMPLinkAcross(Options &opt,
     Int_t nbodies, vector<Particle> &Part, Int_t * &pfof, Int_t *&storeorgIndex,
-    Int_tree_t *&Head, Int_tree_t *&Next,
     Double_t *param, FOFcheckfunc &fofcheck,
     const Int_t numompregions, OMP_Domain *&ompdomain, KDTree **tree3dfofomp,
     Int_t *&omp_nrecv_total, Int_t *&omp_nrecv_offset, OMP_ImportInfo* &ompimport)
 {
-    //now begin linking across
-    Int_t i;
-    Int_t omp_links_across_total, numloops;
-    Int_t nt, orgIndex, curIndex, *nn=new Int_t[nbodies], pfofcomp;
-    int curTask;
-    Coordinate x;
-    Particle *Pval;
+    Int_t i, links=0;
+    Int_t *nn=new Int_t[nbodies];
+    bool typed=(opt.partsearchtype==PSTALL && opt.iBaryonSearch>1);
+    unique_ptr<std::atomic<Int_t>[]> attach;
 #ifndef USEMPI
     int ThisTask=0,NProcs=1;
 #endif
 
     LOG(info) << "Linking across OpenMP domains";
     vr::Timer linking_timer;
-    numloops = 0;
-    do {
-        omp_links_across_total = 0;
-        #pragma omp parallel default(shared) \
-        private(i,orgIndex,curIndex, x, nt, Pval, pfofcomp)
-        {
-        #pragma omp for nowait reduction(+:omp_links_across_total)
-        for (i=0;i<numompregions;i++) {
-            for (auto j=0;j<omp_nrecv_total[i];j++) {
-                Pval=&Part[ompimport[omp_nrecv_offset[i]+j].index];
-                pfofcomp = ompimport[omp_nrecv_offset[i]+j].pfof;
-                if (pfofcomp == 0) continue;
-                //for each imported particle, find all particles within search window
-                for (auto k=0;k<3;k++) x[k]=Pval->GetPosition(k);
-                nt=tree3dfofomp[i]->SearchBallPosTagged(x, param[1], &nn[ompdomain[i].noffset]);
-                for (auto k=0;k<nt;k++) {
-                    curIndex=nn[k+ompdomain[i].noffset]+ompdomain[i].noffset;
-                    //check that at least on of the particles meets the type criterion if necessary
-                    if (opt.partsearchtype==PSTALL && opt.iBaryonSearch>1)
-                        if (fofcheck(Part[curIndex],param)!=0 && fofcheck(*Pval,param)!=0) continue;
+    auto label = [&](Int_t orgIndex) { return (pfof[orgIndex]>0)?pfof[orgIndex]:nbodies+1+orgIndex; };
+    vr::ConcurrentUnionFind uf(2*nbodies+1);
+    if (typed) {
+        attach.reset(new std::atomic<Int_t>[nbodies]);
+        #pragma omp parallel for schedule(static) if (nbodies>ompsearchnum)
+        for (i=0;i<nbodies;i++) attach[i].store(0);
+    }
 
-                    orgIndex = storeorgIndex[Part[curIndex].GetID()+ompdomain[i].noffset];
-                    //otherwise, change these particles to local group id if local group id smaller
-                    //if local particle in a group
-                    if (pfof[orgIndex]>0)  {
-                        //only change if both particles are appropriate type and group ids indicate local needs to be exported
-                        if (opt.partsearchtype==PSTALL && opt.iBaryonSearch>1)
-                            if (!(fofcheck(Part[curIndex],param)==0 && fofcheck(*Pval,param)==0)) continue;
-                        //if local group id is larger, change locally
-                        if (pfof[orgIndex] > pfofcomp) {
-                            Int_t ss = Head[nn[k+ompdomain[i].noffset]+ompdomain[i].noffset];
-                            do{
-                                orgIndex = storeorgIndex[Part[ss+ompdomain[i].noffset].GetID()+ompdomain[i].noffset];
-                                pfof[orgIndex]=pfofcomp;
-                            }while((ss = Next[ss+ompdomain[i].noffset]) >= 0);
-                            omp_links_across_total++;
-                        }
-                    }
-                    //if local particle not in a group and export is appropriate type, link
-                    else {
-                        if (opt.partsearchtype==PSTALL && opt.iBaryonSearch>1)
-                            if (fofcheck(*Pval,param)!=0) continue;
-                        pfof[orgIndex]=pfofcomp;
-                        omp_links_across_total++;
-                    }
+    #pragma omp parallel for default(shared) private(i) schedule(dynamic) reduction(+:links)
+    for (i=0;i<numompregions;i++) {
+        Int_t *nnlocal=&nn[ompdomain[i].noffset];
+        for (auto j=0;j<omp_nrecv_total[i];j++) {
+            OMP_ImportInfo &import=ompimport[omp_nrecv_offset[i]+j];
+            Particle *Pval=&Part[import.index];
+            //links are only made from imported particles that are a basis for links
+            if (typed && fofcheck(*Pval,param)!=0) continue;
+            Int_t importlabel=label(storeorgIndex[Pval->GetID()+ompdomain[import.task].noffset]);
+            //for each imported particle, find all particles within search window
+            Coordinate x;
+            for (auto k=0;k<3;k++) x[k]=Pval->GetPosition(k);
+            Int_t nt=tree3dfofomp[i]->SearchBallPosTagged(x, param[1], nnlocal);
+            for (auto k=0;k<nt;k++) {
+                Int_t curIndex=nnlocal[k]+ompdomain[i].noffset;
+                Int_t orgIndex=storeorgIndex[Part[curIndex].GetID()+ompdomain[i].noffset];
+                if (!typed || fofcheck(Part[curIndex],param)==0) {
+                    if (uf.unite(label(orgIndex), importlabel)) links++;
                 }
+                //other particles only join a group if not already in one, and do not link groups themselves
+                else if (pfof[orgIndex]==0) OpenMPAttachMin(attach[orgIndex], importlabel);
             }
         }
-        }
-
-        #pragma omp parallel default(shared) \
-        private(i,orgIndex,curIndex,curTask)
-        {
-        #pragma omp for nowait
-        for (i=0;i<numompregions;i++) {
-            for (auto j=0;j<omp_nrecv_total[i];j++) {
-                curIndex=ompimport[omp_nrecv_offset[i]+j].index;
-                curTask=ompimport[omp_nrecv_offset[i]+j].task;
-                orgIndex=storeorgIndex[Part[curIndex].GetID()+ompdomain[curTask].noffset];
-                ompimport[omp_nrecv_offset[i]+j].pfof=pfof[orgIndex];
-            }
-        }
-        }
-        numloops++;
-        LOG(debug) << "Linking across at loop " << numloops << " having found "
-                   << omp_links_across_total << " links";
-    }while(omp_links_across_total>0);
+    }
     delete[] nn;
-    LOG(info) << "Finished linking in " << linking_timer;
+
+    //relabel, each particle reading and writing only its own group id
+    #pragma omp parallel for schedule(static) if (nbodies>ompsearchnum)
+    for (i=0;i<nbodies;i++) {
+        Int_t root;
+        if (typed && pfof[i]==0 && attach[i].load()>0) root=uf.find(attach[i].load());
+        else root=uf.find(label(i));
+        pfof[i]=(root<=nbodies)?root:0;
+    }
+    LOG(info) << "Finished linking " << links << " sets across OpenMP domains in " << linking_timer;
 }
 
 Int_t OpenMPResortParticleandGroups(Int_t nbodies, vector<Particle> &Part, Int_t *&pfof, Int_t minsize)
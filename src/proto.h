@@ -6,8 +6,13 @@
 
 #include "allvars.h"
 
+#include "asyncwriter.h"
 #include "fofalgo.h"
+#include "histogram.h"
 #include "logging.h"
+#include "radialbins.h"
+#include "shrinkingsphere.h"
+#include "spatialindex.h"
 #include "stf-fitting.h"
 
 #ifndef STFPROTO_H
@@ -64,12 +69,18 @@ void WriteLocalVelocityDensity(Options &opt, const Int_t nbodies, vector<Particl
 
 ///Writes a tipsy formatted fof.grpfile
 void WriteFOF(Options &opt, const Int_t nbodies, Int_t *pfof);
+#ifdef USEMPI
+///Writes the group id and particle id of every local particle, each task writing its own slice
+void WriteFOFDistributed(Options &opt, const Int_t nbodies, Particle *Part, Int_t *pfof);
+#endif
 ///Writes a pg list file (first in effective index order of input file(s), second is particle ids
 void WritePGList(Options &opt, const Int_t ngroups, const Int_t ng, Int_t *numingroup, Int_t **pglist, Int_t *ids);
 ///Write catalog information (number of groups, number in groups, number of particles in groups, particle pids)
 void WriteGroupCatalog(Options &opt, const Int_t ngroups, Int_t *numingroup, Int_t **pglist, vector<Particle> &Part, Int_t nadditional=0);
 ///Write catalog information related to particle types relevant if different particle types are included in the grouping algorithm
 void WriteGroupPartType(Options &opt, const Int_t ngroups, Int_t *numingroup, Int_t **pglist, vector<Particle> &Part);
+///Queue the group catalog, and optionally the particle type catalog, on an output writer
+void SubmitGroupCatalog(vr::AsyncWriter &writer, Options &opt, const Int_t ngroups, Int_t *numingroup, Int_t **pglist, vector<Particle> &Part, Int_t nadditional=0, bool iparttype=false);
 ///Writes the bulk properties of the substructures
 void WriteProperties(Options &opt, const Int_t ngroups, PropData *pdata);
 ///Writes the bulk properties of the substructures in a subfind like HDF5 format
@@ -139,8 +150,12 @@ void WriteExtendedOutput (Options &opt, Int_t numgroups, Int_t nbodies, PropData
 
 ///Set up non-uniform grid structure using kd-tree
 KDTree* InitializeTreeGrid(Options &opt, const Int_t nbodies, Particle *Part);
+///Leaf nodes of a tree in particle order, from a single traversal
+vector<Node*> GetLeafNodeList(KDTree *tree);
 ///Fill cells of grid from tree
 void FillTreeGrid(Options &opt, const Int_t nbodies, const Int_t ngrid, KDTree *&tree, Particle *Part, GridCell* &grid);
+///Free grid filled from tree
+void FreeTreeGrid(const Int_t ngrid, GridCell *grid);
 
 //@}
 
@@ -168,6 +183,8 @@ void GetVelocityDensityHaloOnlyDen(Options &opt, const Int_t nbodies, Particle *
 void GetVelocityDensityExact(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree);
 ///optimised search for cosmological simulations
 void GetVelocityDensityApproximative(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree);
+///exact or approximative velocity density searching the particles in each leaf of the tree together
+void GetVelocityDensityBatched(Options &opt, const Int_t nbodies, Particle *Part, KDTree *tree);
 //@}
 
 /// \name Suboutines that compare local velocity density to background
@@ -203,8 +220,8 @@ Int_t GetOutliersValues(Options &opt, const Int_t nbodies, Particle *Part, int s
 Int_t *SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part, Int_t &numgroups);
 ///Search the outliers
 Int_t *SearchSubset(Options &opt, const Int_t nbodies, const Int_t nsubset, Particle *Partsubset, Int_t &numgroups, Int_t sublevel=0, Int_t *pnumcores=NULL);
-///Search for subsubstructures
-void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubset, Int_t *&pfof, Int_t &ngroup, Int_t &nhalos, PropData *pdata=NULL);
+///Search for subsubstructures, returning in localtime (if given) the time in seconds spent on this task before synchronising with the others
+void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubset, Int_t *&pfof, Int_t &ngroup, Int_t &nhalos, PropData *pdata=NULL, double *localtime=NULL);
 ///Given a set of tagged core particles, assign surroundings
 void HaloCoreGrowth(Options &opt, const Int_t nsubset, Particle *&Partsubset, Int_t *&pfof, Int_t *&pfofbg, Int_t &numgroupsbg, Double_t param[], vector<Double_t> &dispfac,
     int numactiveloops, vector<int> &corelevel, int nthreads);
@@ -268,9 +285,17 @@ inline Int_t MergeHaloGroups(Options &opt, Particle *Partsubset, Int_t numgroups
 
 ///used for tree potential calculation (which is only used for large groups)
 void GetNodeList(Node *np, Int_t &ncell, Node **nodelist, const Int_t bsize);
+///used for group walks in the tree potential calculation
+void GetSinkNodeList(Node *np, Int_t &nsink, Node **sinklist, const Int_t bsize, const Int_t gsize);
+///builds the tree kept across unbinding iterations when potentials are updated incrementally
+void BuildIncrementalPotentialTree(Options &opt, Int_t nbodies, Particle *Part, IncrementalPotentialTree &ptree);
+///subtracts the contribution of the nEplus particles listed in nEplusid from the potential of the other nig particles exactly
+void UpdatePotentialForUnboundParticlesPP(Options &opt, Int_t &nig, Particle *groupPart, Int_t &nEplus, Int_t *&nEplusid, int *&Eplusflag);
+///subtracts the contribution of the nEplus particles listed in nEplusid using the multipoles of the tree built by \ref BuildIncrementalPotentialTree
+void UpdatePotentialForUnboundParticlesTree(Options &opt, Int_t &nig, Particle *groupPart, Int_t &nEplus, Int_t *&nEplusid, IncrementalPotentialTree &ptree);
 
 ///Interface for unbinding proceedure
-int CheckUnboundGroups(Options opt, const Int_t nbodies, Particle *Part, Int_t &ngroup, Int_t *&pfof, Int_t *numingroup=NULL, Int_t **pglist=NULL,int ireorder=1, Int_t *groupflag=NULL);
+int CheckUnboundGroups(Options &opt, const Int_t nbodies, Particle *Part, Int_t &ngroup, Int_t *&pfof, Int_t *numingroup=NULL, Int_t **pglist=NULL,int ireorder=1, Int_t *groupflag=NULL);
 ///check if group self-bound
 int Unbind(Options &opt, Particle **gPartList, Int_t &numgroups, Int_t *numingroup, Int_t *pfof, Int_t **pglist, int ireorder=1);
 int Unbind(Options &opt, Particle *Part, Int_t &numgroups, Int_t *&numingroup, Int_t *&noffset, Int_t *&pfof);
@@ -407,9 +432,9 @@ void GetExtraBHProperties(Options &opt, PropData &pdata, Int_t n, Particle *Pval
 ///calculate extra dm properties
 void GetExtraDMProperties(Options &opt, PropData &pdata, Int_t n, Particle *Pval);
 
-///calculate spherical overdensity from vector of radii, masses and indices
+///calculate spherical overdensity from vector of radii and masses, walking the radial bins outwards
 Int_t CalculateSphericalOverdensity(Options &opt, PropData &pdata,
-    vector<Double_t> &radii, vector<Double_t> &masses, vector<Int_t> &indices,
+    vector<Double_t> &radii, vector<Double_t> &masses, vr::RadialBins &bins,
     Double_t &m200val, Double_t &m200mval, Double_t &mBN98val, Double_t &virval, Double_t &m500val,
     vector<Double_t> &SOlgrhovals);
 Int_t CalculateSphericalOverdensity(Options &opt, PropData &pdata,
@@ -480,10 +505,10 @@ OMP_ImportInfo *OpenMPImportParticles(Options &opt, const Int_t nbodies, vector<
     const Int_t numompregions, OMP_Domain *&ompdomain, const Double_t rdist,
     Int_t *&omp_nrecv_total, Int_t *&omp_nrecv_offset, Int_t &omp_import_total);
 
-///link across mpi domains
+///link across OpenMP domains in a single pass with a lock-free union-find
 void OpenMPLinkAcross(Options &opt,
     Int_t nbodies, vector<Particle> &Part, Int_t * &pfof,
-    Int_t *&storetype, Int_tree_t *&Head, Int_tree_t *&Next,
+    Int_t *&storetype,
     Double_t *param, FOFcheckfunc &fofcheck,
     const Int_t numompregions, OMP_Domain *&ompdomain, KDTree **tree3dfofomp,
     Int_t *&omp_nrecv_total, Int_t *&omp_nrecv_offset, OMP_ImportInfo* &ompimport);
@@ -510,10 +535,15 @@ void MPIInitialDomainDecomposition(Options &opt);
 void MPIDomainExtent(Options &opt);
 ///domain decomposition
 void MPIDomainDecomposition(Options &opt);
-///z-curve based mesh decomposition
+///z-curve or Hilbert curve based mesh decomposition
 void MPIInitialDomainDecompositionWithMesh(Options &opt);
-///z-curve repartitioning of cells
+///repartitioning of cells along the curve by their load
 bool MPIRepartitionDomainDecompositionWithMesh(Options &opt);
+///number of local particles and expected work in each mesh cell
+void MPIGetMeshCellWork(Options &opt, const Int_t nbodies, Particle *Part, Int_t *pfof, Int_t ngroup,
+    vector<double> &cellnumparts, vector<double> &cellwork);
+///converts the work of mesh cells to measured costs and writes them for the next run
+void MPIWriteMeshCellCosts(Options &opt, vector<double> &cellnumparts, vector<double> &cellwork, double time);
 
 ///Determine Domain Extent for tipsy input
 void MPIDomainExtentTipsy(Options &opt);
@@ -542,8 +572,16 @@ void MPIDomainExtentNchilada(Options &opt);
 ///Determine Domain for Gadget input
 void MPIDomainDecompositionNchilada(Options &opt);
 
+///index of the mesh cell containing a position
+unsigned long long MPIGetMeshCellIndex(Options &opt, Double_t x, Double_t y, Double_t z);
+///index of the mesh cell containing a position, placing positions on or just outside the periodic domain in the edge cells
+unsigned long long MPIGetClampedMeshCellIndex(Options &opt, Double_t x, Double_t y, Double_t z);
 ///determine what processor a particle is sent to based on domain decomposition
 int MPIGetParticlesProcessor(Options &opt, const Double_t,const Double_t,const Double_t);
+///determine the processors of a chunk of positions stored as x,y,z triplets
+void MPIGetParticlesProcessor(Options &opt, Int_t n, const float *pos, int *ibuf);
+///determine the processors of a chunk of positions stored as x,y,z triplets
+void MPIGetParticlesProcessor(Options &opt, Int_t n, const double *pos, int *ibuf);
 /// Determine number of local particles wrapper
 void MPINumInDomain(Options &opt);
 
@@ -551,6 +589,14 @@ void MPINumInDomain(Options &opt);
 void MPIDistributeReadTasks(Options&opt, int *&ireadtask, int*&readtaskID);
 ///set which file a given task will read
 int MPISetFilesRead(Options&opt, std::vector<int> &ireadfile, int *&ireadtask);
+///plan the particle ranges a read task loads, balancing the amount of data read by each read task
+std::vector<MPIReadRange> MPIPlanFileReads(Options &opt, int *ireadtask, const std::vector<unsigned long long> &npartfile, const std::vector<double> &typecost, bool isplitfiles);
+///set which files a given task will read from its planned ranges
+int MPISetFilesRead(Options&opt, std::vector<int> &ireadfile, const std::vector<MPIReadRange> &readranges);
+///return the cost of the planned ranges, as used by \ref MPIPlanFileReads
+double MPIReadRangesCost(const std::vector<MPIReadRange> &readranges, const std::vector<double> &typecost);
+///report the expected and actual time taken by the read tasks
+void MPIReportReadBalance(MPI_Comm comm, double cost, double readtime);
 
 ///generic init of write communicator to mpi world;
 void MPIInitWriteComm();
@@ -563,11 +609,15 @@ void MPIFreeWriteComm();
 void MPINumInDomainTipsy(Options &opt);
 /// Determine number of local particles for gadget
 void MPINumInDomainGadget(Options &opt);
+///Read the number of particles of each type in every gadget input file
+std::vector<unsigned long long> MPIGadgetFileParticleCounts(Options &opt, MPI_Comm comm);
 /// Determine number of local particles for ramses
 void MPINumInDomainRAMSES(Options &opt);
 #ifdef USEHDF
 /// Determine number of local particles for HDF
 void MPINumInDomainHDF(Options &opt);
+///Read the number of particles of each type in every HDF input file
+std::vector<unsigned long long> MPIHDFFileParticleCounts(Options &opt, MPI_Comm comm);
 #endif
 /// Determine number of local particles for Nchilada
 void MPINumInDomainNchilada(Options &opt);
@@ -603,12 +653,18 @@ vector<int> MPIGetCellListInSearchUsingMesh(Options &opt, Double_t xsearch[3][2]
 void MPIAddParticletoAppropriateBuffer(Options &opt, const int &ibuf, Int_t ibufindex, int *&ireadtask, const Int_t &Bufsize, Int_t *&Nbuf, Particle *&Pbuf, Int_t &numpart, Particle *Part, Int_t *&Nreadbuf, vector<Particle>*&Preadbuf);
 ///Send particle information from read threads to non read threads using MPI_COMM_WORLD
 void MPISendParticlesFromReadThreads(Options &opt, Int_t nlocalbuff, Particle *Part, int taskID);
+///Send a full particle buffer from a read thread to a non read thread without waiting for it to be received
+void MPIISendParticlesFromReadThreads(Options &opt, Int_t nlocalbuff, Particle *Pbuf, int taskID);
+///Wait for the particle buffers sent by this read thread to be received
+void MPICompleteParticleSendsFromReadThreads();
 ///recv particle data from read threads
 void MPIReceiveParticlesFromReadThreads(Options &opt, Particle *&Pbuf, Particle *Part, int *&readtaskID, int *&irecv, int *&mpi_irecvflag, Int_t *&Nlocalthreadbuf, MPI_Request *&mpi_request, Particle *&Pbaryons);
 ///Send/recv particle data read from input files between the various read threads;
 void MPISendParticlesBetweenReadThreads(Options &opt, Particle *&Pbuf, Particle *Part, Int_t *&nreadoffset, int *&ireadtask, int *&readtaskID, Particle *&Pbaryons, Int_t *&mpi_nsend_baryon);
 ///Send/recv particle data stored in vector using the read thread communication domain
 void MPISendParticlesBetweenReadThreads(Options &opt, vector<Particle> *&Pbuf, Particle *Part, int *&ireadtask, int *&readtaskID, Particle *&Pbaryons, MPI_Comm &mpi_read_comm, Int_t *&mpi_nsend_readthread, Int_t *&mpi_nsend_readthread_baryon);
+///Repartition the mesh with the cell counts of a single pass load and send the particles kept by each read task to their domains
+void MPIExchangeSinglePassLoad(Options &opt, vector<Particle> &Part, Particle *&Pbaryons, Int_t nlocalread, Int_t nbaryonread, int *&ireadtask, int *&readtaskID, MPI_Comm &mpi_comm_read);
 
 ///Interrupt send of particle information to destination taskID using MPI_COMM_WORLD
 void MPIISendParticleInfo(Options &opt, Int_t nlocalbuff, Particle *Part, int taskID, int tag, MPI_Request &rqst);
@@ -705,6 +761,13 @@ void MPISendReceiveFOFBHInfoBetweenThreads(Options &opt, fofid_in *FoFGroupDataL
 void MPISendReceiveFOFExtraDMInfoBetweenThreads(Options &opt, fofid_in *FoFGroupDataLocal, vector<Int_t> &indices, vector<float> &propbuff, int recvTask, int tag, MPI_Comm &mpi_comm);
 //@}
 
+/// \name MPI sparse communication routines
+/// see \ref mpiroutines.cxx for implementation
+//@{
+///fill the send and receive counts of this task using a sparse non-blocking consensus exchange rather than gathering all counts
+void MPIGatherSendCounts(const Int_t *nsend_local, Int_t *nsend, MPI_Comm comm=MPI_COMM_WORLD);
+//@}
+
 /// \name MPI search related routines
 /// see \ref mpiroutines.cxx for implementation
 //@{
@@ -727,8 +790,13 @@ Int_t MPILinkAcross(const Int_t nbodies, KDTree *&tree, Particle *Part, Int_t *&
 Int_t MPILinkAcross(const Int_t nbodies, KDTree *&tree, Particle *Part, Int_t *&pfof, Int_tree_t *&Len, Int_tree_t *&Head, Int_tree_t *&Next, Double_t rdist2, FOFcompfunc &cmp, Double_t *params);
 ///Link groups across MPI threads checking particle types
 Int_t MPILinkAcross(const Int_t nbodies, KDTree *&tree, Particle *Part, Int_t *&pfof, Int_tree_t *&Len, Int_tree_t *&Head, Int_tree_t *&Next, Double_t rdist2, FOFcheckfunc &check, Double_t *params);
+///link groups across mpi domains in a single pass, resolving the global group ids with a distributed union-find
+Int_t MPILinkAcrossUnionFind(const Int_t nbodies, KDTree *&tree, Particle *Part, Int_t *&pfof, Double_t rdist2,
+    FOFcompfunc *cmp=NULL, FOFcheckfunc *check=NULL, Double_t *params=NULL);
 ///update export list after after linking across
 void MPIUpdateExportList(const Int_t nbodies, Particle *Part, Int_t *&pfof, Int_tree_t *&Len);
+///order local particles by destination task and group id prior to localizing groups
+void MPISortParticlesForGroupExchange(const Int_t nbodies, Particle *Part, Int_t *pfof);
 ///localize groups to a single mpi thread
 Int_t MPIGroupExchange(Options &opt, const Int_t nbodies, Particle *Part, Int_t *&pfof);
 ///Determine the local number of groups and their sizes (groups must be local to an mpi thread)
@@ -738,8 +806,6 @@ Int_t MPIBaryonGroupExchange(Options &opt, const Int_t nbodies, Particle *Part,
 ///similar to \ref MPICompileGroups but optimised for separate baryon search, assumes only looking at baryons
 Int_t MPIBaryonCompileGroups(Options &opt, const Int_t nbodies, Particle *Part, Int_t *&pfof, Int_t minsize, int iorder=1);
 ///localize baryons particle members of groups to a single mpi thread
-///Collect FOF from all
-void MPICollectFOF(const Int_t nbodies, Int_t *&pfof);
 ///comparison function to order particles for export
 int fof_export_cmp(const void *a, const void *b);
 ///comparison function to order particles for export and fof group localization.
@@ -851,6 +917,12 @@ std::string GetMemUsage(Options &opt, string file, int line, string function);
 #define MEMORY_USAGE_REPORT(lvl, opt) { if(LOG_ENABLED(lvl)) LOG(lvl) << GetMemUsage(opt, __FILE__, __LINE__, __PRETTY_FUNCTION__); }
 ///Init memory log
 void InitMemUsageLog(Options &opt);
+///stable parallel radix sort of indices by 64 bit keys
+void RadixSortIndices(const Int_t n, const unsigned long long *keys, Int_t *indices);
+///reorders particles in place following a permutation of their indices
+void PermuteParticles(const Int_t n, Particle *Part, const Int_t *indices);
+///stable radix sort of particles by a property, replacing qsort with the matching comparison function
+void SortParticles(const Int_t n, Particle *Part, int sortkey);
 
 namespace vr {
 	/// Get the basename of `filename`
@@ -0,0 +1,138 @@
+/**
+ * @file
+ *
+ * Particles around a centre bucketed by the logarithm of their radius
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "radialbins.h"
+
+namespace vr
+{
+
+RadialBins::RadialBins(const Options &opt, const std::vector<Double_t> &radii, const std::vector<Double_t> &masses,
+                       Int_t particles_per_bin)
+  : radii(radii)
+{
+	const Int_t n = radii.size();
+	Double_t rminpos = MAXVALUE, rmaxall = 0;
+	for (Int_t j = 0; j < n; j++) {
+		if (radii[j] > 0 && radii[j] < rminpos) {
+			rminpos = radii[j];
+		}
+		rmaxall = std::max(rmaxall, radii[j]);
+	}
+	Int_t nb = std::max(Int_t(1), std::min(n / std::max(particles_per_bin, Int_t(1)), Int_t(1) << 16));
+	if (!(rmaxall > rminpos)) {
+		nb = 1;
+	}
+
+	// bins of equal width in ln r, with radii at or below the smallest positive radius in the first
+	std::vector<int> binof(n, 0);
+	if (nb > 1) {
+		const Double_t lrmin = std::log(rminpos);
+		const Double_t scale = nb / (std::log(rmaxall) - lrmin);
+		for (Int_t j = 0; j < n; j++) {
+			if (radii[j] <= rminpos) {
+				continue;
+			}
+			binof[j] = std::min(nb - 1, Int_t((std::log(radii[j]) - lrmin) * scale));
+		}
+	}
+
+	auto fill = [&]() {
+		offsets.assign(nb + 1, 0);
+		for (Int_t j = 0; j < n; j++) {
+			offsets[binof[j] + 1]++;
+		}
+		for (Int_t b = 0; b < nb; b++) {
+			offsets[b + 1] += offsets[b];
+		}
+		indices.resize(n);
+		std::vector<Int_t> next(offsets.begin(), offsets.end() - 1);
+		for (Int_t j = 0; j < n; j++) {
+			indices[next[binof[j]]++] = j;
+		}
+		binmass.assign(nb, 0);
+		binrmin.assign(nb, MAXVALUE);
+		binrmax.assign(nb, 0);
+		for (Int_t b = 0; b < nb; b++) {
+			for (Int_t k = offsets[b]; k < offsets[b + 1]; k++) {
+				Int_t j = indices[k];
+#ifdef NOMASS
+				binmass[b] += opt.MassValue;
+#else
+				binmass[b] += masses[j];
+#endif
+				binrmin[b] = std::min(binrmin[b], radii[j]);
+				binrmax[b] = std::max(binrmax[b], radii[j]);
+			}
+		}
+	};
+	fill();
+
+	// the bins must not overlap in radius, which rounding in the logarithms could break
+	Double_t rmaxbefore = 0;
+	for (Int_t b = 0; b < nb; b++) {
+		if (offsets[b + 1] == offsets[b]) {
+			continue;
+		}
+		if (binrmin[b] < rmaxbefore) {
+			nb = 1;
+			std::fill(binof.begin(), binof.end(), 0);
+			fill();
+			break;
+		}
+		rmaxbefore = binrmax[b];
+	}
+	is_sorted.assign(nb, 0);
+}
+
+int RadialBins::bin(Int_t j) const
+{
+	return std::upper_bound(offsets.begin(), offsets.end(), j) - offsets.begin() - 1;
+}
+
+Int_t RadialBins::end_within(Double_t r) const
+{
+	Int_t end = 0;
+	for (int b = 0; b < nbins(); b++) {
+		if (offsets[b + 1] == offsets[b]) {
+			continue;
+		}
+		if (binrmin[b] > r) {
+			break;
+		}
+		end = offsets[b + 1];
+	}
+	return end;
+}
+
+Int_t RadialBins::sorted(Int_t j)
+{
+	int b = bin(j);
+	sort(b);
+	return indices[j];
+}
+
+void RadialBins::sort(int b)
+{
+	if (is_sorted[b]) {
+		return;
+	}
+	std::sort(indices.begin() + offsets[b], indices.begin() + offsets[b + 1], [this](Int_t a, Int_t c) {
+		return radii[a] < radii[c] || (radii[a] == radii[c] && a < c);
+	});
+	is_sorted[b] = 1;
+}
+
+void RadialBins::sort()
+{
+	for (int b = 0; b < nbins(); b++) {
+		sort(b);
+	}
+}
+
+}  // namespace vr
@@ -0,0 +1,94 @@
+/**
+ * @file
+ *
+ * Particles around a centre bucketed by the logarithm of their radius
+ */
+
+#ifndef VR_RADIALBINS_H_
+#define VR_RADIALBINS_H_
+
+#include <vector>
+
+#include "allvars.h"
+
+
+namespace vr {
+
+/**
+ * Orders the particles around a centre by radius one bin at a time.
+ *
+ * The particles are bucketed into bins of equal width in the logarithm of the
+ * radius with a counting sort, so that every particle of a bin lies within the
+ * radii of the particles of the next bin. The total mass and the smallest and
+ * largest radius of every bin are kept. A bin is only sorted by radius when
+ * asked for, so that walks out from the centre can step over whole bins using
+ * their masses and radii and only sort the bins in which something happens.
+ * Once every bin is sorted the order is that of sorting all the particles by
+ * radius, with ties broken by index.
+ */
+class RadialBins {
+
+public:
+
+	/**
+	 * Buckets the particles.
+	 *
+	 * @param opt The options giving the masses if NOMASS is defined
+	 * @param radii The radii of the particles, which must outlive this object
+	 * @param masses The masses of the particles, unused if NOMASS is defined
+	 * @param particles_per_bin The mean number of particles in a bin
+	 */
+	RadialBins(const Options &opt, const std::vector<Double_t> &radii, const std::vector<Double_t> &masses,
+	           Int_t particles_per_bin = 32);
+
+	/// The number of particles
+	Int_t size() const { return indices.size(); }
+
+	/// The number of bins
+	int nbins() const { return offsets.size() - 1; }
+
+	/// The position of the first particle of a bin
+	Int_t begin(int b) const { return offsets[b]; }
+
+	/// The position after the last particle of a bin
+	Int_t end(int b) const { return offsets[b + 1]; }
+
+	/// The bin holding the particle at a position
+	int bin(Int_t j) const;
+
+	/// The total mass of the particles of a bin
+	Double_t mass(int b) const { return binmass[b]; }
+
+	/// The smallest radius of the particles of a bin
+	Double_t rmin(int b) const { return binrmin[b]; }
+
+	/// The largest radius of the particles of a bin
+	Double_t rmax(int b) const { return binrmax[b]; }
+
+	/// The number of particles in the bins that may hold particles within a radius
+	Int_t end_within(Double_t r) const;
+
+	/// The index of the particle at a position, ordered by radius only if its bin is sorted
+	Int_t operator[](Int_t j) const { return indices[j]; }
+
+	/// The index of the particle at a position in order of radius, sorting its bin if needed
+	Int_t sorted(Int_t j);
+
+	/// Sorts the particles of a bin by radius
+	void sort(int b);
+
+	/// Sorts the particles of every bin by radius
+	void sort();
+
+private:
+
+	const std::vector<Double_t> &radii;
+	std::vector<Int_t> indices, offsets;
+	std::vector<Double_t> binmass, binrmin, binrmax;
+	std::vector<char> is_sorted;
+
+};
+
+}  // namespace vr
+
+#endif // VR_RADIALBINS_H_
@@ -1,9 +1,6 @@
 /*! \file ramsesio.cxx
  *  \brief this file contains routines for ramses snapshot file io
  *
- * \todo need to check if amr file quantity ngrid_current is actually the number of cells in the file as
- * an example fortran code I have been given seems to also use the ngridlevel array, which stores the number of cells
- * at a given resolution level.
  * \todo need to add in ability for multiple read threads and sends between read threads
  *
  *
@@ -23,71 +20,171 @@
 #include "ramsesitems.h"
 #include "endianutils.h"
 
+#include <random>
 
-int RAMSES_fortran_read(fstream &F, int &i){
-    int dummy,byteoffset=0;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    F.read((char*)&i,sizeof(int)); byteoffset+=dummy;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    return byteoffset;
-}
-int RAMSES_fortran_read(fstream &F, RAMSESFLOAT &f){
-    int dummy,byteoffset=0;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    F.read((char*)&f,sizeof(RAMSESFLOAT)); byteoffset+=dummy;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    return byteoffset;
-}
-int RAMSES_fortran_read(fstream &F, int *i){
-    int dummy,byteoffset=0;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    F.read((char*)i,dummy); byteoffset+=dummy;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    return byteoffset;
-}
-int RAMSES_fortran_read(fstream &F, unsigned int *i){
-    int dummy,byteoffset=0;
-    F.read((char*)&dummy, sizeof(dummy)); byteoffset += sizeof(int);
-    F.read((char*)i,dummy);               byteoffset += dummy;
-    F.read((char*)&dummy, sizeof(dummy)); byteoffset += sizeof(int);
-    return byteoffset;
-}
-int RAMSES_fortran_read(fstream &F, long long *i){
-    int dummy,byteoffset=0;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    F.read((char*)i,dummy); byteoffset+=dummy;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    return byteoffset;
+string RAMSES_file_name(Options &opt, const char *kind, int ifile)
+{
+    char buf[2000];
+    sprintf(buf,"%s/%s_%s.out%05d",opt.fname,kind,opt.ramsessnapname,ifile+1);
+    if (FileExists(buf)) return string(buf);
+    sprintf(buf,"%s/%s_%s.out",opt.fname,kind,opt.ramsessnapname);
+    return string(buf);
 }
-int RAMSES_fortran_read(fstream &F, RAMSESFLOAT *f){
-    int dummy,byteoffset=0;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    F.read((char*)f,dummy); byteoffset+=dummy;
-    F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-    return byteoffset;
+
+/*! Reads the particles of a part_ file. The file holds a header of \ref RAMSESPARTNHEADERRECORDS records
+    (ncpu, ndim, npart, seeds, nstar_tot, mstar_tot, mstar_lost, nsink) followed by one record per field,
+    each coordinate of the positions and velocities having its own record, then mass, id, level, and for runs
+    with star formation, birth epoch and metallicity. Only the records of the requested fields are copied.
+    Files without birth epochs give ages of zero.
+*/
+bool RAMSES_read_part_file(Options &opt, int ifile, RAMSES_Part_Data &data, int fields)
+{
+    Fortran_Record_File F;
+    string fname=RAMSES_file_name(opt, "part", ifile);
+    data.npart=0;
+    if (!F.open(fname) || !F.holds<int>(RAMSESPARTNHEADERRECORDS-1, 0)) {
+        LOG(error) << "Could not read RAMSES particle file " << fname;
+        return false;
+    }
+    data.ndim=F.get<int>(1, 0);
+    data.npart=F.get<int>(2, 0);
+    data.nsink=F.get<int>(RAMSESPARTNHEADERRECORDS-1, 0);
+    int ndim=data.ndim, irecord=RAMSESPARTNHEADERRECORDS;
+    size_t n=data.npart;
+    int imass=irecord+2*ndim, iid=imass+1, iage=imass+3;
+    if (!F.holds<RAMSESFLOAT>(imass, n) || !F.holds<RAMSESIDTYPE>(iid, n)) {
+        LOG(error) << "RAMSES particle file " << fname << " does not hold the expected records";
+        return false;
+    }
+    if (fields & RAMSESPARTPOS) {
+        data.x.resize(ndim*n);
+        for (auto idim=0;idim<ndim;idim++) F.read(irecord+idim, &data.x[idim*n], n);
+    }
+    if (fields & RAMSESPARTVEL) {
+        data.v.resize(ndim*n);
+        for (auto idim=0;idim<ndim;idim++) F.read(irecord+ndim+idim, &data.v[idim*n], n);
+    }
+    if (fields & RAMSESPARTMASS) {
+        data.m.resize(n);
+        F.read(imass, data.m.data(), n);
+    }
+    if (fields & RAMSESPARTID) {
+        data.id.resize(n);
+        F.read(iid, data.id.data(), n);
+    }
+    if (fields & RAMSESPARTAGE) {
+        data.age.assign(n, 0);
+        if (F.holds<RAMSESFLOAT>(iage, n)) F.read(iage, data.age.data(), n);
+    }
+    return true;
 }
 
-int RAMSES_fortran_skip(fstream &F, int nskips){
-    int dummy,byteoffset=0;
-    for (int i=0;i<nskips;i++) {
-        F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
-        F.seekg(dummy,ios::cur); byteoffset+=dummy;
-        F.read((char*)&dummy, sizeof(dummy));byteoffset+=sizeof(int);
+/*! Reads the gas cells of a cpu from its amr_ and hydro_ files. Each file holds the grids of every cpu and boundary
+    list at each level, of which only those owned by the cpu are read. Every leaf cell, one without a son or at the
+    maximum level, gives a gas cell placed at a random point within it, drawn from a generator seeded by the cpu
+    so that the same positions are found whenever the file is read.
+
+    The amr_ header holds ncpu, ndim, (nx,ny,nz), nlevelmax, ngridmax, nboundary, ngrid_current, boxlen and 11 more
+    records, then headl, taill, numbl and numbtot, followed for boundaries by headb, tailb and numbb, then the free
+    memory counters, the ordering, 5 bisection records or the hilbert keys, and 3 records of the coarse level.
+    Each grid list then has 3 records of grid indices, ndim of centres, the father, 2*ndim of neighbours and
+    2^ndim each of sons, cpu map and refinement map. The hydro_ file has 6 header records (ncpu, nvarh, ndim,
+    nlevelmax, nboundary, gamma) and for each grid list its level and number of grids followed by one record
+    per cell of the grid and variable.
+*/
+bool RAMSES_read_gas_file(Options &opt, int ifile, RAMSES_Gas_Data &data, int fields)
+{
+    Fortran_Record_File Famr, Fhydro;
+    string famrname=RAMSES_file_name(opt, "amr", ifile), fhydroname=RAMSES_file_name(opt, "hydro", ifile);
+    data=RAMSES_Gas_Data();
+    if (!Famr.open(famrname) || !Famr.holds<int>(5, 1)) {
+        LOG(error) << "Could not read RAMSES amr file " << famrname;
+        return false;
+    }
+    bool ihydro=(fields & RAMSESGASHYDRO);
+    if (ihydro && (!Fhydro.open(fhydroname) || !Fhydro.holds<RAMSESFLOAT>(5, 1))) {
+        LOG(error) << "Could not read RAMSES hydro file " << fhydroname;
+        return false;
+    }
+    int ncpu=Famr.get<int>(0, 0), ndim=Famr.get<int>(1, 0), nlevelmax=Famr.get<int>(3, 0), nboundary=Famr.get<int>(5, 0);
+    int twotondim=1<<ndim, icpu=ifile+1;
+    if (ndim!=3) {
+        LOG(error) << "RAMSES amr file " << famrname << " has " << ndim << " dimensions, only 3 are supported";
+        return false;
     }
-    return byteoffset;
+    //grids per cpu and level, numbl(1:ncpu,1:nlevelmax), and per boundary and level, numbb(1:nboundary,1:nlevelmax)
+    int inumbl=21, inumbb=(nboundary>0)?25:-1;
+    int irecord=(nboundary>0)?26:23;
+    irecord++;
+    bool ibisection=(Famr.get_string(irecord).find("bisection")!=string::npos);
+    irecord+=1+(ibisection?5:1)+3;
+    if (!Famr.holds<int>(inumbl, (size_t)ncpu*nlevelmax) || (nboundary>0 && !Famr.holds<int>(inumbb, (size_t)nboundary*nlevelmax))) {
+        LOG(error) << "RAMSES amr file " << famrname << " does not hold the expected header";
+        return false;
+    }
+    int nvarh=0, jrecord=6;
+    RAMSESFLOAT gamma_index=0;
+    if (ihydro) {
+        nvarh=Fhydro.get<int>(1, 0);
+        gamma_index=Fhydro.get<RAMSESFLOAT>(5, 0);
+        if (nvarh<5) {
+            LOG(error) << "RAMSES hydro file " << fhydroname << " has " << nvarh << " variables, at least density, velocities and pressure are needed";
+            return false;
+        }
+    }
+    mt19937 generator(icpu);
+    uniform_real_distribution<double> jitter(-0.5, 0.5);
+
+    for (auto ilevel=1;ilevel<=nlevelmax;ilevel++) {
+        double dx=ldexp(1.0, -ilevel);
+        for (auto ibound=1;ibound<=ncpu+nboundary;ibound++) {
+            size_t ncache=(ibound<=ncpu)?Famr.get<int>(inumbl, (ibound-1)+(size_t)ncpu*(ilevel-1))
+                :Famr.get<int>(inumbb, (ibound-ncpu-1)+(size_t)nboundary*(ilevel-1));
+            jrecord+=2;
+            if (ncache==0) continue;
+            int ixg=irecord+3, ison=ixg+ndim+1+2*ndim, ivar=jrecord;
+            irecord=ison+3*twotondim;
+            if (ihydro) jrecord+=twotondim*nvarh;
+            if (ibound!=icpu) continue;
+            if (!Famr.holds<int>(ison+twotondim-1, ncache) || !Famr.holds<RAMSESFLOAT>(ixg+ndim-1, ncache)
+                || (ihydro && !Fhydro.holds<RAMSESFLOAT>(jrecord-1, ncache))) {
+                LOG(error) << "RAMSES amr file " << famrname << " or its hydro file does not hold the grids of level " << ilevel;
+                return false;
+            }
+            for (auto ind=0;ind<twotondim;ind++) {
+                //offset of the cell within its grid
+                int iz=ind/4, iy=(ind-4*iz)/2, ix=ind-2*iy-4*iz;
+                double offset[3]={(ix-0.5)*dx, (iy-0.5)*dx, (iz-0.5)*dx};
+                for (size_t igrid=0;igrid<ncache;igrid++) {
+                    if (Famr.get<int>(ison+ind, igrid)!=0 && ilevel<nlevelmax) continue;
+                    data.ncell++;
+                    if (fields & RAMSESGASPOS) {
+                        for (auto idim=0;idim<3;idim++) data.x.push_back(Famr.get<RAMSESFLOAT>(ixg+idim, igrid)+offset[idim]+jitter(generator)*dx);
+                    }
+                    if (ihydro) {
+                        int ivarcell=ivar+ind*nvarh;
+                        RAMSESFLOAT rho=Fhydro.get<RAMSESFLOAT>(ivarcell, igrid);
+                        for (auto idim=0;idim<3;idim++) data.v.push_back(Fhydro.get<RAMSESFLOAT>(ivarcell+1+idim, igrid));
+                        data.rho.push_back(rho);
+                        data.m.push_back(rho*dx*dx*dx);
+                        //the specific internal energy is P/rho/(gamma-1)
+                        data.u.push_back(Fhydro.get<RAMSESFLOAT>(ivarcell+4, igrid)/rho/(gamma_index-1.0));
+                        data.Z.push_back((nvarh>5)?Fhydro.get<RAMSESFLOAT>(ivarcell+5, igrid):0);
+                    }
+                }
+            }
+        }
+    }
+    return true;
 }
 
 Int_t RAMSES_get_nbodies(char *fname, int ptype, Options &opt)
 {
     char buf[2000],buf1[2000],buf2[2000];
-    double * dummy_age, * dummy_mass;
     double dmp_mass;
     double OmegaM, OmegaB;
     int totalghost = 0;
-    int totalstars = 0;
-    int totaldm    = 0;
     int alltotal   = 0;
-    int ghoststars = 0;
     string stringbuf;
     int ninputoffset = 0;
     sprintf(buf1,"%s/amr_%s.out00001",fname,opt.ramsessnapname);
@@ -118,16 +215,9 @@ Int_t RAMSES_get_nbodies(char *fname, int ptype, Options &opt)
         exit(9);
     }
 
-    fstream Framses;
     RAMSES_Header ramses_header_info;
-    //buffers to load data
-    int intbuff[NRAMSESTYPE];
-    long long longbuff[NRAMSESTYPE];
-    int i,j,k,ireaderror=0;
     Int_t nbodies=0;
-    //IntType inttype;
-    int dummy;
-
+    int i,j,k;
     int nusetypes,usetypes[NRAMSESTYPE];
 
     if (ptype==PSTALL) {nusetypes=4;usetypes[0]=RAMSESGASTYPE;usetypes[1]=RAMSESDMTYPE;usetypes[2]=RAMSESSTARTYPE;usetypes[3]=RAMSESBHTYPE;}
@@ -139,136 +229,46 @@ Int_t RAMSES_get_nbodies(char *fname, int ptype, Options &opt)
 
     for (j = 0; j < NRAMSESTYPE; j++) ramses_header_info.npartTotal[j] = 0;
 
-    //Open the specified file and the specified dataset in the file.
-    //first open amr data
-    sprintf(buf1,"%s/amr_%s.out00001",fname,opt.ramsessnapname);
-    sprintf(buf2,"%s/amr_%s.out",fname,opt.ramsessnapname);
-    if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-    else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-    Framses.open(buf, ios::binary|ios::in);
-    //read header info
-    //this is based on a ramsestotipsy fortran code that does not detail everything in the header block but at least its informative. The example has
-    /*
-    read(10)ncpu
-    read(10)ndim
-    read(10)nx,ny,nz
-    read(10)nlevelmax
-    read(10)ngridmax
-    read(10)nboundary
-    read(10)ngrid_current
-    read(10)boxlen
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)
-    read(10)msph
-    close(10)
-    */
-
-    // Number of files
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.num_files, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-    opt.num_files=ramses_header_info.num_files;
-
-    // Number of dimensions
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.ndim, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    //
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.nx, sizeof(int));
-    Framses.read((char*)&ramses_header_info.ny, sizeof(int));
-    Framses.read((char*)&ramses_header_info.nz, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    // Maximum refinement level
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.nlevelmax, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    //
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.ngridmax, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    //
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.nboundary, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    //this would be number of active grids but ignore for now
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.seekg(dummy,ios::cur);
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    // Boxsize
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.BoxSize, sizeof(RAMSESFLOAT));
-    Framses.read((char*)&dummy, sizeof(dummy));
-
-    //now skip 10 blocks
-    for (i=0;i<10;i++) {
-        Framses.read((char*)&dummy, sizeof(dummy));
-        //skip block size given by dummy
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
+    //read the header of the first amr file, which holds ncpu, ndim, (nx,ny,nz), nlevelmax, ngridmax, nboundary,
+    //ngrid_current, boxlen, 10 records of output times and cosmology and then mass_sph
+    {
+        Fortran_Record_File Framses;
+        if (!Framses.open(RAMSES_file_name(opt, "amr", 0)) || !Framses.holds<RAMSESFLOAT>(18, 1)) {
+            printf("Error. Can't read header of AMR data `%s'\n\n", RAMSES_file_name(opt, "amr", 0).c_str());
+            exit(9);
+        }
+        ramses_header_info.num_files=Framses.get<int>(0, 0);
+        ramses_header_info.ndim=Framses.get<int>(1, 0);
+        ramses_header_info.nx=Framses.get<int>(2, 0);
+        ramses_header_info.ny=Framses.get<int>(2, 1);
+        ramses_header_info.nz=Framses.get<int>(2, 2);
+        ramses_header_info.nlevelmax=Framses.get<int>(3, 0);
+        ramses_header_info.ngridmax=Framses.get<int>(4, 0);
+        ramses_header_info.nboundary=Framses.get<int>(5, 0);
+        ramses_header_info.BoxSize=Framses.get<RAMSESFLOAT>(7, 0);
+        ramses_header_info.mass[RAMSESGASTYPE]=Framses.get<RAMSESFLOAT>(18, 0);
+        opt.num_files=ramses_header_info.num_files;
     }
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.mass[RAMSESGASTYPE], sizeof(RAMSESFLOAT));
-    Framses.read((char*)&dummy, sizeof(dummy));
 
-    Framses.close();
-
-    //reopen to get number of amr cells might need to alter to read grid information and what cells have no so-called son cells
+    //number of gas cells is the number of leaf cells of each cpu
     if (opt.partsearchtype==PSTGAS||opt.partsearchtype==PSTALL||(opt.partsearchtype==PSTDARK&&opt.iBaryonSearch)) {
+    Int_t ngas=0;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ngas)
+#endif
     for (i=0;i<ramses_header_info.num_files;i++) {
-        sprintf(buf1,"%s/amr_%s.out%05d",fname,opt.ramsessnapname,i+1);
-        sprintf(buf2,"%s/amr_%s.out",fname,opt.ramsessnapname);
-        if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-        else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-        Framses.open(buf, ios::binary|ios::in);
-        for (j=0;j<6;j++) {
-            Framses.read((char*)&dummy, sizeof(dummy));
-            Framses.seekg(dummy,ios::cur);
-            Framses.read((char*)&dummy, sizeof(dummy));
-        }
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.read((char*)&ramses_header_info.npart[RAMSESGASTYPE], sizeof(int));
-        Framses.read((char*)&dummy, sizeof(dummy));
-        ramses_header_info.npartTotal[RAMSESGASTYPE]+=ramses_header_info.npart[RAMSESGASTYPE];
+        RAMSES_Gas_Data gas;
+        RAMSES_read_gas_file(opt, i, gas, 0);
+        ngas+=gas.ncell;
     }
+    ramses_header_info.npartTotal[RAMSESGASTYPE]=ngas;
 
     //now hydro header data
-    sprintf(buf1,"%s/hydro_%s.out00001",fname,opt.ramsessnapname);
-    sprintf(buf2,"%s/hydro_%s.out",fname,opt.ramsessnapname);
-    if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-    else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-    Framses.open(buf, ios::binary|ios::in);
-
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.seekg(dummy,ios::cur);
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.nvarh, sizeof(int));
-    Framses.read((char*)&dummy, sizeof(dummy));
-    for (i=0;i<3;i++) {
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
+    Fortran_Record_File Framses;
+    if (Framses.open(RAMSES_file_name(opt, "hydro", 0)) && Framses.holds<RAMSESFLOAT>(5, 1)) {
+        ramses_header_info.nvarh=Framses.get<int>(1, 0);
+        ramses_header_info.gamma_index=Framses.get<RAMSESFLOAT>(5, 0);
     }
-
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.read((char*)&ramses_header_info.gamma_index, sizeof(RAMSESFLOAT));
-    Framses.read((char*)&dummy, sizeof(dummy));
-    Framses.close();
     }
 
 
@@ -297,118 +297,29 @@ Int_t RAMSES_get_nbodies(char *fname, int ptype, Options &opt)
     Finfo.close();
     dmp_mass = 1.0 / (opt.Neff*opt.Neff*opt.Neff) * (OmegaM - OmegaB) / OmegaM;
 
-    //now particle info
+    //now particle info, where the type of a particle is set by its mass and age, with particles that are not dark
+    //matter but have no age being ghosts
+    Int_t ndm=0, nstar=0;
+    int nsink=0;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ndm,nstar,totalghost,alltotal) reduction(max:nsink)
+#endif
     for (i=0;i<ramses_header_info.num_files;i++)
     {
-        sprintf(buf1,"%s/part_%s.out%05d",fname,opt.ramsessnapname,i+1);
-        sprintf(buf2,"%s/part_%s.out",fname,opt.ramsessnapname);
-        if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-        else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-        Framses.open(buf, ios::binary|ios::in);
-
-        ramses_header_info.npart[RAMSESDMTYPE]   = 0;
-        ramses_header_info.npart[RAMSESSTARTYPE] = 0;
-        ramses_header_info.npart[RAMSESSINKTYPE] = 0;
-
-        //number of cpus
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        //number of dimensions
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Total number of LOCAL particles
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.read((char*)&ramses_header_info.npartlocal, sizeof(int));
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Random seeds
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Total number of Stars over all processors
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.read((char*)&ramses_header_info.nstarTotal, sizeof(int));
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Total mass of stars
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Total lost mass of stars
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Number of sink particles over the whole simulation (all are included in
-        // all processors)
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.read((char*)&ramses_header_info.npartTotal[RAMSESSINKTYPE], sizeof(int));
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        //to determine how many particles of each type, need to look at the mass
-        // Skip pos, vel, mass
-        for (j = 0; j < 6; j++)
-        {
-            Framses.read((char*)&dummy, sizeof(dummy));
-            Framses.seekg(dummy,ios::cur);
-            Framses.read((char*)&dummy, sizeof(dummy));
-        }
-        //allocate memory to store masses and ages
-        dummy_mass = new double [ramses_header_info.npartlocal];
-        dummy_age  = new double [ramses_header_info.npartlocal];
-
-        // Read Mass
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.read((char*)&dummy_mass[0], dummy);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Skip Id
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Skip level
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.seekg(dummy,ios::cur);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        // Read Birth epoch
-        //necessary to separate ghost star particles with negative ages from real one
-        Framses.read((char*)&dummy, sizeof(dummy));
-        Framses.read((char*)&dummy_age[0], dummy);
-        Framses.read((char*)&dummy, sizeof(dummy));
-
-        ghoststars = 0;
-        for (j = 0; j < ramses_header_info.npartlocal; j++)
+        RAMSES_Part_Data partdata;
+        if (!RAMSES_read_part_file(opt, i, partdata, RAMSESPARTMASS|RAMSESPARTAGE)) continue;
+        nsink=max(nsink, partdata.nsink);
+        for (j = 0; j < partdata.npart; j++)
         {
-            if (fabs((dummy_mass[j]-dmp_mass)/dmp_mass) < 1e-5)
-                ramses_header_info.npart[RAMSESDMTYPE]++;
-            else
-                if (dummy_age[j] != 0.0)
-                    ramses_header_info.npart[RAMSESSTARTYPE]++;
-                else
-                ghoststars++;
+            if (fabs((partdata.m[j]-dmp_mass)/dmp_mass) < 1e-5) ndm++;
+            else if (partdata.age[j] != 0.0) nstar++;
+            else totalghost++;
         }
-        delete [] dummy_age;
-        delete [] dummy_mass;
-        Framses.close();
-
-        totalghost += ghoststars;
-        totalstars += ramses_header_info.npart[RAMSESSTARTYPE];
-        totaldm    += ramses_header_info.npart[RAMSESDMTYPE];
-        alltotal   += ramses_header_info.npartlocal;
-
-        //now with information loaded, set totals
-        ramses_header_info.npartTotal[RAMSESDMTYPE]+=ramses_header_info.npart[RAMSESDMTYPE];
-        ramses_header_info.npartTotal[RAMSESSTARTYPE]+=ramses_header_info.npart[RAMSESSTARTYPE];
-        ramses_header_info.npartTotal[RAMSESSINKTYPE]+=ramses_header_info.npart[RAMSESSINKTYPE];
+        alltotal += partdata.npart;
     }
+    ramses_header_info.npartTotal[RAMSESDMTYPE]=ndm;
+    ramses_header_info.npartTotal[RAMSESSTARTYPE]=nstar;
+    ramses_header_info.npartTotal[RAMSESSINKTYPE]=nsink;
     for(j=0, nbodies=0; j<nusetypes; j++) {
         k=usetypes[j];
         nbodies+=ramses_header_info.npartTotal[k];
@@ -430,19 +341,15 @@ Int_t RAMSES_get_nbodies(char *fname, int ptype, Options &opt)
 /// header and overrides passed cosmological parameters with ones stored in header.
 void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Particle *&Pbaryons, Int_t nbaryons)
 {
-    char buf[2000],buf1[2000],buf2[2000];
+    char buf1[2000];
     string stringbuf,orderingstring;
     fstream Finfo;
-    fstream *Famr;
-    fstream *Fhydro;
-    fstream *Fpart, *Fpartvel,*Fpartid,*Fpartmass, *Fpartlevel, *Fpartage, *Fpartmet;
     RAMSES_Header *header;
     int intbuff[NRAMSESTYPE];
     long long longbuff[NRAMSESTYPE];
-    int i,j,k,n,idim,ivar,igrid,ireaderror=0;
+    int i,n,idim,ireaderror=0;
     Int_t count2,bcount2;
     //IntType inttype;
-    int dummy,byteoffset;
     Double_t MP_DM=MAXVALUE,LN,N_DM,MP_B=0;
     double z,aadjust,Hubble,Hubbleflow;
     Double_t mscale,lscale,lvscale,rhoscale;
@@ -452,8 +359,6 @@ void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Parti
     RAMSESIDTYPE idval;
     int typeval;
     RAMSESFLOAT ageval,metval;
-    int *ngridlevel,*ngridbound,*ngridfile;
-    int lmin=1000000,lmax=0;
     double dmp_mass;
 
     int ninputoffset = 0;
@@ -468,22 +373,18 @@ void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Parti
     MPI_Bcast (&(opt.num_files), sizeof(opt.num_files), MPI_BYTE, 0, MPI_COMM_WORLD);
     MPI_Barrier (MPI_COMM_WORLD);
 #endif
-    ///\todo because of the stupid fortran format, easier if chunksize is BIG so that
-    ///number of particles local to a file are smaller
-    Int_t chunksize=RAMSESCHUNKSIZE,nchunk;
-    RAMSESFLOAT *xtempchunk, *vtempchunk, *mtempchunk, *sphtempchunk, *agetempchunk, *mettempchunk, *hydrotempchunk;
-    RAMSESIDTYPE *idvalchunk, *levelchunk;
-    int *icellchunk;
+    Int_t nchunk;
+    RAMSESFLOAT *xtempchunk, *vtempchunk, *mtempchunk, *agetempchunk;
+    RAMSESIDTYPE *idvalchunk;
+    //files decoded at once, each by its own thread
+    int nreadbatch=1;
+#ifdef USEOPENMP
+    nreadbatch=omp_get_max_threads();
+#endif
+    vector<int> readfiles;
+    vector<RAMSES_Part_Data> partdata;
+    vector<RAMSES_Gas_Data> gasdata;
 
-    Famr       = new fstream[opt.num_files];
-    Fhydro     = new fstream[opt.num_files];
-    Fpart      = new fstream[opt.num_files];
-    Fpartvel   = new fstream[opt.num_files];
-    Fpartmass  = new fstream[opt.num_files];
-    Fpartid    = new fstream[opt.num_files];
-    Fpartlevel = new fstream[opt.num_files];
-    Fpartage   = new fstream[opt.num_files];
-    Fpartmet   = new fstream[opt.num_files];
     header     = new RAMSES_Header[opt.num_files];
 
     Particle *Pbuf;
@@ -635,13 +536,15 @@ void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Parti
     opt.ellxscale = LN;
 
     //grab from the first particle file the dimensions of the arrays and also the number of cpus (should be number of files)
-    sprintf(buf1,"%s/part_%s.out00001",opt.fname,opt.ramsessnapname);
-    Fpart[ifirstfile].open(buf1, ios::binary|ios::in);
-    RAMSES_fortran_read(Fpart[ifirstfile],header[ifirstfile].nfiles);
-    RAMSES_fortran_read(Fpart[ifirstfile],header[ifirstfile].ndim);
-    //adjust the number of files
-    opt.num_files=header[ifirstfile].nfiles;
-    Fpart[ifirstfile].close();
+    {
+        Fortran_Record_File Fpart;
+        if (Fpart.open(RAMSES_file_name(opt, "part", 0)) && Fpart.holds<int>(1, 1)) {
+            header[ifirstfile].nfiles=Fpart.get<int>(0, 0);
+            header[ifirstfile].ndim=Fpart.get<int>(1, 0);
+            //adjust the number of files
+            opt.num_files=header[ifirstfile].nfiles;
+        }
+    }
 #ifdef USEMPI
     //now read tasks prepped and can read files to send information
     }
@@ -664,206 +567,109 @@ void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Parti
         inreadsend=0;
 #endif
     //read particle files consists of positions,velocities, mass, id, and level (along with ages and met if some flags set)
-    for (i=0;i<opt.num_files;i++) {
-    if (ireadfile[i]) {
-        sprintf(buf1,"%s/part_%s.out%05d",opt.fname,opt.ramsessnapname,i+1);
-        sprintf(buf2,"%s/part_%s.out",opt.fname,opt.ramsessnapname);
-        if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-        else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-        Fpart[i].open(buf, ios::binary|ios::in);
-        Fpartvel[i].open(buf, ios::binary|ios::in);
-        Fpartmass[i].open(buf, ios::binary|ios::in);
-        Fpartid[i].open(buf, ios::binary|ios::in);
-        Fpartlevel[i].open(buf, ios::binary|ios::in);
-        Fpartage[i].open(buf, ios::binary|ios::in);
-        Fpartmet[i].open(buf, ios::binary|ios::in);
-
-        //skip header information in each file save for number in the file
-        //@{
-        byteoffset=0;
-        // ncpus
-        byteoffset+=RAMSES_fortran_skip(Fpart[i]);
-        // ndims
-        byteoffset+=RAMSES_fortran_skip(Fpart[i]);
-        // store number of particles locally in file
-        byteoffset+=RAMSES_fortran_read(Fpart[i],header[i].npartlocal);
-        // skip local seeds, nstartot, mstartot, mstarlost, nsink
-        byteoffset+=RAMSES_fortran_skip(Fpart[i],5);
-
-        //byteoffset now stores size of header offset for particles
-        Fpartvel[i].seekg(byteoffset,ios::cur);
-        Fpartmass[i].seekg(byteoffset,ios::cur);
-        Fpartid[i].seekg(byteoffset,ios::cur);
-        Fpartlevel[i].seekg(byteoffset,ios::cur);
-        Fpartage[i].seekg(byteoffset,ios::cur);
-        Fpartmet[i].seekg(byteoffset,ios::cur);
-        //skip positions
-        for(idim=0;idim<header[ifirstfile].ndim;idim++)
-        {
-            RAMSES_fortran_skip(Fpartvel[i]);
-            RAMSES_fortran_skip(Fpartmass[i]);
-            RAMSES_fortran_skip(Fpartid[i]);
-            RAMSES_fortran_skip(Fpartlevel[i]);
-            RAMSES_fortran_skip(Fpartage[i]);
-            RAMSES_fortran_skip(Fpartmet[i]);
-        }
-        //skip velocities
-        for(idim=0;idim<header[ifirstfile].ndim;idim++)
-        {
-            RAMSES_fortran_skip(Fpartmass[i]);
-            RAMSES_fortran_skip(Fpartid[i]);
-            RAMSES_fortran_skip(Fpartlevel[i]);
-            RAMSES_fortran_skip(Fpartage[i]);
-            RAMSES_fortran_skip(Fpartmet[i]);
+    //files are decoded in batches, one per thread, and their particles then placed in file order
+    for (i=0;i<opt.num_files;i++) if (ireadfile[i]) readfiles.push_back(i);
+    partdata.resize(min(nreadbatch,(int)readfiles.size()));
+    for (size_t ibatch=0;ibatch<readfiles.size();ibatch+=nreadbatch) {
+        int nbatchfiles=min((size_t)nreadbatch,readfiles.size()-ibatch);
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ireaderror) if (nbatchfiles>1)
+#endif
+        for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+            if (!RAMSES_read_part_file(opt, readfiles[ibatch+ibatchfile], partdata[ibatchfile],
+                RAMSESPARTPOS|RAMSESPARTVEL|RAMSESPARTMASS|RAMSESPARTID|RAMSESPARTAGE)) ireaderror++;
         }
-        //skip mass
-        RAMSES_fortran_skip(Fpartid[i]);
-        RAMSES_fortran_skip(Fpartlevel[i]);
-        RAMSES_fortran_skip(Fpartage[i]);
-        RAMSES_fortran_skip(Fpartmet[i]);
-        //skip ids;
-        RAMSES_fortran_skip(Fpartlevel[i]);
-        RAMSES_fortran_skip(Fpartage[i]);
-        RAMSES_fortran_skip(Fpartmet[i]);
-        //skip levels
-        RAMSES_fortran_skip(Fpartage[i]);
-        RAMSES_fortran_skip(Fpartmet[i]);
-        //skip ages
-        RAMSES_fortran_skip(Fpartmet[i]);
-        //@}
-
-        //data loaded into memory in chunks
-        chunksize    = nchunk = header[i].npartlocal;
-        ninputoffset = 0;
-        xtempchunk   = new RAMSESFLOAT  [3*chunksize];
-        vtempchunk   = new RAMSESFLOAT  [3*chunksize];
-        mtempchunk   = new RAMSESFLOAT  [chunksize];
-        idvalchunk   = new RAMSESIDTYPE [chunksize];
-        levelchunk   = new RAMSESIDTYPE [chunksize];
-        agetempchunk = new RAMSESFLOAT  [chunksize];
-        mettempchunk = new RAMSESFLOAT  [chunksize];
-
-        for(idim=0;idim<header[ifirstfile].ndim;idim++)
-        {
-            RAMSES_fortran_read(Fpart[i],&xtempchunk[idim*nchunk]);
-            RAMSES_fortran_read(Fpartvel[i],&vtempchunk[idim*nchunk]);
+        //a file that cannot be read would leave the particle counts inconsistent with the header
+        if (ireaderror>0) {
+            LOG(error) << "Could not read " << ireaderror << " RAMSES particle files, exiting";
+#ifdef USEMPI
+            MPI_Abort(MPI_COMM_WORLD,9);
+#else
+            exit(9);
+#endif
         }
-        RAMSES_fortran_read(Fpartmass[i],  mtempchunk);
-        RAMSES_fortran_read(Fpartid[i],    idvalchunk);
-        RAMSES_fortran_read(Fpartlevel[i], levelchunk);
-        RAMSES_fortran_read(Fpartage[i],   agetempchunk);
-        RAMSES_fortran_read(Fpartmet[i],   mettempchunk);
-
-        RAMSES_fortran_read(Fpartid[i],idvalchunk);
-        for (int nn=0;nn<nchunk;nn++)
-        {
-            if (fabs((mtempchunk[nn]-dmp_mass)/dmp_mass) > 1e-5 && (agetempchunk[nn] == 0.0))
-            {
-              //  GHOST PARTIRCLE!!!
-            }
-            else
+        for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+            i=readfiles[ibatch+ibatchfile];
+            RAMSES_Part_Data &data=partdata[ibatchfile];
+            nchunk       = data.npart;
+            ninputoffset = 0;
+            xtempchunk   = data.x.data();
+            vtempchunk   = data.v.data();
+            mtempchunk   = data.m.data();
+            idvalchunk   = data.id.data();
+            agetempchunk = data.age.data();
+
+            for (int nn=0;nn<nchunk;nn++)
             {
-                xtemp[0] = xtempchunk[nn];
-                xtemp[1] = xtempchunk[nn+nchunk];
-                xtemp[2] = xtempchunk[nn+2*nchunk];
+                if (fabs((mtempchunk[nn]-dmp_mass)/dmp_mass) > 1e-5 && (agetempchunk[nn] == 0.0))
+                {
+                  //  GHOST PARTIRCLE!!!
+                }
+                else
+                {
+                    xtemp[0] = xtempchunk[nn];
+                    xtemp[1] = xtempchunk[nn+nchunk];
+                    xtemp[2] = xtempchunk[nn+2*nchunk];
 
-                vtemp[0] = vtempchunk[nn];
-                vtemp[1] = vtempchunk[nn+nchunk];
-                vtemp[2] = vtempchunk[nn+2*nchunk];
+                    vtemp[0] = vtempchunk[nn];
+                    vtemp[1] = vtempchunk[nn+nchunk];
+                    vtemp[2] = vtempchunk[nn+2*nchunk];
 
-                idval = idvalchunk[nn];
+                    idval = idvalchunk[nn];
 
-                ///Need to check this for correct 'endianness'
+                    ///Need to check this for correct 'endianness'
 //             for (int kk=0;kk<3;kk++) {xtemp[kk]=LittleRAMSESFLOAT(xtemp[kk]);vtemp[kk]=LittleRAMSESFLOAT(vtemp[kk]);}
 #ifndef NOMASS
-            mtemp=mtempchunk[nn];
+                mtemp=mtempchunk[nn];
 #else
-            mtemp=1.0;
+                mtemp=1.0;
 #endif
-            ageval = agetempchunk[nn];
-            if (fabs((mtemp-dmp_mass)/dmp_mass) < 1e-5) typeval = DARKTYPE;
-            else typeval = STARTYPE;
+                ageval = agetempchunk[nn];
+                if (fabs((mtemp-dmp_mass)/dmp_mass) < 1e-5) typeval = DARKTYPE;
+                else typeval = STARTYPE;
 /*
-            if (ageval==0 && idval>0) typeval=DARKTYPE;
-            else if (idval>0) typeval=STARTYPE;
-            else typeval=BHTYPE;
+                if (ageval==0 && idval>0) typeval=DARKTYPE;
+                else if (idval>0) typeval=STARTYPE;
+                else typeval=BHTYPE;
 */
 #ifdef USEMPI
-            //determine processor this particle belongs on based on its spatial position
-            ibuf=MPIGetParticlesProcessor(opt, xtemp[0],xtemp[1],xtemp[2]);
-            ibufindex=ibuf*BufSize+Nbuf[ibuf];
+                //determine processor this particle belongs on based on its spatial position
+                ibuf=MPIGetParticlesProcessor(opt, xtemp[0],xtemp[1],xtemp[2]);
+                ibufindex=ibuf*BufSize+Nbuf[ibuf];
 #endif
-            //reset hydro quantities of buffer
+                //reset hydro quantities of buffer
 #ifdef USEMPI
 #ifdef GASON
-            Pbuf[ibufindex].SetU(0);
+                Pbuf[ibufindex].SetU(0);
 #ifdef STARON
-            Pbuf[ibufindex].SetSFR(0);
-            Pbuf[ibufindex].SetZmet(0);
+                Pbuf[ibufindex].SetSFR(0);
+                Pbuf[ibufindex].SetZmet(0);
 #endif
 #endif
 #ifdef STARON
-            Pbuf[ibufindex].SetZmet(0);
-            Pbuf[ibufindex].SetTage(0);
+                Pbuf[ibufindex].SetZmet(0);
+                Pbuf[ibufindex].SetTage(0);
 #endif
 #ifdef BHON
 #endif
 #endif
 
-            if (opt.partsearchtype==PSTALL) {
-#ifdef USEMPI
-                Pbuf[ibufindex]=Particle(mtemp*mscale,
-                    xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
-                    vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
-                    vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
-                    vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                    count2,typeval);
-                Pbuf[ibufindex].SetPID(idval);
-#ifdef EXTRAINPUTINFO
-                if (opt.iextendedoutput)
-                {
-                    Part[ibufindex].SetInputFileID(i);
-                    Part[ibufindex].SetInputIndexInFile(nn+ninputoffset);
-                }
-#endif
-                Nbuf[ibuf]++;
-                MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
-#else
-                Part[count2]=Particle(mtemp*mscale,
-                    xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
-                    vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
-                    vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
-                    vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                    count2,typeval);
-                Part[count2].SetPID(idval);
-#ifdef EXTRAINPUTINFO
-                if (opt.iextendedoutput)
-                {
-                  Part[count2].SetInputFileID(i);
-                  Part[count2].SetInputIndexInFile(nn+ninputoffset);
-                }
-#endif
-#endif
-                count2++;
-            }
-            else if (opt.partsearchtype==PSTDARK) {
-                if (!(typeval==STARTYPE||typeval==BHTYPE)) {
+                if (opt.partsearchtype==PSTALL) {
 #ifdef USEMPI
                     Pbuf[ibufindex]=Particle(mtemp*mscale,
                         xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
                         vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
                         vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
                         vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                        count2,DARKTYPE);
+                        count2,typeval);
                     Pbuf[ibufindex].SetPID(idval);
 #ifdef EXTRAINPUTINFO
                     if (opt.iextendedoutput)
                     {
-                        Pbuf[ibufindex].SetInputFileID(i);
-                        Pbuf[ibufindex].SetInputIndexInFile(nn+ninputoffset);
+                        Part[ibufindex].SetInputFileID(i);
+                        Part[ibufindex].SetInputIndexInFile(nn+ninputoffset);
                     }
 #endif
-                    //ensure that store number of particles to be sent to other reading threads
                     Nbuf[ibuf]++;
                     MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
 #else
@@ -877,127 +683,154 @@ void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Parti
 #ifdef EXTRAINPUTINFO
                     if (opt.iextendedoutput)
                     {
-                        Part[count2].SetInputFileID(i);
-                        Part[count2].SetInputIndexInFile(nn+ninputoffset);
+                      Part[count2].SetInputFileID(i);
+                      Part[count2].SetInputIndexInFile(nn+ninputoffset);
                     }
 #endif
 #endif
                     count2++;
                 }
-                else if (opt.iBaryonSearch) {
+                else if (opt.partsearchtype==PSTDARK) {
+                    if (!(typeval==STARTYPE||typeval==BHTYPE)) {
 #ifdef USEMPI
-                    Pbuf[ibufindex]=Particle(mtemp*mscale,
-                        xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
-                        vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
-                        vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
-                        vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                        count2);
-                    Pbuf[ibufindex].SetPID(idval);
+                        Pbuf[ibufindex]=Particle(mtemp*mscale,
+                            xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
+                            vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
+                            vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
+                            vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
+                            count2,DARKTYPE);
+                        Pbuf[ibufindex].SetPID(idval);
 #ifdef EXTRAINPUTINFO
-                    if (opt.iextendedoutput)
-                    {
-                        Pbuf[ibufindex].SetInputFileID(i);
-                        Pbuf[ibufindex].SetInputIndexInFile(nn+ninputoffset);
-                    }
+                        if (opt.iextendedoutput)
+                        {
+                            Pbuf[ibufindex].SetInputFileID(i);
+                            Pbuf[ibufindex].SetInputIndexInFile(nn+ninputoffset);
+                        }
 #endif
-                    if (typeval==STARTYPE) Pbuf[ibufindex].SetType(STARTYPE);
-                    else if (typeval==BHTYPE) Pbuf[ibufindex].SetType(BHTYPE);
-                    //ensure that store number of particles to be sent to the reading threads
-                    Nbuf[ibuf]++;
-                    if (ibuf==ThisTask) {
-                        if (k==RAMSESSTARTYPE) Nlocalbaryon[2]++;
-                        else if (k==RAMSESSINKTYPE) Nlocalbaryon[3]++;
-                    }
-                    MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocalbaryon[0], Pbaryons, Nreadbuf, Preadbuf);
+                        //ensure that store number of particles to be sent to other reading threads
+                        Nbuf[ibuf]++;
+                        MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
 #else
-                    Pbaryons[bcount2]=Particle(mtemp*mscale,
-                        xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
-                        vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
-                        vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
-                        vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                        count2,typeval);
-                    Pbaryons[bcount2].SetPID(idval);
+                        Part[count2]=Particle(mtemp*mscale,
+                            xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
+                            vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
+                            vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
+                            vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
+                            count2,typeval);
+                        Part[count2].SetPID(idval);
 #ifdef EXTRAINPUTINFO
-                    if (opt.iextendedoutput)
-                    {
-                        Part[bcount2].SetInputFileID(i);
-                        Part[bcount2].SetInputIndexInFile(nn+ninputoffset);
+                        if (opt.iextendedoutput)
+                        {
+                            Part[count2].SetInputFileID(i);
+                            Part[count2].SetInputIndexInFile(nn+ninputoffset);
+                        }
+#endif
+#endif
+                        count2++;
                     }
+                    else if (opt.iBaryonSearch) {
+#ifdef USEMPI
+                        Pbuf[ibufindex]=Particle(mtemp*mscale,
+                            xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
+                            vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
+                            vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
+                            vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
+                            count2);
+                        Pbuf[ibufindex].SetPID(idval);
+#ifdef EXTRAINPUTINFO
+                        if (opt.iextendedoutput)
+                        {
+                            Pbuf[ibufindex].SetInputFileID(i);
+                            Pbuf[ibufindex].SetInputIndexInFile(nn+ninputoffset);
+                        }
 #endif
+                        if (typeval==STARTYPE) Pbuf[ibufindex].SetType(STARTYPE);
+                        else if (typeval==BHTYPE) Pbuf[ibufindex].SetType(BHTYPE);
+                        //ensure that store number of particles to be sent to the reading threads
+                        Nbuf[ibuf]++;
+                        if (ibuf==ThisTask) {
+                            if (typeval==STARTYPE) Nlocalbaryon[2]++;
+                            else if (typeval==BHTYPE) Nlocalbaryon[3]++;
+                        }
+                        MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocalbaryon[0], Pbaryons, Nreadbuf, Preadbuf);
+#else
+                        Pbaryons[bcount2]=Particle(mtemp*mscale,
+                            xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
+                            vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
+                            vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
+                            vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
+                            count2,typeval);
+                        Pbaryons[bcount2].SetPID(idval);
+#ifdef EXTRAINPUTINFO
+                        if (opt.iextendedoutput)
+                        {
+                            Part[bcount2].SetInputFileID(i);
+                            Part[bcount2].SetInputIndexInFile(nn+ninputoffset);
+                        }
 #endif
-                    bcount2++;
+#endif
+                        bcount2++;
+                    }
                 }
-            }
-            else if (opt.partsearchtype==PSTSTAR) {
-                if (typeval==STARTYPE) {
+                else if (opt.partsearchtype==PSTSTAR) {
+                    if (typeval==STARTYPE) {
 #ifdef USEMPI
-                    //if using MPI, determine proccessor and place in ibuf, store particle in particle buffer and if buffer full, broadcast data
-                    //unless ibuf is 0, then just store locally
-                    Pbuf[ibufindex]=Particle(mtemp*mscale,
+                        //if using MPI, determine proccessor and place in ibuf, store particle in particle buffer and if buffer full, broadcast data
+                        //unless ibuf is 0, then just store locally
+                        Pbuf[ibufindex]=Particle(mtemp*mscale,
+                            xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
+                            vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
+                            vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
+                            vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
+                            count2,STARTYPE);
+                        //ensure that store number of particles to be sent to the reading threads
+                        Pbuf[ibufindex].SetPID(idval);
+#ifdef EXTRAINPUTINFO
+                        if (opt.iextendedoutput)
+                        {
+                            Pbuf[ibufindex].SetInputFileID(i);
+                            Pbuf[ibufindex].SetInputIndexInFile(nn+ninputoffset);
+                        }
+#endif
+                        Nbuf[ibuf]++;
+                        MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
+#else
+                    Part[count2]=Particle(mtemp*mscale,
                         xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
                         vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
                         vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
                         vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                        count2,STARTYPE);
-                    //ensure that store number of particles to be sent to the reading threads
-                    Pbuf[ibufindex].SetPID(idval);
-#ifdef EXTRAINPUTINFO
-                    if (opt.iextendedoutput)
-                    {
-                        Pbuf[ibufindex].SetInputFileID(i);
-                        Pbuf[ibufindex].SetInputIndexInFile(nn+ninputoffset);
-                    }
-#endif
-                    Nbuf[ibuf]++;
-                    MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
-#else
-                Part[count2]=Particle(mtemp*mscale,
-                    xtemp[0]*lscale,xtemp[1]*lscale,xtemp[2]*lscale,
-                    vtemp[0]*opt.velocityinputconversion+Hubbleflow*xtemp[0],
-                    vtemp[1]*opt.velocityinputconversion+Hubbleflow*xtemp[1],
-                    vtemp[2]*opt.velocityinputconversion+Hubbleflow*xtemp[2],
-                    count2,typeval);
-                Part[count2].SetPID(idval);
+                        count2,typeval);
+                    Part[count2].SetPID(idval);
 #ifdef EXTRAINPUTINFO
-                  if (opt.iextendedoutput)
-                  {
-                      Part[count2].SetInputFileID(i);
-                      Part[count2].SetInputIndexInFile(nn+ninputoffset);
-	              }
+                      if (opt.iextendedoutput)
+                      {
+                          Part[count2].SetInputFileID(i);
+                          Part[count2].SetInputIndexInFile(nn+ninputoffset);
+    	              }
 #endif
 #endif
-                    count2++;
+                        count2++;
+                    }
                 }
-            }
-        }//end of ghost particle check
-        }//end of loop over chunk
-        delete[] xtempchunk;
-        delete[] vtempchunk;
-        delete[] mtempchunk;
-        delete[] idvalchunk;
-        delete[] agetempchunk;
-        delete[] levelchunk;
-        delete[] mettempchunk;
-        Fpart[i].close();
-        Fpartvel[i].close();
-        Fpartmass[i].close();
-        Fpartid[i].close();
-        Fpartlevel[i].close();
-        Fpartage[i].close();
-        Fpartmet[i].close();
+            }//end of ghost particle check
+            }//end of loop over chunk
+            data=RAMSES_Part_Data();
 #ifdef USEMPI
 
-        //send information between read threads
-        if (opt.nsnapread>1&&inreadsend<totreadsend){
-            MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
-            MPISendParticlesBetweenReadThreads(opt, Preadbuf, Part.data(), ireadtask, readtaskID, Pbaryons, mpi_comm_read, mpi_nsend_readthread, mpi_nsend_readthread_baryon);
-            inreadsend++;
-            for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
-        }
+            //send information between read threads
+            if (opt.nsnapread>1&&inreadsend<totreadsend){
+                MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
+                MPISendParticlesBetweenReadThreads(opt, Preadbuf, Part.data(), ireadtask, readtaskID, Pbaryons, mpi_comm_read, mpi_nsend_readthread, mpi_nsend_readthread_baryon);
+                inreadsend++;
+                for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
+            }
 #endif
-    }//end of whether reading a file
-    }//end of loop over file
+        }//end of loop over files of the batch
+    }//end of loop over batches
 #ifdef USEMPI
+    //wait for the full buffers still in flight before sending what is left
+    MPICompleteParticleSendsFromReadThreads();
     //once finished reading the file if there are any particles left in the buffer broadcast them
     for(ibuf = 0; ibuf < NProcs; ibuf++) if (ireadtask[ibuf]<0)
     {
@@ -1028,263 +861,167 @@ void ReadRamses(Options &opt, vector<Particle> &Part, const Int_t nbodies, Parti
     if (ireadtask[ThisTask]>=0) {
     inreadsend=0;
 #endif
-    for (i=0;i<opt.num_files;i++) if (ireadfile[i]) {
-        sprintf(buf1,"%s/amr_%s.out%05d",opt.fname,opt.ramsessnapname,i+1);
-        sprintf(buf2,"%s/amr_%s.out",opt.fname,opt.ramsessnapname);
-        if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-        else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-        Famr[i].open(buf, ios::binary|ios::in);
-        sprintf(buf1,"%s/hydro_%s.out%05d",opt.fname,opt.ramsessnapname,i+1);
-        sprintf(buf2,"%s/hydro_%s.out",opt.fname,opt.ramsessnapname);
-        if (FileExists(buf1)) sprintf(buf,"%s",buf1);
-        else if (FileExists(buf2)) sprintf(buf,"%s",buf2);
-        Fhydro[i].open(buf, ios::binary|ios::in);
-        //read some of the amr header till get to number of cells in current file
-        //@{
-        byteoffset=0;
-        byteoffset+=RAMSES_fortran_read(Famr[i],header[i].ndim);
-        header[i].twotondim=pow(2,header[i].ndim);
-        Famr[i].read((char*)&dummy, sizeof(dummy));
-        Famr[i].read((char*)&header[i].nx, sizeof(int));
-        Famr[i].read((char*)&header[i].ny, sizeof(int));
-        Famr[i].read((char*)&header[i].nz, sizeof(int));
-        Famr[i].read((char*)&dummy, sizeof(dummy));
-        byteoffset+=RAMSES_fortran_read(Famr[i],header[i].nlevelmax);
-        byteoffset+=RAMSES_fortran_read(Famr[i],header[i].ngridmax);
-        byteoffset+=RAMSES_fortran_read(Famr[i],header[i].nboundary);
-        byteoffset+=RAMSES_fortran_read(Famr[i],header[i].npart[RAMSESGASTYPE]);
-
-        //then skip the rest
-        for (j=0;j<14;j++) RAMSES_fortran_skip(Famr[i]);
-        if (lmin>header[i].nlevelmax) lmin=header[i].nlevelmax;
-        if (lmax<header[i].nlevelmax) lmax=header[i].nlevelmax;
-        //@}
-        //read header info from hydro files
-        //@{
-        RAMSES_fortran_skip(Fhydro[i]);
-        RAMSES_fortran_read(Fhydro[i],header[i].nvarh);
-        RAMSES_fortran_skip(Fhydro[i]);
-        RAMSES_fortran_skip(Fhydro[i]);
-        RAMSES_fortran_skip(Fhydro[i]);
-        RAMSES_fortran_read(Fhydro[i],header[i].gamma_index);
-        //@}
-    }
-    for (i=0;i<opt.num_files;i++) if (ireadfile[i]) {
-        //then apparently read ngridlevels, which appears to be an array storing the number of grids at a given level
-        ngridlevel=new int[header[i].nlevelmax];
-        ngridfile=new int[(1+header[i].nboundary)*header[i].nlevelmax];
-        RAMSES_fortran_read(Famr[i],ngridlevel);
-        for (j=0;j<header[i].nlevelmax;j++) ngridfile[j]=ngridlevel[j];
-        //skip some more
-        RAMSES_fortran_skip(Famr[i]);
-        //if nboundary>0 then need two skip twice then read ngridbound
-        if(header[i].nboundary>0) {
-            ngridbound=new int[header[i].nboundary*header[i].nlevelmax];
-            RAMSES_fortran_skip(Famr[i]);
-            RAMSES_fortran_skip(Famr[i]);
-            //ngridbound is an array of some sort but I don't see what it is used for
-            RAMSES_fortran_read(Famr[i],ngridbound);
-            for (j=0;j<header[i].nlevelmax;j++) ngridfile[header[i].nlevelmax+j]=ngridbound[j];
+    //amr and hydro files of each cpu decoded in batches, one per thread, and their cells then placed in file order
+    readfiles.clear();
+    for (i=0;i<opt.num_files;i++) if (ireadfile[i]) readfiles.push_back(i);
+    gasdata.resize(min(nreadbatch,(int)readfiles.size()));
+    for (size_t ibatch=0;ibatch<readfiles.size();ibatch+=nreadbatch) {
+        int nbatchfiles=min((size_t)nreadbatch,readfiles.size()-ibatch);
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ireaderror) if (nbatchfiles>1)
+#endif
+        for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+            if (!RAMSES_read_gas_file(opt, readfiles[ibatch+ibatchfile], gasdata[ibatchfile], RAMSESGASPOS|RAMSESGASHYDRO)) ireaderror++;
         }
-        //skip some more
-        RAMSES_fortran_skip(Famr[i],2);
-        //if odering list in info is bisection need to skip more
-        if (orderingstring==string("bisection")) RAMSES_fortran_skip(Famr[i],5);
-        else RAMSES_fortran_skip(Famr[i],4);
-
-        ninputoffset=0;
-
-        for (k=0;k<header[i].nboundary+1;k++) {
-            for (j=0;j<header[i].nlevelmax;j++) {
-                //first read amr for positions
-                chunksize=nchunk=ngridfile[k*header[i].nlevelmax+j];
-                if (chunksize>0) {
-                    xtempchunk=new RAMSESFLOAT[3*chunksize];
-                    //store son value in icell
-                    icellchunk=new int[header[i].twotondim*chunksize];
-                    //skip grid index, next index and prev index.
-                    RAMSES_fortran_skip(Famr[i],3);
-                    //now read grid centre
-                    for (idim=0;idim<header[i].ndim;idim++) {
-                        RAMSES_fortran_read(Famr[i],&xtempchunk[idim*chunksize]);
-                    }
-                    //skip father index, then neighbours index
-                    RAMSES_fortran_skip(Famr[i],1+2*header[i].ndim);
-                    //read son index to determine if a cell in a specific grid is at the highest resolution and needs to be represented by a particle
-                    for (idim=0;idim<header[i].twotondim;idim++) {
-                        RAMSES_fortran_read(Famr[i],&icellchunk[idim*chunksize]);
-                    }
-                    //skip cpu map and refinement map (2^ndim*2)
-                    RAMSES_fortran_skip(Famr[i],2*header[i].twotondim);
+        //a file that cannot be read would leave the particle counts inconsistent with the header
+        if (ireaderror>0) {
+            LOG(error) << "Could not read " << ireaderror << " RAMSES amr/hydro files, exiting";
+#ifdef USEMPI
+            MPI_Abort(MPI_COMM_WORLD,9);
+#else
+            exit(9);
+#endif
+        }
+        for (int ibatchfile=0;ibatchfile<nbatchfiles;ibatchfile++) {
+            i=readfiles[ibatch+ibatchfile];
+            RAMSES_Gas_Data &data=gasdata[ibatchfile];
+            for (Int_t icell=0;icell<data.ncell;icell++) {
+                for (idim=0;idim<3;idim++) {
+                    xpos[idim]=data.x[3*icell+idim];
+                    vpos[idim]=data.v[3*icell+idim];
                 }
-                RAMSES_fortran_skip(Fhydro[i]);
-                //then read hydro for other variables (first is density, then velocity, then pressure, then metallicity )
-                if (chunksize>0) {
-                    hydrotempchunk=new RAMSESFLOAT[chunksize*header[i].twotondim*header[i].nvarh];
-                    //first read velocities (for 2 cells per number of dimensions (ie: cell corners?))
-                    for (idim=0;idim<header[i].twotondim;idim++) {
-                        for (ivar=0;ivar<header[i].nvarh;ivar++) {
-                            RAMSES_fortran_read(Fhydro[i],&hydrotempchunk[idim*chunksize*header[i].nvarh+ivar*chunksize]);
-                            for (igrid=0;igrid<chunksize;igrid++) {
-                                //once we have looped over all the hydro data then can start actually storing it into the particle structures
-                                if (ivar==header[i].nvarh-1) {
-                                    //if cell has no internal cells or at maximum level produce a particle
-                                    if (icellchunk[idim*chunksize+igrid]==0 || j==header[i].nlevelmax-1) {
-                                        //first suggestion is to add some jitter to the particle positions
-                                        double dx = pow(0.5, j);
-                                        int ix, iy, iz;
-                                        //below assumes three dimensions with 8 corners (? maybe cells) per grid
-                                        iz = idim/4;
-                                        iy = (idim - (4*iz))/2;
-                                        ix = idim - (2*iy) - (4*iz);
-                                        // Calculate absolute coordinates + jitter, and generate particle
-                                        xpos[0] = ((((float)rand()/(float)RAND_MAX) * header[i].BoxSize * dx) +(header[i].BoxSize * (xtempchunk[igrid] + (double(ix)-0.5) * dx )) - (header[i].BoxSize*dx/2.0)) ;
-                                        xpos[1] = ((((float)rand()/(float)RAND_MAX) * header[i].BoxSize * dx) +(header[i].BoxSize * (xtempchunk[igrid+1*chunksize] + (double(iy)-0.5) * dx )) - (header[i].BoxSize*dx/2.0)) ;
-                                        xpos[2] = ((((float)rand()/(float)RAND_MAX) * header[i].BoxSize * dx) +(header[i].BoxSize * (xtempchunk[igrid+2*chunksize] + (double(iz)-0.5) * dx )) - (header[i].BoxSize*dx/2.0)) ;
 #ifdef USEMPI
-                                        //determine processor this particle belongs on based on its spatial position
-                                        ibuf=MPIGetParticlesProcessor(opt, xpos[0],xpos[1],xpos[2]);
-                                        ibufindex=ibuf*BufSize+Nbuf[ibuf];
+                //determine processor this particle belongs on based on its spatial position
+                ibuf=MPIGetParticlesProcessor(opt, xpos[0],xpos[1],xpos[2]);
+                ibufindex=ibuf*BufSize+Nbuf[ibuf];
 #endif
-
-                                        vpos[0]=hydrotempchunk[idim*chunksize*header[i].nvarh+1*chunksize+igrid];
-                                        vpos[1]=hydrotempchunk[idim*chunksize*header[i].nvarh+2*chunksize+igrid];
-                                        vpos[2]=hydrotempchunk[idim*chunksize*header[i].nvarh+3*chunksize+igrid];
-                                        mtemp=dx*dx*dx*hydrotempchunk[idim*chunksize*header[i].nvarh+0*chunksize+igrid];
-                                        //the self energy P/rho is given by
-                                        utemp=hydrotempchunk[idim*chunksize*header[i].nvarh+4*chunksize+igrid]/hydrotempchunk[idim*chunksize*header[i].nvarh+0*chunksize+igrid]/(header[i].gamma_index-1.0);
-                                        rhotemp=hydrotempchunk[idim*chunksize*header[i].nvarh+0*chunksize+igrid]*rhoscale;
-                                        Ztemp=hydrotempchunk[idim*chunksize*header[i].nvarh+5*chunksize+igrid];
-                                        if (opt.partsearchtype==PSTALL) {
+                mtemp=data.m[icell];
+                utemp=data.u[icell];
+                rhotemp=data.rho[icell]*rhoscale;
+                Ztemp=data.Z[icell];
+                if (opt.partsearchtype==PSTALL) {
 #ifdef USEMPI
-                                            Pbuf[ibufindex]=Particle(mtemp*mscale,
-                                                xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
-                                                vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
-                                                vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
-                                                vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
-                                                count2,GASTYPE);
-                                            Pbuf[ibufindex].SetPID(idval);
+                    Pbuf[ibufindex]=Particle(mtemp*mscale,
+                        xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
+                        vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
+                        vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
+                        vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
+                        count2,GASTYPE);
+                    Pbuf[ibufindex].SetPID(idval);
 #ifdef GASON
-                                            Pbuf[ibufindex].SetU(utemp);
-                                            Pbuf[ibufindex].SetSPHDen(rhotemp);
+                    Pbuf[ibufindex].SetU(utemp);
+                    Pbuf[ibufindex].SetSPHDen(rhotemp);
 #ifdef STARON
-                                            Pbuf[ibufindex].SetZmet(Ztemp);
+                    Pbuf[ibufindex].SetZmet(Ztemp);
 #endif
 #endif
 #ifdef EXTRAINPUTINFO
-                                            if (opt.iextendedoutput)
-                                            {
-                                                Pbuf[ibufindex].SetInputFileID(i);
-                                                Pbuf[ibufindex].SetInputIndexInFile(idim*chunksize*header[i].nvarh+0*chunksize+igrid+ninputoffset);
-                                            }
+                    if (opt.iextendedoutput)
+                    {
+                        Pbuf[ibufindex].SetInputFileID(i);
+                        Pbuf[ibufindex].SetInputIndexInFile(icell);
+                    }
 #endif
-                                            //ensure that store number of particles to be sent to the threads involved with reading snapshot files
-                                            Nbuf[ibuf]++;
-                                            MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
+                    //ensure that store number of particles to be sent to the threads involved with reading snapshot files
+                    Nbuf[ibuf]++;
+                    MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocal, Part.data(), Nreadbuf, Preadbuf);
 #else
-                                            Part[count2]=Particle(mtemp*mscale,
-                                                xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
-                                                vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
-                                                vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
-                                                vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
-                                                count2,GASTYPE);
-                                            Part[count2].SetPID(idval);
+                    Part[count2]=Particle(mtemp*mscale,
+                        xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
+                        vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
+                        vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
+                        vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
+                        count2,GASTYPE);
+                    Part[count2].SetPID(idval);
 #ifdef GASON
-                                            Part[count2].SetU(utemp);
-                                            Part[count2].SetSPHDen(rhotemp);
+                    Part[count2].SetU(utemp);
+                    Part[count2].SetSPHDen(rhotemp);
 #ifdef STARON
-                                            Part[count2].SetZmet(Ztemp);
+                    Part[count2].SetZmet(Ztemp);
 #endif
 #endif
 #ifdef EXTRAINPUTINFO
-                                            if (opt.iextendedoutput)
-                                            {
-                                                Part[count2].SetInputFileID(i);
-                                                Part[count2].SetInputIndexInFile(idim*chunksize*header[i].nvarh+0*chunksize+igrid+ninputoffset);
-                                            }
+                    if (opt.iextendedoutput)
+                    {
+                        Part[count2].SetInputFileID(i);
+                        Part[count2].SetInputIndexInFile(icell);
+                    }
 #endif
 
 #endif
-                                            count2++;
-                                        }
-                                        else if (opt.partsearchtype==PSTDARK&&opt.iBaryonSearch) {
+                    count2++;
+                }
+                else if (opt.partsearchtype==PSTDARK&&opt.iBaryonSearch) {
 #ifdef USEMPI
-                                            Pbuf[ibufindex]=Particle(mtemp*mscale,
-                                                xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
-                                                vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
-                                                vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
-                                                vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
-                                                count2,GASTYPE);
-                                            Pbuf[ibufindex].SetPID(idval);
+                    Pbuf[ibufindex]=Particle(mtemp*mscale,
+                        xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
+                        vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
+                        vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
+                        vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
+                        count2,GASTYPE);
+                    Pbuf[ibufindex].SetPID(idval);
 #ifdef GASON
-                                            Pbuf[ibufindex].SetU(utemp);
-                                            Pbuf[ibufindex].SetSPHDen(rhotemp);
+                    Pbuf[ibufindex].SetU(utemp);
+                    Pbuf[ibufindex].SetSPHDen(rhotemp);
 #ifdef STARON
-                                            Pbuf[ibufindex].SetZmet(Ztemp);
+                    Pbuf[ibufindex].SetZmet(Ztemp);
 #endif
 #endif
 #ifdef EXTRAINPUTINFO
-                                            if (opt.iextendedoutput)
-                                            {
-                                                Pbuf[ibufindex].SetInputFileID(i);
-                                                Pbuf[ibufindex].SetInputIndexInFile(idim*chunksize*header[i].nvarh+0*chunksize+igrid+ninputoffset);
-                                            }
+                    if (opt.iextendedoutput)
+                    {
+                        Pbuf[ibufindex].SetInputFileID(i);
+                        Pbuf[ibufindex].SetInputIndexInFile(icell);
+                    }
 #endif
-                                            //ensure that store number of particles to be sent to the reading threads
-                                            if (ibuf==ThisTask) {
-                                                Nlocalbaryon[1]++;
-                                            }
-                                            MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocalbaryon[0], Pbaryons, Nreadbuf, Preadbuf);
+                    //ensure that store number of particles to be sent to the reading threads
+                    Nbuf[ibuf]++;
+                    if (ibuf==ThisTask) {
+                        Nlocalbaryon[1]++;
+                    }
+                    MPIAddParticletoAppropriateBuffer(opt, ibuf, ibufindex, ireadtask, BufSize, Nbuf, Pbuf, Nlocalbaryon[0], Pbaryons, Nreadbuf, Preadbuf);
 #else
-                                            Pbaryons[bcount2]=Particle(mtemp*mscale,
-                                                xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
-                                                vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
-                                                vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
-                                                vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
-                                                count2,GASTYPE);
-                                            Pbaryons[bcount2].SetPID(idval);
+                    Pbaryons[bcount2]=Particle(mtemp*mscale,
+                        xpos[0]*lscale,xpos[1]*lscale,xpos[2]*lscale,
+                        vpos[0]*opt.velocityinputconversion+Hubbleflow*xpos[0],
+                        vpos[1]*opt.velocityinputconversion+Hubbleflow*xpos[1],
+                        vpos[2]*opt.velocityinputconversion+Hubbleflow*xpos[2],
+                        count2,GASTYPE);
+                    Pbaryons[bcount2].SetPID(idval);
 #ifdef GASON
-                                            Pbaryons[bcount2].SetU(utemp);
-                                            Pbaryons[bcount2].SetSPHDen(rhotemp);
+                    Pbaryons[bcount2].SetU(utemp);
+                    Pbaryons[bcount2].SetSPHDen(rhotemp);
 #ifdef STARON
-                                            Pbaryons[bcount2].SetZmet(Ztemp);
+                    Pbaryons[bcount2].SetZmet(Ztemp);
 #endif
 #endif
 #ifdef EXTRAINPUTINFO
-                                            if (opt.iextendedoutput)
-                                            {
-                                                Pbaryons[bcount2].SetInputFileID(i);
-                                                Pbaryons[bcount2].SetInputIndexInFile(idim*chunksize*header[i].nvarh+0*chunksize+igrid+ninputoffset);
-                                            }
+                    if (opt.iextendedoutput)
+                    {
+                        Pbaryons[bcount2].SetInputFileID(i);
+                        Pbaryons[bcount2].SetInputIndexInFile(icell);
+                    }
 #endif
 
 #endif
-                                        bcount2++;
-                                    }
-                                }
-                                }
-                            }
-                        }
-                    }
-                }
-                if (chunksize>0) {
-                    delete[] xtempchunk;
-                    delete[] hydrotempchunk;
+                    bcount2++;
                 }
             }
-        }
-        Famr[i].close();
+            data=RAMSES_Gas_Data();
 #ifdef USEMPI
-        //send information between read threads
-        if (opt.nsnapread>1&&inreadsend<totreadsend){
-            MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
-            MPISendParticlesBetweenReadThreads(opt, Preadbuf, Part.data(), ireadtask, readtaskID, Pbaryons, mpi_comm_read, mpi_nsend_readthread, mpi_nsend_readthread_baryon);
-            inreadsend++;
-            for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
-        }
+            //send information between read threads
+            if (opt.nsnapread>1&&inreadsend<totreadsend){
+                MPI_Allgather(Nreadbuf, opt.nsnapread, MPI_Int_t, mpi_nsend_readthread, opt.nsnapread, MPI_Int_t, mpi_comm_read);
+                MPISendParticlesBetweenReadThreads(opt, Preadbuf, Part.data(), ireadtask, readtaskID, Pbaryons, mpi_comm_read, mpi_nsend_readthread, mpi_nsend_readthread_baryon);
+                inreadsend++;
+                for(ibuf = 0; ibuf < opt.nsnapread; ibuf++) Nreadbuf[ibuf]=0;
+            }
 #endif
-    }
+        }//end of loop over files of the batch
+    }//end of loop over batches
 #ifdef USEMPI
+    //wait for the full buffers still in flight before sending what is left
+    MPICompleteParticleSendsFromReadThreads();
     //once finished reading the file if there are any particles left in the buffer broadcast them
     for(ibuf = 0; ibuf < NProcs; ibuf++) if (ireadtask[ibuf]<0)
     {
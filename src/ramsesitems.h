@@ -91,12 +91,47 @@ struct RAMSES_Header {
 };
 //@}
 
-int RAMSES_fortran_read(fstream &, int &);
-int RAMSES_fortran_read(fstream &, RAMSESFLOAT &);
-int RAMSES_fortran_read(fstream &, int*);
-int RAMSES_fortran_read(fstream &, RAMSESFLOAT *);
-int RAMSES_fortran_read(fstream &, RAMSESIDTYPE *);
-int RAMSES_fortran_skip(fstream &, int nskips=1);
+///fields of the particles in a part_ file, each read as one record
+//@{
+#define RAMSESPARTPOS 1
+#define RAMSESPARTVEL 2
+#define RAMSESPARTMASS 4
+#define RAMSESPARTID 8
+#define RAMSESPARTAGE 16
+//@}
+///number of header records in a part_ file before the particle positions
+#define RAMSESPARTNHEADERRECORDS 8
+
+///particles of one part_ file, with each coordinate stored contiguously as in the file
+struct RAMSES_Part_Data {
+    int npart = 0;
+    int ndim = 3;
+    ///number of sink particles in the whole simulation, which are held by every file
+    int nsink = 0;
+    vector<RAMSESFLOAT> x, v, m, age;
+    vector<RAMSESIDTYPE> id;
+};
+
+///fields of gas cells read from the amr_ and hydro_ files, only the number of leaf cells is determined if none are requested
+//@{
+#define RAMSESGASPOS 1
+#define RAMSESGASHYDRO 2
+//@}
+
+///gas cells of one cpu, one per leaf cell of its grids, with positions in box units and other quantities in code units
+struct RAMSES_Gas_Data {
+    Int_t ncell = 0;
+    ///positions and velocities stored as x,y,z of each cell in turn
+    vector<RAMSESFLOAT> x, v;
+    vector<RAMSESFLOAT> m, u, rho, Z;
+};
+
+///name of the file of a given kind (amr, hydro or part) written by cpu ifile+1
+string RAMSES_file_name(Options &opt, const char *kind, int ifile);
+///reads the requested fields of the particles in a part_ file
+bool RAMSES_read_part_file(Options &opt, int ifile, RAMSES_Part_Data &data, int fields);
+///reads the requested fields of the gas cells in the amr_ and hydro_ files of a cpu
+bool RAMSES_read_gas_file(Options &opt, int ifile, RAMSES_Gas_Data &data, int fields);
 
 /// \name Get the number of particles in the ramses files
 //@{
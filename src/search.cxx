@@ -107,7 +107,8 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
 #endif
     {
         vr::Timer t;
-        tree = new KDTree(Part.data(),nbodies,opt.Bsize,tree->TPHYS,tree->KEPAN,1000,0,0,0,period);
+        //the local velocity density may already have built a tree over these particles
+        tree = vr::spatial_index().acquire(Part.data(),nbodies,opt.Bsize,period);
         tree->OverWriteInputOrder();
         LOG(info) << "Finished building single trees in " << t;
     }
@@ -162,7 +163,7 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
             numompregions, ompdomain, rdist,
             omp_nrecv_total, omp_nrecv_offset, omp_import_total);
         if (omp_import_total > 0) {
-            OpenMPLinkAcross(opt, nbodies, Part, pfof, storeorgIndex, Head, Next,
+            OpenMPLinkAcross(opt, nbodies, Part, pfof, storeorgIndex,
                 param, fofcheck, numompregions, ompdomain, tree3dfofomp,
                 omp_nrecv_total, omp_nrecv_offset, ompimport);
 
@@ -276,13 +277,13 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
         delete[] storetype;
     }
 #endif
-    delete tree;
+    vr::spatial_index().release(tree);
 #endif
 
 #ifdef USEMPI
     if (NProcs==1) {
         totalgroups=numgroups;
-        if (tree != NULL) delete tree;
+        vr::spatial_index().release(tree);
         delete[] Head;
         delete[] Next;
     }
@@ -339,17 +340,15 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
     MEMORY_USAGE_REPORT(debug, opt);
 
     LOG(info) << "Starting to linking across MPI domains";
-    do {
-        if (opt.partsearchtype==PSTALL && opt.iBaryonSearch>1) {
-            links_across=MPILinkAcross(nbodies, tree, Part.data(), pfof, Len, Head, Next, param[1], fofcheck, param);
-        }
-        else {
-            links_across=MPILinkAcross(nbodies, tree, Part.data(), pfof, Len, Head, Next, param[1]);
-        }
-        LOG(trace) << "Found " << links_across << " links to particles on other mpi domains ";
-        MPI_Allreduce(&links_across, &links_across_total, 1, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
-        MPIUpdateExportList(nbodies,Part.data(),pfof,Len);
-    }while(links_across_total>0);
+    if (opt.partsearchtype==PSTALL && opt.iBaryonSearch>1) {
+        links_across=MPILinkAcrossUnionFind(nbodies, tree, Part.data(), pfof, param[1], NULL, &fofcheck, param);
+    }
+    else {
+        links_across=MPILinkAcrossUnionFind(nbodies, tree, Part.data(), pfof, param[1]);
+    }
+    LOG(trace) << "Found " << links_across << " links to particles on other mpi domains ";
+    MPI_Allreduce(&links_across, &links_across_total, 1, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
+    LOG_RANK0(debug) << "Linked " << links_across_total << " groups across MPI domains";
     LOG_RANK0(info) << "Finished linking across MPI domains in " << mpi_timer;
 
     delete[] FoFDataIn;
@@ -358,13 +357,15 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
     delete[] PartDataGet;
 
     //reorder local particle array and delete memory associated with Head arrays, only need to keep Particles, pfof and some id and idexing information
-    delete tree;
+    vr::spatial_index().release(tree);
     delete[] Head;
     delete[] Next;
     delete[] Len;
     //Now redistribute groups so that they are local to a processor (also orders the group ids according to size
     opt.HaloMinSize=MinNumOld;//reset minimum size
+    vr::Timer exchange_timer;
     Int_t newnbodies=MPIGroupExchange(opt, nbodies, Part.data(), pfof);
+    LOG_RANK0(info) << "Finished exchanging groups across MPI domains in " << exchange_timer;
     //once groups are local, can free up memory. Might need to increase size
     //of vector
     if (Nmemlocal<Nlocal) {
@@ -441,9 +442,9 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
         if (numlocalden_total > 0) {
             LOG(debug) << "Found " << numlocalden << " particles for which density must be calculated";
             LOG(info) << "Going to build tree";
-            tree=new KDTree(Part.data(),Nlocal,opt.Bsize,tree->TPHYS,tree->KEPAN,100,0,0,0,period);
+            tree=vr::spatial_index().acquire(Part.data(),Nlocal,opt.Bsize,period,true);
             GetVelocityDensity(opt, Nlocal, Part.data(),tree);
-            delete tree;
+            vr::spatial_index().release(tree);
         }
         // Delete exported particles
         assert(Part.size()==Nlocal);
@@ -509,7 +510,7 @@ Int_t* SearchFullSet(Options &opt, const Int_t nbodies, vector<Particle> &Part,
             numingroup[pfof[i]]++;
         }
         for (i=2;i<=numgroups;i++) noffset[i]=noffset[i-1]+numingroup[i-1];
-        qsort(Part.data(), Nlocal, sizeof(Particle), PIDCompare);
+        SortParticles(Nlocal, Part.data(), PSORTPID);
         //sort(Part.begin(),Part.end(),PIDCompareVec);
         for (i=0;i<Nlocal;i++) Part[i].SetPID(storetype[Part[i].GetID()]);
         delete[] storetype;
@@ -785,7 +786,7 @@ private(i,tid,xscaling,vscaling)
 
     ///\todo only run this sort if necessary to keep id order
     for (i=0;i<npartingroups;i++) Part[i].SetID(ids[i]);
-    gsl_heapsort(Part.data(), Nlocal, sizeof(Particle), IDCompare);
+    SortParticles(Nlocal, Part.data(), PSORTID);
     //sort(Part.begin(), Part.end(), IDCompareVec);
     delete[] ids;
     numgroups=ng;
@@ -1064,7 +1065,7 @@ Int_t* SearchSubset(Options &opt, const Int_t nbodies, const Int_t nsubset, Part
     }
 
     //Sort the particle data based on the particle IDs
-    qsort(Partsubset, nsubset, sizeof(Particle), PIDCompare);
+    SortParticles(nsubset, Partsubset, PSORTPID);
 
     //Store the index in another array and reset the type data
     vector<int> storeindx(nsubset);
@@ -1848,14 +1849,8 @@ private(i,tid)
     else MPIBuildParticleExportList(opt, nsubset, Partsubset, pfof, Len, sqrt(param[1]));
     //Now that have FoFDataGet (the exported particles) must search local volume using said particles
     //This is done by finding all particles in the search volume and then checking if those particles meet the FoF criterion
-    //One must keep iterating till there are no new links.
-    //Wonder if i don't need another loop and a final check
-    Int_t links_across,links_across_total;
-    do {
-        links_across=MPILinkAcross(nsubset, tree, Partsubset, pfof, Len, Head, Next, param[1], fofcmp, param);
-        MPIUpdateExportList(nsubset, Partsubset,pfof,Len);
-        MPI_Allreduce(&links_across, &links_across_total, 1, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
-    }while(links_across_total>0);
+    //The links are resolved globally in a single pass
+    MPILinkAcrossUnionFind(nsubset, tree, Partsubset, pfof, param[1], &fofcmp, NULL, param);
 
     //reorder local particle array and delete memory associated with Head arrays, only need to keep Particles, pfof and some id and idexing information
     delete tree;
@@ -1917,7 +1912,7 @@ private(i,tid)
     }
 
     // Sort base on the type
-    qsort(Partsubset, nsubset, sizeof(Particle), TypeCompare);
+    SortParticles(nsubset, Partsubset, PSORTTYPE);
 
     //Reset the typedata and set the ID
     for (i = 0; i < nsubset; i++){
@@ -1989,7 +1984,7 @@ void HaloCoreGrowth(Options &opt, const Int_t nsubset, Particle *&Partsubset, In
                 Pcore[nincore].SetType(pfofbg[Partsubset[i].GetID()]);
                 nincore++;
             }
-            qsort(Pcore,nincore,sizeof(Particle),TypeCompare);
+            SortParticles(nincore, Pcore, PSORTTYPE);
             noffset[0]=noffset[1]=0;
             for (i=2;i<=numgroupsbg;i++) noffset[i]=noffset[i-1]+ncore[i-1];
             //now get centre of masses and dispersions
@@ -2113,7 +2108,7 @@ private(i,tid,Pval,D2,dval,mval,pid,weight)
                     nincore++;
                     ncore[pfofbg[Partsubset[i].GetID()]]++;
                 }
-                qsort(Pcore,nincore,sizeof(Particle),TypeCompare);
+                SortParticles(nincore, Pcore, PSORTTYPE);
                 noffset[0]=noffset[1]=0;
                 for (i=2;i<=numgroupsbg;i++) noffset[i]=noffset[i-1]+ncore[i-1];
                 //now get centre of masses and dispersions
@@ -2852,8 +2847,9 @@ void UpdateGroupIDsFromSubstructure(Int_t activenumgroups, Int_t oldnumgroups,
     simply more useful to not have the functions called within this loop parallelised. This loop invokes a few routines that have OpenMP
     parallelisation: InitializeTreeGrid, GetCellVel, GetCellVelDisp, CalcVelSigmaTensor, etc.
 */
-void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubset, Int_t *&pfof, Int_t &ngroup, Int_t &nhalos, PropData *pdata)
+void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubset, Int_t *&pfof, Int_t &ngroup, Int_t &nhalos, PropData *pdata, double *localtime)
 {
+    vr::Timer timer;
     //now build a sublist of groups to search for substructure
     Int_t nsubsearch, oldnsubsearch,sublevel,maxsublevel,ngroupidoffset,ngroupidoffsetold,ngrid;
     bool iflag,iunbindflag;
@@ -3002,13 +2998,15 @@ void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubse
         if (ompactivesubgroups.size()>0) {
             Int_t oldns = ns;
             ns = 0;
-            Options opt2;
-            #pragma omp parallel for \
-            default(shared) private(subPart, subpfof, opt2) schedule(dynamic) \
-            reduction(+:ns)
+            //each thread copies the configuration once and only resets the search context for every object
+            SearchContext searchcontext(opt);
+            #pragma omp parallel default(shared) private(subPart, subpfof) reduction(+:ns)
+            {
+            Options opt2(opt);
+            #pragma omp for schedule(dynamic) nowait
             for (auto iomp=0;iomp<ompactivesubgroups.size();iomp++) {
                 Int_t i=ompactivesubgroups[iomp];
-                opt2 = opt;
+                searchcontext.Apply(opt2);
                 subpfofold[i] = pfof[subpglist[i][0]];
                 subPart = new Particle[subnumingroup[i]];
                 for (Int_t j=0;j<subnumingroup[i];j++) {
@@ -3043,6 +3041,7 @@ void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubse
                 delete[] subPart;
                 ns += subngroup[i];
             }
+            }
             ns += oldns;
         }
 #endif
@@ -3285,6 +3284,8 @@ void SearchSubSub(Options &opt, const Int_t nsubset, vector<Particle> &Partsubse
         ngroup-=nhaloidoffset;
     }
     }
+    //time spent on this task alone, before waiting for the others
+    if (localtime!=NULL) *localtime=timer.get()*1e-6;
     //update the number of local groups found
 #ifdef USEMPI
     MPI_Barrier(MPI_COMM_WORLD);
@@ -3484,7 +3485,7 @@ Int_t* SearchBaryons(Options &opt, Int_t &nbaryons, Particle *&Pbaryons, const I
             storeval2[i]=Part[i].GetPID();
             Part[i].SetPID(pfofdark[i]);
         }
-        qsort(Part.data(),nparts,sizeof(Particle),TypeCompare);
+        SortParticles(nparts, Part.data(), PSORTTYPE);
         //sort(Part.begin(),Part.end(),TypeCompareVec);
         Pbaryons=&Part[ndark];
         for (i=0;i<nparts;i++) {
@@ -3541,7 +3542,7 @@ Int_t* SearchBaryons(Options &opt, Int_t &nbaryons, Particle *&Pbaryons, const I
 
     //search all dm particles in structures
     for (i=0;i<ndark;i++) Part[i].SetPotential(2*(pfofdark[i]==0)+(pfofdark[i]>1));
-    qsort(Part.data(), ndark, sizeof(Particle), PotCompare);
+    SortParticles(ndark, Part.data(), PSORTPOTENTIAL);
     //sort(Part.begin(),Part.begin()+ndark,PotCompareVec);
     ids=new Int_t[ndark+1];
     //store the original order of the dark matter particles
@@ -3680,7 +3681,7 @@ private(i,tid,p1,pindex,x1,D2,dval,rval,icheck,nnID,dist2,baryonfofold)
         //reset order
         delete tree;
         for (i=0;i<ndark;i++) Part[i].SetID(ids[i]);
-        qsort(Part.data(), ndark, sizeof(Particle), IDCompare);
+        SortParticles(ndark, Part.data(), PSORTID);
         //sort(Part.begin(), Part.begin()+ndark, IDCompareVec);
         delete[] ids;
 
@@ -3727,11 +3728,11 @@ private(i,tid,p1,pindex,x1,D2,dval,rval,icheck,nnID,dist2,baryonfofold)
         //reset order
         if (npartingroups>0) delete tree;
         for (i=0;i<ndark;i++) Part[i].SetID(ids[i]);
-        qsort(Part.data(), ndark, sizeof(Particle), IDCompare);
+        SortParticles(ndark, Part.data(), PSORTID);
         //sort(Part.begin(), Part.end(), IDCompareVec);
         delete[] ids;
         for (i=0;i<nparts;i++) {Part[i].SetPID(pfofall[Part[i].GetID()]);Part[i].SetID(storeval[i]);}
-        qsort(Part.data(), nparts, sizeof(Particle), IDCompare);
+        SortParticles(nparts, Part.data(), PSORTID);
         //sort(Part.begin(), Part.end(), IDCompareVec);
         for (i=0;i<nparts;i++) {
             pfofall[i]=Part[i].GetPID();Part[i].SetPID(storeval2[i]);
@@ -3748,11 +3749,11 @@ private(i,tid,p1,pindex,x1,D2,dval,rval,icheck,nnID,dist2,baryonfofold)
         //reset order
         if (npartingroups>0) delete tree;
         for (i=0;i<ndark;i++) Part[i].SetID(ids[i]);
-        qsort(Part.data(), ndark, sizeof(Particle), IDCompare);
+        SortParticles(ndark, Part.data(), PSORTID);
         //sort(Part.begin(), Part.begin()+ndark, IDCompareVec);
         delete[] ids;
         for (i=0;i<nparts;i++) {Part[i].SetPID(pfofall[Part[i].GetID()]);Part[i].SetID(storeval[i]);}
-        qsort(Part.data(), nparts, sizeof(Particle), IDCompare);
+        SortParticles(nparts, Part.data(), PSORTID);
         //sort(Part.begin(), Part.end(), IDCompareVec);
         for (i=0;i<nparts;i++) {
             pfofall[i]=Part[i].GetPID();Part[i].SetPID(storeval2[i]);
@@ -3764,7 +3765,7 @@ private(i,tid,p1,pindex,x1,D2,dval,rval,icheck,nnID,dist2,baryonfofold)
     else {
         delete tree;
         for (i=0;i<ndark;i++) Part[i].SetID(ids[i]);
-        qsort(Part.data(), ndark, sizeof(Particle), IDCompare);
+        SortParticles(ndark, Part.data(), PSORTID);
         //sort(Part.begin(), Part.begin()+ndark, IDCompareVec);
         delete[] ids;
         for (i=0;i<nbaryons;i++) Pbaryons[i].SetID(i+ndark);
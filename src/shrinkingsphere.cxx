@@ -0,0 +1,194 @@
+/**
+ * @file
+ *
+ * Shrinking sphere refinement of the centre of a group of particles
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "shrinkingsphere.h"
+
+namespace vr
+{
+
+ShrinkingSphere::ShrinkingSphere(const Options &opt, Int_t nbodies, Particle *part, int type)
+{
+	Int_t n = 0;
+	for (Int_t i = 0; i < nbodies; i++) {
+		n += (type < 0 || part[i].GetType() == type);
+	}
+	x.resize(n); y.resize(n); z.resize(n); mass.resize(n);
+	vx.resize(n); vy.resize(n); vz.resize(n);
+	n = 0;
+	for (Int_t i = 0; i < nbodies; i++) {
+		Particle &p = part[i];
+		if (type >= 0 && p.GetType() != type) {
+			continue;
+		}
+		x[n] = p.X(); y[n] = p.Y(); z[n] = p.Z();
+		vx[n] = p.Vx(); vy[n] = p.Vy(); vz[n] = p.Vz();
+#ifdef NOMASS
+		mass[n] = opt.MassValue;
+#else
+		mass[n] = p.GetMass();
+#endif
+		n++;
+	}
+}
+
+void ShrinkingSphere::reset()
+{
+	sx = x; sy = y; sz = z; smass = mass;
+	nsearch = size();
+}
+
+ShrinkingSphere::sums ShrinkingSphere::scan(const Coordinate &cm, Double_t r2, Double_t keep2)
+{
+	// particles within r2 of cm are summed, those within keep2 are kept in order at the front of the arrays
+	auto scan_range = [&](Int_t begin, Int_t end, sums &s) -> Int_t {
+		Int_t nkept = begin;
+		for (Int_t j = begin; j < end; j++) {
+			Double_t dx = sx[j] - cm[0];
+			Double_t dy = sy[j] - cm[1];
+			Double_t dz = sz[j] - cm[2];
+			Double_t d2 = dx*dx + dy*dy + dz*dz;
+			if (d2 <= r2) {
+				s.cmx += smass[j] * sx[j];
+				s.cmy += smass[j] * sy[j];
+				s.cmz += smass[j] * sz[j];
+				s.mass += smass[j];
+				s.ninside++;
+			}
+			if (d2 <= keep2) {
+				sx[nkept] = sx[j]; sy[nkept] = sy[j]; sz[nkept] = sz[j]; smass[nkept] = smass[j];
+				nkept++;
+			}
+		}
+		return nkept - begin;
+	};
+
+	sums total {0, 0, 0, 0, 0};
+#ifdef USEOPENMP
+	if (nsearch >= omppropnum && !omp_in_parallel()) {
+		int nthreads = omp_get_max_threads();
+		std::vector<Int_t> begin(nthreads + 1), nkept(nthreads, 0);
+		for (int t = 0; t <= nthreads; t++) {
+			begin[t] = nsearch * t / nthreads;
+		}
+		Double_t cmx = 0, cmy = 0, cmz = 0, encmass = 0;
+		Int_t ninside = 0;
+#pragma omp parallel num_threads(nthreads) reduction(+:cmx,cmy,cmz,encmass,ninside)
+		{
+			int tid = omp_get_thread_num();
+			if (omp_get_num_threads() == nthreads) {
+				sums s {0, 0, 0, 0, 0};
+				nkept[tid] = scan_range(begin[tid], begin[tid + 1], s);
+				cmx = s.cmx; cmy = s.cmy; cmz = s.cmz; encmass = s.mass; ninside = s.ninside;
+			}
+			else if (tid == 0) {
+				// fewer threads than asked for, scan everything here
+				sums s {0, 0, 0, 0, 0};
+				nkept.assign(nthreads, 0);
+				nkept[0] = scan_range(0, nsearch, s);
+				begin[0] = 0;
+				cmx = s.cmx; cmy = s.cmy; cmz = s.cmz; encmass = s.mass; ninside = s.ninside;
+			}
+		}
+		// close the gaps between the particles kept by each thread
+		Int_t n = nkept[0];
+		for (int t = 1; t < nthreads; t++) {
+			if (nkept[t] == 0) {
+				continue;
+			}
+			auto from = begin[t], to = begin[t] + nkept[t];
+			std::copy(sx.begin() + from, sx.begin() + to, sx.begin() + n);
+			std::copy(sy.begin() + from, sy.begin() + to, sy.begin() + n);
+			std::copy(sz.begin() + from, sz.begin() + to, sz.begin() + n);
+			std::copy(smass.begin() + from, smass.begin() + to, smass.begin() + n);
+			n += nkept[t];
+		}
+		nsearch = n;
+		total = sums {cmx, cmy, cmz, encmass, ninside};
+		return total;
+	}
+#endif
+	nsearch = scan_range(0, nsearch, total);
+	return total;
+}
+
+Int_t ShrinkingSphere::refine(const Options &opt, Coordinate &cm, Double_t &r2, Scaling scaling)
+{
+	const Int_t n = size();
+	Int_t naccepted = n;
+	Coordinate cmold = cm;
+	Double_t ri = std::sqrt(r2), ri2 = r2;
+	// the arrays searched hold every particle within rkept of ckept
+	Coordinate ckept = cm;
+	Double_t rkept = MAXVALUE;
+	reset();
+	while (true) {
+		if (scaling == Scaling::radius) {
+			ri *= opt.pinfo.cmadjustfac;
+			ri2 = ri * ri;
+		}
+		else {
+			ri2 *= opt.pinfo.cmadjustfac;
+		}
+		Double_t rsphere = std::sqrt(ri2), offset = 0;
+		if (rkept < MAXVALUE) {
+			for (int k = 0; k < 3; k++) {
+				offset += (cmold[k] - ckept[k]) * (cmold[k] - ckept[k]);
+			}
+			offset = std::sqrt(offset);
+			// the centre moved too far for the particles kept to cover the sphere, so start again from all of them
+			if (offset + rsphere > rkept * (1.0 - 1e-9)) {
+				reset();
+				rkept = MAXVALUE;
+			}
+		}
+		auto s = scan(cmold, ri2, 4.0 * ri2);
+		rkept = (rkept < MAXVALUE) ? std::min(2.0 * rsphere, rkept - offset) : 2.0 * rsphere;
+		ckept = cmold;
+		if (s.ninside >= opt.pinfo.cmfrac * n && s.ninside >= PROPCMMINNUM) {
+			cm[0] = s.cmx; cm[1] = s.cmy; cm[2] = s.cmz;
+			for (int k = 0; k < 3; k++) {
+				cm[k] /= s.mass;
+			}
+			cmold = cm;
+			r2 = ri2;
+			naccepted = s.ninside;
+		}
+		else {
+			break;
+		}
+	}
+	return naccepted;
+}
+
+Coordinate ShrinkingSphere::velocity(const Coordinate &cm, Double_t r2) const
+{
+	const Int_t n = size();
+	Double_t cmx = 0, cmy = 0, cmz = 0, encmass = 0;
+#ifdef USEOPENMP
+#pragma omp parallel for reduction(+:cmx,cmy,cmz,encmass) if (n >= omppropnum && !omp_in_parallel())
+#endif
+	for (Int_t j = 0; j < n; j++) {
+		Double_t dx = x[j] - cm[0];
+		Double_t dy = y[j] - cm[1];
+		Double_t dz = z[j] - cm[2];
+		if (dx*dx + dy*dy + dz*dz <= r2) {
+			cmx += mass[j] * vx[j];
+			cmy += mass[j] * vy[j];
+			cmz += mass[j] * vz[j];
+			encmass += mass[j];
+		}
+	}
+	Coordinate vel(cmx, cmy, cmz);
+	for (int k = 0; k < 3; k++) {
+		vel[k] /= encmass;
+	}
+	return vel;
+}
+
+}  // namespace vr
@@ -0,0 +1,95 @@
+/**
+ * @file
+ *
+ * Shrinking sphere refinement of the centre of a group of particles
+ */
+
+#ifndef VR_SHRINKINGSPHERE_H_
+#define VR_SHRINKINGSPHERE_H_
+
+#include <vector>
+
+#include "allvars.h"
+
+
+namespace vr {
+
+/**
+ * Refines the centre of mass of a group of particles by iteratively taking the
+ * centre of mass of the particles within a sphere around the previous centre,
+ * shrinking the sphere by Options::pinfo.cmadjustfac each time. Iterations stop
+ * once the sphere would hold fewer than Options::pinfo.cmfrac of the particles
+ * or fewer than PROPCMMINNUM particles.
+ *
+ * The particles are packed into arrays once. After each iteration, the particles
+ * further than twice the radius of the sphere from its centre are dropped from
+ * the arrays searched, so the work falls with the volume of the sphere. The
+ * next centre is the centre of mass of particles in the current sphere, so the
+ * next sphere almost always lies within the particles kept. When it does not,
+ * the search starts again from all the particles. No particle of a sphere is
+ * ever missed, and the order of the particles is kept, so the result is that of
+ * scanning all the particles on every iteration. Groups with at least
+ * omppropnum particles are searched with several threads.
+ */
+class ShrinkingSphere {
+
+public:
+
+	/// How the sphere shrinks on each iteration
+	enum class Scaling {
+		/// the squared radius is multiplied by the adjustment factor
+		radius_squared,
+		/// the radius is multiplied by the adjustment factor
+		radius
+	};
+
+	/**
+	 * Packs the particles of a group.
+	 *
+	 * @param opt The options giving the masses if NOMASS is defined
+	 * @param nbodies The number of particles in the group
+	 * @param part The particles of the group
+	 * @param type If not negative, only particles of this type are packed
+	 */
+	ShrinkingSphere(const Options &opt, Int_t nbodies, Particle *part, int type = -1);
+
+	/// The number of particles packed
+	Int_t size() const { return x.size(); }
+
+	/**
+	 * Iterates the centre of the sphere.
+	 *
+	 * @param opt The options with the parameters of the iterations
+	 * @param cm The starting centre, set to the centre found
+	 * @param r2 The squared radius of the starting sphere, set to that of the
+	 * sphere around the centre found, or left as it is if no iteration was accepted
+	 * @param scaling How the sphere shrinks on each iteration
+	 * @return The number of particles in the sphere around the centre found, or
+	 * size() if no iteration was accepted
+	 */
+	Int_t refine(const Options &opt, Coordinate &cm, Double_t &r2, Scaling scaling = Scaling::radius_squared);
+
+	/// Mass weighted velocity of the particles within sqrt(r2) of cm
+	Coordinate velocity(const Coordinate &cm, Double_t r2) const;
+
+private:
+
+	struct sums {
+		Double_t cmx, cmy, cmz, mass;
+		Int_t ninside;
+	};
+
+	sums scan(const Coordinate &cm, Double_t r2, Double_t keep2);
+	void reset();
+
+	/// all packed particles
+	std::vector<Double_t> x, y, z, mass, vx, vy, vz;
+	/// packed positions and masses of the particles that may lie in the coming spheres
+	std::vector<Double_t> sx, sy, sz, smass;
+	Int_t nsearch {0};
+
+};
+
+}  // namespace vr
+
+#endif // VR_SHRINKINGSPHERE_H_
@@ -0,0 +1,149 @@
+/**
+ * @file
+ *
+ * Physical-space trees shared between the stages of a run
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "logging.h"
+#include "spatialindex.h"
+
+namespace vr
+{
+
+namespace
+{
+
+// splitmix64 finaliser, spreading every bit of the input over the output
+inline std::uint64_t mix(std::uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+}  // anonymous namespace
+
+SpatialIndex::~SpatialIndex()
+{
+	clear();
+}
+
+KDTree *SpatialIndex::acquire(Particle *part, Int_t nbodies, Int_t bucket_size, const Double_t *period, bool exact_buckets)
+{
+	if (tree && !kept) {
+		LOG(warning) << "A tree was asked for before the previous one was given back, leaving it to its user";
+		tree = nullptr;
+	}
+	if (tree && part == this->part && nbodies == this->nbodies && same_period(period)
+	    && (!exact_buckets || bucket_size == this->bucket_size)
+	    && fingerprint(part, nbodies) == particles_fingerprint) {
+		// kept trees do not restore the input order, which a later plain release must do again
+		tree->SetResetOrder(true);
+		kept = false;
+		nreused++;
+		total_saved_time += build_time;
+		LOG(debug) << "Reusing tree over " << nbodies << " particles with buckets of " << this->bucket_size
+		           << " instead of building one with buckets of " << bucket_size;
+		return tree;
+	}
+
+	clear();
+	this->period.clear();
+	if (period) {
+		this->period.assign(period, period + 3);
+	}
+	Timer timer;
+	tree = new KDTree(part, nbodies, bucket_size, KDTree::TPHYS, KDTree::KEPAN, 1000, 0, 0, 0,
+	                  period ? this->period.data() : NULL);
+	build_time = timer.get();
+	this->part = part;
+	this->nbodies = nbodies;
+	this->bucket_size = bucket_size;
+	nbuilt++;
+	total_build_time += build_time;
+	LOG(debug) << "Built tree over " << nbodies << " particles in " << us_time(build_time);
+	return tree;
+}
+
+void SpatialIndex::release(KDTree *tree, bool keep)
+{
+	if (!tree) {
+		return;
+	}
+	if (tree != this->tree) {
+		delete tree;
+		return;
+	}
+	if (keep) {
+		// the particles stay in tree order for whoever uses the tree next
+		tree->SetResetOrder(false);
+		particles_fingerprint = fingerprint(part, nbodies);
+		kept = true;
+		return;
+	}
+	delete tree;
+	this->tree = nullptr;
+	kept = false;
+}
+
+void SpatialIndex::clear()
+{
+	if (tree) {
+		tree->SetResetOrder(false);
+		delete tree;
+	}
+	tree = nullptr;
+	kept = false;
+	part = nullptr;
+	nbodies = 0;
+}
+
+void SpatialIndex::report() const
+{
+	if (nbuilt == 0) {
+		return;
+	}
+	LOG(info) << "Built " << nbuilt << " shared trees in " << us_time(total_build_time) << ", reused " << nreused
+	          << " times saving about " << us_time(total_saved_time) << " of builds";
+}
+
+std::uint64_t SpatialIndex::fingerprint(Particle *part, Int_t nbodies) const
+{
+	// order dependent, as each particle is mixed with its index before the sum
+	std::uint64_t sum = 0;
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) reduction(+:sum) if (nbodies > ompsearchnum)
+#endif
+	for (Int_t i = 0; i < nbodies; i++) {
+		std::uint64_t h = mix(static_cast<std::uint64_t>(i));
+		for (int j = 0; j < 3; j++) {
+			Double_t x = part[i].GetPosition(j);
+			std::uint64_t bits = 0;
+			std::memcpy(&bits, &x, sizeof(x) < sizeof(bits) ? sizeof(x) : sizeof(bits));
+			h = mix(h ^ bits);
+		}
+		h = mix(h ^ static_cast<std::uint64_t>(part[i].GetID()));
+		sum += h;
+	}
+	return sum;
+}
+
+bool SpatialIndex::same_period(const Double_t *period) const
+{
+	if (!period) {
+		return this->period.empty();
+	}
+	return this->period.size() == 3 && std::equal(this->period.begin(), this->period.end(), period);
+}
+
+SpatialIndex &spatial_index()
+{
+	static SpatialIndex index;
+	return index;
+}
+
+}  // namespace vr
@@ -0,0 +1,107 @@
+/**
+ * @file
+ *
+ * Physical-space trees shared between the stages of a run
+ */
+
+#ifndef VR_SPATIALINDEX_H_
+#define VR_SPATIALINDEX_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "allvars.h"
+#include "timer.h"
+
+
+namespace vr {
+
+/**
+ * Keeps the physical-space tree built over a set of particles so that later
+ * stages searching the same particles use it instead of building their own.
+ *
+ * Building a KDTree permutes the particles into tree order, so a tree is only
+ * handed out again while the particles are exactly as it left them: the same
+ * array and number of particles, in the same order, with the same positions
+ * and ids. This is checked with a fingerprint of the particles that costs a
+ * single parallel pass over them, far less than a build.
+ *
+ * A stage that gives its tree back to be kept leaves its particles in tree
+ * order, as a kept tree does not restore the input order when it is finally
+ * dropped. A stage that gives its tree back without keeping it gets the usual
+ * behaviour of deleting the tree.
+ *
+ * The bucket size only changes the speed of neighbour searches, so stages that
+ * do not rely on the leaves of the tree are served by a cached tree with any
+ * bucket size. Stages that do, such as those walking the leaves, ask for exact
+ * buckets and get a new tree if the cached one has different buckets.
+ *
+ * The index is not thread safe and is meant to be used between parallel regions.
+ */
+class SpatialIndex {
+
+public:
+
+	SpatialIndex() = default;
+	~SpatialIndex();
+
+	SpatialIndex(const SpatialIndex &) = delete;
+	SpatialIndex &operator=(const SpatialIndex &) = delete;
+
+	/**
+	 * Returns a physical-space tree over the given particles, reusing the
+	 * cached tree if it was built over the same, unchanged particles.
+	 *
+	 * @param part The particles, which are put in tree order
+	 * @param nbodies The number of particles
+	 * @param bucket_size The number of particles in the leaves of the tree
+	 * @param period The period in each dimension, or NULL if not periodic
+	 * @param exact_buckets Whether a tree with another bucket size will not do
+	 */
+	KDTree *acquire(Particle *part, Int_t nbodies, Int_t bucket_size, const Double_t *period, bool exact_buckets = false);
+
+	/**
+	 * Gives back a tree obtained from acquire(), or any other tree over the
+	 * particles, which becomes the cached tree if kept and is deleted otherwise.
+	 * A kept tree leaves the particles in tree order, a deleted tree restores
+	 * their input order, also when it was kept and acquired again before.
+	 */
+	void release(KDTree *tree, bool keep = false);
+
+	/// Drops the cached tree, leaving the particles in their current order
+	void clear();
+
+	/// Logs the number of trees built and reused and the build time saved
+	void report() const;
+
+private:
+
+	std::uint64_t fingerprint(Particle *part, Int_t nbodies) const;
+	bool same_period(const Double_t *period) const;
+
+	/// the last tree handed out, which is cached once it has been given back to be kept
+	KDTree *tree {nullptr};
+	bool kept {false};
+	Particle *part {nullptr};
+	Int_t nbodies {0};
+	Int_t bucket_size {0};
+	/// fingerprint of the particles when the tree was given back
+	std::uint64_t particles_fingerprint {0};
+	/// the tree may refer to the period it was built with for as long as it lives
+	std::vector<Double_t> period;
+	/// time taken to build the cached tree, in [us]
+	Timer::duration build_time {0};
+
+	Int_t nbuilt {0};
+	Int_t nreused {0};
+	Timer::duration total_build_time {0};
+	Timer::duration total_saved_time {0};
+
+};
+
+/// The index shared by the stages of a run
+SpatialIndex &spatial_index();
+
+}  // namespace vr
+
+#endif // VR_SPATIALINDEX_H_
@@ -42,17 +42,12 @@ void GetCM(Options &opt, const Int_t nbodies, Particle *Part, Int_t ngroup, Int_
     LOG(debug) << "Getting CM";
     Particle *Pval;
     Int_t i,j,k;
-    Coordinate cmold;
-    Double_t massval, ri,rcmv,r2,cmx,cmy,cmz,EncMass,Ninside;
-    Double_t cmvx,cmvy,cmvz;
-    Double_t vc,rc,x,y,z,vx,vy,vz,mval;
-    Double_t change=MAXVALUE,tol=1e-2;
-    Int_t ii,icmv;
+    Double_t massval,rcmv,r2,cmx,cmy,cmz,EncMass;
 
     //for small groups loop over groups
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)  \
-private(i,j,k,Pval,ri,massval,rcmv,r2,cmx,cmy,cmz,EncMass,Ninside,cmold,change,tol,x,y,z,vx,vy,vz,vc,rc)
+private(i,j,k,Pval,massval,rcmv,r2)
 {
     #pragma omp for schedule(dynamic) nowait
 #endif
@@ -91,68 +86,11 @@ private(i,j,k,Pval,ri,massval,rcmv,r2,cmx,cmy,cmz,EncMass,Ninside,cmold,change,t
             if (sqrt(r2)>pdata[i].gsize)pdata[i].gsize=sqrt(r2);
         }
         //iterate for better cm if group large enough
-        cmold=pdata[i].gcm;
-        change=MAXVALUE;tol=1e-2;
         if (numingroup[i]*opt.pinfo.cmadjustfac>=PROPCMMINNUM && opt.iIterateCM) {
-            ri=pdata[i].gsize;
-            ri=ri*ri;
-            cmold=pdata[i].gcm;
-            rcmv=ri;
-            while (true)
-            {
-                ri*=opt.pinfo.cmadjustfac;
-                // find c/m of all particles within ri
-                cmx=cmy=cmz=0.;
-                EncMass=0.;
-                Ninside=0;
-                for (j=0;j<numingroup[i];j++)
-                {
-                    Pval=&Part[j+noffset[i]];
-                    x = (*Pval).X() - cmold[0];
-                    y = (*Pval).Y() - cmold[1];
-                    z = (*Pval).Z() - cmold[2];
-                    if ((x*x + y*y + z*z) <= ri)
-                    {
-                        massval = (*Pval).GetMass();
-#ifdef NOMASS
-                        massval = opt.MassValue;
-#endif
-                        cmx += massval*(*Pval).X();
-                        cmy += massval*(*Pval).Y();
-                        cmz += massval*(*Pval).Z();
-                        EncMass += massval;
-                        Ninside++;
-                    }
-                }
-                if (Ninside >= opt.pinfo.cmfrac * numingroup[i] && Ninside >= PROPCMMINNUM) {
-                    pdata[i].gcm[0]=cmx;pdata[i].gcm[1]=cmy;pdata[i].gcm[2]=cmz;
-                    for (k=0;k<3;k++) pdata[i].gcm[k] /= EncMass;
-                    cmold=pdata[i].gcm;
-                    rcmv=ri;
-                }
-                else break;
-            }
-            cmx=cmy=cmz=EncMass=0.;
-            for (j=0;j<numingroup[i];j++)
-            {
-                Pval=&Part[j+noffset[i]];
-                x = (*Pval).X() - pdata[i].gcm[0];
-                y = (*Pval).Y() - pdata[i].gcm[1];
-                z = (*Pval).Z() - pdata[i].gcm[2];
-                if ((x*x + y*y + z*z) <= rcmv)
-                {
-                    massval = (*Pval).GetMass();
-                    #ifdef NOMASS
-                    massval = opt.MassValue;
-                    #endif
-                    cmx += massval*(*Pval).Vx();
-                    cmy += massval*(*Pval).Vy();
-                    cmz += massval*(*Pval).Vz();
-                    EncMass += massval;
-                }
-            }
-            pdata[i].gcmvel[0]=cmx;pdata[i].gcmvel[1]=cmy;pdata[i].gcmvel[2]=cmz;
-            for (k=0;k<3;k++) pdata[i].gcmvel[k] /= EncMass;
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]]);
+            rcmv=pdata[i].gsize*pdata[i].gsize;
+            sphere.refine(opt, pdata[i].gcm, rcmv);
+            pdata[i].gcmvel=sphere.velocity(pdata[i].gcm, rcmv);
         }
     }
 #ifdef USEOPENMP
@@ -232,90 +170,11 @@ private(j,Pval,massval)
             for (k=0;k<3;k++) r2+=(pdata[i].gcm[k]-(*Pval).GetPosition(k))*(pdata[i].gcm[k]-(*Pval).GetPosition(k));
             if (sqrt(r2)>pdata[i].gsize)pdata[i].gsize=sqrt(r2);
         }
-        ri=pdata[i].gsize;
-        ri=ri*ri;
-        //iterate for better cm if group large enough
-        cmold=pdata[i].gcm;
-        change=MAXVALUE;tol=1e-2;
-        rcmv=ri;
-        ii=numingroup[i];
-        while (opt.iIterateCM)
-        {
-            ri*=opt.pinfo.cmadjustfac;
-            // find c/m of all particles within ri
-            cmx=cmy=cmz=0.;
-            EncMass=0.;
-            Ninside=0;
-#ifdef USEOPENMP
-#pragma omp parallel default(shared) \
-private(j,Pval,x,y,z,massval)
-{
-#pragma omp for reduction(+:EncMass,Ninside,cmx,cmy,cmz)
-#endif
-            for (j=0;j<numingroup[i];j++)
-            {
-                Pval=&Part[j+noffset[i]];
-                x = (*Pval).X() - cmold[0];
-                y = (*Pval).Y() - cmold[1];
-                z = (*Pval).Z() - cmold[2];
-                if ((x*x + y*y + z*z) <= ri)
-                {
-                    massval = (*Pval).GetMass();
-#ifdef NOMASS
-                    massval = opt.MassValue;
-#endif
-                    cmx += massval*(*Pval).X();
-                    cmy += massval*(*Pval).Y();
-                    cmz += massval*(*Pval).Z();
-                    EncMass += massval;
-                    Ninside++;
-                }
-            }
-#ifdef USEOPENMP
-}
-#endif
-            x = Part[noffset[i]+ii-1].X() - cmold[0];
-            y = Part[noffset[i]+ii-1].Y() - cmold[1];
-            z = Part[noffset[i]+ii-1].Z() - cmold[2];
-            if (Ninside >= opt.pinfo.cmfrac * numingroup[i] && Ninside >= PROPCMMINNUM) {
-                cmold[0]=cmx;cmold[1]=cmy;cmold[2]=cmz;
-                for (k=0;k<3;k++) cmold[k] /= EncMass;
-                rcmv=ri;
-                icmv=ii;
-            }
-            else break;
-        }
-        pdata[i].gcm=cmold;
-        cmx=cmy=cmz=EncMass=0.;
-#ifdef USEOPENMP
-#pragma omp parallel default(shared) \
-private(j,Pval,x,y,z,massval)
-{
-    #pragma omp for reduction(+:EncMass,cmx,cmy,cmz)
-#endif
-        for (j=0;j<numingroup[i];j++)
-        {
-            Pval=&Part[j+noffset[i]];
-            x = (*Pval).X() - cmold[0];
-            y = (*Pval).Y() - cmold[1];
-            z = (*Pval).Z() - cmold[2];
-            if ((x*x + y*y + z*z) <= rcmv)
-            {
-                massval = (*Pval).GetMass();
-                #ifdef NOMASS
-                massval = opt.MassValue;
-                #endif
-                cmx += massval*(*Pval).Vx();
-                cmy += massval*(*Pval).Vy();
-                cmz += massval*(*Pval).Vz();
-                EncMass += massval;
-            }
-        }
-#ifdef USEOPENMP
-}
-#endif
-        pdata[i].gcmvel[0]=cmx;pdata[i].gcmvel[1]=cmy;pdata[i].gcmvel[2]=cmz;
-        for (k=0;k<3;k++) pdata[i].gcmvel[k] /= EncMass;
+        //iterate for better cm, the sphere being searched with several threads
+        vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]]);
+        rcmv=pdata[i].gsize*pdata[i].gsize;
+        sphere.refine(opt, pdata[i].gcm, rcmv);
+        pdata[i].gcmvel=sphere.velocity(pdata[i].gcm, rcmv);
     }
     LOG(debug) << "Done getting CM in " << timer;
 }
@@ -340,7 +199,7 @@ void GetProperties(Options &opt, const Int_t nbodies, Particle *Part, Int_t ngro
     Particle *Pval;
     Int_t i,j,k;
     Coordinate cmold(0.),cmref;
-    Double_t ri,rcmv,r2,cmx,cmy,cmz,EncMass,Ninside, SFR, temp;
+    Double_t rcmv,r2,cmx,cmy,cmz,EncMass, SFR, temp;
     Double_t EncMassSF,EncMassNSF;
     Double_t cmvx,cmvy,cmvz;
     Double_t vc,rc,x,y,z,vx,vy,vz,jzval,Rdist,zdist,Ekin,Krot,mval;
@@ -352,7 +211,6 @@ void GetProperties(Options &opt, const Int_t nbodies, Particle *Part, Int_t ngro
     Double_t Tsum_hot,Zsum_hot;
     Double_t sigV_gas_sf,sigV_gas_nsf;
     Coordinate jval;
-    Double_t change=MAXVALUE,tol=1e-2;
     Int_t ii,icmv;
     Int_t RV_num;
     Double_t virval=log(opt.virlevel*opt.rhobg);
@@ -403,7 +261,7 @@ private(i,j,k,Pval,cmref)
             for (k=0;k<3;k++) Pval->SetPosition(k, Pval->GetPosition(k) - cmref[k]);
         }
         //sort by radius (here use gsl_heapsort as no need to allocate more memory
-        gsl_heapsort(&Part[noffset[i]], numingroup[i], sizeof(Particle), RadCompare);
+        SortParticles(numingroup[i], &Part[noffset[i]], PSORTRADIUS);
     }
 #ifdef USEOPENMP
 }
@@ -412,7 +270,7 @@ private(i,j,k,Pval,cmref)
     //for small groups loop over groups
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)  \
-private(i,j,k,Pval,ri,rcmv,r2,cmx,cmy,cmz,EncMass,Ninside,cmold,change,tol)\
+private(i,j,k,Pval,rcmv,r2,cmx,cmy,cmz,EncMass,cmold)\
 private(x,y,z,vx,vy,vz,vc,rc,jval,jzval,Rdist,zdist,Ekin,Krot,mval,RV_Ekin,RV_Krot,RV_num,SFR,temp)\
 private(EncMassSF,EncMassNSF,Krot_sf,Krot_nsf,Ekin_sf,Ekin_nsf)
 {
@@ -730,74 +588,11 @@ private(EncMassSF,EncMassNSF,Krot_sf,Krot_nsf,Ekin_sf,Ekin_nsf)
 	#endif
 
         //iterate for better cm if group large enough
-        cmold=pdata[i].cm_gas;
-        change=MAXVALUE;tol=1e-2;
         if (pdata[i].n_gas*opt.pinfo.cmadjustfac>=PROPCMMINNUM && opt.iIterateCM) {
-            ri=pdata[i].gsize;
-            ri=ri*ri;
-            cmold=pdata[i].cm_gas;
-            rcmv=ri;
-            while (true)
-            {
-                ri*=opt.pinfo.cmadjustfac;
-                // find c/m of all particles within ri
-                cmx=cmy=cmz=0.;
-                EncMass=0.;
-                Ninside=0;
-                for (j=0;j<numingroup[i];j++) {
-                Pval=&Part[j+noffset[i]];
-                if (Pval->GetType()==GASTYPE)
-                {
-                    x = (*Pval).X() - cmold[0];
-                    y = (*Pval).Y() - cmold[1];
-                    z = (*Pval).Z() - cmold[2];
-                    if ((x*x + y*y + z*z) <= ri)
-                    {
-                        #ifndef NOMASS
-                        mval = Pval->GetMass();
-                        #else
-                        mval = opt.MassValue;
-                        #endif
-                        cmx += mval*(*Pval).X();
-                        cmy += mval*(*Pval).Y();
-                        cmz += mval*(*Pval).Z();
-                        EncMass += mval;
-                        Ninside++;
-                    }
-                }
-                }
-                if (Ninside >= opt.pinfo.cmfrac * pdata[i].n_gas && Ninside >= PROPCMMINNUM) {
-                    pdata[i].cm_gas[0]=cmx;pdata[i].cm_gas[1]=cmy;pdata[i].cm_gas[2]=cmz;
-                    for (k=0;k<3;k++) pdata[i].cm_gas[k] /= EncMass;
-                    cmold=pdata[i].cm_gas;
-                    rcmv=ri;
-                }
-                else break;
-            }
-            cmx=cmy=cmz=EncMass=0.;
-            for (j=0;j<numingroup[i];j++) {
-            Pval=&Part[j+noffset[i]];
-            if (Pval->GetType()==GASTYPE)
-            {
-                x = (*Pval).X() - pdata[i].cm_gas[0];
-                y = (*Pval).Y() - pdata[i].cm_gas[1];
-                z = (*Pval).Z() - pdata[i].cm_gas[2];
-                if ((x*x + y*y + z*z) <= rcmv)
-                {
-                    #ifndef NOMASS
-                    mval = Pval->GetMass();
-                    #else
-                    mval = opt.MassValue;
-                    #endif
-                    cmx += mval*(*Pval).Vx();
-                    cmy += mval*(*Pval).Vy();
-                    cmz += mval*(*Pval).Vz();
-                    EncMass += mval;
-                }
-            }
-            }
-            pdata[i].cmvel_gas[0]=cmx;pdata[i].cmvel_gas[1]=cmy;pdata[i].cmvel_gas[2]=cmz;
-            for (k=0;k<3;k++) pdata[i].cmvel_gas[k] /= EncMass;
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]], GASTYPE);
+            rcmv=pdata[i].gsize*pdata[i].gsize;
+            sphere.refine(opt, pdata[i].cm_gas, rcmv);
+            pdata[i].cmvel_gas=sphere.velocity(pdata[i].cm_gas, rcmv);
         }
 
         if (pdata[i].n_gas>=PROPROTMINNUM) {
@@ -989,74 +784,11 @@ private(EncMassSF,EncMassNSF,Krot_sf,Krot_nsf,Ekin_sf,Ekin_nsf)
             pdata[i].Z_mean_star/=pdata[i].M_star;
         }
         //iterate for better cm if group large enough
-        cmold=pdata[i].cm_star;
-        change=MAXVALUE;tol=1e-2;
         if (pdata[i].n_star*opt.pinfo.cmadjustfac>=PROPCMMINNUM && opt.iIterateCM) {
-            ri=pdata[i].gsize;
-            ri=ri*ri;
-            cmold=pdata[i].cm_star;
-            rcmv=ri;
-            while (true)
-            {
-                ri*=opt.pinfo.cmadjustfac;
-                // find c/m of all particles within ri
-                cmx=cmy=cmz=0.;
-                EncMass=0.;
-                Ninside=0;
-                for (j=0;j<numingroup[i];j++) {
-                Pval=&Part[j+noffset[i]];
-                if (Pval->GetType()==STARTYPE)
-                {
-                    x = (*Pval).X() - cmold[0];
-                    y = (*Pval).Y() - cmold[1];
-                    z = (*Pval).Z() - cmold[2];
-                    if ((x*x + y*y + z*z) <= ri)
-                    {
-                        #ifndef NOMASS
-                        mval = Pval->GetMass();
-                        #else
-                        mval = opt.MassValue;
-                        #endif
-                        cmx += mval*(*Pval).X();
-                        cmy += mval*(*Pval).Y();
-                        cmz += mval*(*Pval).Z();
-                        EncMass += mval;
-                        Ninside++;
-                    }
-                }
-                }
-                if (Ninside >= opt.pinfo.cmfrac * pdata[i].n_star && Ninside >= PROPCMMINNUM) {
-                    pdata[i].cm_star[0]=cmx;pdata[i].cm_star[1]=cmy;pdata[i].cm_star[2]=cmz;
-                    for (k=0;k<3;k++) pdata[i].cm_star[k] /= EncMass;
-                    cmold=pdata[i].cm_star;
-                    rcmv=ri;
-                }
-                else break;
-            }
-            cmx=cmy=cmz=EncMass=0.;
-            for (j=0;j<numingroup[i];j++) {
-            Pval=&Part[j+noffset[i]];
-            if (Pval->GetType()==STARTYPE)
-            {
-                x = (*Pval).X() - pdata[i].cm_star[0];
-                y = (*Pval).Y() - pdata[i].cm_star[1];
-                z = (*Pval).Z() - pdata[i].cm_star[2];
-                if ((x*x + y*y + z*z) <= rcmv)
-                {
-#ifndef NOMASS
-                    mval = Pval->GetMass();
-#else
-                    mval = opt.MassValue;
-#endif
-                    cmx += mval*(*Pval).Vx();
-                    cmy += mval*(*Pval).Vy();
-                    cmz += mval*(*Pval).Vz();
-                    EncMass += mval;
-                }
-            }
-            }
-            pdata[i].cmvel_star[0]=cmx;pdata[i].cmvel_star[1]=cmy;pdata[i].cmvel_star[2]=cmz;
-            for (k=0;k<3;k++) pdata[i].cmvel_star[k] /= EncMass;
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]], STARTYPE);
+            rcmv=pdata[i].gsize*pdata[i].gsize;
+            sphere.refine(opt, pdata[i].cm_star, rcmv);
+            pdata[i].cmvel_star=sphere.velocity(pdata[i].cm_star, rcmv);
         }
         if (pdata[i].n_star>=PROPROTMINNUM) {
 	    Double_t oldrc=0;
@@ -1641,74 +1373,11 @@ private(j,Pval,x,y,z,vx,vy,vz,J,mval,SFR)
         #endif
 
         //iterate for better cm if group large enough
-        cmold=pdata[i].cm_gas;
-        change=MAXVALUE;tol=1e-2;
         if (pdata[i].n_gas*opt.pinfo.cmadjustfac>=PROPCMMINNUM && opt.iIterateCM) {
-            ri=pdata[i].gsize;
-            ri=ri*ri;
-            cmold=pdata[i].cm_gas;
-            rcmv=ri;
-            while (true)
-            {
-                ri*=opt.pinfo.cmadjustfac;
-                // find c/m of all particles within ri
-                cmx=cmy=cmz=0.;
-                EncMass=0.;
-                Ninside=0;
-                for (j=0;j<numingroup[i];j++) {
-                Pval=&Part[j+noffset[i]];
-                if (Pval->GetType()==GASTYPE)
-                {
-                    x = (*Pval).X() - cmold[0];
-                    y = (*Pval).Y() - cmold[1];
-                    z = (*Pval).Z() - cmold[2];
-                    if ((x*x + y*y + z*z) <= ri)
-                    {
-#ifndef NOMASS
-                        mval = Pval->GetMass();
-#else
-                        mval = opt.MassValue;
-#endif
-                        cmx += mval*(*Pval).X();
-                        cmy += mval*(*Pval).Y();
-                        cmz += mval*(*Pval).Z();
-                        EncMass += mval;
-                        Ninside++;
-                    }
-                }
-                }
-                if (Ninside >= opt.pinfo.cmfrac * pdata[i].n_gas && Ninside >= PROPCMMINNUM) {
-                    pdata[i].cm_gas[0]=cmx;pdata[i].cm_gas[1]=cmy;pdata[i].cm_gas[2]=cmz;
-                    for (k=0;k<3;k++) pdata[i].cm_gas[k] /= EncMass;
-                    cmold=pdata[i].cm_gas;
-                    rcmv=ri;
-                }
-                else break;
-            }
-            cmx=cmy=cmz=EncMass=0.;
-            for (j=0;j<numingroup[i];j++) {
-            Pval=&Part[j+noffset[i]];
-            if (Pval->GetType()==GASTYPE)
-            {
-                x = (*Pval).X() - pdata[i].cm_gas[0];
-                y = (*Pval).Y() - pdata[i].cm_gas[1];
-                z = (*Pval).Z() - pdata[i].cm_gas[2];
-                if ((x*x + y*y + z*z) <= rcmv)
-                {
-#ifndef NOMASS
-                    mval = Pval->GetMass();
-#else
-                    mval = opt.MassValue;
-#endif
-                    cmx += mval*(*Pval).Vx();
-                    cmy += mval*(*Pval).Vy();
-                    cmz += mval*(*Pval).Vz();
-                    EncMass += mval;
-                }
-            }
-            }
-            pdata[i].cmvel_gas[0]=cmx;pdata[i].cmvel_gas[1]=cmy;pdata[i].cmvel_gas[2]=cmz;
-            for (k=0;k<3;k++) pdata[i].cmvel_gas[k] /= EncMass;
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]], GASTYPE);
+            rcmv=pdata[i].gsize*pdata[i].gsize;
+            sphere.refine(opt, pdata[i].cm_gas, rcmv);
+            pdata[i].cmvel_gas=sphere.velocity(pdata[i].cm_gas, rcmv);
         }
         //now having angular momentum and a few other properties.
         if (pdata[i].n_gas>=PROPROTMINNUM) {
@@ -1922,74 +1591,11 @@ private(j,Pval,x,y,z,vx,vy,vz,J,mval)
             pdata[i].Z_mean_star=Zmeansum/pdata[i].M_star;
         }
         //iterate for better cm if group large enough
-        cmold=pdata[i].cm_star;
-        change=MAXVALUE;tol=1e-2;
         if (pdata[i].n_star*opt.pinfo.cmadjustfac>=PROPCMMINNUM && opt.iIterateCM) {
-            ri=pdata[i].gsize;
-            ri=ri*ri;
-            cmold=pdata[i].cm_star;
-            rcmv=ri;
-            while (true)
-            {
-                ri*=opt.pinfo.cmadjustfac;
-                // find c/m of all particles within ri
-                cmx=cmy=cmz=0.;
-                EncMass=0.;
-                Ninside=0;
-                for (j=0;j<numingroup[i];j++) {
-                Pval=&Part[j+noffset[i]];
-                if (Pval->GetType()==STARTYPE)
-                {
-                    x = (*Pval).X() - cmold[0];
-                    y = (*Pval).Y() - cmold[1];
-                    z = (*Pval).Z() - cmold[2];
-                    if ((x*x + y*y + z*z) <= ri)
-                    {
-#ifndef NOMASS
-                        mval = Pval->GetMass();
-#else
-                        mval = opt.MassValue;
-#endif
-                        cmx += mval*(*Pval).X();
-                        cmy += mval*(*Pval).Y();
-                        cmz += mval*(*Pval).Z();
-                        EncMass += mval;
-                        Ninside++;
-                    }
-                }
-                }
-                if (Ninside >= opt.pinfo.cmfrac * pdata[i].n_star && Ninside >= PROPCMMINNUM) {
-                    pdata[i].cm_star[0]=cmx;pdata[i].cm_star[1]=cmy;pdata[i].cm_star[2]=cmz;
-                    for (k=0;k<3;k++) pdata[i].cm_star[k] /= EncMass;
-                    cmold=pdata[i].cm_star;
-                    rcmv=ri;
-                }
-                else break;
-            }
-            cmx=cmy=cmz=EncMass=0.;
-            for (j=0;j<numingroup[i];j++) {
-            Pval=&Part[j+noffset[i]];
-            if (Pval->GetType()==STARTYPE)
-            {
-                x = (*Pval).X() - pdata[i].cm_star[0];
-                y = (*Pval).Y() - pdata[i].cm_star[1];
-                z = (*Pval).Z() - pdata[i].cm_star[2];
-                if ((x*x + y*y + z*z) <= rcmv)
-                {
-#ifndef NOMASS
-                    mval = Pval->GetMass();
-#else
-                    mval = opt.MassValue;
-#endif
-                    cmx += mval*(*Pval).Vx();
-                    cmy += mval*(*Pval).Vy();
-                    cmz += mval*(*Pval).Vz();
-                    EncMass += mval;
-                }
-            }
-            }
-            pdata[i].cmvel_star[0]=cmx;pdata[i].cmvel_star[1]=cmy;pdata[i].cmvel_star[2]=cmz;
-            for (k=0;k<3;k++) pdata[i].cmvel_star[k] /= EncMass;
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]], STARTYPE);
+            rcmv=pdata[i].gsize*pdata[i].gsize;
+            sphere.refine(opt, pdata[i].cm_star, rcmv);
+            pdata[i].cmvel_star=sphere.velocity(pdata[i].cm_star, rcmv);
         }
 
         if (pdata[i].n_star>=PROPROTMINNUM) {
@@ -2358,7 +1964,7 @@ void GetInclusiveMasses(Options &opt, const Int_t nbodies, Particle *Part, Int_t
     else if (opt.iInclusiveHalo == 2) {
         LOG(debug) << " with masses based on full SO search (slower)";
     }
-    Double_t ri,ri2,rcmv,r2,cmx,cmy,cmz,EncMass,Ninside;
+    Double_t ri2,r2,cmx,cmy,cmz,EncMass,Ninside;
     Double_t x,y,z,vx,vy,vz,massval,rc,rcold;
     Coordinate cmold(0.),J(0.);
     Double_t change=MAXVALUE,tol=1e-2;
@@ -2403,7 +2009,7 @@ void GetInclusiveMasses(Options &opt, const Int_t nbodies, Particle *Part, Int_t
     //for small groups loop over groups
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)  \
-private(i,j,k,Pval,ri,rcmv,ri2,r2,cmx,cmy,cmz,EncMass,Ninside,icmv,cmold,x,y,z,vx,vy,vz,massval)
+private(i,j,k,Pval,ri2,r2,cmx,cmy,cmz,EncMass,Ninside,icmv,cmold,x,y,z,vx,vy,vz,massval)
 {
     #pragma omp for schedule(dynamic) nowait
 #endif
@@ -2423,53 +2029,20 @@ private(i,j,k,Pval,ri,rcmv,ri2,r2,cmx,cmy,cmz,EncMass,Ninside,icmv,cmold,x,y,z,v
             }
         }
         for (k=0;k<3;k++)pdata[i].gcm[k]*=(1.0/pdata[i].gmass);
-        ri=ri2=0;
+        ri2=0;
         for (j=0;j<numingroup[i];j++) {
             Pval=&Part[j+noffset[i]];
             x = (*Pval).X() - pdata[i].gcm[0];
             y = (*Pval).Y() - pdata[i].gcm[1];
             z = (*Pval).Z() - pdata[i].gcm[2];
             r2=x*x+y*y+z*z;
-            if (ri2<r2) {ri2=r2;ri=sqrt(ri2);}
+            if (ri2<r2) ri2=r2;
         }
-        //iterate cm
-        cmold=pdata[i].gcm;
+        //iterate cm, shrinking the radius rather than its square
         icmv=numingroup[i];
-        while (opt.iIterateCM)
-        {
-            ri*=opt.pinfo.cmadjustfac;
-            rcmv=ri;
-            ri2=ri*ri;
-            // find c/m of all particles within ri
-            cmx=cmy=cmz=0.;
-            EncMass=0.;
-            Ninside=0;
-            for (j=0;j<numingroup[i];j++)
-            {
-                Pval=&Part[j+noffset[i]];
-                x = (*Pval).X() - cmold[0];
-                y = (*Pval).Y() - cmold[1];
-                z = (*Pval).Z() - cmold[2];
-                if ((x*x + y*y + z*z) <= ri2)
-                {
-                    massval = (*Pval).GetMass();
-                    #ifdef NOMASS
-                    massval = opt.MassValue;
-                    #endif
-                    cmx += massval*(*Pval).X();
-                    cmy += massval*(*Pval).Y();
-                    cmz += massval*(*Pval).Z();
-                    EncMass += massval;
-                    Ninside++;
-                }
-            }
-            if (Ninside >= opt.pinfo.cmfrac * numingroup[i] && Ninside >= PROPCMMINNUM) {
-                pdata[i].gcm[0]=cmx;pdata[i].gcm[1]=cmy;pdata[i].gcm[2]=cmz;
-                for (k=0;k<3;k++) pdata[i].gcm[k] /= EncMass;
-                cmold=pdata[i].gcm;
-                icmv=Ninside;
-            }
-            else break;
+        if (opt.iIterateCM) {
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]]);
+            icmv=sphere.refine(opt, pdata[i].gcm, ri2, vr::ShrinkingSphere::Scaling::radius);
         }
         //move to centre-of-mass
         for (j=0;j<numingroup[i];j++) {
@@ -2479,7 +2052,7 @@ private(i,j,k,Pval,ri,rcmv,ri2,r2,cmx,cmy,cmz,EncMass,Ninside,icmv,cmold,x,y,z,v
             }
         }
         //sort by radius
-        gsl_heapsort(&Part[noffset[i]], numingroup[i], sizeof(Particle), RadCompare);
+        SortParticles(numingroup[i], &Part[noffset[i]], PSORTRADIUS);
         pdata[i].gsize=Part[noffset[i]+numingroup[i]-1].Radius();
         pdata[i].gRhalfmass=Part[noffset[i]+(numingroup[i]/2)].Radius();
         //then get cmvel if extra output is desired as will need angular momentum
@@ -2533,61 +2106,20 @@ private(j,Pval,massval)
         pdata[i].gmass=EncMass;
         pdata[i].gcm[0]=cmx;pdata[i].gcm[1]=cmy;pdata[i].gcm[2]=cmz;
         for (k=0;k<3;k++)pdata[i].gcm[k]*=(1.0/pdata[i].gmass);
-        ri=ri2=0;
+        ri2=0;
         for (j=0;j<numingroup[i];j++) {
             Pval=&Part[j+noffset[i]];
             x = (*Pval).X() - pdata[i].gcm[0];
             y = (*Pval).Y() - pdata[i].gcm[1];
             z = (*Pval).Z() - pdata[i].gcm[2];
             r2=x*x+y*y+z*z;
-            if (ri2<r2) {ri2=r2;ri=sqrt(ri2);}
+            if (ri2<r2) ri2=r2;
         }
-        //iterate cm
-        cmold=pdata[i].gcm;
+        //iterate cm, shrinking the radius rather than its square
         icmv=numingroup[i];
-        while (opt.iIterateCM)
-        {
-            ri*=opt.pinfo.cmadjustfac;
-            rcmv=ri;
-            ri2=ri*ri;
-            // find c/m of all particles within ri
-            cmx=cmy=cmz=0.;
-            EncMass=0.;
-            Ninside=0;
-#ifdef USEOPENMP
-#pragma omp parallel default(shared)  \
-private(j,Pval,x,y,z,massval)
-{
-#pragma omp for reduction(+:EncMass,Ninside,cmx,cmy,cmz)
-#endif
-            for (j=0;j<numingroup[i];j++) {
-                Pval=&Part[j+noffset[i]];
-                x = (*Pval).X() - cmold[0];
-                y = (*Pval).Y() - cmold[1];
-                z = (*Pval).Z() - cmold[2];
-                massval=(*Pval).GetMass();
-#ifdef NOMASS
-                massval = opt.MassValue;
-#endif
-                if ((x*x + y*y + z*z) <= ri2)
-                {
-                    EncMass+=massval;
-                    cmx+=(*Pval).X()*massval;
-                    cmy+=(*Pval).Y()*massval;
-                    cmz+=(*Pval).Z()*massval;
-                    Ninside++;
-                }
-            }
-#ifdef USEOPENMP
-}
-#endif
-            if (Ninside >= opt.pinfo.cmfrac * numingroup[i] && Ninside >= PROPCMMINNUM) {
-                pdata[i].gcm[0]=cmx;pdata[i].gcm[1]=cmy;pdata[i].gcm[2]=cmz;
-                for (k=0;k<3;k++) pdata[i].gcm[k] /= EncMass;
-                cmold=pdata[i].gcm;
-                icmv=Ninside;
-            }
-            else break;
+        if (opt.iIterateCM) {
+            vr::ShrinkingSphere sphere(opt, numingroup[i], &Part[noffset[i]]);
+            icmv=sphere.refine(opt, pdata[i].gcm, ri2, vr::ShrinkingSphere::Scaling::radius);
         }
         for (j=0;j<numingroup[i];j++) {
             Pval=&Part[j+noffset[i]];
@@ -2595,7 +2127,7 @@ private(j,Pval,x,y,z,massval)
                 Pval->SetPosition(k,(*Pval).GetPosition(k)-pdata[i].gcm[k]);
             }
         }
-        qsort(&Part[noffset[i]], numingroup[i], sizeof(Particle), RadCompare);
+        SortParticles(numingroup[i], &Part[noffset[i]], PSORTRADIUS);
         pdata[i].gsize=Part[noffset[i]+numingroup[i]-1].Radius();
         pdata[i].gRhalfmass=Part[noffset[i]+(numingroup[i]/2)].Radius();
         //then get cmvel if extra output is desired as will need angular momentum
@@ -2766,11 +2298,9 @@ private(i,j,k,x,y,z,Pval)
         vector<Int_t> taggedparts;
         vector<Double_t> radii;
         vector<Double_t> masses;
-        vector<Int_t> indices;
         vector<Coordinate> posparts;
         vector<Coordinate> velparts;
         vector<int> typeparts;
-        size_t n;
         Double_t dx;
         vector<Double_t> maxrdist(ngroup+1);
         //to store particle ids of those in SO volume.
@@ -2816,7 +2346,7 @@ private(i,j,k,x,y,z,Pval)
         //build tree optimised to search for more than min group size
         //this is the bottle neck for the SO calculation. Wonder if there is an easy
         //way of speeding it up
-        tree=new KDTree(Part,nbodies,opt.HaloMinSize,tree->TPHYS,tree->KEPAN,100,0,0,0,period);
+        tree=vr::spatial_index().acquire(Part,nbodies,opt.HaloMinSize,period);
         //store the radii that will be used to search for each group
         //this is based on maximum radius and the enclosed density within the FOF so that if
         //this density is larger than desired overdensity then we must increase the radius
@@ -2856,7 +2386,7 @@ private(i,j,k,x,y,z,Pval)
         fac=-log(4.0*M_PI/3.0);
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)  \
-private(i,j,k,taggedparts,radii,masses,indices,posparts,velparts,typeparts,n,dx,EncMass,J,rc,rhoval,rhoval2,tid,SOpids,iSOfound)
+private(i,j,k,taggedparts,radii,masses,posparts,velparts,typeparts,dx,EncMass,J,rc,rhoval,rhoval2,tid,SOpids,iSOfound)
 {
     #pragma omp for schedule(dynamic) nowait
 #endif
@@ -2941,27 +2471,25 @@ private(i,j,k,taggedparts,radii,masses,indices,posparts,velparts,typeparts,n,dx,
                 }
             }
 #endif
-            //get incides
-            indices.resize(radii.size());
-            n=0;generate(indices.begin(), indices.end(), [&]{ return n++; });
-            //sort by radius
-            auto comparator = [&radii](int a, int b){ return radii[a] < radii[b]; };
-            sort(indices.begin(), indices.end(), comparator);
-            Int_t llindex = CalculateSphericalOverdensity(opt, pdata[i], radii, masses, indices, m200val, m200mval, mBN98val, virval, m500val, SOlgrhovals);
+            //bucket by radius, only the bins needed are sorted
+            vr::RadialBins bins(opt, radii, masses);
+            Int_t llindex = CalculateSphericalOverdensity(opt, pdata[i], radii, masses, bins, m200val, m200mval, mBN98val, virval, m500val, SOlgrhovals);
             SetSphericalOverdensityMasstoFlagValue(opt, pdata[i]);
 
             //calculate angular momentum if necessary
             if (opt.iextrahalooutput) {
-                for (j=0;j<radii.size();j++) {
-                    massval = masses[indices[j]];
-                    J=Coordinate(posparts[indices[j]]).Cross(velparts[indices[j]])*massval;
-                    rc=posparts[indices[j]].Length();
+                //only the bins reaching the largest overdensity radius hold particles that contribute
+                Int_t nwithin=bins.end_within(max({pdata[i].gR200c,pdata[i].gR200m,pdata[i].gRBN98}));
+                for (j=0;j<nwithin;j++) {
+                    massval = masses[bins[j]];
+                    J=Coordinate(posparts[bins[j]]).Cross(velparts[bins[j]])*massval;
+                    rc=posparts[bins[j]].Length();
                     if (rc<=pdata[i].gR200c) pdata[i].gJ200c+=J;
                     if (rc<=pdata[i].gR200m) pdata[i].gJ200m+=J;
                     if (rc<=pdata[i].gRBN98) pdata[i].gJBN98+=J;
 #ifdef GASON
                     if (opt.iextragasoutput) {
-                        if (typeparts[indices[j]]==GASTYPE){
+                        if (typeparts[bins[j]]==GASTYPE){
                             if (rc<=pdata[i].gR200c) {
                                 pdata[i].M_200crit_gas+=massval;
                                 pdata[i].L_200crit_gas+=J;
@@ -2979,7 +2507,7 @@ private(i,j,k,taggedparts,radii,masses,indices,posparts,velparts,typeparts,n,dx,
 #endif
 #ifdef STARON
                     if (opt.iextrastaroutput) {
-                        if (typeparts[indices[j]]==STARTYPE){
+                        if (typeparts[bins[j]]==STARTYPE){
                             if (rc<=pdata[i].gR200c) {
                                 pdata[i].M_200crit_star+=massval;
                                 pdata[i].L_200crit_star+=J;
@@ -3005,13 +2533,14 @@ private(i,j,k,taggedparts,radii,masses,indices,posparts,velparts,typeparts,n,dx,
                 int ibin = 0;
                 if (opt.iprofilenorm == PROFILERNORMR200CRIT) irnorm = 1.0/pdata[i].gR200c;
                 else irnorm = 1.0;
+                bins.sort();
                 for (j=0;j<radii.size();j++) {
                     ///\todo need to update to allow for star forming/non-star forming profiles
                     ///by storing the star forming value.
                     double sfrval = 0;
-                    AddDataToRadialBin(opt, radii[indices[j]], masses[indices[j]],
+                    AddDataToRadialBin(opt, radii[bins[j]], masses[bins[j]],
 #if defined(GASON) || defined(STARON) || defined(BHON)
-                        sfrval, typeparts[indices[j]],
+                        sfrval, typeparts[bins[j]],
 #endif
                         irnorm, ibin, pdata[i]);
                 }
@@ -3024,13 +2553,12 @@ private(i,j,k,taggedparts,radii,masses,indices,posparts,velparts,typeparts,n,dx,
 #if defined(GASON) || defined(STARON) || defined(BHON)
                 SOparttypelist[i].resize(llindex);
 #endif
-                for (j=0;j<llindex;j++) SOpartlist[i][j]=SOpids[indices[j]];
+                for (j=0;j<llindex;j++) SOpartlist[i][j]=SOpids[bins.sorted(j)];
 #if defined(GASON) || defined(STARON) || defined(BHON)
-                for (j=0;j<llindex;j++) SOparttypelist[i][j]=typeparts[indices[j]];
+                for (j=0;j<llindex;j++) SOparttypelist[i][j]=typeparts[bins.sorted(j)];
 #endif
                 SOpids.clear();
             }
-            indices.clear();
             radii.clear();
             masses.clear();
             if (opt.iextrahalooutput) {
@@ -3045,7 +2573,7 @@ private(i,j,k,taggedparts,radii,masses,indices,posparts,velparts,typeparts,n,dx,
 #ifdef USEOPENMP
     }
 #endif
-        delete tree;
+        vr::spatial_index().release(tree);
         //reset its after putting particles back in input order
         for (i=0;i<nbodies;i++) Part[i].SetID(ids[i]);
         ids.clear();
@@ -3293,12 +2821,10 @@ void GetSOMasses(Options &opt, const Int_t nbodies, Particle *Part, Int_t ngroup
     vector<Double_t> radii;
     vector<Double_t> masses;
 
-    vector<Int_t> indices;
     Coordinate posref;
     vector<Coordinate> velparts;
     vector<Coordinate> posparts;
     vector<int> typeparts;
-    size_t n;
     Double_t dx;
     vector<Double_t> maxrdist(ngroup+1);
     //to store particle ids of those in SO volume.
@@ -3322,7 +2848,7 @@ void GetSOMasses(Options &opt, const Int_t nbodies, Particle *Part, Int_t ngroup
     //build tree optimised to search for more than min group size
     //this is the bottle neck for the SO calculation. Wonder if there is an easy
     //way of speeding it up
-    tree=new KDTree(Part,nbodies,opt.HaloMinSize,tree->TPHYS,tree->KEPAN,100,0,0,0,period);
+    tree=vr::spatial_index().acquire(Part,nbodies,opt.HaloMinSize,period);
     //store the radii that will be used to search for each group
     //this is based on maximum radius and the enclosed density within the FOF so that if
     //this density is larger than desired overdensity then we must increase the radius
@@ -3365,7 +2891,7 @@ void GetSOMasses(Options &opt, const Int_t nbodies, Particle *Part, Int_t ngroup
 
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)  \
-private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typeparts,n,dx,EncMass,J,rc,rhoval,rhoval2,tid,SOpids,iSOfound)
+private(i,j,k,taggedparts,radii,masses,posref,posparts,velparts,typeparts,dx,EncMass,J,rc,rhoval,rhoval2,tid,SOpids,iSOfound)
 {
 #pragma omp for schedule(dynamic) nowait
 #endif
@@ -3526,13 +3052,9 @@ private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typepart
             }
         }
 #endif
-        //get incides
-        indices.resize(radii.size());
-        n=0;generate(indices.begin(), indices.end(), [&]{ return n++; });
-        //sort by radius
-        auto comparator = [&radii](int a, int b){ return radii[a] < radii[b]; };
-        sort(indices.begin(), indices.end(), comparator);
-        Int_t llindex = CalculateSphericalOverdensity(opt, pdata[i], radii, masses, indices, m200val, m200mval, mBN98val, virval, m500val, SOlgrhovals);
+        //bucket by radius, only the bins needed are sorted
+        vr::RadialBins bins(opt, radii, masses);
+        Int_t llindex = CalculateSphericalOverdensity(opt, pdata[i], radii, masses, bins, m200val, m200mval, mBN98val, virval, m500val, SOlgrhovals);
         SetSphericalOverdensityMasstoFlagValue(opt, pdata[i]);
 
 #if (defined(GASON)) || (defined(GASON) && defined(SWIFTINTERFACE))
@@ -3586,14 +3108,21 @@ private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typepart
 
         //calculate angular momentum if necessary
         if (opt.iextrahalooutput) {
-            for (j=0;j<radii.size();j++) {
+            //only the bins reaching the largest overdensity or aperture radius hold particles that contribute
+            Double_t rwithin=max({pdata[i].gR200c,pdata[i].gR200m,pdata[i].gRBN98});
+            for (auto iso=0;iso<opt.SOnum;iso++) rwithin=max(rwithin,pdata[i].SO_radius[iso]);
+#if (defined(GASON)) || (defined(GASON) && defined(SWIFTINTERFACE))
+            for (auto r_ap=0;r_ap<sonum_hotgas;r_ap++) rwithin=max(rwithin,SOlg_radii_highT[r_ap]);
+#endif
+            Int_t nwithin=bins.end_within(rwithin);
+            for (j=0;j<nwithin;j++) {
 #ifndef NOMASS
-                auto massval = masses[indices[j]];
+                auto massval = masses[bins[j]];
 #else
                 auto massval = opt.MassValue;
 #endif
 
-                auto jj = indices[j];
+                auto jj = bins[j];
 #if defined(GASON) || defined(STARON) || defined(BHON) || defined(HIGHRES)
                 auto typeval = typeparts[jj];
 #endif
@@ -3724,6 +3253,7 @@ private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typepart
             int ibin = 0;
             if (opt.iprofilenorm == PROFILERNORMR200CRIT) irnorm = 1.0/pdata[i].gR200c;
             else irnorm = 1.0;
+            bins.sort();
             for (j=0;j<radii.size();j++) {
                 ///\todo need to update to allow for star forming/non-star forming profiles
                 ///by storing the star forming value.
@@ -3731,14 +3261,14 @@ private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typepart
                 int typeval = DARKTYPE;
 #if defined(GASON) || defined(STARON) || defined(BHON)
                 if (opt.iextragasoutput || opt.iextrastaroutput || opt.iextrainterloperoutput || opt.iSphericalOverdensityPartList)
-                    typeval = typeparts[indices[j]];
+                    typeval = typeparts[bins[j]];
 #endif
 #ifndef NOMASS
-                auto massval = masses[indices[j]];
+                auto massval = masses[bins[j]];
 #else
                 auto massval = opt.MassValue;
 #endif
-                AddDataToRadialBinInclusive(opt, radii[indices[j]], massval,
+                AddDataToRadialBinInclusive(opt, radii[bins[j]], massval,
 #if defined(GASON) || defined(STARON) || defined(BHON)
                     sfrval, typeval,
 #endif
@@ -3752,13 +3282,12 @@ private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typepart
 #if defined(GASON) || defined(STARON) || defined(BHON) || defined(HIGHRES)
             SOparttypelist[i].resize(llindex);
 #endif
-            for (j=0;j<llindex;j++) SOpartlist[i][j]=SOpids[indices[j]];
+            for (j=0;j<llindex;j++) SOpartlist[i][j]=SOpids[bins.sorted(j)];
 #if defined(GASON) || defined(STARON) || defined(BHON) || defined(HIGHRES)
-            for (j=0;j<llindex;j++) SOparttypelist[i][j]=typeparts[indices[j]];
+            for (j=0;j<llindex;j++) SOparttypelist[i][j]=typeparts[bins.sorted(j)];
 #endif
             SOpids.clear();
         }
-        indices.clear();
         radii.clear();
         masses.clear();
         if (opt.iextrahalooutput) {
@@ -3773,7 +3302,7 @@ private(i,j,k,taggedparts,radii,masses,indices,posref,posparts,velparts,typepart
 #ifdef USEOPENMP
 }
 #endif
-    delete tree;
+    vr::spatial_index().release(tree);
     //reset its after putting particles back in input order
     for (i=0;i<nbodies;i++) Part[i].SetID(ids[i]);
     ids.clear();
@@ -4766,7 +4295,7 @@ private(i,j,k,r2,v2,poti,Ti,pot,Eval,npot,storepid,menc,potmin,ipotmin,cmpotmin)
             for (j=0;j<numingroup[i];j++) {
                 for (k=0;k<3;k++) Part[j+noffset[i]].SetPosition(k,Part[j+noffset[i]].GetPosition(k)-cmpotmin[k]);
             }
-            gsl_heapsort(&Part[noffset[i]],numingroup[i],sizeof(Particle),RadCompare);
+            SortParticles(numingroup[i], &Part[noffset[i]], PSORTRADIUS);
             //now determine kinetic frame
             pdata[i].gcmvel[0]=pdata[i].gcmvel[1]=pdata[i].gcmvel[2]=menc=0.;
             for (j=0;j<npot;j++) {
@@ -4850,7 +4379,7 @@ private(i,j,k,r2,v2,poti,Ti,pot,Eval,npot,storepid,menc,potmin,ipotmin,cmpotmin)
             for (j=0;j<numingroup[i];j++) {
                 for (k=0;k<3;k++) Part[j+noffset[i]].SetPosition(k,Part[j+noffset[i]].GetPosition(k)-cmpotmin[k]);
             }
-            gsl_heapsort(&Part[noffset[i]],numingroup[i],sizeof(Particle),RadCompare);
+            SortParticles(numingroup[i], &Part[noffset[i]], PSORTRADIUS);
             //now determine kinetic frame
             pdata[i].gcmvel[0]=pdata[i].gcmvel[1]=pdata[i].gcmvel[2]=menc=0.;
             for (j=0;j<npot;j++) {
@@ -5075,7 +4604,7 @@ Int_t **SortAccordingtoBindingEnergy(Options &opt, const Int_t nbodies, Particle
             if (pfof[Part[i].GetID()]>ioffset) Part[i].SetPID(pfof[Part[i].GetID()]);
             else Part[i].SetPID(nbodies+1);//here move all particles not in groups to the back of the particle array
         }
-        qsort(Part, nbodies, sizeof(Particle), PIDCompare);
+        SortParticles(nbodies, Part, PSORTPID);
         for (i=0;i<nbodies;i++) Part[i].SetPID(storepid[Part[i].GetID()]);
         storepid.clear();
 
@@ -5106,10 +4635,10 @@ private(i,j)
     for (i=1;i<=ngroup;i++)
     {
         if (opt.iSortByBindingEnergy) {
-            qsort(&Part[noffset[i]], numingroup[i], sizeof(Particle), DenCompare);
+            SortParticles(numingroup[i], &Part[noffset[i]], PSORTDENSITY);
         }
         else {
-            qsort(&Part[noffset[i]], numingroup[i], sizeof(Particle), PotCompare);
+            SortParticles(numingroup[i], &Part[noffset[i]], PSORTPOTENTIAL);
         }
         //having sorted particles get most bound, first unbound
         pdata[i].iunbound=numingroup[i];
@@ -5149,7 +4678,7 @@ private(i,j)
     //reset particles back to id order
     if (opt.iseparatefiles) {
         LOG(info) << "Reset particles to original order";
-        qsort(Part, nbodies, sizeof(Particle), IDCompare);
+        SortParticles(nbodies, Part, PSORTID);
     }
     LOG(info) << "Done";
     return pglist;
@@ -5172,7 +4701,7 @@ void CalculateHaloProperties(Options &opt, const Int_t nbodies, Particle *Part,
         if (pfof[Part[i].GetID()]>0) Part[i].SetPID(pfof[Part[i].GetID()]);
         else Part[i].SetPID(nbodies+1);//here move all particles not in groups to the back of the particle array
     }
-    qsort(Part, nbodies, sizeof(Particle), PIDCompare);
+    SortParticles(nbodies, Part, PSORTPID);
 
     noffset[0]=noffset[1]=0;
     for (i=2;i<=ngroup;i++) noffset[i]=noffset[i-1]+numingroup[i-1];
@@ -6950,60 +6479,85 @@ void GetExtraDMProperties(Options &opt, PropData &pdata, Int_t n, Particle *Pval
 
 /// \ name Spherical Overdensity related function calls
 //@{
-//loop over radii to get overdensity working outwards from some small fraction of the mass or at least 1 particles + small fraction of min halo size
+///largest log density of the overdensity thresholds whose radius has not been found yet, or -MAXVALUE once all are
+static inline Double_t SphericalOverdensityMaxUnfound(Options &opt, PropData &pdata,
+    Double_t m200val, Double_t m200mval, Double_t mBN98val, Double_t virval, Double_t m500val,
+    vector<Double_t> &SOlgrhovals)
+{
+    Double_t maxval=-MAXVALUE;
+    if (pdata.gRvir==0) maxval=max(maxval,virval);
+    if (pdata.gR200c==0) maxval=max(maxval,m200val);
+    if (pdata.gR200m==0) maxval=max(maxval,m200mval);
+    if (pdata.gR500c==0) maxval=max(maxval,m500val);
+    if (pdata.gRBN98==0) maxval=max(maxval,mBN98val);
+    for (auto iso=0;iso<opt.SOnum;iso++) if (pdata.SO_radius[iso]==0) maxval=max(maxval,SOlgrhovals[iso]);
+    return maxval;
+}
+
+/*! loop over radii to get overdensity working outwards from some small fraction of the mass or at least 1 particles + small fraction of min halo size.
+    The particles are walked in order of radius one bin of \ref vr::RadialBins at a time. A bin is stepped over without
+    being sorted when even the mass inside it at its largest radius is denser than every threshold not yet found, as
+    none can then be crossed by its particles, so that only the bins around the overdensity radii are sorted.
+*/
 Int_t CalculateSphericalOverdensity(Options &opt, PropData &pdata,
-    vector<Double_t> &radii, vector<Double_t> &masses, vector<Int_t> &indices,
+    vector<Double_t> &radii, vector<Double_t> &masses, vr::RadialBins &bins,
     Double_t &m200val, Double_t &m200mval, Double_t &mBN98val, Double_t &virval, Double_t &m500val,
     vector<Double_t> &SOlgrhovals)
 {
     //Set the start point as the 3rd particle as the 1st particle can have a r=0
-    int minnum=2;
-    int iindex=radii.size();
-    //if the lowest overdensity threshold is below the density at the outer
-    //edge then extrapolate density based on average slope using 10% of radial bins
+    Int_t minnum=2;
+    Int_t iindex=radii.size();
     double massval, EncMass, rc, oldrc, rhoval, MinMass;
     double rc2, EncMass2, rhoval2;
-    double gamma1, gamma2, gamma1lin, gamma2lin;
-    double fac, MassEdge;
-    int lindex=0.9*iindex, llindex=iindex;
-    int iSOfound = 0;
-
+    double gamma1, gamma2;
+    double fac, halfmass;
+    //margins on the bounds of bins, well above the rounding of sums in a different order
+    const double lgrhomargin=1e-10, massmargin=1e-12;
+    Int_t llindex=iindex;
+    int iSOfound = 0, b;
 
-    MassEdge=EncMass=0;
-    for (auto j=0;j<iindex;j++) {
-#ifndef NOMASS
-        massval = masses[indices[j]];
-#else
-        massval = opt.MassValue;
-#endif
-        MassEdge+=massval;
-        if (j<lindex) EncMass+=massval;
-    }
     fac = 3.0 / (4.0*M_PI);
 
     //find first particle r>0
-    while(radii[indices[minnum-1]]==0) minnum++;
+    while(radii[bins.sorted(minnum-1)]==0) minnum++;
 
     //now find radii matching SO density thresholds
 #ifndef NOMASS
-    EncMass=0;for (auto j=0;j<minnum;j++) EncMass+=masses[indices[j]];
-    MinMass=masses[indices[0]];
+    EncMass=0;for (auto j=0;j<minnum;j++) EncMass+=masses[bins.sorted(j)];
+    MinMass=masses[bins.sorted(0)];
 #else
     EncMass=0;for (auto j=0;j<minnum;j++) EncMass+=opt.MassValue;
     MinMass=opt.MassValue;
 #endif
 
-    rc=radii[indices[minnum-1]];
+    rc=radii[bins.sorted(minnum-1)];
     llindex=radii.size();
 
     //store old radius, old enclosed mass and ln density
     rc2 = rc;
     EncMass2 = EncMass;
     rhoval2 = std::log10(fac * EncMass2 * std::pow(rc2, -3.0));
-    for (auto j=minnum;j<radii.size();j++) {
-        rc=radii[indices[j]];
+    b=bins.bin(minnum-1);
+    for (auto j=minnum;j<iindex;j++) {
+        if (j==bins.end(b)) {
+            while (j==bins.end(b)) b++;
+            //once all thresholds are found nothing changes further out
+            Double_t maxunfound=SphericalOverdensityMaxUnfound(opt, pdata, m200val, m200mval, mBN98val, virval, m500val, SOlgrhovals);
+            if (maxunfound==-MAXVALUE) break;
+            //step over the bin if its particles are all denser than the thresholds left
+            if (std::log10(fac * EncMass * std::pow(bins.rmax(b), -3.0)) > maxunfound+lgrhomargin) {
+                EncMass += bins.mass(b);
+                rc2 = rc = bins.rmax(b);
+                EncMass2 = EncMass;
+                rhoval2 = std::log10(fac * EncMass2 * std::pow(rc2, -3.0));
+                j = bins.end(b)-1;
+                continue;
+            }
+            bins.sort(b);
+        }
+        rc=radii[bins[j]];
 #ifndef NOMASS
-        EncMass+=masses[indices[j]];
+        EncMass+=masses[bins[j]];
 #else
         EncMass+=opt.MassValue;
 #endif
@@ -7043,14 +6597,31 @@ Int_t CalculateSphericalOverdensity(Options &opt, PropData &pdata,
 #ifdef NOMASS
     massval = opt.MassValue;
 #else
-    massval = masses[indices[0]];
+    massval = masses[bins.sorted(0)];
 #endif
     EncMass = massval;
-    oldrc = radii[indices[0]];
-    for (auto j=1;j<radii.size();j++) {
-        rc = radii[indices[j]];
+    oldrc = radii[bins.sorted(0)];
+    b=bins.bin(0);
+    for (auto j=1;j<iindex;j++) {
+        if (j==bins.end(b)) {
+            while (j==bins.end(b)) b++;
+            //smallest half mass still to be reached, stepping over the bins that do not reach it
+            halfmass=MAXVALUE;
+            if (pdata.gM200c > 0 && pdata.gRhalf200c == 0) halfmass=min(halfmass,0.5*pdata.gM200c);
+            if (pdata.gM200m > 0 && pdata.gRhalf200m == 0) halfmass=min(halfmass,0.5*pdata.gM200m);
+            if (pdata.gMBN98 > 0 && pdata.gRhalfBN98 == 0) halfmass=min(halfmass,0.5*pdata.gMBN98);
+            if (halfmass==MAXVALUE) break;
+            if (EncMass+bins.mass(b) < halfmass*(1.0-massmargin)) {
+                EncMass += bins.mass(b);
+                oldrc = bins.rmax(b);
+                j = bins.end(b)-1;
+                continue;
+            }
+            bins.sort(b);
+        }
+        rc = radii[bins[j]];
 #ifndef NOMASS
-        massval = masses[indices[j]];
+        massval = masses[bins[j]];
 #endif
         EncMass += massval;
         gamma1 = (rc - oldrc)/massval;
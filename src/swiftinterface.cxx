@@ -12,6 +12,8 @@
 Options libvelociraptorOpt;
 Options libvelociraptorOptbackup;
 Options libvelociraptorOptextra[10];
+///output writer kept across invocations so that writing the catalogues can overlap with the return to swift
+std::unique_ptr<vr::AsyncWriter> libvelociraptorWriter;
 //KDTree *mpimeshtree;
 //Particle *mpimeshinfo;
 
@@ -163,6 +165,17 @@ int InitVelociraptor(Options &opt, char* configname, unitinfo u, siminfo s, cons
     MPIInitWriteComm();
 #endif
 
+    //output can only overlap with swift if both are able to use HDF5 at the same time
+#ifdef USEHDF
+    hbool_t ithreadsafe = 0;
+    H5is_library_threadsafe(&ithreadsafe);
+    if (opt.iasyncoutput && opt.ibinaryout==OUTHDF && !ithreadsafe) {
+        LOG_RANK0(warning) << "HDF5 library is not thread-safe, writing output synchronously";
+        opt.iasyncoutput = 0;
+    }
+#endif
+    if (!libvelociraptorWriter) libvelociraptorWriter.reset(new vr::AsyncWriter(opt.asyncoutputbufsize, opt.iasyncoutput));
+
     LOG_RANK0(info) << "Finished initialising VELOCIraptor";
 
     //return the configuration flag value
@@ -320,6 +333,9 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
     return_data.num_most_bound = 0;
     return_data.most_bound_index = NULL;
 
+    //output of the previous invocation must be complete before starting again
+    if (libvelociraptorWriter) libvelociraptorWriter->flush();
+
     libvelociraptorOpt.outname = outputname;
     libvelociraptorOpt.snapshotvalue = HALOIDSNVAL* snapnum;
     libvelociraptorOpt.memuse_peak = 0;
@@ -517,7 +533,7 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
         for (Int_t i=0;i<Nlocal;i++) {sortvalhalos[i]=pfof[i]*(pfof[i]>0)+Nlocal*(pfof[i]==0);originalID[i]=parts[i].GetID();parts[i].SetID(i);}
         Int_t *noffsethalos=BuildNoffset(Nlocal, parts.data(), nhalos, numinhalos, sortvalhalos);
         GetInclusiveMasses(libvelociraptorOpt, Nlocal, parts.data(), nhalos, pfof, numinhalos, pdatahalos, noffsethalos);
-        qsort(parts.data(),Nlocal,sizeof(Particle),IDCompare);
+        SortParticles(Nlocal, parts.data(), PSORTID);
         delete[] numinhalos;
         delete[] sortvalhalos;
         delete[] noffsethalos;
@@ -581,15 +597,20 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
     numingroup=BuildNumInGroup(Nlocal, ngroup, pfof);
     pglist=SortAccordingtoBindingEnergy(libvelociraptorOpt,Nlocal,parts.data(),ngroup,pfof,numingroup,pdata);//alters pglist so most bound particles first
     vr::Timer write_timer;
-    WriteProperties(libvelociraptorOpt,ngroup,pdata);
-    WriteGroupCatalog(libvelociraptorOpt, ngroup, numingroup, pglist, parts);
-    //if baryons have been searched output related gas baryon catalogue
-    if (libvelociraptorOpt.iBaryonSearch>0 || libvelociraptorOpt.partsearchtype==PSTALL){
-      WriteGroupPartType(libvelociraptorOpt, ngroup, numingroup, pglist, parts);
-    }
 #ifdef EXTENDEDHALOOUTPUT
     if (opt.iExtendedOutput) WriteExtendedOutput (libvelociraptorOpt, ngroup, nbodies, pdata, parts, pfof);
 #endif
+    //the properties job takes ownership of pdata, and the group catalogue is copied if written asynchronously,
+    //so the particles can be returned to swift while the output is being written
+    Options writeopt = libvelociraptorOpt;
+    libvelociraptorWriter->submit([writeopt, ngroup, pdata]() mutable {
+        WriteProperties(writeopt,ngroup,pdata);
+        delete[] pdata;
+    }, sizeof(PropData)*(ngroup+1));
+    //if baryons have been searched output related gas baryon catalogue
+    SubmitGroupCatalog(*libvelociraptorWriter, libvelociraptorOpt, ngroup, numingroup, pglist, parts, 0,
+        libvelociraptorOpt.iBaryonSearch>0 || libvelociraptorOpt.partsearchtype==PSTALL);
+    pdata = NULL;
     delete[] pfof;
     //if returning to swift as swift is writing a snapshot, then write for the groups where the particles are found in a file
     //assuming that the swift task and swift index can be used to determine where a particle will be written.
@@ -615,7 +636,6 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
       }
     }
 
-    delete[] pdata;
     delete[] nsub;
     delete[] uparentgid;
     delete[] parentgid;
@@ -642,7 +662,7 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
       if (NProcs > 1) {
         for (auto i=0;i<num_most_bound; i++) most_bound_parts[i].SetID((most_bound_parts[i].GetSwiftTask()!=ThisTask));
         //now sort items according to whether local swift task
-        qsort(most_bound_parts.data(), num_most_bound, sizeof(Particle), IDCompare);
+        SortParticles(num_most_bound, most_bound_parts.data(), PSORTID);
         //communicate information
         MPISwiftExchange(most_bound_parts);
         num_most_bound = most_bound_parts.size();
@@ -674,13 +694,13 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
       if (NProcs > 1) {
         for (auto i=0;i<Nlocal; i++) parts[i].SetID((parts[i].GetSwiftTask()!=ThisTask));
         //now sort items according to whether local swift task
-        qsort(parts.data(), Nlocal, sizeof(Particle), IDCompare);
+        SortParticles(Nlocal, parts.data(), PSORTID);
         //communicate information
         MPISwiftExchange(parts);
         Nlocal = parts.size(); 
       }
 #endif
-      qsort(parts.data(), Nlocal, sizeof(Particle), PIDCompare);
+      SortParticles(Nlocal, parts.data(), PSORTPID);
       nig=0;
       Int_t istart=0;
       for (auto i=0;i<Nlocal;i++) if (parts[i].GetPID()>0) {nig=Nlocal-i;istart=i;break;}
@@ -702,6 +722,9 @@ vr_return_data InvokeVelociraptorHydro(const int snapnum, char* outputname,
     free(s.cellloc);
     free(cell_node_ids);
     parts.clear();
+    //the particles of the next call are unrelated to these, so drop the shared tree over them
+    vr::spatial_index().report();
+    vr::spatial_index().clear();
 
     LOG(info) << "VELOCIraptor returning.";
     return return_data;
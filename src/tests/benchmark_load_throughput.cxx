@@ -0,0 +1,142 @@
+// Throughput of the particle load stage. Reads a snapshot the same way as the main executable, from the header through
+// the domain decomposition to the particles being in their domains, and reports the rate at which input files are
+// consumed in GB/s. Takes the same arguments as stf, of which only those related to the input are used, e.g.
+//   mpirun -np 16 benchmark_load_throughput -i snapshot -s 16 -I 2 -C config.cfg
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "ioutils.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// total size of the input files, following the naming of the multi-file snapshots of each format
+unsigned long long input_bytes(const Options &opt)
+{
+    auto file_size = [](const std::string &name) -> unsigned long long {
+        struct stat st;
+        return stat(name.c_str(), &st) == 0 ? st.st_size : 0;
+    };
+    std::string suffix = (opt.inputtype == IOHDF) ? ".hdf5" : "";
+    if (opt.num_files <= 1) return file_size(opt.fname + suffix);
+    unsigned long long nbytes = 0;
+    for (int i = 0; i < opt.num_files; i++) nbytes += file_size(opt.fname + ("." + std::to_string(i)) + suffix);
+    return nbytes;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+#ifdef USEOPENMP
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#else
+    MPI_Init(&argc, &argv);
+#endif // USEOPENMP
+    MPI_Comm_rank(MPI_COMM_WORLD, &ThisTask);
+    MPI_Comm_size(MPI_COMM_WORLD, &NProcs);
+#else
+    int ThisTask = 0;
+    Int_t Nlocal;
+    Int_t Nlocalbaryon[NBARYONTYPES];
+#endif // USEMPI
+
+    Options opt;
+    GetArgs(argc, argv, opt);
+#ifdef USEMPI
+    mpi_nlocal = new Int_t[NProcs];
+    mpi_domain = new MPI_Domain[NProcs];
+#endif // USEMPI
+
+    vr::Timer timer;
+    Int_t nbodies = 0, nbaryons = 0;
+    if (ThisTask == 0) {
+        nbodies = ReadHeader(opt);
+        if (opt.iBaryonSearch > 0) {
+            int pstemp = opt.partsearchtype;
+            opt.partsearchtype = PSTGAS;
+            nbaryons += ReadHeader(opt);
+            if (opt.iusestarparticles) {
+                opt.partsearchtype = PSTSTAR;
+                nbaryons += ReadHeader(opt);
+            }
+            if (opt.iusesinkparticles) {
+                opt.partsearchtype = PSTBH;
+                nbaryons += ReadHeader(opt);
+            }
+            opt.partsearchtype = pstemp;
+        }
+    }
+    std::vector<Particle> Part;
+    Particle *Pbaryons = NULL;
+#ifdef USEMPI
+    MPI_Bcast(&nbodies, 1, MPI_Int_t, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&nbaryons, 1, MPI_Int_t, 0, MPI_COMM_WORLD);
+    MPIUpdateUseParticleTypes(opt);
+    for (int i = 0; i < NBARYONTYPES; i++) Nlocalbaryon[i] = 0;
+    if (NProcs == 1) Nlocal = Nmemlocal = nbodies;
+#ifdef MPIREDUCEMEM
+    else if (opt.impisinglepassload) {
+        MPIDomainExtent(opt);
+        MPIDomainDecomposition(opt);
+        Nlocal = Nmemlocal = Nmemlocalbaryon = 0;
+    }
+    else MPINumInDomain(opt);
+#else
+    else {
+        MPIDomainExtent(opt);
+        MPIDomainDecomposition(opt);
+        Nlocal = Nmemlocal = nbodies / NProcs * MPIProcFac;
+        Nlocalbaryon[0] = Nmemlocalbaryon = nbaryons / NProcs * MPIProcFac;
+    }
+#endif // MPIREDUCEMEM
+    if (opt.iBaryonSearch > 0 && opt.partsearchtype != PSTALL) {
+        Part.resize(Nmemlocal + Nmemlocalbaryon);
+        Pbaryons = &(Part.data()[Nlocal]);
+        nbaryons = Nlocalbaryon[0];
+    }
+    else {
+        Part.resize(Nmemlocal);
+        nbaryons = 0;
+    }
+#else
+    Nlocal = nbodies;
+    Nlocalbaryon[0] = nbaryons;
+    Part.resize(nbodies + ((opt.iBaryonSearch > 0 && opt.partsearchtype != PSTALL) ? nbaryons : 0));
+    if (opt.iBaryonSearch > 0 && opt.partsearchtype != PSTALL) Pbaryons = &(Part.data()[nbodies]);
+    else nbaryons = 0;
+#endif // USEMPI
+    double tdecomposition = timer.get() * 1e-6;
+    ReadData(opt, Part, nbodies, Pbaryons, nbaryons);
+    double tload = timer.get() * 1e-6;
+
+    Int_t nloaded = Nlocal + ((opt.iBaryonSearch > 0 && opt.partsearchtype != PSTALL) ? Nlocalbaryon[0] : 0);
+#ifdef USEMPI
+    double tlocal[2] = {tdecomposition, tload};
+    MPI_Allreduce(MPI_IN_PLACE, tlocal, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    tdecomposition = tlocal[0];
+    tload = tlocal[1];
+    MPI_Allreduce(MPI_IN_PLACE, &nloaded, 1, MPI_Int_t, MPI_SUM, MPI_COMM_WORLD);
+#endif // USEMPI
+    if (ThisTask == 0) {
+        auto nbytes = input_bytes(opt);
+        LOG(info) << "Loaded " << nloaded << " particles from " << opt.num_files << " files holding " << vr::memory_amount(nbytes)
+                  << " in " << tload << " s (" << tdecomposition << " s before reading particles): "
+                  << nbytes / tload / 1e9 << " GB/s of input, " << nloaded * sizeof(Particle) / tload / 1e9 << " GB/s of particles";
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return 0;
+}
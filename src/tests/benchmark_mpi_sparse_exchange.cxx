@@ -0,0 +1,74 @@
+// Scaling benchmark comparing the dense MPI_Allgather of the NProcs x NProcs send count matrix with
+// the sparse exchange of MPIGatherSendCounts, for ranks that each talk to a fixed number of neighbours.
+// Can be run on a single node by oversubscribing, e.g.
+//   for n in 2 4 8 16 32 64; do mpirun --oversubscribe -np $n benchmark_mpi_sparse_exchange 6 200; done
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "ioutils.h"
+#include "logging.h"
+#include "proto.h"
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ThisTask);
+    MPI_Comm_size(MPI_COMM_WORLD, &NProcs);
+
+    int nneighbours = 6, nreps = 100;
+    if (argc > 1) nneighbours = std::stoi(argv[1]);
+    if (argc > 2) nreps = std::stoi(argv[2]);
+    nneighbours = std::min(nneighbours, NProcs - 1);
+
+    // ring of neighbours on either side of each rank
+    std::vector<Int_t> nsend_local(NProcs, 0);
+    for (int k = 1; k <= nneighbours; k++) {
+        int offset = (k + 1) / 2;
+        int neighbour = (k % 2) ? (ThisTask + offset) % NProcs : (ThisTask - offset + NProcs) % NProcs;
+        nsend_local[neighbour] = 1000 + ThisTask + neighbour;
+    }
+    std::vector<Int_t> dense(NProcs * NProcs), sparse(NProcs * NProcs, 0);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    for (int rep = 0; rep < nreps; rep++)
+        MPI_Allgather(nsend_local.data(), NProcs, MPI_Int_t, dense.data(), NProcs, MPI_Int_t, MPI_COMM_WORLD);
+    double tdense = (MPI_Wtime() - t0) / nreps;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    for (int rep = 0; rep < nreps; rep++)
+        MPIGatherSendCounts(nsend_local.data(), sparse.data());
+    double tsparse = (MPI_Wtime() - t0) / nreps;
+
+    // the row and column of this task must match the dense matrix
+    int nwrong = 0, nwrongtotal;
+    for (int j = 0; j < NProcs; j++) {
+        nwrong += (sparse[j + ThisTask * NProcs] != dense[j + ThisTask * NProcs]);
+        nwrong += (sparse[ThisTask + j * NProcs] != dense[ThisTask + j * NProcs]);
+    }
+    double tmax[2], tlocal[2] = {tdense, tsparse};
+    MPI_Reduce(tlocal, tmax, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Allreduce(&nwrong, &nwrongtotal, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (ThisTask == 0) {
+        LOG(info) << "NProcs " << NProcs << ", neighbours " << nneighbours << ": dense allgather " << tmax[0] * 1e6
+                  << " us, sparse exchange " << tmax[1] * 1e6 << " us per call, count matrix memory "
+                  << vr::memory_amount(sizeof(Int_t) * NProcs * NProcs);
+        if (nwrongtotal > 0) LOG(error) << nwrongtotal << " counts differ between dense and sparse exchange";
+    }
+    MPI_Finalize();
+    return nwrongtotal > 0;
+#else
+    LOG(info) << "Benchmark requires MPI, nothing to do";
+    return 0;
+#endif // USEMPI
+}
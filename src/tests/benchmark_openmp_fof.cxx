@@ -0,0 +1,194 @@
+// Thread scaling of the 3DFOF search over OpenMP domains, as run by SearchFullSet, from one thread up to a maximum number
+// of threads doubling each time. The groups found must be those of a single tree FOF search over all particles.
+// Runs on a single process, e.g.
+//   benchmark_openmp_fof 4000000 128 250000
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// clumps of particles over a uniform background in a periodic box of unit size
+std::vector<Particle> generate_clumps(Int_t npart, int nclumps)
+{
+    std::mt19937_64 gen(2024);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    std::vector<double> centre(3 * nclumps), size(nclumps);
+    for (int c = 0; c < nclumps; c++) {
+        for (int k = 0; k < 3; k++) centre[3 * c + k] = uniform(gen);
+        size[c] = 0.002 + 0.02 * uniform(gen);
+    }
+    std::vector<Particle> parts(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double x[3];
+        int c = std::min(int(uniform(gen) * nclumps), nclumps - 1);
+        bool background = uniform(gen) < 0.3;
+        for (int k = 0; k < 3; k++) {
+            x[k] = background ? uniform(gen) : centre[3 * c + k] + size[c] * normal(gen);
+            x[k] -= std::floor(x[k]);
+        }
+        parts[i] = Particle(1.0 / npart, x[0], x[1], x[2], 0, 0, 0, i, DARKTYPE);
+    }
+    return parts;
+}
+
+// whether two group id arrays, indexed by particle id, give the same groups whatever their numbering
+bool same_groups(Int_t npart, const Int_t *pfof, const Int_t *reference, Int_t ngroups)
+{
+    std::vector<Int_t> map(ngroups + 1, -1), inverse(ngroups + 1, -1);
+    for (Int_t i = 0; i < npart; i++) {
+        if ((pfof[i] == 0) != (reference[i] == 0)) return false;
+        if (pfof[i] == 0) continue;
+        if (pfof[i] > ngroups || reference[i] > ngroups) return false;
+        if (map[pfof[i]] == -1 && inverse[reference[i]] == -1) {
+            map[pfof[i]] = reference[i];
+            inverse[reference[i]] = pfof[i];
+        }
+        if (map[pfof[i]] != reference[i] || inverse[reference[i]] != pfof[i]) return false;
+    }
+    return true;
+}
+
+#ifdef USEOPENMP
+struct fof_times {
+    double domains, local, import, link, resort;
+};
+
+// the OpenMP domain search of SearchFullSet, returning group ids indexed by particle id
+Int_t *openmp_fof(Options &opt, std::vector<Particle> &Part, Double_t *param, Double_t *period, Int_t minsize,
+                  Int_t &numgroups, fof_times &times)
+{
+    Int_t nbodies = Part.size();
+    Double_t rdist = std::sqrt(param[1]);
+    FOFcheckfunc fofcheck = FOFchecktype;
+    vr::Timer timer;
+    KDTree *tree = new KDTree(Part.data(), nbodies, opt.openmpfofsize, KDTree::TPHYS, KDTree::KEPAN, 100);
+    tree->OverWriteInputOrder();
+    Int_t numompregions = tree->GetNumLeafNodes();
+    OMP_Domain *ompdomain = OpenMPBuildDomains(opt, numompregions, tree, rdist);
+    Int_t *storeorgIndex = new Int_t[nbodies];
+    for (Int_t i = 0; i < nbodies; i++) storeorgIndex[i] = Part[i].GetID();
+    KDTree **tree3dfofomp = OpenMPBuildLocalTrees(opt, numompregions, Part, ompdomain, period);
+    times.domains = timer.get() * 1e-6;
+
+    timer = vr::Timer();
+    Int_t *pfof = new Int_t[nbodies];
+    for (Int_t i = 0; i < nbodies; i++) pfof[i] = 0;
+    Int_tree_t *Head = new Int_tree_t[nbodies], *Next = new Int_tree_t[nbodies];
+    numgroups = OpenMPLocalSearch(opt, nbodies, Part, pfof, storeorgIndex, Head, Next, tree3dfofomp, param, rdist, 2,
+                                  &FOF3d, numompregions, ompdomain);
+    times.local = timer.get() * 1e-6;
+
+    timer = vr::Timer();
+    Int_t *omp_nrecv_total = new Int_t[numompregions], *omp_nrecv_offset = new Int_t[numompregions];
+    Int_t omp_import_total = 0;
+    OMP_ImportInfo *ompimport = NULL;
+    if (numgroups > 0) {
+        ompimport = OpenMPImportParticles(opt, nbodies, Part, pfof, storeorgIndex, numompregions, ompdomain, rdist,
+                                          omp_nrecv_total, omp_nrecv_offset, omp_import_total);
+    }
+    times.import = timer.get() * 1e-6;
+
+    timer = vr::Timer();
+    if (omp_import_total > 0) {
+        OpenMPLinkAcross(opt, nbodies, Part, pfof, storeorgIndex, param, fofcheck, numompregions, ompdomain, tree3dfofomp,
+                         omp_nrecv_total, omp_nrecv_offset, ompimport);
+    }
+    times.link = timer.get() * 1e-6;
+
+    delete[] ompimport;
+    delete[] omp_nrecv_total;
+    delete[] omp_nrecv_offset;
+    delete[] Head;
+    delete[] Next;
+    for (Int_t i = 0; i < numompregions; i++) delete tree3dfofomp[i];
+    delete[] tree3dfofomp;
+    delete[] ompdomain;
+    for (Int_t i = 0; i < nbodies; i++) Part[i].SetID(storeorgIndex[i]);
+    delete[] storeorgIndex;
+    delete tree;
+
+    timer = vr::Timer();
+    if (numgroups > 0) numgroups = OpenMPResortParticleandGroups(nbodies, Part, pfof, minsize);
+    times.resort = timer.get() * 1e-6;
+    return pfof;
+}
+#endif // USEOPENMP
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    vr::init_logging(vr::LogLevel::info);
+    int nfail = 0;
+#ifndef USEOPENMP
+    LOG(info) << "Compiled without OpenMP, nothing to measure";
+#else
+    Int_t npart = 2000000;
+    int maxthreads = 128;
+    if (argc > 1) npart = std::stoll(argv[1]);
+    if (argc > 2) maxthreads = std::stoi(argv[2]);
+
+    Options opt;
+    opt.p = 1.0;
+    opt.openmpfofsize = npart / 64;
+    if (argc > 3) opt.openmpfofsize = std::stoll(argv[3]);
+    Double_t period[3] = {opt.p, opt.p, opt.p}, param[20];
+    // linking length of 0.2 of the mean interparticle spacing
+    param[0] = KDTree::TPHYS;
+    param[1] = std::pow(0.2 / std::cbrt(double(npart)), 2.0);
+    param[6] = param[1];
+    Int_t minsize = 20;
+
+    auto initial = generate_clumps(npart, 200);
+
+    // single tree search over all particles
+    auto parts = initial;
+    Int_t nreference;
+    vr::Timer timer;
+    KDTree *tree = new KDTree(parts.data(), npart, opt.Bsize, KDTree::TPHYS, KDTree::KEPAN, 1000, 0, 0, 0, period);
+    Int_t *reference = tree->FOF(std::sqrt(param[1]), nreference, minsize, 1);
+    delete tree;
+    LOG(info) << "Single tree FOF of " << npart << " particles found " << nreference << " groups in " << timer;
+
+    double tserial = 0;
+    for (int nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+        omp_set_num_threads(nthreads);
+        parts = initial;
+        Int_t numgroups;
+        fof_times times;
+        timer = vr::Timer();
+        Int_t *pfof = openmp_fof(opt, parts, param, period, minsize, numgroups, times);
+        double t = timer.get() * 1e-6;
+        if (nthreads == 1) tserial = t;
+        bool same = (numgroups == nreference && same_groups(npart, pfof, reference, numgroups));
+        delete[] pfof;
+        LOG(info) << "OpenMP FOF on " << nthreads << " threads took " << t << " s, speedup " << tserial / t
+                  << " (domains " << times.domains << " s, local " << times.local << " s, import " << times.import
+                  << " s, link " << times.link << " s, resort " << times.resort << " s), found " << numgroups
+                  << " groups";
+        if (!same) {
+            LOG(error) << "OpenMP FOF on " << nthreads << " threads does not find the groups of the single tree FOF";
+            nfail++;
+        }
+    }
+    delete[] reference;
+#endif // USEOPENMP
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
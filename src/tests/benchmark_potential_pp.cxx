@@ -0,0 +1,102 @@
+// Throughput of the direct summation potential of small groups, comparing PotentialPP, which visits every pair once
+// with the vectorised kernel on packed positions and masses, against the scalar symmetric loop it replaced, which
+// updates both particles of a pair through the particle array. Potentials must agree to rounding, e.g.
+//   benchmark_potential_pp 50 150 1000 4000
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// Hernquist-like sphere of npart particles
+std::vector<Particle> generate_halo(Int_t npart)
+{
+    std::mt19937_64 gen(1729 + npart);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<Particle> parts(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double u = uniform(gen) * 0.99;
+        double r = std::sqrt(u) / (1 - std::sqrt(u));
+        double cost = 2 * uniform(gen) - 1, sint = std::sqrt(1 - cost * cost), phi = 2 * M_PI * uniform(gen);
+        parts[i] = Particle(1.0 + uniform(gen), r * sint * std::cos(phi), r * sint * std::sin(phi), r * cost, 0, 0, 0, i);
+    }
+    return parts;
+}
+
+// the scalar symmetric loop PotentialPP used before
+void symmetric_potential(const Options &opt, Int_t nbodies, Particle *Part)
+{
+    Double_t r2, pot, eps2 = opt.uinfo.eps * opt.uinfo.eps;
+    for (Int_t j = 0; j < nbodies; j++) Part[j].SetPotential(0.);
+    for (Int_t j = 0; j < nbodies; j++) {
+        for (Int_t k = j + 1; k < nbodies; k++) {
+            r2 = 0.;
+            for (int n = 0; n < 3; n++) r2 += pow(Part[j].GetPosition(n) - Part[k].GetPosition(n), 2.0);
+            r2 += eps2;
+            r2 = 1.0 / sqrt(r2);
+            pot = -opt.G * (Part[j].GetMass() * Part[k].GetMass()) * r2;
+            Part[j].SetPotential(Part[j].GetPotential() + pot);
+            Part[k].SetPotential(Part[k].GetPotential() + pot);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    vr::init_logging(vr::LogLevel::info);
+
+    std::vector<Int_t> sizes;
+    for (int i = 1; i < argc; i++) sizes.push_back(std::stoll(argv[i]));
+    if (sizes.empty()) sizes = {50, POTPPCALCNUM, 1000, 4000};
+
+    Options opt;
+    opt.G = 1.0;
+    opt.uinfo.eps = 1e-3;
+
+    int nfail = 0;
+    for (Int_t npart : sizes) {
+        auto reference = generate_halo(npart), parts = reference;
+        // repeat small groups so that every measurement covers about 1e8 pairs
+        Int_t nrep = std::max(Int_t(1), Int_t(1e8 / (double(npart) * npart)));
+
+        vr::Timer reference_timer;
+        for (Int_t r = 0; r < nrep; r++) symmetric_potential(opt, npart, reference.data());
+        auto treference = std::max(reference_timer.get(), vr::Timer::duration(1));
+        vr::Timer timer;
+        for (Int_t r = 0; r < nrep; r++) PotentialPP(opt, npart, parts.data());
+        auto t = std::max(timer.get(), vr::Timer::duration(1));
+
+        double maxdiff = 0;
+        for (Int_t i = 0; i < npart; i++) {
+            maxdiff = std::max(maxdiff, std::abs((parts[i].GetPotential() - reference[i].GetPotential()) /
+                                                 reference[i].GetPotential()));
+        }
+        double npairs = 0.5 * double(npart) * (npart - 1) * nrep;
+        LOG(info) << npart << " particles, " << nrep << " repetitions: PotentialPP " << vr::us_time(t) << " ("
+                  << npairs / t << " pairs/us), scalar loop " << vr::us_time(treference) << " ("
+                  << npairs / treference << " pairs/us), speedup " << double(treference) / t
+                  << ", largest relative difference " << maxdiff;
+        if (maxdiff > 1e-10) {
+            LOG(error) << "PotentialPP differs from the scalar loop";
+            nfail++;
+        }
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
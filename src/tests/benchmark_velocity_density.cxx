@@ -0,0 +1,137 @@
+// Accuracy and throughput of the local velocity density, comparing the leaf batched search with the exact search per
+// particle and the approximative search per leaf. Densities are compared with those of the exact search per particle.
+// Runs on a single process, e.g.
+//   OMP_NUM_THREADS=16 benchmark_velocity_density 1000000 256 32
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// clumps of particles with their own bulk velocity and dispersion over a uniform background in a periodic box of unit size
+std::vector<Particle> generate_clumps(Int_t npart, int nclumps)
+{
+    std::mt19937_64 gen(2024);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    std::vector<double> centre(3 * nclumps), bulk(3 * nclumps), size(nclumps);
+    for (int c = 0; c < nclumps; c++) {
+        for (int k = 0; k < 3; k++) {
+            centre[3 * c + k] = uniform(gen);
+            bulk[3 * c + k] = 100 * normal(gen);
+        }
+        size[c] = 0.002 + 0.02 * uniform(gen);
+    }
+    std::vector<Particle> parts(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double x[3], v[3];
+        if (uniform(gen) < 0.3) {
+            for (int k = 0; k < 3; k++) {
+                x[k] = uniform(gen);
+                v[k] = 300 * normal(gen);
+            }
+        }
+        else {
+            int c = std::min(int(uniform(gen) * nclumps), nclumps - 1);
+            for (int k = 0; k < 3; k++) {
+                x[k] = centre[3 * c + k] + size[c] * normal(gen);
+                x[k] -= std::floor(x[k]);
+                v[k] = bulk[3 * c + k] + 5000 * size[c] * normal(gen);
+            }
+        }
+        parts[i] = Particle(1.0 / npart, x[0], x[1], x[2], v[0], v[1], v[2], i, 1);
+    }
+    return parts;
+}
+
+// densities in input order, given by the particle ids
+std::vector<double> densities(const std::vector<Particle> &parts)
+{
+    std::vector<double> den(parts.size());
+    for (auto &p : parts) den[p.GetID()] = p.GetDensity();
+    return den;
+}
+
+struct density_error {
+    double median;
+    double max;
+    double fraction;
+};
+
+// relative differences, and the fraction of particles differing by more than the rounding of the kernel sums
+density_error compare(const std::vector<double> &reference, const std::vector<double> &den)
+{
+    std::vector<double> err(den.size());
+    for (size_t i = 0; i < den.size(); i++) err[i] = std::abs(den[i] - reference[i]) / reference[i];
+    double maxerr = *std::max_element(err.begin(), err.end());
+    Int_t ndiffer = std::count_if(err.begin(), err.end(), [](double e) { return e > 1e-8; });
+    std::nth_element(err.begin(), err.begin() + err.size() / 2, err.end());
+    return {err[err.size() / 2], maxerr, ndiffer / double(den.size())};
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ThisTask);
+    MPI_Comm_size(MPI_COMM_WORLD, &NProcs);
+    if (NProcs > 1) {
+        LOG_RANK0(error) << "Run on a single process, the searches compared do not import particles from other domains";
+        MPI_Finalize();
+        return 1;
+    }
+#endif // USEMPI
+    Int_t npart = 200000;
+    if (argc > 1) npart = std::stoll(argv[1]);
+
+    vr::init_logging(vr::LogLevel::info);
+    Options opt;
+    opt.p = 1.0;
+    if (argc > 2) opt.Nsearch = std::stoi(argv[2]);
+    if (argc > 3) opt.Nvel = std::stoi(argv[3]);
+
+    auto initial = generate_clumps(npart, 50);
+    std::vector<double> reference;
+    int nfail = 0;
+    struct method {
+        const char *name;
+        int approx, batched;
+    };
+    for (auto m : {method{"exact per particle", 0, 0}, method{"exact batched", 0, 1},
+                   method{"approximative per leaf", 1, 0}, method{"approximative batched", 1, 1}}) {
+        auto parts = initial;
+        opt.iLocalVelDenApproxCalcFlag = m.approx;
+        opt.iLocalVelDenBatchedSearch = m.batched;
+        vr::spatial_index().clear();
+        vr::Timer timer;
+        GetVelocityDensity(opt, npart, parts.data());
+        double t = timer.get() * 1e-6;
+        auto den = densities(parts);
+        if (reference.empty()) reference = den;
+        auto err = compare(reference, den);
+        LOG(info) << "Velocity density " << m.name << " of " << npart << " particles with (Nse,Nv)=(" << opt.Nsearch << ","
+                  << opt.Nvel << ") took " << t << " s, " << npart / t << " particles/s; relative to exact per particle: median "
+                  << err.median << ", max " << err.max << ", " << err.fraction << " of particles differ";
+        // the batched exact search finds the same neighbours, up to ties in distance
+        if (m.approx == 0 && err.fraction > 1e-3) {
+            LOG(error) << "Velocity density " << m.name << " differs from the exact search per particle";
+            nfail++;
+        }
+    }
+    vr::spatial_index().clear();
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
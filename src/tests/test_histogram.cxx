@@ -0,0 +1,172 @@
+// Test of vr::Histogram, which bins the velocity density ratios for DetermineDenVRatioDistribution. Ratios placed at
+// the centres of the bins, with a known number and weight per bin, must give exact sums on any number of threads.
+// Random ratios with outliers are then compared with binning the particles one by one, which the threaded sums may
+// only differ from by rounding.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// ratios of a dominant gaussian population with a tail of outliers, as found by GetDenVRatio
+std::vector<Particle> generate_ratios(Int_t npart, unsigned seed)
+{
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(-1.0, 0.5);
+    std::vector<Particle> parts(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        parts[i] = Particle(1.0 + 0.1 * uniform(gen), 0, 0, 0, 0, 0, 0, i, DARKTYPE);
+        parts[i].SetPotential(uniform(gen) < 0.95 ? normal(gen) : 6.0 * uniform(gen));
+    }
+    return parts;
+}
+
+// ratios at the centres of nbins bins of width dx starting at xmin, ncopies * (k + 1) of them in bin k with weight
+// 0.5 + 0.25 * k, plus one ratio below the first bin and one on the upper edge of the last, which must be skipped
+std::vector<Particle> generate_binned_ratios(Double_t xmin, Double_t dx, int nbins, Int_t ncopies, unsigned seed)
+{
+    std::vector<Particle> parts;
+    for (int k = 0; k < nbins; k++) {
+        for (Int_t i = 0; i < ncopies * (k + 1); i++) {
+            parts.emplace_back(0.5 + 0.25 * k, 0, 0, 0, 0, 0, 0, parts.size(), DARKTYPE);
+            parts.back().SetPotential(xmin + (k + 0.5) * dx);
+        }
+    }
+    for (auto x : {xmin - dx, xmin + nbins * dx}) {
+        parts.emplace_back(1.0, 0, 0, 0, 0, 0, 0, parts.size(), DARKTYPE);
+        parts.back().SetPotential(x);
+    }
+    std::shuffle(parts.begin(), parts.end(), std::mt19937_64(seed));
+    return parts;
+}
+
+// the binning of the particles one by one
+void reference_fill(const std::vector<Particle> &parts, Double_t xmin, Double_t dx, int nbins,
+                    std::vector<Double_t> &sum, std::vector<Double_t> &sum2)
+{
+    sum.assign(nbins, 0);
+    sum2.assign(nbins, 0);
+    for (auto &p : parts) {
+        Double_t t = (p.GetPotential() - xmin) / dx;
+        if (t < 0 || t >= nbins) continue;
+#if defined(NOMASSWEIGHT) || defined(HIGHRES)
+        Double_t w = 1.0;
+#else
+        Double_t w = p.GetMass();
+#endif
+        sum[int(t)] += w;
+        sum2[int(t)] += w * w;
+    }
+}
+
+double largest_difference(const std::vector<Double_t> &found, const std::vector<Double_t> &expected)
+{
+    double maxdiff = 0;
+    for (size_t j = 0; j < expected.size(); j++) {
+        maxdiff = std::max(maxdiff, std::abs(found[j] - expected[j]) / std::max(std::abs(expected[j]), 1e-300));
+    }
+    return maxdiff;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    vr::init_logging(vr::LogLevel::info);
+
+    int maxthreads = 1;
+#ifdef USEOPENMP
+    maxthreads = omp_get_max_threads();
+#endif
+    int nfail = 0;
+    for (Int_t ncopies : {Int_t(1), Int_t(2000)}) {
+        const int nbins = 16;
+        const Double_t xmin = -1.0, dx = 0.25;
+        auto parts = generate_binned_ratios(xmin, dx, nbins, ncopies, 11 + ncopies);
+        for (int nthreads = 1;; nthreads = std::min(2 * nthreads, maxthreads)) {
+#ifdef USEOPENMP
+            omp_set_num_threads(nthreads);
+#endif
+            vr::Histogram histogram(parts.size(), parts.data());
+            auto range = histogram.range();
+            auto binned = histogram.fill(xmin, dx, nbins);
+            // bins 4 to 7 hold 5 + 6 + 7 + 8 copies
+            bool pass = range.first == xmin - dx && range.second == xmin + nbins * dx &&
+                        histogram.count(xmin + 4 * dx, xmin + 8 * dx) == 26 * ncopies;
+            for (int k = 0; k < nbins; k++) {
+#if defined(NOMASSWEIGHT) || defined(HIGHRES)
+                Double_t w = 1.0;
+#else
+                Double_t w = 0.5 + 0.25 * k;
+#endif
+                pass = pass && binned.sum[k] == ncopies * (k + 1) * w && binned.sum2[k] == ncopies * (k + 1) * w * w;
+            }
+            LOG(info) << "Histogram of " << parts.size() << " ratios at the bin centres on " << nthreads << " threads "
+                      << (pass ? "has" : "does not have") << " the expected sums";
+            if (!pass) {
+                LOG(error) << "Histogram of ratios at the bin centres differs from the expected sums";
+                nfail++;
+            }
+            if (nthreads == maxthreads) break;
+        }
+    }
+
+    for (Int_t npart : {Int_t(1000), Int_t(100000), Int_t(4000000)}) {
+        auto parts = generate_ratios(npart, 7 + npart);
+        Double_t rmin = parts[0].GetPotential(), rmax = rmin;
+        for (auto &p : parts) {
+            rmin = std::min(rmin, p.GetPotential());
+            rmax = std::max(rmax, p.GetPotential());
+        }
+        // bins over the whole range and over a peak, as in the two binnings of DetermineDenVRatioDistribution
+        const int nbins = 88;
+        Double_t lo = -2.0, hi = 0.0;
+        std::vector<Double_t> sum, sum2, peaksum, peaksum2;
+        vr::Timer reference_timer;
+        reference_fill(parts, rmin, (rmax - rmin) / nbins, nbins, sum, sum2);
+        reference_fill(parts, lo, (hi - lo) / nbins, nbins, peaksum, peaksum2);
+        auto treference = reference_timer.get();
+        Int_t npeak = std::count_if(parts.begin(), parts.end(), [lo, hi](const Particle &p) {
+            return p.GetPotential() >= lo && p.GetPotential() < hi;
+        });
+
+        for (int nthreads = 1;; nthreads = std::min(2 * nthreads, maxthreads)) {
+#ifdef USEOPENMP
+            omp_set_num_threads(nthreads);
+#endif
+            vr::Timer timer;
+            vr::Histogram histogram(npart, parts.data());
+            auto range = histogram.range();
+            auto all = histogram.fill(rmin, (rmax - rmin) / nbins, nbins);
+            auto peak = histogram.fill(lo, (hi - lo) / nbins, nbins);
+            auto t = timer.get();
+
+            double maxdiff = std::max({largest_difference(all.sum, sum), largest_difference(all.sum2, sum2),
+                                       largest_difference(peak.sum, peaksum), largest_difference(peak.sum2, peaksum2)});
+            LOG(info) << "Histograms of " << npart << " ratios on " << nthreads << " threads: largest relative difference "
+                      << maxdiff << ", " << vr::us_time(t) << " instead of " << vr::us_time(treference);
+            if (range.first != rmin || range.second != rmax || histogram.count(lo, hi) != npeak || maxdiff > 1e-10) {
+                LOG(error) << "Histograms differ from binning the particles one by one";
+                nfail++;
+            }
+            if (nthreads == maxthreads) break;
+        }
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
@@ -0,0 +1,110 @@
+// Test of the incremental update of the potential of large groups during unbinding, which subtracts the contribution of
+// the particles removed in every iteration using the multipoles of a tree kept across iterations, against the exact
+// pairwise update. Particles are removed from the tail of the group as the unbinding does after sorting by energy.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// Hernquist-like sphere ordered by radius with some scatter, so the removed particles are mostly but not only the
+// outermost ones, like the least bound particles of a halo
+std::vector<Particle> generate_halo(Int_t npart)
+{
+    std::mt19937_64 gen(31415);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 0.5);
+    std::vector<Particle> parts(npart);
+    std::vector<double> key(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double u = uniform(gen) * 0.99;
+        double r = std::sqrt(u) / (1 - std::sqrt(u));
+        double cost = 2 * uniform(gen) - 1, sint = std::sqrt(1 - cost * cost), phi = 2 * M_PI * uniform(gen);
+        parts[i] = Particle(1.0 / npart, r * sint * std::cos(phi), r * sint * std::sin(phi), r * cost, 0, 0, 0, i);
+        key[i] = r * std::exp(normal(gen));
+    }
+    std::sort(parts.begin(), parts.end(),
+              [&key](const Particle &a, const Particle &b) { return key[a.GetID()] < key[b.GetID()]; });
+    for (Int_t i = 0; i < npart; i++) parts[i].SetPID(i);
+    return parts;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    Int_t npart = 20000;
+    if (argc > 1) npart = std::stoll(argv[1]);
+
+    vr::init_logging(vr::LogLevel::info);
+    Options opt;
+    opt.G = 1.0;
+    opt.uinfo.eps = 0;
+    opt.uinfo.iapproxpot = 0;
+    opt.uinfo.bgpot = 0;
+
+    auto halo = generate_halo(npart);
+    PotentialPP(opt, npart, halo.data());
+
+    int nfail = 0;
+    const int niter = 5;
+    for (auto theta : {0.3, 0.5, 0.7}) {
+        opt.uinfo.TreeThetaOpen = theta;
+        auto exact = halo, parts = halo;
+        IncrementalPotentialTree ptree;
+        BuildIncrementalPotentialTree(opt, npart, parts.data(), ptree);
+
+        Int_t nig = npart;
+        vr::Timer::duration texact = 0, ttree = 0;
+        double rms = 0, maxerr = 0;
+        for (int iter = 0; iter < niter; iter++) {
+            Int_t nEplus = 0.02 * nig;
+            std::vector<Int_t> ids(nEplus);
+            std::vector<int> flags(nig, 0);
+            for (Int_t k = 0; k < nEplus; k++) ids[k] = nig - 1 - k;
+            Int_t *nEplusid = ids.data();
+            int *Eplusflag = flags.data();
+
+            vr::Timer exact_timer;
+            UpdatePotentialForUnboundParticlesPP(opt, nig, exact.data(), nEplus, nEplusid, Eplusflag);
+            texact += exact_timer.get();
+            vr::Timer tree_timer;
+            UpdatePotentialForUnboundParticlesTree(opt, nig, parts.data(), nEplus, nEplusid, ptree);
+            ttree += tree_timer.get();
+            nig -= nEplus;
+
+            // the potentials of the particles left must agree with the exact update
+            double sum = 0;
+            for (Int_t j = 0; j < nig; j++) {
+                double err = std::abs((parts[j].GetPotential() - exact[j].GetPotential()) / exact[j].GetPotential());
+                sum += err * err;
+                maxerr = std::max(maxerr, err);
+            }
+            rms = std::max(rms, std::sqrt(sum / nig));
+        }
+        LOG(info) << niter << " iterations removing " << npart - nig << " of " << npart
+                  << " particles with opening angle " << theta << ": rms relative error " << rms
+                  << ", max relative error " << maxerr << ", " << vr::us_time(ttree) << " instead of "
+                  << vr::us_time(texact);
+        if (rms > 1e-3 || maxerr > 1e-2) {
+            LOG(error) << "Incremental potential update differs from the exact update for opening angle " << theta;
+            nfail++;
+        }
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
@@ -0,0 +1,98 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// Hernquist-like sphere, centrally concentrated so the tree is exercised over a large range of cell sizes
+std::vector<Particle> generate_halo(Int_t npart, Double_t scale_radius)
+{
+    std::mt19937_64 gen(4242);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<Particle> parts(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double u = uniform(gen) * 0.99;
+        double r = scale_radius * std::sqrt(u) / (1 - std::sqrt(u));
+        double cost = 2 * uniform(gen) - 1, sint = std::sqrt(1 - cost * cost), phi = 2 * M_PI * uniform(gen);
+        parts[i] = Particle(1.0 / npart, r * sint * std::cos(phi), r * sint * std::sin(phi), r * cost, 0, 0, 0, i);
+    }
+    return parts;
+}
+
+struct potential_error {
+    double rms;
+    double max;
+};
+
+potential_error compare(const std::vector<Particle> &reference, const std::vector<Particle> &parts)
+{
+    std::vector<double> pot(parts.size());
+    for (auto &p : parts) pot[p.GetID()] = p.GetPotential();
+    double sum = 0, maxerr = 0;
+    for (auto &p : reference) {
+        double err = std::abs((pot[p.GetID()] - p.GetPotential()) / p.GetPotential());
+        sum += err * err;
+        maxerr = std::max(maxerr, err);
+    }
+    return {std::sqrt(sum / reference.size()), maxerr};
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    Int_t npart = 20000;
+    if (argc > 1) npart = std::stoll(argv[1]);
+
+    vr::init_logging(vr::LogLevel::trace);
+    Options opt;
+    opt.G = 1.0;
+    opt.uinfo.eps = 0;
+    opt.uinfo.iapproxpot = 0;
+
+    auto reference = generate_halo(npart, 1.0);
+    {
+        vr::Timer timer;
+        PotentialPP(opt, npart, reference.data());
+        LOG(info) << "PotentialPP of " << npart << " particles took " << timer;
+    }
+
+    int nfail = 0;
+    for (auto theta : {0.3, 0.5, 0.7}) {
+        potential_error errors[2];
+        for (auto method : {POTTREEMETHODPARTICLE, POTTREEMETHODGROUP}) {
+            auto parts = reference;
+            opt.uinfo.TreeThetaOpen = theta;
+            opt.uinfo.TreeWalkMethod = method;
+            vr::Timer timer;
+            Potential(opt, npart, parts.data());
+            errors[method] = compare(reference, parts);
+            LOG(info) << "Method " << method << " with opening angle " << theta << " took " << timer
+                      << ", rms relative error " << errors[method].rms << ", max relative error " << errors[method].max;
+        }
+        // the quadrupole group walk should be at least as accurate as the monopole particle walk
+        if (errors[POTTREEMETHODGROUP].rms > errors[POTTREEMETHODPARTICLE].rms) {
+            LOG(error) << "Group walk less accurate than particle walk for opening angle " << theta;
+            nfail++;
+        }
+        if (errors[POTTREEMETHODGROUP].rms > 1e-2) {
+            LOG(error) << "Group walk rms relative error too large for opening angle " << theta;
+            nfail++;
+        }
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
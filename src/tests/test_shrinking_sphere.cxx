@@ -0,0 +1,277 @@
+// Test of vr::ShrinkingSphere, the centre finder of GetCM, GetProperties and GetInclusiveMasses. A halo made of pairs
+// of particles mirrored about a known centre, with mirrored velocities about a known bulk velocity, must be centred
+// there to rounding, and close to it when a satellite drags the starting centre of mass away. Random groups are then
+// compared with the scan over all particles on every iteration used before, which serial searches must match exactly.
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// concentrated halo with an offset satellite, or two equal clumps, so that the centre moves as the sphere shrinks
+std::vector<Particle> generate_group(Int_t npart, bool dumbbell, unsigned seed)
+{
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    std::vector<Particle> parts(npart);
+    const int types[] = {DARKTYPE, DARKTYPE, GASTYPE, STARTYPE};
+    for (Int_t i = 0; i < npart; i++) {
+        double x[3], centre[3] = {10, 20, 30}, scale = 1.0;
+        bool second = dumbbell ? uniform(gen) < 0.5 : uniform(gen) < 0.1;
+        if (second) {
+            centre[0] += dumbbell ? 3.0 : 2.0;
+            scale = dumbbell ? 1.0 : 0.2;
+        }
+        double u = uniform(gen) * 0.99;
+        double r = scale * std::sqrt(u) / (1 - std::sqrt(u));
+        double cost = 2 * uniform(gen) - 1, sint = std::sqrt(1 - cost * cost), phi = 2 * M_PI * uniform(gen);
+        x[0] = centre[0] + r * sint * std::cos(phi);
+        x[1] = centre[1] + r * sint * std::sin(phi);
+        x[2] = centre[2] + r * cost;
+        parts[i] = Particle(0.5 + uniform(gen), x[0], x[1], x[2], 100 * normal(gen), 100 * normal(gen), 100 * normal(gen), i,
+                            types[i % 4]);
+    }
+    return parts;
+}
+
+// pairs of particles of a concentrated halo mirrored about centre, with velocities mirrored about cmvel, plus a compact
+// satellite of nsatellite particles offset along x
+std::vector<Particle> generate_mirrored_halo(Int_t npairs, Int_t nsatellite, const Coordinate &centre,
+                                             const Coordinate &cmvel, unsigned seed)
+{
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    std::vector<Particle> parts;
+    const int types[] = {DARKTYPE, DARKTYPE, GASTYPE, STARTYPE};
+    for (Int_t i = 0; i < npairs + nsatellite; i++) {
+        bool satellite = (i >= npairs);
+        double u = uniform(gen) * 0.99, scale = satellite ? 0.2 : 1.0;
+        double r = scale * std::sqrt(u) / (1 - std::sqrt(u));
+        double cost = 2 * uniform(gen) - 1, sint = std::sqrt(1 - cost * cost), phi = 2 * M_PI * uniform(gen);
+        double dx[3] = {r * sint * std::cos(phi), r * sint * std::sin(phi), r * cost}, dv[3];
+        for (int k = 0; k < 3; k++) dv[k] = 100 * normal(gen);
+        double mass = 0.5 + uniform(gen);
+        if (satellite) {
+            dx[0] += 2.0;
+            parts.emplace_back(mass, centre[0] + dx[0], centre[1] + dx[1], centre[2] + dx[2], cmvel[0] + dv[0],
+                               cmvel[1] + dv[1], cmvel[2] + dv[2], parts.size(), types[i % 4]);
+            continue;
+        }
+        for (int sign : {1, -1}) {
+            parts.emplace_back(mass, centre[0] + sign * dx[0], centre[1] + sign * dx[1], centre[2] + sign * dx[2],
+                               cmvel[0] + sign * dv[0], cmvel[1] + sign * dv[1], cmvel[2] + sign * dv[2],
+                               parts.size(), types[i % 4]);
+        }
+    }
+    return parts;
+}
+
+struct centre {
+    Coordinate cm, cmvel;
+    Double_t r2;
+    Int_t ninside;
+};
+
+// the iterations as written in GetCM (radius_squared) and GetInclusiveMasses (radius)
+centre reference_centre(const Options &opt, Int_t npart, Particle *Part, Coordinate cm, Double_t r2, int type, bool scaleradius)
+{
+    Int_t n = 0;
+    for (Int_t j = 0; j < npart; j++) n += (type < 0 || Part[j].GetType() == type);
+    Coordinate cmold = cm;
+    Double_t ri = scaleradius ? std::sqrt(r2) : r2, ri2, rcmv = r2;
+    Int_t icmv = n;
+    while (true) {
+        ri *= opt.pinfo.cmadjustfac;
+        ri2 = scaleradius ? ri * ri : ri;
+        Double_t cmx = 0, cmy = 0, cmz = 0, EncMass = 0;
+        Int_t Ninside = 0;
+        for (Int_t j = 0; j < npart; j++) {
+            Particle *Pval = &Part[j];
+            if (type >= 0 && Pval->GetType() != type) continue;
+            Double_t x = (*Pval).X() - cmold[0];
+            Double_t y = (*Pval).Y() - cmold[1];
+            Double_t z = (*Pval).Z() - cmold[2];
+            if ((x * x + y * y + z * z) <= ri2) {
+                Double_t massval = (*Pval).GetMass();
+                cmx += massval * (*Pval).X();
+                cmy += massval * (*Pval).Y();
+                cmz += massval * (*Pval).Z();
+                EncMass += massval;
+                Ninside++;
+            }
+        }
+        if (Ninside >= opt.pinfo.cmfrac * n && Ninside >= PROPCMMINNUM) {
+            cm[0] = cmx; cm[1] = cmy; cm[2] = cmz;
+            for (int k = 0; k < 3; k++) cm[k] /= EncMass;
+            cmold = cm;
+            rcmv = ri2;
+            icmv = Ninside;
+        }
+        else break;
+    }
+    Double_t cmx = 0, cmy = 0, cmz = 0, EncMass = 0;
+    for (Int_t j = 0; j < npart; j++) {
+        Particle *Pval = &Part[j];
+        if (type >= 0 && Pval->GetType() != type) continue;
+        Double_t x = (*Pval).X() - cm[0];
+        Double_t y = (*Pval).Y() - cm[1];
+        Double_t z = (*Pval).Z() - cm[2];
+        if ((x * x + y * y + z * z) <= rcmv) {
+            Double_t massval = (*Pval).GetMass();
+            cmx += massval * (*Pval).Vx();
+            cmy += massval * (*Pval).Vy();
+            cmz += massval * (*Pval).Vz();
+            EncMass += massval;
+        }
+    }
+    Coordinate cmvel(cmx, cmy, cmz);
+    for (int k = 0; k < 3; k++) cmvel[k] /= EncMass;
+    return {cm, cmvel, rcmv, icmv};
+}
+
+double max_relative_difference(const Coordinate &a, const Coordinate &b)
+{
+    double diff = 0;
+    for (int k = 0; k < 3; k++) diff = std::max(diff, std::abs(a[k] - b[k]) / std::max(std::abs(b[k]), 1e-300));
+    return diff;
+}
+
+double max_difference(const Coordinate &a, const Coordinate &b)
+{
+    double diff = 0;
+    for (int k = 0; k < 3; k++) diff = std::max(diff, std::abs(a[k] - b[k]));
+    return diff;
+}
+
+// starting sphere as set up by the property routines, all particles of the type around their centre of mass
+void starting_sphere(const std::vector<Particle> &parts, int type, Coordinate &cm, Double_t &r2, Int_t &n)
+{
+    Double_t mass = 0;
+    cm = Coordinate(0.);
+    r2 = 0;
+    n = 0;
+    for (auto &p : parts) {
+        if (type >= 0 && p.GetType() != type) continue;
+        for (int k = 0; k < 3; k++) cm[k] += p.GetMass() * p.GetPosition(k);
+        mass += p.GetMass();
+        n++;
+    }
+    for (int k = 0; k < 3; k++) cm[k] /= mass;
+    for (auto &p : parts) {
+        if (type >= 0 && p.GetType() != type) continue;
+        Double_t d2 = 0;
+        for (int k = 0; k < 3; k++) d2 += (p.GetPosition(k) - cm[k]) * (p.GetPosition(k) - cm[k]);
+        r2 = std::max(r2, d2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    vr::init_logging(vr::LogLevel::info);
+    Options opt;
+    opt.pinfo.cmfrac = 0.01;
+
+    int nfail = 0;
+    const Coordinate halocentre(10, 20, 30), halovel(50, -30, 20);
+    for (Int_t npairs : {Int_t(1000), Int_t(2 * omppropnum)}) {
+        for (Int_t nsatellite : {Int_t(0), npairs / 5}) {
+            auto parts = generate_mirrored_halo(npairs, nsatellite, halocentre, halovel, 3 + npairs + nsatellite);
+            for (int type : {-1, int(GASTYPE)}) {
+                for (bool scaleradius : {false, true}) {
+                    Coordinate cm;
+                    Double_t r2;
+                    Int_t n;
+                    starting_sphere(parts, type, cm, r2, n);
+                    vr::ShrinkingSphere sphere(opt, parts.size(), parts.data(), type);
+                    Int_t ninside = sphere.refine(opt, cm, r2,
+                        scaleradius ? vr::ShrinkingSphere::Scaling::radius : vr::ShrinkingSphere::Scaling::radius_squared);
+                    Coordinate cmvel = sphere.velocity(cm, r2);
+
+                    // without a satellite every sphere holds whole pairs about the centre, with one the sphere only
+                    // converges onto it, to well within the scale radius of 1 and the velocity dispersion of 100
+                    Int_t nexpected = 0;
+                    for (auto &p : parts) {
+                        if (type >= 0 && p.GetType() != type) continue;
+                        Double_t d2 = 0;
+                        for (int k = 0; k < 3; k++) d2 += std::pow(p.GetPosition(k) - halocentre[k], 2);
+                        nexpected += (d2 <= r2);
+                    }
+                    double dcm = max_difference(cm, halocentre), dvel = max_difference(cmvel, halovel);
+                    LOG(info) << "Mirrored halo of " << n << " particles of type " << type << " with "
+                              << (nsatellite ? "a satellite" : "no satellite")
+                              << (scaleradius ? " shrinking the radius" : " shrinking the squared radius") << ": "
+                              << ninside << " particles in the final sphere, centre off by " << dcm << ", velocity by "
+                              << dvel;
+                    bool pass = ninside >= opt.pinfo.cmfrac * n;
+                    if (nsatellite == 0) pass = pass && ninside == nexpected && dcm < 1e-10 && dvel < 1e-8;
+                    else pass = pass && dcm < 1e-2 && dvel < 5;
+                    if (!pass) {
+                        LOG(error) << "Shrinking sphere does not find the centre of the mirrored halo";
+                        nfail++;
+                    }
+                }
+            }
+        }
+    }
+
+    for (Int_t npart : {Int_t(2000), Int_t(40000), Int_t(4 * omppropnum)}) {
+        for (bool dumbbell : {false, true}) {
+            auto parts = generate_group(npart, dumbbell, 7 + npart);
+            for (int type : {-1, int(GASTYPE)}) {
+                for (bool scaleradius : {false, true}) {
+                    Coordinate cm;
+                    Double_t r2;
+                    Int_t n;
+                    starting_sphere(parts, type, cm, r2, n);
+
+                    vr::Timer reference_timer;
+                    auto reference = reference_centre(opt, npart, parts.data(), cm, r2, type, scaleradius);
+                    auto treference = reference_timer.get();
+
+                    vr::Timer timer;
+                    vr::ShrinkingSphere sphere(opt, npart, parts.data(), type);
+                    centre result {cm, Coordinate(0.), r2, 0};
+                    result.ninside = sphere.refine(opt, result.cm, result.r2,
+                        scaleradius ? vr::ShrinkingSphere::Scaling::radius : vr::ShrinkingSphere::Scaling::radius_squared);
+                    result.cmvel = sphere.velocity(result.cm, result.r2);
+                    auto t = timer.get();
+
+                    bool serial = (n < omppropnum);
+                    double dcm = max_relative_difference(result.cm, reference.cm);
+                    double dvel = max_relative_difference(result.cmvel, reference.cmvel);
+                    bool pass = (result.ninside == reference.ninside && result.r2 == reference.r2);
+                    if (serial) pass = pass && dcm == 0 && dvel == 0;
+                    else pass = pass && dcm < 1e-12 && dvel < 1e-10;
+                    LOG(info) << (dumbbell ? "Dumbbell" : "Halo") << " of " << n << " particles of type " << type
+                              << (scaleradius ? " shrinking the radius" : " shrinking the squared radius") << ": "
+                              << reference.ninside << " particles in the final sphere, centre differs by " << dcm
+                              << ", velocity by " << dvel << ", " << vr::us_time(t) << " instead of "
+                              << vr::us_time(treference);
+                    if (!pass) {
+                        LOG(error) << "Shrinking sphere centre differs from the reference";
+                        nfail++;
+                    }
+                }
+            }
+        }
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
@@ -0,0 +1,260 @@
+// Test of CalculateSphericalOverdensity, which walks radial bins out from the centre of a halo until the enclosed
+// density drops below every overdensity threshold. On a singular isothermal sphere, whose enclosed mass grows linearly
+// with radius, each overdensity radius, mass and half mass radius is known analytically. Halos with a central particle,
+// a satellite shell and a background are then compared with the walk over all particles sorted by radius that
+// GetSOMasses and GetInclusiveMasses used before.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// radii of a concentrated halo with a satellite and a uniform background out to rmax
+void generate_halo(Int_t npart, double rmax, unsigned seed, std::vector<Double_t> &radii, std::vector<Double_t> &masses)
+{
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    radii.resize(npart);
+    masses.resize(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double u = uniform(gen), r;
+        if (u < 0.8) {
+            double s = std::sqrt(0.99 * uniform(gen));
+            r = 0.05 * s / (1 - s);
+        }
+        else if (u < 0.85) r = 0.4 + 0.01 * uniform(gen);
+        else r = rmax * std::cbrt(uniform(gen));
+        radii[i] = std::min(r, rmax);
+        masses[i] = 1.0 + 0.1 * uniform(gen);
+    }
+    // a particle at the centre, as for a halo centred on its most bound particle
+    radii[0] = 0;
+}
+
+// radii of a singular isothermal sphere of npart particles of unit mass out to rmax, in random order, the enclosed mass
+// within the ith smallest radius being exactly npart times that radius over rmax
+void generate_isothermal_sphere(Int_t npart, double rmax, unsigned seed, std::vector<Double_t> &radii,
+                                std::vector<Double_t> &masses)
+{
+    radii.resize(npart);
+    masses.assign(npart, 1.0);
+    for (Int_t i = 0; i < npart; i++) radii[i] = rmax * (i + 1) / npart;
+    std::shuffle(radii.begin(), radii.end(), std::mt19937_64(seed));
+}
+
+// the walk as written before, over indices sorted by radius
+Int_t reference_spherical_overdensity(Options &opt, PropData &pdata, std::vector<Double_t> &radii,
+                                      std::vector<Double_t> &masses, std::vector<Int_t> &indices, Double_t &m200val,
+                                      Double_t &m200mval, Double_t &mBN98val, Double_t &virval, Double_t &m500val,
+                                      std::vector<Double_t> &SOlgrhovals)
+{
+    int minnum = 2;
+    Int_t iindex = radii.size(), llindex = iindex;
+    int iSOfound = 0;
+    double fac = 3.0 / (4.0 * M_PI);
+    while (radii[indices[minnum - 1]] == 0) minnum++;
+    double EncMass = 0;
+    for (auto j = 0; j < minnum; j++) EncMass += masses[indices[j]];
+    double MinMass = masses[indices[0]];
+    double rc = radii[indices[minnum - 1]];
+    double rc2 = rc, EncMass2 = EncMass, rhoval2 = std::log10(fac * EncMass2 * std::pow(rc2, -3.0)), rhoval;
+    double gamma1, gamma2;
+    for (Int_t j = minnum; j < iindex; j++) {
+        rc = radii[indices[j]];
+        EncMass += masses[indices[j]];
+        rhoval = std::log10(fac * EncMass * std::pow(rc, -3.0));
+        gamma1 = (rc - rc2) / (rhoval - rhoval2);
+        gamma2 = std::log10(EncMass2 / EncMass) / (rc2 - rc);
+        if (gamma1 > 0) {
+            rhoval2 = rhoval;
+            rc2 = rc;
+            EncMass2 = EncMass;
+            continue;
+        }
+        Interpolate_SphericalOverdensity(opt, pdata, m200val, m200mval, mBN98val, virval, m500val, SOlgrhovals, gamma1,
+                                         gamma2, rc, std::log10(EncMass), rhoval, iSOfound);
+        EncMass2 = EncMass;
+        rc2 = rc;
+        rhoval2 = rhoval;
+        if (pdata.gR200m != 0 && pdata.gR200c != 0 && pdata.gRvir != 0 && pdata.gR500c != 0 && pdata.gRBN98 != 0 &&
+            iSOfound == opt.SOnum) {
+            llindex = j;
+            break;
+        }
+    }
+    if (pdata.gM200c < MinMass) pdata.gM200c = pdata.gR200c = 0.0;
+    if (pdata.gM200m < MinMass) pdata.gM200m = pdata.gR200m = 0.0;
+    if (pdata.gMvir < MinMass) pdata.gMvir = pdata.gRvir = 0.0;
+    if (pdata.gM500c < MinMass) pdata.gM500c = pdata.gR500c = 0.0;
+    if (pdata.gMBN98 < MinMass) pdata.gMBN98 = pdata.gRBN98 = 0.0;
+    for (auto iso = 0; iso < opt.SOnum; iso++)
+        if (pdata.SO_mass[iso] < MinMass) pdata.SO_mass[iso] = pdata.SO_radius[iso] = 0.0;
+    EncMass = masses[indices[0]];
+    double oldrc = radii[indices[0]];
+    for (Int_t j = 1; j < iindex; j++) {
+        rc = radii[indices[j]];
+        double massval = masses[indices[j]];
+        EncMass += massval;
+        gamma1 = (rc - oldrc) / massval;
+        if (EncMass >= 0.5 * pdata.gM200c && pdata.gM200c > 0 && pdata.gRhalf200c == 0) {
+            pdata.gRhalf200c = rc - gamma1 * (EncMass - 0.5 * pdata.gM200c);
+            if (pdata.gRhalf200c <= 0) pdata.gRhalf200c = rc;
+        }
+        if (EncMass >= 0.5 * pdata.gM200m && pdata.gM200m > 0 && pdata.gRhalf200m == 0) {
+            pdata.gRhalf200m = rc - gamma1 * (EncMass - 0.5 * pdata.gM200m);
+            if (pdata.gRhalf200m <= 0) pdata.gRhalf200m = rc;
+        }
+        if (EncMass >= 0.5 * pdata.gMBN98 && pdata.gMBN98 > 0 && pdata.gRhalfBN98 == 0) {
+            pdata.gRhalfBN98 = rc - gamma1 * (EncMass - 0.5 * pdata.gMBN98);
+            if (pdata.gRhalfBN98 <= 0) pdata.gRhalfBN98 = rc;
+        }
+        oldrc = rc;
+        if (pdata.gRhalf200c > 0 && pdata.gRhalf200m > 0 && pdata.gRhalfBN98 > 0) break;
+    }
+    return llindex;
+}
+
+// the radii and masses found, in a fixed order
+std::vector<double> results(Options &opt, const PropData &pdata)
+{
+    std::vector<double> values {pdata.gR200c, pdata.gM200c, pdata.gR200m, pdata.gM200m, pdata.gRvir, pdata.gMvir,
+                                pdata.gR500c, pdata.gM500c, pdata.gRBN98, pdata.gMBN98, pdata.gRhalf200c,
+                                pdata.gRhalf200m, pdata.gRhalfBN98};
+    for (auto iso = 0; iso < opt.SOnum; iso++) {
+        values.push_back(pdata.SO_radius[iso]);
+        values.push_back(pdata.SO_mass[iso]);
+    }
+    return values;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    vr::init_logging(vr::LogLevel::info);
+
+    int nfail = 0;
+    for (Int_t npart : {Int_t(10000), Int_t(1000000)}) {
+        // R200c at half of rmax, all other thresholds being lower or higher densities that are reached within rmax
+        Options opt;
+        opt.SOnum = 3;
+        opt.SOthresholds_values_crit = {100.0, 1000.0, 2500.0};
+        double rmax = 1.0;
+        opt.rhocrit = 3.0 * npart / (4.0 * M_PI * rmax * 200.0 * 0.25);
+        opt.rhobg = 0.3 * opt.rhocrit;
+        opt.virBN98 = 100.0;
+        opt.virlevel = 330.0;
+        std::vector<Double_t> rhovals {opt.rhocrit * 200.0, opt.rhobg * 200.0, opt.virlevel * opt.rhobg,
+                                       opt.rhocrit * 500.0, opt.virBN98 * opt.rhocrit};
+        Double_t m200val = std::log10(rhovals[0]), m200mval = std::log10(rhovals[1]);
+        Double_t virval = std::log10(rhovals[2]), m500val = std::log10(rhovals[3]), mBN98val = std::log10(rhovals[4]);
+        std::vector<Double_t> SOlgrhovals(opt.SOnum);
+        for (auto iso = 0; iso < opt.SOnum; iso++) {
+            rhovals.push_back(opt.rhocrit * opt.SOthresholds_values_crit[iso]);
+            SOlgrhovals[iso] = std::log10(rhovals.back());
+        }
+
+        std::vector<Double_t> radii, masses;
+        generate_isothermal_sphere(npart, rmax, 5 + npart, radii, masses);
+        PropData pdata;
+        pdata.AllocateSOs(opt);
+        vr::RadialBins bins(opt, radii, masses);
+        CalculateSphericalOverdensity(opt, pdata, radii, masses, bins, m200val, m200mval, mBN98val, virval, m500val,
+                                      SOlgrhovals);
+
+        // the mean density within r is 3 npart / (4 pi rmax r^2), and half the mass within R is within R / 2
+        std::vector<double> expected, found {pdata.gR200c, pdata.gR200m, pdata.gRvir, pdata.gR500c, pdata.gRBN98};
+        for (auto iso = 0; iso < opt.SOnum; iso++) found.push_back(pdata.SO_radius[iso]);
+        for (auto rho : rhovals) expected.push_back(std::sqrt(3.0 * npart / (4.0 * M_PI * rmax * rho)));
+        found.insert(found.end(), {pdata.gM200c, pdata.gM200m, pdata.gMvir, pdata.gM500c, pdata.gMBN98});
+        for (auto iso = 0; iso < opt.SOnum; iso++) found.push_back(pdata.SO_mass[iso]);
+        for (size_t k = 0, nradii = expected.size(); k < nradii; k++) expected.push_back(npart * expected[k] / rmax);
+        found.insert(found.end(), {pdata.gRhalf200c, pdata.gRhalf200m, pdata.gRhalfBN98});
+        expected.insert(expected.end(), {0.5 * expected[0], 0.5 * expected[1], 0.5 * expected[4]});
+        double maxdiff = 0;
+        for (size_t k = 0; k < expected.size(); k++) {
+            maxdiff = std::max(maxdiff, std::abs(found[k] - expected[k]) / expected[k]);
+        }
+        LOG(info) << "Isothermal sphere of " << npart << " particles: R200c " << pdata.gR200c << " instead of "
+                  << expected[0] << ", largest relative difference from the analytic radii and masses " << maxdiff;
+        if (maxdiff > 1e-3) {
+            LOG(error) << "Spherical overdensities of the isothermal sphere differ from the analytic values";
+            nfail++;
+        }
+    }
+
+    for (int sonum : {0, 3}) {
+        Options opt;
+        opt.SOnum = sonum;
+        opt.SOthresholds_values_crit = {100.0, 1000.0, 2500.0};
+        opt.SOthresholds_values_crit.resize(sonum);
+        for (Int_t npart : {Int_t(1000), Int_t(100000), Int_t(1000000)}) {
+            // a mean density of the halo within 0.3 of about 200 times the critical density
+            double rmax = 1.0;
+            opt.rhocrit = 0.8 * npart / (4.0 * M_PI / 3.0 * std::pow(0.3, 3.0)) / 200.0;
+            opt.rhobg = 0.3 * opt.rhocrit;
+            // virial thresholds that are reached, as otherwise the virial mass is never set
+            opt.virBN98 = 100.0;
+            opt.virlevel = 330.0;
+            Double_t virval = std::log10(opt.virlevel * opt.rhobg);
+            Double_t mBN98val = std::log10(opt.virBN98 * opt.rhocrit);
+            Double_t m200val = std::log10(opt.rhocrit * 200.0);
+            Double_t m200mval = std::log10(opt.rhobg * 200.0);
+            Double_t m500val = std::log10(opt.rhocrit * 500.0);
+            std::vector<Double_t> SOlgrhovals(sonum);
+            for (auto iso = 0; iso < sonum; iso++)
+                SOlgrhovals[iso] = std::log10(opt.rhocrit * opt.SOthresholds_values_crit[iso]);
+
+            std::vector<Double_t> radii, masses;
+            generate_halo(npart, rmax, 11 + npart, radii, masses);
+
+            PropData reference;
+            reference.AllocateSOs(opt);
+            vr::Timer reference_timer;
+            std::vector<Int_t> indices(npart);
+            for (Int_t j = 0; j < npart; j++) indices[j] = j;
+            std::sort(indices.begin(), indices.end(), [&radii](Int_t a, Int_t b) { return radii[a] < radii[b]; });
+            Int_t reference_llindex = reference_spherical_overdensity(opt, reference, radii, masses, indices, m200val,
+                                                                      m200mval, mBN98val, virval, m500val, SOlgrhovals);
+            auto treference = reference_timer.get();
+
+            PropData pdata;
+            pdata.AllocateSOs(opt);
+            vr::Timer timer;
+            vr::RadialBins bins(opt, radii, masses);
+            Int_t llindex = CalculateSphericalOverdensity(opt, pdata, radii, masses, bins, m200val, m200mval, mBN98val,
+                                                          virval, m500val, SOlgrhovals);
+            auto t = timer.get();
+
+            auto expected = results(opt, reference), found = results(opt, pdata);
+            double maxdiff = 0;
+            for (size_t k = 0; k < expected.size(); k++) {
+                maxdiff = std::max(maxdiff, std::abs(found[k] - expected[k]) / std::max(std::abs(expected[k]), 1e-300));
+            }
+            LOG(info) << "Halo of " << npart << " particles with " << sonum << " extra overdensities: R200c "
+                      << pdata.gR200c << ", R200m " << pdata.gR200m << ", largest relative difference " << maxdiff
+                      << ", " << vr::us_time(t) << " instead of " << vr::us_time(treference);
+            if (llindex != reference_llindex || maxdiff > 1e-9 || pdata.gR200c <= 0) {
+                LOG(error) << "Spherical overdensities differ from the walk over all sorted particles, " << llindex
+                           << " particles in the list instead of " << reference_llindex;
+                nfail++;
+            }
+        }
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
@@ -0,0 +1,100 @@
+// Test of the grid of cells built from the leaves of a tree: the leaves enumerated in a single traversal must be those
+// found walking down from the root for every particle with FindLeafNode, as FillTreeGrid did before, and the cell
+// velocities computed through the shared index buffer must be those of the particles of each cell.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef USEMPI
+#include <mpi.h>
+#endif // USEMPI
+
+#include "allvars.h"
+#include "logging.h"
+#include "proto.h"
+#include "timer.h"
+
+// centrally concentrated sphere with random velocities, so that leaves span a large range of sizes
+std::vector<Particle> generate_halo(Int_t npart)
+{
+    std::mt19937_64 gen(2025);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    std::vector<Particle> parts(npart);
+    for (Int_t i = 0; i < npart; i++) {
+        double u = uniform(gen) * 0.99;
+        double r = 0.1 * std::sqrt(u) / (1 - std::sqrt(u));
+        double cost = 2 * uniform(gen) - 1, sint = std::sqrt(1 - cost * cost), phi = 2 * M_PI * uniform(gen);
+        parts[i] = Particle(1.0 + uniform(gen), r * sint * std::cos(phi), r * sint * std::sin(phi), r * cost,
+                            normal(gen), normal(gen), normal(gen), i);
+    }
+    return parts;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef USEMPI
+    MPI_Init(&argc, &argv);
+#endif // USEMPI
+    vr::init_logging(vr::LogLevel::info);
+
+    int nfail = 0;
+    for (Int_t npart : {Int_t(1000), Int_t(100000), Int_t(1000000)}) {
+        Options opt;
+        opt.gridtype = PHYSENGRID;
+        opt.Ncell = 0.01 * npart;
+        auto parts = generate_halo(npart);
+
+        // leaves found walking down from the root for the first particle not yet in a leaf
+        KDTree *tree = InitializeTreeGrid(opt, npart, parts.data());
+        Int_t ngrid = tree->GetNumLeafNodes();
+        vr::Timer walk_timer;
+        std::vector<Node *> walked;
+        for (Int_t ipart = 0; ipart < npart; ipart += walked.back()->GetCount()) {
+            walked.push_back(tree->FindLeafNode(ipart));
+        }
+        auto twalk = walk_timer.get();
+        vr::Timer timer;
+        std::vector<Node *> leaves = GetLeafNodeList(tree);
+        auto t = timer.get();
+        LOG(info) << npart << " particles in " << leaves.size() << " leaves enumerated in " << vr::us_time(t)
+                  << " instead of " << vr::us_time(twalk);
+        if ((Int_t)leaves.size() != ngrid || leaves != walked) {
+            LOG(error) << "Leaves differ from those found with FindLeafNode";
+            nfail++;
+        }
+
+        GridCell *grid = new GridCell[ngrid];
+        FillTreeGrid(opt, npart, ngrid, tree, parts.data(), grid);
+        Coordinate *gvel = GetCellVel(opt, npart, parts.data(), ngrid, grid);
+        // every particle is in exactly one cell, and cell velocities are the mass weighted means of their particles
+        std::vector<int> ncells(npart, 0);
+        double maxdiff = 0;
+        for (Int_t i = 0; i < ngrid; i++) {
+            Double_t mass = 0, vel[3] = {0, 0, 0};
+            for (Int_t j = 0; j < grid[i].nparts; j++) {
+                Particle &p = parts[grid[i].nindex[j]];
+                ncells[grid[i].nindex[j]]++;
+                mass += p.GetMass();
+                for (int k = 0; k < 3; k++) vel[k] += p.GetMass() * p.GetVelocity(k);
+            }
+            for (int k = 0; k < 3; k++) maxdiff = std::max(maxdiff, std::abs(vel[k] / mass - gvel[i][k]));
+            if (std::abs(mass - grid[i].mass) > 1e-10 * mass) maxdiff = std::max(maxdiff, 1.0);
+        }
+        if (std::any_of(ncells.begin(), ncells.end(), [](int n) { return n != 1; }) || maxdiff > 1e-10) {
+            LOG(error) << "Grid cells do not hold each particle once or give the wrong velocities, largest difference "
+                       << maxdiff;
+            nfail++;
+        }
+        delete[] gvel;
+        FreeTreeGrid(ngrid, grid);
+    }
+
+#ifdef USEMPI
+    MPI_Finalize();
+#endif // USEMPI
+    return nfail > 0;
+}
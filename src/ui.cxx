@@ -297,6 +297,7 @@ void usage(void)
     \section localdensityconfig Parameters related to local density estimator.
     See \ref localfield.cxx, \ref bgfield.cxx & \ref localbgcomp.cxx for more details
 
+    \arg <b> \e Local_velocity_density_batched_search </b> 1/0 search the particles in a leaf of the tree together when calculating the local velocity density, adjust \ref Options.iLocalVelDenBatchedSearch. Only used with mpi if no particles are imported from other domains \n
     \arg <b> \e Nsearch_velocity </b> number of velocity neighbours used to calculate velocity density, adjust \ref Options.Nvel (suggested value is 32) \n
     \arg <b> \e Nsearch_physical </b> number of physical neighbours searched for Nv to calculate velocity density  \ref Options.Nsearch (suggested value is 256) \n
     \arg <b> \e Cell_fraction </b> fraction of a halo contained in a subvolume used to characterize the background  \ref Options.Ncellfac \n
@@ -420,6 +421,9 @@ void usage(void)
     \arg <b> \e Write_group_array_file </b> 0/1 flag indicating whether write a single large tipsy style group assignment file is written. \ref Options.iwritefof \n
     \arg <b> \e Separate_output_files </b> 1/0 flag indicating whether separate files are written for field and subhalo groups. \ref Options.iseparatefiles \n
     \arg <b> \e Binary_output </b> 3/2/1/0 flag indicating whether output is hdf, binary or ascii. \ref Options.ibinaryout, \ref OUTADIOS, \ref OUTHDF, \ref OUTBINARY, \ref OUTASCII \n
+    \arg <b> \e Property_output_column_store </b> 1/0 flag indicating whether all columns of the properties file are filled into contiguous arrays before writing. \ref Options.ipropertycolumnstore \n
+    \arg <b> \e Asynchronous_output </b> 1/0 flag indicating whether catalogues are written on a background thread. \ref Options.iasyncoutput \n
+    \arg <b> \e Asynchronous_output_buffer_size </b> memory budget in bytes of the output waiting to be written asynchronously. \ref Options.asyncoutputbufsize \n
     \arg <b> \e Comoving_units </b> 1/0 flag indicating whether the properties output is in physical or comoving little h units. \ref Options.icomoveunit \n
 
     \section inputflags input flags related to varies input formats
@@ -442,6 +446,14 @@ void usage(void)
     of data. \ref Options.mpipartfac \n
     \arg <b> \e MPI_particle_total_buf_size </b> Total memory size in bytes used to store particles in temporary buffer such that
     particles are sent to non-reading mpi processes in one communication round in chunks of size buffer_size/NProcs/sizeof(Particle). \ref Options.mpiparticlebufsize \n
+    \arg <b> \e MPI_read_sends_in_flight </b> Maximum number of full particle buffers a read task sends to non-reading mpi processes without waiting
+    for them to be received. \ref Options.mpireadsendsinflight \n
+    \arg <b> \e MPI_single_pass_load </b> Read HDF input once, binning particles into the z-curve mesh as they are read and then exchanging them,
+    rather than counting the particles in each domain before reading. \ref Options.impisinglepassload \n
+    \arg <b> \e MPI_mesh_curve_type </b> Space filling curve along which mesh cells are assigned to mpi processes, 0 Morton (z-curve), 1 Hilbert. \ref Options.mpimeshcurve \n
+    \arg <b> \e MPI_mesh_cost_weighting </b> Load of a mesh cell used when balancing the mesh decomposition, 0 number of particles, 1 number of particles weighted
+    by the cell overdensity, 2 cost measured in a previous run and stored in \e MPI_mesh_cost_file, falling back to 1 for cells without a measurement. \ref Options.mpimeshweighting \n
+    \arg <b> \e MPI_mesh_cost_file </b> File from which measured mesh cell costs are read and to which the costs of this run are written. \ref Options.mpimeshcostfile \n
 
     */
 
@@ -851,6 +863,8 @@ void GetParamFile(Options &opt)
                     //bg and fof parameters
                     else if (strcmp(tbuff, "Local_velocity_density_approximate_calculation")==0)
                         opt.iLocalVelDenApproxCalcFlag = atoi(vbuff);
+                    else if (strcmp(tbuff, "Local_velocity_density_batched_search")==0)
+                        opt.iLocalVelDenBatchedSearch = atoi(vbuff);
                     else if (strcmp(tbuff, "Cell_fraction")==0)
                         opt.Ncellfac = atof(vbuff);
                     else if (strcmp(tbuff, "Grid_type")==0)
@@ -1040,6 +1054,14 @@ void GetParamFile(Options &opt)
                         opt.uinfo.approxpotminnum = atoi(vbuff);
                     else if (strcmp(tbuff, "Approximate_potential_calculation_method")==0)
                         opt.uinfo.approxpotmethod = atoi(vbuff);
+                    else if (strcmp(tbuff, "Tree_potential_opening_angle")==0)
+                        opt.uinfo.TreeThetaOpen = atof(vbuff);
+                    else if (strcmp(tbuff, "Tree_potential_walk_method")==0)
+                        opt.uinfo.TreeWalkMethod = atoi(vbuff);
+                    else if (strcmp(tbuff, "Tree_potential_group_size")==0)
+                        opt.uinfo.TreeGroupSize = atoi(vbuff);
+                    else if (strcmp(tbuff, "Unbinding_incremental_potential_update")==0)
+                        opt.uinfo.iincrementalpot = atoi(vbuff);
 
                     //property related
                     else if (strcmp(tbuff, "Reference_frame_for_properties")==0)
@@ -1139,12 +1161,22 @@ void GetParamFile(Options &opt)
                     else if (strcmp(tbuff, "MPI_particle_total_buf_size")==0)
                         opt.mpiparticletotbufsize = atol(vbuff);
                     //mpi memory related
+                    else if (strcmp(tbuff, "MPI_read_sends_in_flight")==0)
+                        opt.mpireadsendsinflight = atoi(vbuff);
                     else if (strcmp(tbuff, "MPI_part_allocation_fac")==0)
                         opt.mpipartfac = atof(vbuff);
                     else if (strcmp(tbuff, "MPI_number_of_tasks_per_write")==0)
                         opt.mpinprocswritesize = atoi(vbuff);
                     else if (strcmp(tbuff, "MPI_use_zcurve_mesh_decomposition")==0)
                         opt.impiusemesh = (atoi(vbuff)>0);
+                    else if (strcmp(tbuff, "MPI_single_pass_load")==0)
+                        opt.impisinglepassload = (atoi(vbuff)>0);
+                    else if (strcmp(tbuff, "MPI_mesh_curve_type")==0)
+                        opt.mpimeshcurve = atoi(vbuff);
+                    else if (strcmp(tbuff, "MPI_mesh_cost_weighting")==0)
+                        opt.mpimeshweighting = atoi(vbuff);
+                    else if (strcmp(tbuff, "MPI_mesh_cost_file")==0)
+                        opt.mpimeshcostfile = string(vbuff);
                     else if (strcmp(tbuff, "MPI_zcurve_mesh_decomposition_min_num_cells_per_dim")==0)
                         opt.minnumcellperdim = atoi(vbuff);
                     ///OpenMP related
@@ -1855,6 +1887,12 @@ void GetParamFile(Options &opt)
                         opt.iseparatefiles = atoi(vbuff);
                     else if (strcmp(tbuff, "Binary_output")==0)
                         opt.ibinaryout = atoi(vbuff);
+                    else if (strcmp(tbuff, "Property_output_column_store")==0)
+                        opt.ipropertycolumnstore = atoi(vbuff);
+                    else if (strcmp(tbuff, "Asynchronous_output")==0)
+                        opt.iasyncoutput = atoi(vbuff);
+                    else if (strcmp(tbuff, "Asynchronous_output_buffer_size")==0)
+                        opt.asyncoutputbufsize = atol(vbuff);
                     else if (strcmp(tbuff, "Comoving_units")==0)
                         opt.icomoveunit = atoi(vbuff);
                     else if (strcmp(tbuff, "Extended_output")==0)
@@ -2022,6 +2060,10 @@ void ConfigCheck(Options &opt)
     else if (opt.mpipartfac>1){
         LOG_RANK0(warning) << "MPI Particle allocation factor is high (>1)";
     }
+    if (opt.mpireadsendsinflight<1){
+        LOG_RANK0(warning) << "Number of particle buffers in flight from read tasks < 1. Setting to 1";
+        opt.mpireadsendsinflight = 1;
+    }
     if (opt.mpinprocswritesize<1){
 #ifdef USEPARALLELHDF
         LOG_RANK0(warning) << "Number of MPI task writing collectively < 1. Setting to 1";
@@ -2034,7 +2076,30 @@ void ConfigCheck(Options &opt)
         opt.mpinprocswritesize = NProcs;
 #endif
     }
+    //the writers call MPI (write communicators, collective reductions) and MPI is only initialised with
+    //MPI_THREAD_FUNNELED, so only the main thread may call it, even when running on a single process
+    if (opt.iasyncoutput){
+        LOG_RANK0(warning) << "Asynchronous output is not available when compiled with MPI. Writing synchronously";
+        opt.iasyncoutput = 0;
+    }
+    if (opt.impisinglepassload && (opt.inputtype!=IOHDF || !opt.impiusemesh)){
+        LOG_RANK0(warning) << "Single pass loading requires HDF input and the z-curve mesh decomposition. Counting particles before reading";
+        opt.impisinglepassload = false;
+    }
+    if (opt.mpimeshcurve!=MPIMESHCURVEMORTON && opt.mpimeshcurve!=MPIMESHCURVEHILBERT){
+        ConfigExit("Invalid MPI mesh curve type, must be 0 (Morton) or 1 (Hilbert)");
+    }
+    if (opt.mpimeshweighting<MPIMESHWEIGHTNUMPARTS || opt.mpimeshweighting>MPIMESHWEIGHTMEASURED){
+        ConfigExit("Invalid MPI mesh cost weighting, must be 0, 1 or 2");
+    }
+    if (opt.mpimeshweighting==MPIMESHWEIGHTMEASURED && opt.mpimeshcostfile.empty()){
+        LOG_RANK0(warning) << "Measured MPI mesh costs requested but no MPI_mesh_cost_file given. Weighting cells by density instead";
+        opt.mpimeshweighting = MPIMESHWEIGHTDENSITY;
+    }
 #endif
+    if (opt.asyncoutputbufsize<0){
+        ConfigExit("Invalid asynchronous output buffer size, must be >=0");
+    }
 
 #ifdef USEOPENMP
     if (opt.iopenmpfof == 1 && opt.openmpfofsize < ompfofsearchnum){
@@ -2174,6 +2239,15 @@ void ConfigCheck(Options &opt)
             ConfigExit("In approximate potential but using invalid method for sampling particles. Use 0 for Tree and 1 for Rand. Check config.");
         }
     }
+    if (opt.uinfo.TreeThetaOpen <= 0 || opt.uinfo.TreeThetaOpen >= 1) {
+        ConfigExit("Tree potential opening angle must be in (0,1). Check config.");
+    }
+    if (opt.uinfo.TreeWalkMethod < POTTREEMETHODPARTICLE || opt.uinfo.TreeWalkMethod > POTTREEMETHODGROUP) {
+        ConfigExit("Invalid tree potential walk method. Use 0 for per particle walks and 1 for group walks. Check config.");
+    }
+    if (opt.uinfo.TreeGroupSize < opt.uinfo.BucketSize) {
+        ConfigExit("Tree potential group size must be at least the tree bucket size. Check config.");
+    }
 
     set<string> uniqueval;
     set<string> outputset;
@@ -2367,6 +2441,7 @@ ConfigInfo::ConfigInfo(Options &opt){
 
     //local field parameters
     AddEntry("Local_velocity_density_approximate_calculation", opt.iLocalVelDenApproxCalcFlag);
+    AddEntry("Local_velocity_density_batched_search", opt.iLocalVelDenBatchedSearch);
     AddEntry("Cell_fraction", opt.Ncellfac);
     AddEntry("Grid_type", opt.gridtype);
     AddEntry("Nsearch_velocity", opt.Nvel);
@@ -2477,6 +2552,10 @@ ConfigInfo::ConfigInfo(Options &opt){
     AddEntry("Approximate_potential_calculation_particle_number_fraction", opt.uinfo.approxpotnumfrac);
     AddEntry("Approximate_potential_calculation_min_particle", opt.uinfo.approxpotminnum);
     AddEntry("Approximate_potential_calculation_method", opt.uinfo.approxpotmethod);
+    AddEntry("Tree_potential_opening_angle", opt.uinfo.TreeThetaOpen);
+    AddEntry("Tree_potential_walk_method", opt.uinfo.TreeWalkMethod);
+    AddEntry("Tree_potential_group_size", opt.uinfo.TreeGroupSize);
+    AddEntry("Unbinding_incremental_potential_update", opt.uinfo.iincrementalpot);
 
     //property related
     AddEntry("Inclusive_halo_masses", opt.iInclusiveHalo);
@@ -2635,6 +2714,9 @@ ConfigInfo::ConfigInfo(Options &opt){
     AddEntry("MPI_particle_total_buf_size",opt.mpiparticletotbufsize);
     AddEntry("Separate_output_files", opt.iseparatefiles);
     AddEntry("Binary_output", opt.ibinaryout);
+    AddEntry("Property_output_column_store", opt.ipropertycolumnstore);
+    AddEntry("Asynchronous_output", opt.iasyncoutput);
+    AddEntry("Asynchronous_output_buffer_size", opt.asyncoutputbufsize);
     AddEntry("Comoving_units", opt.icomoveunit);
     AddEntry("Extended_output", opt.iextendedoutput);
 
@@ -2655,6 +2737,11 @@ ConfigInfo::ConfigInfo(Options &opt){
 
     //mpi related configuration
     AddEntry("MPI_part_allocation_fac", opt.mpipartfac);
+    AddEntry("MPI_read_sends_in_flight", opt.mpireadsendsinflight);
+    AddEntry("MPI_single_pass_load", opt.impisinglepassload);
+    AddEntry("MPI_mesh_curve_type", opt.mpimeshcurve);
+    AddEntry("MPI_mesh_cost_weighting", opt.mpimeshweighting);
+    AddEntry("MPI_mesh_cost_file", opt.mpimeshcostfile);
 #endif
     AddEntry("#Compilation Info");
 #ifdef USEMPI
@@ -5,6 +5,8 @@
     \todo Need to clean up unbind proceedure, ensure its mpi compatible and can be combined with a pglist output easily
  */
 
+#include <cassert>
+
 #include "logging.h"
 #include "stf.h"
 #include "timer.h"
@@ -22,6 +24,15 @@ void GetNodeList(Node *np, Int_t &ncell, Node **nodelist, const Int_t bsize){
     //else ncell++;
 }
 
+///subroutine that generates the list of sink cells used in group tree walks, that is the largest cells containing at most gsize particles
+void GetSinkNodeList(Node *np, Int_t &nsink, Node **sinklist, const Int_t bsize, const Int_t gsize){
+    if (np->GetCount()<=gsize || np->GetCount()<=bsize) sinklist[nsink++]=np;
+    else {
+        GetSinkNodeList(((SplitNode*)np)->GetLeft(),nsink,sinklist,bsize,gsize);
+        GetSinkNodeList(((SplitNode*)np)->GetRight(),nsink,sinklist,bsize,gsize);
+    }
+}
+
 ///subroutine that marks a cell for a given particle in tree-walk
 inline void MarkCell(Node *np, Int_t *marktreecell, Int_t *markleafcell, Int_t &ntreecell, Int_t &nleafcell, Double_t *r2val, const Int_t bsize, Double_t *cR2max, Coordinate *cm, Double_t *cmtot, const Coordinate &xpos, Double_t eps2){
     Int_t nid=np->GetID();
@@ -45,6 +56,85 @@ inline void MarkCell(Node *np, Int_t *marktreecell, Int_t *markleafcell, Int_t &
     }
 }
 
+/*! subroutine that marks cells for a group of particles (the sink cell) in a tree-walk.
+    A cell is only used as a multipole if the closest possible particle in the sink, given by the distance between
+    the cms less the maximum extent of the sink, satisfies the opening criterion and the cell does not contain the sink.
+    Otherwise it is opened and if it is a leaf node, the cell is marked for direct summation.
+*/
+inline void MarkCellGroup(Node *np, Int_t *marktreecell, Int_t *markleafcell, Int_t &ntreecell, Int_t &nleafcell, const Int_t bsize, Double_t *cR2max, Coordinate *cm,
+    const Coordinate &sinkcm, const Double_t sinkrmax, const Int_t sinkstart, const Int_t sinkend)
+{
+    Int_t nid=np->GetID();
+    Double_t r2=0, rmin;
+    for (int k=0;k<3;k++)r2+=(cm[nid][k]-sinkcm[k])*(cm[nid][k]-sinkcm[k]);
+    rmin=sqrt(r2)-sinkrmax;
+    if (rmin>0 && rmin*rmin>=cR2max[nid] && (np->GetStart()>=sinkend || np->GetEnd()<=sinkstart)) {
+        marktreecell[ntreecell++]=nid;
+    }
+    else if (np->GetCount()>bsize) {
+        MarkCellGroup(((SplitNode*)np)->GetLeft(),marktreecell,markleafcell,ntreecell,nleafcell,bsize,cR2max,cm,sinkcm,sinkrmax,sinkstart,sinkend);
+        MarkCellGroup(((SplitNode*)np)->GetRight(),marktreecell,markleafcell,ntreecell,nleafcell,bsize,cR2max,cm,sinkcm,sinkrmax,sinkstart,sinkend);
+    }
+    else markleafcell[nleafcell++]=nid;
+}
+
+///\name Direct summation kernels
+//@{
+///sum of m/sqrt(r^2+eps^2) of the packed particles [jstart,jend) at position (xi,yi,zi). Written so that it is vectorised (AVX2/AVX-512 depending on compilation flags), also without OpenMP through -fopenmp-simd
+inline Double_t PotentialPPKernel(const Double_t xi, const Double_t yi, const Double_t zi,
+    const Double_t *x, const Double_t *y, const Double_t *z, const Double_t *m,
+    const Int_t jstart, const Int_t jend, const Double_t eps2)
+{
+    Double_t sum=0;
+#pragma omp simd reduction(+:sum)
+    for (Int_t j=jstart;j<jend;j++) {
+        Double_t dx=x[j]-xi, dy=y[j]-yi, dz=z[j]-zi;
+        sum+=m[j]/sqrt(dx*dx+dy*dy+dz*dz+eps2);
+    }
+    return sum;
+}
+
+///sum of m/sqrt(r^2+eps^2) of the packed particles [jstart,jend) at the position of packed particle i, excluding i itself
+inline Double_t PotentialPPKernel(const PackedParticleData &pdata, const Int_t i,
+    const Int_t jstart, const Int_t jend, const Double_t eps2)
+{
+    const Double_t *x=pdata.x.data(), *y=pdata.y.data(), *z=pdata.z.data(), *m=pdata.mass.data();
+    if (i<jstart || i>=jend) return PotentialPPKernel(x[i], y[i], z[i], x, y, z, m, jstart, jend, eps2);
+    return PotentialPPKernel(x[i], y[i], z[i], x, y, z, m, jstart, i, eps2)
+        +PotentialPPKernel(x[i], y[i], z[i], x, y, z, m, i+1, jend, eps2);
+}
+
+///symmetric form of the kernel for all pairs of a group: returns the sum of m/sqrt(r^2+eps^2) of the packed particles (i,jend)
+///at the position of particle i and adds the contribution of i to the sums pot of those particles, so every pair is visited once
+inline Double_t PotentialPPSymmetricKernel(const PackedParticleData &pdata, const Int_t i, const Int_t jend,
+    const Double_t eps2, Double_t *pot)
+{
+    const Double_t *x=pdata.x.data(), *y=pdata.y.data(), *z=pdata.z.data(), *m=pdata.mass.data();
+    const Double_t xi=x[i], yi=y[i], zi=z[i], mi=m[i];
+    Double_t sum=0;
+#pragma omp simd reduction(+:sum)
+    for (Int_t j=i+1;j<jend;j++) {
+        Double_t dx=x[j]-xi, dy=y[j]-yi, dz=z[j]-zi;
+        Double_t rinv=1.0/sqrt(dx*dx+dy*dy+dz*dz+eps2);
+        sum+=m[j]*rinv;
+        pot[j]+=mi*rinv;
+    }
+    return sum;
+}
+//@}
+
+///potential at offset dx from the cm of a cell of mass mtot with traceless quadrupole moment quad, not including G and the particle mass
+inline Double_t CellQuadrupolePotential(const Double_t dx[3], const Double_t mtot, const Double_t *quad, const Double_t eps2)
+{
+    Double_t r2, rinv, rinv2, qdd;
+    r2=dx[0]*dx[0]+dx[1]*dx[1]+dx[2]*dx[2]+eps2;
+    rinv=1.0/sqrt(r2);
+    rinv2=rinv*rinv;
+    qdd=quad[0]*dx[0]*dx[0]+quad[1]*dx[1]*dx[1]+quad[2]*dx[2]*dx[2]
+        +2.0*(quad[3]*dx[0]*dx[1]+quad[4]*dx[0]*dx[2]+quad[5]*dx[1]*dx[2]);
+    return -(mtot*rinv+0.5*qdd*rinv2*rinv2*rinv);
+}
+
 //@}
 
 //@{
@@ -137,7 +227,7 @@ inline void UpdateCMForUnboundParticles(Options &opt,
 }
 
 /// Update the potential if necessary for small groups
-inline void UpdatePotentialForUnboundParticlesPP(Options &opt,
+void UpdatePotentialForUnboundParticlesPP(Options &opt,
     Int_t &nig, Particle *groupPart,
     Int_t &nEplus, Int_t *&nEplusid, int *&Eplusflag)
 {
@@ -204,6 +294,117 @@ private(r2,poti)
     }
 }
 
+///add the moments of tree particle t to (or, if sign=-1, remove them from) the removed moments of all cells containing it
+inline void AccumulateRemovedMoments(IncrementalPotentialTree &ptree, const Int_t t, const Double_t sign)
+{
+    Int_t nid=0;
+    Double_t m=sign*ptree.pdata.mass[t], s[3];
+    while (nid!=-1) {
+        s[0]=ptree.pdata.x[t]-ptree.cellref[nid][0];
+        s[1]=ptree.pdata.y[t]-ptree.cellref[nid][1];
+        s[2]=ptree.pdata.z[t]-ptree.cellref[nid][2];
+        ptree.dmass[nid]+=m;
+        for (auto n=0;n<3;n++) ptree.ddipole[3*nid+n]+=m*s[n];
+        ptree.dsecond[NQUADCOMP*nid+0]+=m*s[0]*s[0];
+        ptree.dsecond[NQUADCOMP*nid+1]+=m*s[1]*s[1];
+        ptree.dsecond[NQUADCOMP*nid+2]+=m*s[2]*s[2];
+        ptree.dsecond[NQUADCOMP*nid+3]+=m*s[0]*s[1];
+        ptree.dsecond[NQUADCOMP*nid+4]+=m*s[0]*s[2];
+        ptree.dsecond[NQUADCOMP*nid+5]+=m*s[1]*s[2];
+        if (ptree.left[nid]==-1) break;
+        if (t<ptree.end[ptree.left[nid]]) nid=ptree.left[nid];
+        else nid=ptree.right[nid];
+    }
+}
+
+///reset the removed moments of all cells containing tree particle t
+inline void ResetRemovedMoments(IncrementalPotentialTree &ptree, const Int_t t)
+{
+    Int_t nid=0;
+    while (nid!=-1) {
+        ptree.dmass[nid]=0;
+        for (auto n=0;n<3;n++) ptree.ddipole[3*nid+n]=0;
+        for (auto n=0;n<NQUADCOMP;n++) ptree.dsecond[NQUADCOMP*nid+n]=0;
+        if (ptree.left[nid]==-1) break;
+        if (t<ptree.end[ptree.left[nid]]) nid=ptree.left[nid];
+        else nid=ptree.right[nid];
+    }
+}
+
+/*! sum of m/sqrt(r^2+eps^2) at position x of the particles removed in the current iteration, excluding tree particle self.
+    Cells without removed particles are skipped and distant cells are treated using the monopole, dipole and quadrupole
+    of the removed particles about the cell reference point.
+*/
+Double_t RemovedParticlesPotential(const IncrementalPotentialTree &ptree, const Int_t nid, const Double_t x[3], const Int_t self, const Double_t eps2)
+{
+    if (ptree.dmass[nid]==0) return 0;
+    Double_t d[3], r2;
+    for (auto n=0;n<3;n++) d[n]=x[n]-ptree.cellref[nid][n];
+    r2=d[0]*d[0]+d[1]*d[1]+d[2]*d[2];
+    if (r2>=ptree.cR2max[nid]) {
+        const Double_t *dip=&ptree.ddipole[3*nid], *sec=&ptree.dsecond[NQUADCOMP*nid];
+        Double_t rinv, rinv2, dd, trace, qdd;
+        rinv=1.0/sqrt(r2+eps2);
+        rinv2=rinv*rinv;
+        dd=dip[0]*d[0]+dip[1]*d[1]+dip[2]*d[2];
+        //quadrupole Q_ij = 3 S_ij - delta_ij tr(S) from the second moments S about the reference point
+        trace=sec[0]+sec[1]+sec[2];
+        qdd=3.0*(sec[0]*d[0]*d[0]+sec[1]*d[1]*d[1]+sec[2]*d[2]*d[2]
+            +2.0*(sec[3]*d[0]*d[1]+sec[4]*d[0]*d[2]+sec[5]*d[1]*d[2]))-trace*r2;
+        return ptree.dmass[nid]*rinv+dd*rinv2*rinv+0.5*qdd*rinv2*rinv2*rinv;
+    }
+    if (ptree.left[nid]!=-1) {
+        return RemovedParticlesPotential(ptree, ptree.left[nid], x, self, eps2)
+            +RemovedParticlesPotential(ptree, ptree.right[nid], x, self, eps2);
+    }
+    Double_t sum=0;
+    for (auto t=ptree.start[nid];t<ptree.end[nid];t++) {
+        if (ptree.removed[t]!=1 || t==self) continue;
+        r2=eps2;
+        r2+=(x[0]-ptree.pdata.x[t])*(x[0]-ptree.pdata.x[t]);
+        r2+=(x[1]-ptree.pdata.y[t])*(x[1]-ptree.pdata.y[t]);
+        r2+=(x[2]-ptree.pdata.z[t])*(x[2]-ptree.pdata.z[t]);
+        sum+=ptree.pdata.mass[t]/sqrt(r2);
+    }
+    return sum;
+}
+
+/// Update the potential of large groups using a tree that persists across unbinding iterations
+void UpdatePotentialForUnboundParticlesTree(Options &opt,
+    Int_t &nig, Particle *groupPart,
+    Int_t &nEplus, Int_t *&nEplusid, IncrementalPotentialTree &ptree)
+{
+    Double_t eps2=opt.uinfo.eps*opt.uinfo.eps, mv2=opt.MassValue*opt.MassValue;
+    vector<Int_t> tremoved(nEplus);
+    if (opt.uinfo.bgpot!=0) return;
+    //accumulate the removed particles in the cells they belong to
+    for (auto k=0;k<nEplus;k++) {
+        tremoved[k]=ptree.pidindex[groupPart[nEplusid[k]].GetPID()];
+        ptree.removed[tremoved[k]]=1;
+        AccumulateRemovedMoments(ptree, tremoved[k], 1.0);
+    }
+    //and subtract their contribution from the remaining particles
+#ifdef USEOPENMP
+#pragma omp parallel for default(shared) schedule(dynamic,64) if (nig>POTOMPCALCNUM)
+#endif
+    for (auto j=0;j<nig;j++) {
+        Double_t x[3], poti;
+        Int_t t=ptree.pidindex.at(groupPart[j].GetPID());
+        if (ptree.removed[t]==1) continue;
+        for (auto n=0;n<3;n++) x[n]=groupPart[j].GetPosition(n);
+        poti=opt.G*groupPart[j].GetMass()*RemovedParticlesPotential(ptree, 0, x, t, eps2);
+#ifdef NOMASS
+        poti*=mv2;
+#endif
+        groupPart[j].SetPotential(groupPart[j].GetPotential()+poti);
+    }
+    //removed particles are no longer part of the tree
+    for (auto k=0;k<nEplus;k++) {
+        ResetRemovedMoments(ptree, tremoved[k]);
+        ptree.removed[tremoved[k]]=2;
+    }
+}
+
 inline void RemoveGroup(Options &opt, Int_t &ning, Int_t *&pfof, Particle *&groupPart, int &iunbindflag)
 {
     //if group too small remove entirely
@@ -272,7 +473,7 @@ inline void GetBoundFractionAndMaxE(Options &opt,
     This arrays may have been constructed prior to the unbinding call and so can be passed to the routine
     if this is called it uses Particle array then deletes it.
 */
-int CheckUnboundGroups(Options opt, const Int_t nbodies, Particle *Part, Int_t &ngroup, Int_t *&pfof, Int_t *numingroup, Int_t **pglist, int ireorder, Int_t *groupflag)
+int CheckUnboundGroups(Options &opt, const Int_t nbodies, Particle *Part, Int_t &ngroup, Int_t *&pfof, Int_t *numingroup, Int_t **pglist, int ireorder, Int_t *groupflag)
 {
     bool ningflag=false, pglistflag=false;
     int iflag;
@@ -299,7 +500,7 @@ int CheckUnboundGroups(Options opt, const Int_t nbodies, Particle *Part, Int_t &
     Int_t *noffset=new Int_t[ngroup+1];
     Double_t *storeden=new Double_t[nbodies];
     for (Int_t i=0;i<nbodies;i++) {storeval1[i]=Part[i].GetPID();storeval2[i]=Part[i].GetID();storeden[i]=Part[i].GetDensity();Part[i].SetPID(i);Part[i].SetID(pfof[i]+nbodies*(pfof[i]==0));}
-    qsort(Part,nbodies,sizeof(Particle),IDCompare);
+    SortParticles(nbodies, Part, PSORTID);
     noffset[0]=noffset[1]=0;
     for (Int_t i=2;i<=ngroup;i++) noffset[i]=noffset[i-1]+numingroup[i-1];
 #else
@@ -321,7 +522,7 @@ int CheckUnboundGroups(Options opt, const Int_t nbodies, Particle *Part, Int_t &
         if (ireorder) ReorderGroupIDsAndArraybyValue(const Int_t numgroups, const Int_t newnumgroups, Int_t *numingroup, Int_t *pfof, Int_t **pglist, Int_t *value, Int_t *gdata)
     }
     //reset order
-    qsort(Part,nbodies,sizeof(Particle),PIDCompare);
+    SortParticles(nbodies, Part, PSORTPID);
     for (Int_t i=0;i<nbodies;i++) {Part[i].SetPID(storeval1[i]);Part[i].SetID(storeval2[i]);Part[i].SetDensity(storeden[i]);}
     //and alter pglist
     for (Int_t i=0;i<=ng;i++) numingroup[i]=0;
@@ -382,113 +583,195 @@ int CheckUnboundGroups(Options opt, const Int_t nbodies, Particle *Part, Int_t &
     return iflag;
 }
 
-///Calculate potential of groups
-inline void CalculatePotentials(Options &opt, Particle **gPart, Int_t &numgroups, Int_t *numingroup)
+///estimated relative cost of calculating the potential of a group, direct summation for small groups and a tree for larger groups
+inline double PotentialCostEstimate(Int_t ning)
 {
-    int maxnthreads,nthreads=1;
-
-#ifndef USEMPI
-    int ThisTask=0,NProcs=1;
-#endif
+    if (ning<=POTPPCALCNUM) return (double)ning*(double)ning;
+    //tree walk cost per particle, normalised so that the estimate is roughly continuous at POTPPCALCNUM
+    return 20.0*(double)ning*log2((double)ning);
+}
 
-    if (!opt.uinfo.icalculatepotential) return;
+///estimated relative cost of unbinding a group, dominated by the repeated energy sorts and potential updates
+inline double UnbindCostEstimate(Int_t ning)
+{
+    return (double)ning*log2((double)ning+1.0);
+}
 
-    //for parallel environment store maximum number of threads
-    nthreads=1;
+/*! Runs work(i) for all groups with numingroup[i]>0 in order of decreasing estimated cost.
+    Groups whose cost exceeds the average cost per thread cannot be balanced and are processed one at a time so that
+    they use all threads internally. The remaining groups are processed as OpenMP tasks drawn from a single pool, so
+    a thread that finishes a group picks up the most expensive group still waiting.
+    The utilisation of each thread while the pool runs is reported.
+*/
+template<typename F> void RunGroupsByCost(const string &name, Int_t numgroups, Int_t *numingroup, double (*costestimate)(Int_t), F work)
+{
+    int nthreads=1;
+    double totcost=0, maxcost;
+    vector<Int_t> order;
+    vector<double> cost(numgroups+1,0);
 #ifdef USEOPENMP
-#pragma omp parallel
-    {
-    if (omp_get_thread_num()==0) maxnthreads=nthreads=omp_get_num_threads();
-    }
+    nthreads=omp_get_max_threads();
 #endif
+    order.reserve(numgroups);
+    for (auto i=1;i<=numgroups;i++) {
+        if (numingroup[i]<=0) continue;
+        cost[i]=costestimate(numingroup[i]);
+        totcost+=cost[i];
+        order.push_back(i);
+    }
+    if (order.size()==0) return;
+    sort(order.begin(), order.end(), [&cost](const Int_t &a, const Int_t &b){return cost[a]>cost[b];});
 
-    //for each group calculate potential
-    //if group is small calculate potentials using PP
-    //here openmp is over groups since each group is small
+    //groups too expensive to balance across threads
+    maxcost=totcost/(double)nthreads;
+    Int_t nheavy=0;
+    while (nthreads>1 && nheavy<(Int_t)order.size() && cost[order[nheavy]]>maxcost) work(order[nheavy++]);
+    if (nthreads==1) nheavy=0;
+
+    //remaining groups are processed in a task pool
+    vr::Timer timer;
+    vector<double> busy(nthreads,0);
 #ifdef USEOPENMP
 #pragma omp parallel default(shared)
 {
-    #pragma omp for schedule(dynamic,1) nowait
+    #pragma omp single nowait
+    {
 #endif
-    for (auto i=1;i<=numgroups;i++)
+    for (auto k=nheavy;k<(Int_t)order.size();k++)
     {
-        if (numingroup[i]<=POTPPCALCNUM) {
-            if (numingroup[i]<0) continue;
-            PotentialPP(opt, numingroup[i], gPart[i]);
+        Int_t igroup=order[k];
+#ifdef USEOPENMP
+        #pragma omp task default(shared) firstprivate(igroup)
+#endif
+        {
+            int tid=0;
+#ifdef USEOPENMP
+            tid=omp_get_thread_num();
+#endif
+            vr::Timer tasktimer;
+            work(igroup);
+            busy[tid]+=tasktimer.get();
         }
     }
 #ifdef USEOPENMP
+    }
 }
 #endif
-    //reset number of threads to maximum number
-#ifdef USEOPENMP
-#pragma omp master
-    {
-        omp_set_num_threads(maxnthreads);
+    if (nthreads==1 || order.size()==(size_t)nheavy) return;
+    double wall=max((double)timer.get(),1.0), minutil=1.0, maxutil=0, meanutil=0, util;
+    for (auto tid=0;tid<nthreads;tid++) {
+        util=busy[tid]/wall;
+        minutil=min(minutil,util);
+        maxutil=max(maxutil,util);
+        meanutil+=util/(double)nthreads;
+        LOG(trace) << name << " thread " << tid << " utilisation " << util;
     }
-    nthreads=maxnthreads;
-#endif
-    for (auto i=1;i<=numgroups;i++)
+    LOG(debug) << name << ": " << nheavy << " groups processed individually, " << order.size()-nheavy
+               << " groups in task pool over " << nthreads << " threads in " << timer
+               << ", thread utilisation min/mean/max " << minutil << "/" << meanutil << "/" << maxutil;
+}
+
+///Iteratively unbind a single group, returning the number of times the group was altered.
+///Large groups update the potential using a tree, small groups using direct summation.
+inline int UnbindGroup(Options &opt, Int_t igroup, Int_t *pfof, Int_t &ning, Int_t *&pglist, Particle *&groupPart,
+    Double_t &gmass, Coordinate &cmvel)
+{
+    int iunbindflag=0, unbindloops=0;
+    Int_t oldnumingroup=ning, nEplus, maxunbindsize, nunbound;
+    Int_t *nEplusid;
+    int *Eplusflag;
+    Double_t maxE, Efrac;
+    bool unbindcheck, sortflag;
+    bool ilarge=(ning>=ompunbindnum);
+    //tree kept across unbinding iterations if potential is updated incrementally
+    IncrementalPotentialTree *ptree=NULL;
+
+    GetBoundFractionAndMaxE(opt, ning, groupPart, cmvel, Efrac, maxE, nunbound);
+    //if amount unbound is very large, just remove group entirely
+    if (nunbound>=opt.uinfo.maxunboundfracforiterativeunbind*ning) {
+        for (auto j=0;j<ning;j++) pfof[pglist[j]]=0;
+        ning=0;
+        return 1;
+    }
+    //determine if any particle  number of particle with positive energy upto opt.uinfo.maxunbindfrac*numingroup+1
+    maxunbindsize=(Int_t)(opt.uinfo.maxunbindfrac*nunbound+1);
+    nEplusid=new Int_t[ning];
+    Eplusflag=new int[ning];
+    //check if bound;
+    unbindcheck = CheckGroupForBoundness(opt,Efrac,maxE,ning);
+    FillUnboundArrays(opt, maxunbindsize, ning, groupPart, Efrac, nEplusid, Eplusflag, nEplus, unbindcheck);
+    while(unbindcheck)
     {
-        if (numingroup[i]<0) continue;
-        if (numingroup[i]>POTPPCALCNUM) {
-            Potential(opt, numingroup[i], gPart[i]);
+        iunbindflag++;
+        unbindloops++;
+        UpdateCMForUnboundParticles(opt, gmass, cmvel,
+            ning, groupPart, nEplus, nEplusid, Eplusflag);
+        if (!ilarge) {
+            UpdatePotentialForUnboundParticlesPP(opt, ning, groupPart,
+                nEplus, nEplusid, Eplusflag);
+        }
+        else if (opt.uinfo.iincrementalpot && opt.uinfo.bgpot==0) {
+            if (ptree==NULL) {
+                ptree=new IncrementalPotentialTree;
+                BuildIncrementalPotentialTree(opt, ning, groupPart, *ptree);
+            }
+            UpdatePotentialForUnboundParticlesTree(opt, ning, groupPart,
+                nEplus, nEplusid, *ptree);
+        }
+        else UpdatePotentialForUnboundParticles(opt, ning, groupPart,
+            nEplus, nEplusid, Eplusflag);
+        //remove particles with positive energy
+        RemoveUnboundParticles(igroup, pfof, ning, pglist, groupPart, nEplus, nEplusid, Eplusflag);
+        //if number of particles remove with positive energy is near to the number allowed to be removed
+        //must recalculate kinetic energies and check if maxE>0
+        //otherwise, end unbinding.
+        if (nEplus<opt.uinfo.maxallowedunboundfrac*ning) {
+            unbindcheck=false;
+        }
+        else {
+            sortflag=false;
+            if ((oldnumingroup-ning)>opt.uinfo.maxallowedunboundfrac*oldnumingroup) {
+                oldnumingroup=ning;
+                sortflag=true;
+            }
+            //recalculate kinetic energies since cmvel has changed
+            GetBoundFractionAndMaxE(opt, ning, groupPart, cmvel, Efrac, maxE, nunbound, sortflag);
+            maxunbindsize=(Int_t)(opt.uinfo.maxunbindfrac*nunbound+1);
+            unbindcheck = CheckGroupForBoundness(opt,Efrac,maxE,ning);
+            FillUnboundArrays(opt, maxunbindsize, ning, groupPart, Efrac, nEplusid, Eplusflag, nEplus, unbindcheck);
         }
     }
+    //if group too small remove entirely
+    AdjustPGListForUnbinding(unbindloops,ning,pglist,groupPart);
+    RemoveGroup(opt, ning, pfof, groupPart, iunbindflag);
+    delete[] nEplusid;
+    delete[] Eplusflag;
+    if (ptree!=NULL) delete ptree;
+    return iunbindflag;
+}
+
+///Calculate potential of groups
+inline void CalculatePotentials(Options &opt, Particle **gPart, Int_t &numgroups, Int_t *numingroup)
+{
+    if (!opt.uinfo.icalculatepotential) return;
+    //small groups use PP and large groups a tree, all are scheduled by cost
+    RunGroupsByCost("CalculatePotentials", numgroups, numingroup, PotentialCostEstimate,
+        [&](Int_t i) {
+            if (numingroup[i]<=POTPPCALCNUM) PotentialPP(opt, numingroup[i], gPart[i]);
+            else Potential(opt, numingroup[i], gPart[i]);
+        });
 }
 
 ///Calculate potential of groups, assumes particle list is ordered by group
 ///and accessed by numingroup and noffset;
 inline void CalculatePotentials(Options &opt, Particle *gPart, Int_t &numgroups, Int_t *numingroup, Int_t *noffset)
 {
-    int maxnthreads,nthreads=1;
-#ifndef USEMPI
-    int ThisTask=0,NProcs=1;
-#endif
     if (!opt.uinfo.icalculatepotential) return;
-
-    //for parallel environment store maximum number of threads
-    nthreads=1;
-#ifdef USEOPENMP
-#pragma omp parallel
-    {
-    if (omp_get_thread_num()==0) maxnthreads=nthreads=omp_get_num_threads();
-    }
-#endif
-
-    //for each group calculate potential
-    //if group is small calculate potentials using PP
-    //here openmp is over groups since each group is small
-#ifdef USEOPENMP
-#pragma omp parallel default(shared)
-{
-    #pragma omp for schedule(dynamic,1) nowait
-#endif
-    for (auto i=1;i<=numgroups;i++)
-    {
-        if (numingroup[i]<=POTPPCALCNUM) {
-            if (numingroup[i]<0) continue;
-            PotentialPP(opt, numingroup[i], &gPart[noffset[i]]);
-        }
-    }
-#ifdef USEOPENMP
-}
-#endif
-    //reset number of threads to maximum number
-#ifdef USEOPENMP
-#pragma omp master
-    {
-        omp_set_num_threads(maxnthreads);
-    }
-    nthreads=maxnthreads;
-#endif
-    for (auto i=1;i<=numgroups;i++)
-    {
-        if (numingroup[i]<0) continue;
-        if (numingroup[i]>POTPPCALCNUM) {
-            Potential(opt, numingroup[i], &gPart[noffset[i]]);
-        }
-    }
+    RunGroupsByCost("CalculatePotentials", numgroups, numingroup, PotentialCostEstimate,
+        [&](Int_t i) {
+            if (numingroup[i]<=POTPPCALCNUM) PotentialPP(opt, numingroup[i], &gPart[noffset[i]]);
+            else Potential(opt, numingroup[i], &gPart[noffset[i]]);
+        });
 }
 
 ///loop over groups and get velocity frame
@@ -546,7 +829,7 @@ private(npot,menc,potpos,storeval)
                     gPart[i][j].SetID(j);
                 }
                 //sort by radius
-                gsl_heapsort(gPart[i],numingroup[i],sizeof(Particle),RadCompare);
+                SortParticles(numingroup[i], gPart[i], PSORTRADIUS);
                 //use central regions to define centre of mass velocity
                 //determine how many particles to use
                 npot=max(opt.uinfo.Npotref,Int_t(opt.uinfo.fracpotref*numingroup[i]));
@@ -557,7 +840,7 @@ private(npot,menc,potpos,storeval)
                     menc+=gPart[i][j].GetMass();
                 }
                 for (auto j=0;j<3;j++) {cmvel[i][j]/=menc;}
-                gsl_heapsort(gPart[i],numingroup[i],sizeof(Particle),IDCompare);
+                SortParticles(numingroup[i], gPart[i], PSORTID);
                 for (auto j=0;j<numingroup[i];j++) {
                     gPart[i][j].SetID(storeval[j]);
                     for (auto k=0;k<3;k++) gPart[i][j].SetPosition(k,gPart[i][j].GetPosition(k)+potpos[k]);
@@ -593,7 +876,7 @@ private(npot,menc,potmin,ipotmin,potpos,storeval)
                 for (auto j=0;j<numingroup[i];j++) {
                     for (auto k=0;k<3;k++) gPart[i][j].SetPosition(k,gPart[i][j].GetPosition(k)-potpos[k]);
                 }
-                gsl_heapsort(gPart[i],numingroup[i],sizeof(Particle),RadCompare);
+                SortParticles(numingroup[i], gPart[i], PSORTRADIUS);
                 //now determine kinetic frame
                 cmvel[i][0]=cmvel[i][1]=cmvel[i][2]=menc=0.;
                 for (auto j=0;j<npot;j++) {
@@ -601,7 +884,7 @@ private(npot,menc,potmin,ipotmin,potpos,storeval)
                     menc+=gPart[i][j].GetMass();
                 }
                 for (auto j=0;j<3;j++) {cmvel[i][j]/=menc;}
-                gsl_heapsort(gPart[i],numingroup[i],sizeof(Particle),IDCompare);
+                SortParticles(numingroup[i], gPart[i], PSORTID);
                 for (auto j=0;j<numingroup[i];j++) gPart[i][j].SetID(storeval[j]);
                 delete[] storeval;
             }
@@ -666,7 +949,7 @@ private(npot,menc,potpos,storeval)
                     gPart[noffset[i]+j].SetID(j);
                 }
                 //sort by radius
-                gsl_heapsort(&gPart[noffset[i]],numingroup[i],sizeof(Particle),RadCompare);
+                SortParticles(numingroup[i], &gPart[noffset[i]], PSORTRADIUS);
                 //use central regions to define centre of mass velocity
                 //determine how many particles to use
                 npot=max(opt.uinfo.Npotref,Int_t(opt.uinfo.fracpotref*numingroup[i]));
@@ -677,7 +960,7 @@ private(npot,menc,potpos,storeval)
                     menc+=gPart[noffset[i]+j].GetMass();
                 }
                 for (auto j=0;j<3;j++) {cmvel[i][j]/=menc;}
-                gsl_heapsort(&gPart[noffset[i]],numingroup[i],sizeof(Particle),IDCompare);
+                SortParticles(numingroup[i], &gPart[noffset[i]], PSORTID);
                 for (auto j=0;j<numingroup[i];j++) {
                     gPart[noffset[i]+j].SetID(storeval[j]);
                     for (auto k=0;k<3;k++) gPart[noffset[i]+j].SetPosition(k,gPart[noffset[i]+j].GetPosition(k)+potpos[k]);
@@ -713,7 +996,7 @@ private(npot,menc,potmin,ipotmin,potpos,storeval)
                 for (auto j=0;j<numingroup[i];j++) {
                     for (auto k=0;k<3;k++) gPart[noffset[i]+j].SetPosition(k,gPart[noffset[i]+j].GetPosition(k)-potpos[k]);
                 }
-                gsl_heapsort(&gPart[noffset[i]],numingroup[i],sizeof(Particle),RadCompare);
+                SortParticles(numingroup[i], &gPart[noffset[i]], PSORTRADIUS);
                 //now determine kinetic frame
                 cmvel[i][0]=cmvel[i][1]=cmvel[i][2]=menc=0.;
                 for (auto j=0;j<npot;j++) {
@@ -721,7 +1004,7 @@ private(npot,menc,potmin,ipotmin,potpos,storeval)
                     menc+=gPart[noffset[i]+j].GetMass();
                 }
                 for (auto j=0;j<3;j++) {cmvel[i][j]/=menc;}
-                gsl_heapsort(&gPart[noffset[i]],numingroup[i],sizeof(Particle),IDCompare);
+                SortParticles(numingroup[i], &gPart[noffset[i]], PSORTID);
                 for (auto j=0;j<numingroup[i];j++) gPart[noffset[i]+j].SetID(storeval[j]);
                 delete[] storeval;
             }
@@ -754,15 +1037,7 @@ int Unbind(Options &opt, Particle **gPart, Int_t &numgroups, Int_t *numingroup,
     //if the amount of particles removed is large enough for large groups, it is more efficient to
     //recalculate the entire potential using a Tree code than it is removing the contribution of each removed particle from
     //all other particles
-    int maxnthreads,nthreads=1,l,n;
-    Int_t i,j,k,ng=numgroups, oldnumingroup;
-    int unbindloops;
-    bool sortflag;
-    Double_t maxE,v2,r2,poti,Ti,eps2=opt.uinfo.eps*opt.uinfo.eps,mv2=opt.MassValue*opt.MassValue,Efrac, pot;
-    Int_t nEplus,maxunbindsize, nEfrac, nunbound;
-    Int_t *nEplusid;
-    int *Eplusflag;
-    bool unbindcheck;
+    Int_t i,j,ng=numgroups;
 
     Double_t *gmass;
     Coordinate *cmvel;
@@ -797,128 +1072,17 @@ int Unbind(Options &opt, Particle **gPart, Int_t &numgroups, Int_t *numingroup,
     CalculateBindingReferenceFrame(opt, gPart, numgroups, numingroup, gmass, cmvel);
 
     //now go through groups and begin unbinding by finding least bound particle
-    //again for small groups multithread over groups
-    //larger groups thread over particles in a group
-    //for large groups, paralleize over particle, for small groups parallelize over groups
+    //groups are scheduled by cost, with groups too large to balance across threads
+    //threading over particles in a group and all others processed in a pool of tasks
     //here energy data is stored in density
+    RunGroupsByCost("Unbind", numgroups, numingroup, UnbindCostEstimate,
+        [&](Int_t igroup) {
+            int igroupflag=UnbindGroup(opt, igroup, pfof, numingroup[igroup], pglist[igroup], gPart[igroup], gmass[igroup], cmvel[igroup]);
 #ifdef USEOPENMP
-#pragma omp parallel default(shared)  \
-private(i,j,k,n,maxE,maxunbindsize,nEplus,nEplusid,Eplusflag,v2,Ti,unbindcheck,Efrac,nEfrac,nunbound,r2,poti,unbindloops,sortflag,oldnumingroup)
-{
-    #pragma omp for schedule(dynamic) nowait reduction(+:iunbindflag)
+            #pragma omp atomic
 #endif
-    for (i=1;i<=numgroups;i++) if (numingroup[i]<ompunbindnum && numingroup[i]>0)
-    {
-        unbindloops=0;
-        oldnumingroup = numingroup[i];
-        GetBoundFractionAndMaxE(opt, numingroup[i], gPart[i], cmvel[i], Efrac, maxE,nunbound);
-        if (nunbound>=opt.uinfo.maxunboundfracforiterativeunbind*numingroup[i]) {
-            for (j=0;j<numingroup[i];j++) pfof[pglist[i][j]]=0;
-            numingroup[i]=0;
-            iunbindflag++;
-        }
-        else {
-            //determine if any particle  number of particle with positive energy upto opt.uinfo.maxunbindfrac*numingroup+1
-            maxunbindsize=(Int_t)(opt.uinfo.maxunbindfrac*nunbound+1);
-            Eplusflag=new int[numingroup[i]];
-            nEplusid=new Int_t[numingroup[i]];
-            unbindcheck = CheckGroupForBoundness(opt,Efrac,maxE,numingroup[i]);
-            FillUnboundArrays(opt, maxunbindsize, numingroup[i], gPart[i], Efrac, nEplusid, Eplusflag, nEplus, unbindcheck);
-            while(unbindcheck)
-            {
-                iunbindflag++;
-                unbindloops++;
-                UpdateCMForUnboundParticles(opt, gmass[i], cmvel[i],
-                    numingroup[i], gPart[i], nEplus, nEplusid, Eplusflag);
-                UpdatePotentialForUnboundParticlesPP(opt, numingroup[i], gPart[i],
-                    nEplus, nEplusid, Eplusflag);
-                //remove particles with positive energy
-                RemoveUnboundParticles(i, pfof, numingroup[i], pglist[i], gPart[i], nEplus, nEplusid, Eplusflag);
-                //if number of particles remove with positive energy is near to the number allowed to be removed
-                //must recalculate kinetic energies and check if maxE>0
-                //otherwise, end unbinding.
-                if (nEplus<opt.uinfo.maxallowedunboundfrac*numingroup[i]) {
-                    unbindcheck=false;
-                }
-                else {
-                    sortflag=false;
-                    if ((oldnumingroup-numingroup[i])>opt.uinfo.maxallowedunboundfrac*oldnumingroup) {
-                        oldnumingroup=numingroup[i];
-                        sortflag=true;
-                    }
-                    //recalculate kinetic energies since cmvel has changed
-                    GetBoundFractionAndMaxE(opt, numingroup[i], gPart[i], cmvel[i], Efrac, maxE,nunbound, sortflag);
-                    maxunbindsize=(Int_t)(opt.uinfo.maxunbindfrac*nunbound+1);
-                    unbindcheck = CheckGroupForBoundness(opt,Efrac,maxE,numingroup[i]);
-                    FillUnboundArrays(opt, maxunbindsize, numingroup[i], gPart[i], Efrac, nEplusid, Eplusflag, nEplus, unbindcheck);
-                }
-            }
-            //if group too small remove entirely
-            AdjustPGListForUnbinding(unbindloops,numingroup[i],pglist[i],gPart[i]);
-            RemoveGroup(opt, numingroup[i], pfof, gPart[i], iunbindflag);
-            delete[] nEplusid;
-            delete[] Eplusflag;
-        }
-    }
-#ifdef USEOPENMP
-}
-#endif
-    for (i=1;i<=numgroups;i++) if (numingroup[i]>=ompunbindnum)
-    {
-        unbindloops=0;
-        oldnumingroup = numingroup[i];
-        GetBoundFractionAndMaxE(opt, numingroup[i], gPart[i], cmvel[i], Efrac, maxE, nunbound);
-        //if amount unbound is very large, just remove group entirely
-        if (nunbound>=opt.uinfo.maxunboundfracforiterativeunbind*numingroup[i]) {
-            for (j=0;j<numingroup[i];j++) pfof[pglist[i][j]]=0;
-            numingroup[i]=0;
-            iunbindflag++;
-        }
-        else {
-            //determine if any particle  number of particle with positive energy upto opt.uinfo.maxunbindfrac*numingroup+1
-            maxunbindsize=(Int_t)(opt.uinfo.maxunbindfrac*nunbound+1);
-            nEplusid=new Int_t[numingroup[i]];
-            Eplusflag=new int[numingroup[i]];
-            //check if bound;
-            unbindcheck = CheckGroupForBoundness(opt,Efrac,maxE,numingroup[i]);
-            FillUnboundArrays(opt, maxunbindsize, numingroup[i], gPart[i], Efrac, nEplusid, Eplusflag, nEplus, unbindcheck);
-            while(unbindcheck)
-            {
-                iunbindflag+=1;
-                unbindloops++;
-                UpdateCMForUnboundParticles(opt, gmass[i], cmvel[i],
-                    numingroup[i], gPart[i], nEplus, nEplusid, Eplusflag);
-                UpdatePotentialForUnboundParticles(opt, numingroup[i], gPart[i],
-                    nEplus, nEplusid, Eplusflag);
-                RemoveUnboundParticles(i, pfof, numingroup[i], pglist[i], gPart[i], nEplus, nEplusid, Eplusflag);
-                //if number of particles remove with positive energy is near to the number allowed to be removed
-                //must recalculate kinetic energies and check if maxE>0
-                //otherwise, end unbinding.
-                if (nEplus<opt.uinfo.maxallowedunboundfrac*numingroup[i]) {
-                    unbindcheck=false;
-                    continue;
-                }
-                else{
-                    sortflag=false;
-                    if ((oldnumingroup-numingroup[i])>opt.uinfo.maxallowedunboundfrac*oldnumingroup) {
-                        oldnumingroup=numingroup[i];
-                        sortflag=true;
-                    }
-                    //recalculate kinetic energies since cmvel has changed
-                    GetBoundFractionAndMaxE(opt, numingroup[i], gPart[i], cmvel[i], Efrac, maxE, nunbound,sortflag);
-                    //determine if any particle  number of particle with positive energy upto opt.uinfo.maxunbindfrac*numingroup+1
-                    maxunbindsize=(Int_t)(opt.uinfo.maxunbindfrac*nunbound+1);
-                    unbindcheck = CheckGroupForBoundness(opt,Efrac,maxE,numingroup[i]);
-                    FillUnboundArrays(opt, maxunbindsize, numingroup[i], gPart[i], Efrac, nEplusid, Eplusflag, nEplus, unbindcheck);
-                }
-            }
-            AdjustPGListForUnbinding(unbindloops,numingroup[i],pglist[i],gPart[i]);
-            RemoveGroup(opt, numingroup[i], pfof, gPart[i], iunbindflag);
-            delete[] nEplusid;
-            delete[] Eplusflag;
-        }
-    }
-
+            iunbindflag+=igroupflag;
+        });
     for (i=1;i<=numgroups;i++) if (numingroup[i]==0) ng--;
     if (ireorder==1 && iunbindflag&&ng>0) ReorderGroupIDs(numgroups,ng,numingroup,pfof,pglist);
     delete[] cmvel;
@@ -1143,6 +1307,78 @@ void ParticleSubSample(Options &opt, const Int_t nbodies, Particle *&Part,
     }
 }
 
+/*! Builds the tree of a group that is kept across unbinding iterations. The kd-tree is built on a copy of the particles
+    so the order of the group is unchanged, and only the cell structure, fixed cell reference points and opening distances
+    and the tree ordered positions and masses are kept. Particles are identified by their PID.
+*/
+void BuildIncrementalPotentialTree(Options &opt, Int_t nbodies, Particle *Part, IncrementalPotentialTree &ptree)
+{
+    int bsize = opt.uinfo.BucketSize;
+    Int_t ncell;
+    Node **nodelist;
+    Particle *part = new Particle[nbodies];
+    for (auto i=0;i<nbodies;i++) part[i]=Part[i];
+    KDTree *tree = new KDTree(part, nbodies, bsize, tree->TPHYS, tree->KEPAN, 100);
+
+    ncell=tree->GetNumNodes();
+    nodelist=new Node*[ncell];
+    ncell=0;
+    GetNodeList(tree->GetRoot(),ncell,nodelist,bsize);
+    ncell++;
+
+    ptree.nbodies=nbodies;
+    ptree.ncell=ncell;
+    ptree.pdata.Fill(nbodies, part);
+    ptree.pidindex.clear();
+    ptree.pidindex.reserve(nbodies);
+    for (auto i=0;i<nbodies;i++) ptree.pidindex[part[i].GetPID()]=i;
+    ptree.start.resize(ncell);
+    ptree.end.resize(ncell);
+    ptree.left.resize(ncell);
+    ptree.right.resize(ncell);
+    ptree.cellref.resize(ncell);
+    ptree.cR2max.resize(ncell);
+    ptree.dmass.assign(ncell,0);
+    ptree.ddipole.assign(3*ncell,0);
+    ptree.dsecond.assign(NQUADCOMP*ncell,0);
+    ptree.removed.assign(nbodies,0);
+    for (auto j=0;j<ncell;j++) {
+        Double_t mtot=0, bmax=0, r2;
+        ptree.start[j]=nodelist[j]->GetStart();
+        ptree.end[j]=nodelist[j]->GetEnd();
+        //GetNodeList numbers the cells in pre-order with SetID, so a child's id is its index in nodelist
+        //and the left child immediately follows its parent
+        if (nodelist[j]->GetCount()>bsize) {
+            ptree.left[j]=((SplitNode*)nodelist[j])->GetLeft()->GetID();
+            ptree.right[j]=((SplitNode*)nodelist[j])->GetRight()->GetID();
+            assert(ptree.left[j]==j+1 && nodelist[ptree.left[j]]==((SplitNode*)nodelist[j])->GetLeft());
+            assert(ptree.right[j]>ptree.left[j] && ptree.right[j]<ncell && nodelist[ptree.right[j]]==((SplitNode*)nodelist[j])->GetRight());
+        }
+        else ptree.left[j]=ptree.right[j]=-1;
+        ptree.cellref[j]=Coordinate(0.);
+        for (auto k=ptree.start[j];k<ptree.end[j];k++) {
+            for (auto n=0;n<3;n++) ptree.cellref[j][n]+=part[k].GetPosition(n)*part[k].GetMass();
+            mtot+=part[k].GetMass();
+        }
+        ptree.cellref[j]*=1.0/mtot;
+        for (auto k=ptree.start[j];k<ptree.end[j];k++) {
+            r2=0;
+            for (auto n=0;n<3;n++) r2+=(part[k].GetPosition(n)-ptree.cellref[j][n])*(part[k].GetPosition(n)-ptree.cellref[j][n]);
+            if (r2>bmax) bmax=r2;
+        }
+        ptree.cR2max[j]=4.0/3.0*bmax/(opt.uinfo.TreeThetaOpen*opt.uinfo.TreeThetaOpen);
+    }
+    delete[] nodelist;
+    delete tree;
+    delete[] part;
+}
+
+/*! Calculates the tree potential of particles. The tree can be walked either once for every particle, using
+    monopole cell moments (\ref POTTREEMETHODPARTICLE), or once for every sink cell containing at most
+    \ref UnbindInfo.TreeGroupSize particles, using quadrupole cell moments (\ref POTTREEMETHODGROUP).
+    The group walk shares a single interaction list between all particles in a sink and the quadrupole moments
+    allow the same accuracy to be reached with far fewer interactions for a given \ref UnbindInfo.TreeThetaOpen.
+*/
 void PotentialTree(Options &opt, Int_t nbodies, Particle *&Part, KDTree* &tree)
 {
     Int_t ntreecell, nleafcell;
@@ -1150,14 +1386,15 @@ void PotentialTree(Options &opt, Int_t nbodies, Particle *&Part, KDTree* &tree)
     int bsize = opt.uinfo.BucketSize;
     int nthreads = 1;
     //for tree code potential calculation
-    Int_t ncell;
+    Int_t ncell, nsink;
     Int_t *start,*end;
-    Double_t *cmtot,*cBmax,*cR2max, **r2val;
+    Double_t *cmtot,*cBmax,*cR2max, **r2val, *cellquad;
     Coordinate *cellcm;
     Node *root;
-    Node **nodelist, **npomp;
+    Node **nodelist, **npomp, **sinklist;
     Int_t **marktreecell,**markleafcell;
-    bool runomp = false;
+    bool runomp = false, igroupwalk = (opt.uinfo.TreeWalkMethod == POTTREEMETHODGROUP);
+    unsigned long long ncellinteractions = 0, nppinteractions = 0;
 #ifdef USEOPENMP
     runomp = (nbodies > POTOMPCALCNUM);
     nthreads = omp_get_max_threads();
@@ -1173,6 +1410,9 @@ void PotentialTree(Options &opt, Int_t nbodies, Particle *&Part, KDTree* &tree)
     cBmax=new Double_t[ncell];
     cR2max=new Double_t[ncell];
     cellcm=new Coordinate[ncell];
+    //quadrupole moments are only needed when walking the tree for groups
+    cellquad=NULL;
+    if (igroupwalk) cellquad=new Double_t[NQUADCOMP*ncell];
     //to store note list
     nodelist=new Node*[ncell];
 
@@ -1214,11 +1454,77 @@ void PotentialTree(Options &opt, Int_t nbodies, Particle *&Part, KDTree* &tree)
         }
         cBmax[j]=xdiff;
         cR2max[j]=4.0/3.0*xdiff*xdiff/(opt.uinfo.TreeThetaOpen*opt.uinfo.TreeThetaOpen);
+        //traceless quadrupole moment about the cm, Q_ij = sum m (3 x_i x_j - r^2 delta_ij)
+        if (igroupwalk) {
+            Double_t *quad=&cellquad[NQUADCOMP*j], dx[3], dr2;
+            for (auto n=0;n<NQUADCOMP;n++) quad[n]=0;
+            for (auto k=start[j];k<end[j];k++) {
+                for (auto n=0;n<3;n++) dx[n]=Part[k].GetPosition(n)-cellcm[j][n];
+                dr2=dx[0]*dx[0]+dx[1]*dx[1]+dx[2]*dx[2];
+                quad[0]+=Part[k].GetMass()*(3.0*dx[0]*dx[0]-dr2);
+                quad[1]+=Part[k].GetMass()*(3.0*dx[1]*dx[1]-dr2);
+                quad[2]+=Part[k].GetMass()*(3.0*dx[2]*dx[2]-dr2);
+                quad[3]+=Part[k].GetMass()*3.0*dx[0]*dx[1];
+                quad[4]+=Part[k].GetMass()*3.0*dx[0]*dx[2];
+                quad[5]+=Part[k].GetMass()*3.0*dx[1]*dx[2];
+            }
+        }
     }
 #ifdef USEOPENMP
 }
 #endif
 
+    //packed positions and masses for the direct summation over leaf cells
+    PackedParticleData pdata(nbodies, Part);
+
+    if (igroupwalk) {
+        //walk the tree once for each sink cell and use the resulting interaction list for all particles in the sink
+        sinklist=new Node*[ncell];
+        nsink=0;
+        GetSinkNodeList(root,nsink,sinklist,bsize,max(opt.uinfo.TreeGroupSize,bsize));
+#ifdef USEOPENMP
+#pragma omp parallel default(shared)  \
+private(ntreecell,nleafcell,r2) if (runomp)
+{
+    #pragma omp for schedule(dynamic) reduction(+:ncellinteractions,nppinteractions)
+#endif
+        for (auto isink=0;isink<nsink;isink++) {
+            int tid;
+#ifdef USEOPENMP
+            tid=omp_get_thread_num();
+#else
+            tid=0;
+#endif
+            Int_t sid=sinklist[isink]->GetID();
+            ntreecell=nleafcell=0;
+            MarkCellGroup(root, marktreecell[tid], markleafcell[tid], ntreecell, nleafcell, bsize, cR2max, cellcm,
+                cellcm[sid], cBmax[sid], start[sid], end[sid]);
+            ncellinteractions+=ntreecell*(end[sid]-start[sid]);
+            for (auto j=start[sid];j<end[sid];j++) {
+                Double_t pot=0, dx[3];
+                Coordinate xpos(Part[j].GetPosition());
+                for (auto k=0;k<ntreecell;k++) {
+                    Int_t nid=marktreecell[tid][k];
+                    for (auto n=0;n<3;n++) dx[n]=xpos[n]-cellcm[nid][n];
+                    pot+=CellQuadrupolePotential(dx, cmtot[nid], &cellquad[NQUADCOMP*nid], eps2);
+                }
+                for (auto k=0;k<nleafcell;k++) {
+                    pot-=PotentialPPKernel(pdata, j, start[markleafcell[tid][k]], end[markleafcell[tid][k]], eps2);
+                    nppinteractions+=end[markleafcell[tid][k]]-start[markleafcell[tid][k]];
+                }
+                pot*=Part[j].GetMass()*opt.G;
+#ifdef NOMASS
+                pot*=mv2;
+#endif
+                Part[j].SetPotential(pot);
+            }
+        }
+#ifdef USEOPENMP
+}
+#endif
+        delete[] sinklist;
+    }
+    else {
     //then for each cell find all other cells that contain Particles within a cells gRmax and mark those
     //and mark all cells for which one does not have to unfold
     //for marked cells calculate pp, for every other cell just use the CM of the cell to calculate the potential.
@@ -1226,7 +1532,7 @@ void PotentialTree(Options &opt, Int_t nbodies, Particle *&Part, KDTree* &tree)
 #pragma omp parallel default(shared)  \
 private(ntreecell,nleafcell,r2) if (runomp)
 {
-    #pragma omp for schedule(static)
+    #pragma omp for schedule(static) reduction(+:ncellinteractions,nppinteractions)
 #endif
     for (auto j=0;j<nbodies;j++) {
         int tid;
@@ -1240,20 +1546,16 @@ private(ntreecell,nleafcell,r2) if (runomp)
         ntreecell=nleafcell=0;
         Coordinate xpos(Part[j].GetPosition());
         MarkCell(npomp[tid],marktreecell[tid], markleafcell[tid],ntreecell,nleafcell,r2val[tid],bsize, cR2max, cellcm, cmtot, xpos, eps2);
+        ncellinteractions+=ntreecell;
         for (auto k=0;k<ntreecell;k++) {
           Part[j].SetPotential(Part[j].GetPotential()-Part[j].GetMass()*r2val[tid][k]);
         }
+        r2=0;
         for (auto k=0;k<nleafcell;k++) {
-            for (auto l=start[markleafcell[tid][k]];l<end[markleafcell[tid][k]];l++) {
-                if (j!=l) {
-                    r2=0.;
-                    for (auto n=0;n<3;n++) r2+=pow(Part[j].GetPosition(n)-Part[l].GetPosition(n),(Double_t)2.0);
-                    r2+=eps2;
-                    r2=1.0/sqrt(r2);
-                    Part[j].SetPotential(Part[j].GetPotential()-(Part[j].GetMass()*Part[l].GetMass())*r2);
-                }
-            }
+            r2+=PotentialPPKernel(pdata, j, start[markleafcell[tid][k]], end[markleafcell[tid][k]], eps2);
+            nppinteractions+=end[markleafcell[tid][k]]-start[markleafcell[tid][k]];
         }
+        Part[j].SetPotential(Part[j].GetPotential()-Part[j].GetMass()*r2);
         Part[j].SetPotential(Part[j].GetPotential()*opt.G);
 #ifdef NOMASS
         Part[j].SetPotential(Part[j].GetPotential()*mv2);
@@ -1262,6 +1564,10 @@ private(ntreecell,nleafcell,r2) if (runomp)
 #ifdef USEOPENMP
 }
 #endif
+    }
+
+    LOG(trace) << "Tree potential of " << nbodies << " particles used " << ncellinteractions << " cell and "
+        << nppinteractions << " particle interactions";
 
     delete[] start;
     delete[] end;
@@ -1269,6 +1575,7 @@ private(ntreecell,nleafcell,r2) if (runomp)
     delete[] cBmax;
     delete[] cR2max;
     delete[] cellcm;
+    if (cellquad!=NULL) delete[] cellquad;
     delete[] nodelist;
     for (auto j=0;j<nthreads;j++) {delete[] marktreecell[j]; delete[] markleafcell[j]; delete[] r2val[j];}
     delete[] marktreecell;
@@ -1320,21 +1627,19 @@ if (runomp)
 }
 
 
+///Direct summation potential. Positions and masses are first packed into a structure of arrays
+///so that the pairwise kernel is vectorised.
 void PotentialPP(Options &opt, Int_t nbodies, Particle *Part)
 {
-    Double_t r2, pot, poti, eps2=opt.uinfo.eps*opt.uinfo.eps, mv2=opt.MassValue*opt.MassValue;
-    for (auto j=0;j<nbodies;j++) Part[j].SetPotential(0.);
+    Double_t poti, eps2=opt.uinfo.eps*opt.uinfo.eps, mv2=opt.MassValue*opt.MassValue;
+    PackedParticleData pdata(nbodies, Part);
+    vector<Double_t> pot(nbodies,0);
+    for (auto j=0;j<nbodies;j++) pot[j]+=PotentialPPSymmetricKernel(pdata, j, nbodies, eps2, pot.data());
     for (auto j=0;j<nbodies;j++) {
-        for (auto k=j+1;k<nbodies;k++) {
-            r2=0.;for (auto n=0;n<3;n++) r2+=pow(Part[j].GetPosition(n)-Part[k].GetPosition(n),2.0);
-            r2+=eps2;
-            r2=1.0/sqrt(r2);
-            pot=-opt.G*(Part[j].GetMass()*Part[k].GetMass())*r2;
-            poti=Part[j].GetPotential()+pot;Part[j].SetPotential(poti);
-            poti=Part[k].GetPotential()+pot;Part[k].SetPotential(poti);
-        }
-    }
+        poti=-opt.G*pdata.mass[j]*pot[j];
     #ifdef NOMASS
-    for (auto j=0;j<nbodies;j++) Part[j].SetPotential(Part[j].GetPotential()*mv2);
+        poti*=mv2;
     #endif
+        Part[j].SetPotential(poti);
+    }
 }
@@ -0,0 +1,93 @@
+/**
+ * @file
+ *
+ * Lock-free union-find shared by the threads linking groups
+ */
+
+#ifndef VR_UNIONFIND_H_
+#define VR_UNIONFIND_H_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "allvars.h"
+
+
+namespace vr {
+
+/**
+ * A union-find over the labels [0, size) which any number of threads may link
+ * and query at the same time without locks.
+ *
+ * A root is only ever linked below a smaller root, with a compare-and-swap that
+ * fails if the root was linked elsewhere meanwhile, in which case the link is
+ * retried from the new roots. The root of a set is therefore always its smallest
+ * label, whatever the order of the links. Finds halve the paths they walk, again
+ * with a compare-and-swap, as a parent only ever moves to a smaller label.
+ */
+class ConcurrentUnionFind {
+
+public:
+
+	/// Creates a set for each of the given number of labels
+	explicit ConcurrentUnionFind(Int_t size)
+	  : parent(new std::atomic<Int_t>[size]), nlabels(size)
+	{
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (size > ompsearchnum)
+#endif
+		for (Int_t i = 0; i < size; i++) {
+			parent[i].store(i, std::memory_order_relaxed);
+		}
+	}
+
+	/// The number of labels
+	Int_t size() const { return nlabels; }
+
+	/// The root, and so smallest label, of the set holding a label
+	Int_t find(Int_t label)
+	{
+		while (true) {
+			Int_t p = parent[label].load(std::memory_order_acquire);
+			if (p == label) {
+				return label;
+			}
+			Int_t grandparent = parent[p].load(std::memory_order_acquire);
+			if (grandparent != p) {
+				// path halving, left as it is if another thread moved the parent first
+				parent[label].compare_exchange_weak(p, grandparent, std::memory_order_acq_rel);
+			}
+			label = grandparent;
+		}
+	}
+
+	/// Merges the sets holding two labels, returning whether they were separate
+	bool unite(Int_t a, Int_t b)
+	{
+		while (true) {
+			a = find(a);
+			b = find(b);
+			if (a == b) {
+				return false;
+			}
+			if (a < b) {
+				std::swap(a, b);
+			}
+			Int_t expected = a;
+			if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) {
+				return true;
+			}
+		}
+	}
+
+private:
+
+	std::unique_ptr<std::atomic<Int_t>[]> parent;
+	Int_t nlabels;
+
+};
+
+}  // namespace vr
+
+#endif // VR_UNIONFIND_H_
@@ -2,6 +2,9 @@
  *  \brief this file contains an assortment of utilities
  */
 
+#include <cstring>
+#include <type_traits>
+
 #include "ioutils.h"
 #include "logging.h"
 #include "stf.h"
@@ -118,6 +121,179 @@ void InitMemUsageLog(Options &opt){
     Fmem.close();
 }
 
+/// \name Radix sorting
+//@{
+
+///below this many elements a sort is done by insertion, which is faster than the fixed cost of the radix passes
+#define RADIXSORTMINNUM 64
+
+/*! Scratch space of a sort. Sorts of up to ompsortsize elements, such as the many per group sorts done inside
+    parallel loops, reuse a buffer kept by each thread so that they do not allocate. Larger sorts allocate their
+    own so that their memory is not held afterwards. The tag separates buffers of the same type used at once.
+*/
+template<typename T, int tag> class RadixSortScratch {
+public:
+    RadixSortScratch(Int_t n) {
+        if (n>ompsortsize) {
+            large.resize(n);
+            ptr=large.data();
+        }
+        else {
+            static thread_local vector<T> small;
+            if ((Int_t)small.size()<n) small.resize(n);
+            ptr=small.data();
+        }
+    }
+    T *data() {return ptr;}
+private:
+    vector<T> large;
+    T *ptr;
+};
+
+///order preserving map of signed integers to unsigned keys
+template<typename T> static inline typename enable_if<is_integral<T>::value && is_signed<T>::value, unsigned long long>::type
+RadixSortKey(T x)
+{
+    return (unsigned long long)(long long)x ^ (1ULL<<63);
+}
+
+template<typename T> static inline typename enable_if<is_integral<T>::value && is_unsigned<T>::value, unsigned long long>::type
+RadixSortKey(T x)
+{
+    return (unsigned long long)x;
+}
+
+///order preserving map of floating point values to unsigned keys, flipping all bits of negative values and the sign bit of others
+static inline unsigned long long RadixSortKey(double x)
+{
+    unsigned long long u;
+    memcpy(&u, &x, sizeof(u));
+    return (u>>63) ? ~u : u|(1ULL<<63);
+}
+
+/*! Stably sorts indices so that keys[indices[i]] is ascending using an LSD radix sort on 8 bit digits.
+    Digits that are the same for all keys are skipped, so small keys need few passes. Each pass builds
+    per-thread histograms over contiguous chunks, which keeps the sort stable when threaded.
+    Sorting the same indices by several keys in turn, least significant first, sorts by the combined key.
+    Threads are only used for large sorts outside parallel regions, so sorts of single groups can be run
+    from within parallel loops.
+*/
+void RadixSortIndices(const Int_t n, const unsigned long long *keys, Int_t *indices)
+{
+    if (n<=1) return;
+    if (n<=RADIXSORTMINNUM) {
+        for (Int_t i=1;i<n;i++) {
+            Int_t index=indices[i], j=i;
+            for (;j>0 && keys[indices[j-1]]>keys[index];j--) indices[j]=indices[j-1];
+            indices[j]=index;
+        }
+        return;
+    }
+    int nthreads=1;
+    unsigned long long keyor=0, keyand=~0ULL, varying;
+#ifdef USEOPENMP
+    if (n>ompsortsize && !omp_in_parallel()) nthreads=omp_get_max_threads();
+#pragma omp parallel for reduction(|:keyor) reduction(&:keyand) num_threads(nthreads) if (nthreads>1)
+#endif
+    for (Int_t i=0;i<n;i++) {
+        keyor|=keys[i];
+        keyand&=keys[i];
+    }
+    varying=keyor^keyand;
+    if (varying==0) return;
+
+    RadixSortScratch<Int_t,0> buffer(n);
+    vector<Int_t> counts(256*nthreads);
+    Int_t *in=indices, *out=buffer.data();
+    for (int shift=0;shift<64;shift+=8) {
+        if (((varying>>shift)&0xFF)==0) continue;
+#ifdef USEOPENMP
+#pragma omp parallel default(shared) num_threads(nthreads) if (nthreads>1)
+{
+#endif
+        int tid=0, nteam=1;
+#ifdef USEOPENMP
+        tid=omp_get_thread_num();
+        nteam=omp_get_num_threads();
+#endif
+        Int_t start=n*tid/nteam, end=n*(tid+1)/nteam;
+        Int_t *count=&counts[256*tid];
+        for (auto d=0;d<256;d++) count[d]=0;
+        for (Int_t i=start;i<end;i++) count[(keys[in[i]]>>shift)&0xFF]++;
+#ifdef USEOPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+        {
+            //offsets ordered by digit and then by thread
+            Int_t offset=0, c;
+            for (auto d=0;d<256;d++) for (auto t=0;t<nteam;t++) {
+                c=counts[256*t+d];
+                counts[256*t+d]=offset;
+                offset+=c;
+            }
+        }
+        for (Int_t i=start;i<end;i++) out[count[(keys[in[i]]>>shift)&0xFF]++]=in[i];
+#ifdef USEOPENMP
+}
+#endif
+        swap(in,out);
+    }
+    if (in!=indices) copy(in, in+n, indices);
+}
+
+///reorders particles in place so that Part[i] becomes the particle that was at Part[indices[i]], following the cycles
+///of the permutation so that each particle is moved once
+void PermuteParticles(const Int_t n, Particle *Part, const Int_t *indices)
+{
+    RadixSortScratch<char,1> done(n);
+    char *isdone=done.data();
+    for (Int_t i=0;i<n;i++) isdone[i]=0;
+    for (Int_t i=0;i<n;i++) {
+        if (isdone[i] || indices[i]==i) continue;
+        Particle ptemp=std::move(Part[i]);
+        Int_t j=i, k;
+        while (true) {
+            isdone[j]=1;
+            k=indices[j];
+            if (k==i) {Part[j]=std::move(ptemp); break;}
+            Part[j]=std::move(Part[k]);
+            j=k;
+        }
+    }
+}
+
+/*! Sorts particles in ascending order of one of their properties, see \ref PSORTID and following for the properties,
+    which match the NBodylib comparison functions used with qsort. Keys are radix sorted along with the particle
+    indices and the particles are then moved once into place, rather than moved through every comparison.
+    Unlike qsort the sort is stable.
+*/
+void SortParticles(const Int_t n, Particle *Part, int sortkey)
+{
+    if (n<=1) return;
+    RadixSortScratch<unsigned long long,0> keybuffer(n);
+    RadixSortScratch<Int_t,1> indexbuffer(n);
+    unsigned long long *keys=keybuffer.data();
+    Int_t *indices=indexbuffer.data();
+#ifdef USEOPENMP
+#pragma omp parallel for schedule(static) if (n>ompsortsize && !omp_in_parallel())
+#endif
+    for (Int_t i=0;i<n;i++) {
+        indices[i]=i;
+        switch (sortkey) {
+            case PSORTID: keys[i]=RadixSortKey(Part[i].GetID()); break;
+            case PSORTPID: keys[i]=RadixSortKey(Part[i].GetPID()); break;
+            case PSORTTYPE: keys[i]=RadixSortKey(Part[i].GetType()); break;
+            case PSORTRADIUS: keys[i]=RadixSortKey((double)Part[i].Radius()); break;
+            case PSORTPOTENTIAL: keys[i]=RadixSortKey((double)Part[i].GetPotential()); break;
+            case PSORTDENSITY: keys[i]=RadixSortKey((double)Part[i].GetDensity()); break;
+        }
+    }
+    RadixSortIndices(n, keys, indices);
+    PermuteParticles(n, Part, indices);
+}
+//@}
+
 #ifdef NOMASS
 void VR_NOMASS(){};
 #endif